@@ -0,0 +1,428 @@
+/**
+ * \file
+ * \brief	CPU pinning and scheduling class configuration for the daemon threads
+ *
+ * @author	Dominic Eschweiler weiler@upb.de
+ *
+ * Status	: STABLE \n
+ * Date of creation : 18.10.2026
+ *
+ */
+
+
+/*****************************************************************
+ *
+ * Barracuda is a experimental microdriver extension to the 
+ * linux-kernel that is able to outsource common functions to
+ * the userspace. It was intensionally designed to accelerate
+ * CPU-intensive Tasks on a GPU.
+ *
+ * Copyright (C) 2009 Dominic Eschweiler
+ *
+ * This program is free software; you can redistribute it and/or 
+ * modify it under the terms of the GNU General Public License as 
+ * published by the Free Software Foundation; either only GPLv2 - 
+ * version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful, 
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of 
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the 
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public 
+ * License along with this program; 
+ * if not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <sched.h>
+#include <syslog.h>
+
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+
+# include "affinity.h"
+# include "service.h"
+
+HOST static int parse_cpulist(char *cpulist, cpu_set_t *set);
+HOST static int read_sysfs_cpulist(char *path, cpu_set_t *set);
+HOST static void cpuset_to_string(cpu_set_t *set, char *buffer, int length);
+
+#define AFFINITY_MAX_GROUPS	256
+#define AFFINITY_MAX_CPUS	1024
+
+/*
+ * Every role owns a list of cpu groups. The n-th thread of a role is pinned to
+ * group n modulo the number of groups.
+ */
+struct affinity_role{
+	int				configured;
+	cpu_set_t		groups[AFFINITY_MAX_GROUPS];
+	int				number_of_groups;
+	int				sched_configured;
+	int				policy;
+	int				priority;
+	int				nice;
+	volatile int	next_slot;
+	};
+
+static struct affinity_role roles[AFFINITY_ROLES];
+static char *role_names[AFFINITY_ROLES] = { "server", "worker" };
+
+static cpu_set_t online_cpus;
+static cpu_set_t isolated_cpus;
+static cpu_set_t housekeeping_cpus;
+
+
+
+/**
+ * Reads the online and the isolated (isolcpus=) cpus of the system. Threads of
+ * a role without an explicit cpu list are kept away from isolated cpus.
+ *
+ * @returns	 void
+ */
+
+HOST void affinity_init(void)
+{
+int i;
+
+CPU_ZERO(&isolated_cpus);
+CPU_ZERO(&housekeeping_cpus);
+
+if( read_sysfs_cpulist("/sys/devices/system/cpu/online", &online_cpus) == EXIT_FAILURE ){
+	CPU_ZERO(&online_cpus);
+	for(i=0; i<get_number_of_phys_cpus(); i++){
+		CPU_SET(i, &online_cpus);
+		}
+	}
+
+/* the file is empty or missing if there are no isolated cpus */
+read_sysfs_cpulist("/sys/devices/system/cpu/isolated", &isolated_cpus);
+
+for(i=0; i<AFFINITY_MAX_CPUS && i<CPU_SETSIZE; i++){
+	if( CPU_ISSET(i, &online_cpus) && !CPU_ISSET(i, &isolated_cpus) ){
+		CPU_SET(i, &housekeeping_cpus);
+		}
+	}
+
+/* everything is isolated, nothing to keep away from */
+if( CPU_COUNT(&housekeeping_cpus) == 0 ){
+	memcpy(&housekeeping_cpus, &online_cpus, sizeof(cpu_set_t));
+	}
+}
+
+
+
+/**
+ * Sets the cpus of a role. The list uses the sysfs format (e.g. "0-3,8") and
+ * the keyword "iso" stands for all isolated cpus. Workers are pinned round
+ * robin to the single cpus of the list; groups separated by '/' (e.g.
+ * "2-3/4-5") give every worker a cpuset instead.
+ *
+ * @param role		: AFFINITY_SERVER or AFFINITY_WORKER
+ * @param *cpulist	: cpu list
+ *
+ * @returns	 EXIT_SUCCESS or EXIT_FAILURE on a malformed list
+ */
+
+HOST int affinity_set_cpus(int role, char *cpulist)
+{
+struct affinity_role *r = &roles[role];
+char buffer[256];
+char *group;
+char *save;
+cpu_set_t set;
+int i;
+
+if( strlen(cpulist) >= sizeof(buffer) ){ return EXIT_FAILURE; }
+strcpy(buffer, cpulist);
+
+r->number_of_groups = 0;
+
+if( (strchr(buffer, '/') != NULL) || (role == AFFINITY_SERVER) ){
+	/* every group is one cpuset */
+	for(group = strtok_r(buffer, "/", &save); group != NULL; group = strtok_r(NULL, "/", &save)){
+		if( r->number_of_groups == AFFINITY_MAX_GROUPS ){ return EXIT_FAILURE; }
+		if( parse_cpulist(group, &r->groups[r->number_of_groups]) == EXIT_FAILURE ){
+			return EXIT_FAILURE;
+			}
+		r->number_of_groups++;
+		}
+	}
+else{
+	/* every single cpu is its own group */
+	if( parse_cpulist(buffer, &set) == EXIT_FAILURE ){ return EXIT_FAILURE; }
+
+	for(i=0; i<AFFINITY_MAX_CPUS && i<CPU_SETSIZE; i++){
+		if( !CPU_ISSET(i, &set) ){ continue; }
+		if( r->number_of_groups == AFFINITY_MAX_GROUPS ){ break; }
+
+		CPU_ZERO(&r->groups[r->number_of_groups]);
+		CPU_SET(i, &r->groups[r->number_of_groups]);
+		r->number_of_groups++;
+		}
+	}
+
+if( r->number_of_groups == 0 ){ return EXIT_FAILURE; }
+
+r->configured = 1;
+return EXIT_SUCCESS;
+}
+
+
+
+/**
+ * Sets the scheduling class of a role. Valid are "FIFO:<priority>" and
+ * "OTHER:<nice>".
+ *
+ * @param role		: AFFINITY_SERVER or AFFINITY_WORKER
+ * @param *policy	: policy string
+ *
+ * @returns	 EXIT_SUCCESS or EXIT_FAILURE on a malformed policy
+ */
+
+HOST int affinity_set_sched(int role, char *policy)
+{
+struct affinity_role *r = &roles[role];
+char *value = strchr(policy, ':');
+int number = 0;
+
+if(value != NULL){ number = atoi(value+1); }
+
+if( strncmp(policy, "FIFO", 4) == 0 ){
+	if( (number < sched_get_priority_min(SCHED_FIFO)) ||
+		(number > sched_get_priority_max(SCHED_FIFO)) ){
+		return EXIT_FAILURE;
+		}
+	r->policy	= SCHED_FIFO;
+	r->priority	= number;
+	}
+else if( strncmp(policy, "OTHER", 5) == 0 ){
+	if( (number < -20) || (number > 19) ){ return EXIT_FAILURE; }
+	r->policy	= SCHED_OTHER;
+	r->nice		= number;
+	}
+else{
+	return EXIT_FAILURE;
+	}
+
+r->sched_configured = 1;
+return EXIT_SUCCESS;
+}
+
+
+
+/**
+ * Pins the calling thread and applies its scheduling class. Every call of the
+ * worker role takes the next worker slot. The calls work on the calling
+ * kernel thread, so this is also valid for the cloned daemon process.
+ *
+ * @param role		: AFFINITY_SERVER or AFFINITY_WORKER
+ *
+ * @returns	 EXIT_SUCCESS or EXIT_FAILURE if a setting was refused
+ */
+
+HOST int affinity_apply(int role)
+{
+struct affinity_role *r = &roles[role];
+struct sched_param param;
+int slot = __sync_fetch_and_add(&r->next_slot, 1);
+int retval = EXIT_SUCCESS;
+
+if( r->configured ){
+	if( sched_setaffinity(0, sizeof(cpu_set_t), &r->groups[slot % r->number_of_groups]) != 0 ){
+		syslog(LOG_NOTICE, "Pinning %s %d failed : %s\n", role_names[role], slot, strerror(errno));
+		retval = EXIT_FAILURE;
+		}
+	}
+else if( CPU_COUNT(&isolated_cpus) > 0 ){
+	/* honor isolcpus= for threads which were not pinned explicitly */
+	sched_setaffinity(0, sizeof(cpu_set_t), &housekeeping_cpus);
+	}
+
+if( r->sched_configured ){
+	memset(&param, 0, sizeof(param));
+	param.sched_priority = (r->policy == SCHED_FIFO) ? r->priority : 0;
+
+	if( sched_setscheduler(0, r->policy, &param) != 0 ){
+		syslog(LOG_NOTICE, "Scheduling class for %s %d refused : %s\n", role_names[role], slot, strerror(errno));
+		retval = EXIT_FAILURE;
+		}
+
+	if( (r->policy == SCHED_OTHER) &&
+		(setpriority(PRIO_PROCESS, syscall(SYS_gettid), r->nice) != 0) ){
+		syslog(LOG_NOTICE, "Nice value for %s %d refused : %s\n", role_names[role], slot, strerror(errno));
+		retval = EXIT_FAILURE;
+		}
+	}
+
+return retval;
+}
+
+
+
+/**
+ * Reports the pinning map to the syslog.
+ *
+ * @returns	 void
+ */
+
+HOST void affinity_report(void)
+{
+struct affinity_role *r;
+char cpus[256];
+char sched[32];
+int role;
+int i;
+
+cpuset_to_string(&isolated_cpus, cpus, sizeof(cpus));
+syslog(LOG_NOTICE, "Isolated cpus : %s\n", cpus);
+
+for(role=0; role<AFFINITY_ROLES; role++){
+	r = &roles[role];
+
+	if( !r->sched_configured ){ strcpy(sched, "inherited"); }
+	else if( r->policy == SCHED_FIFO ){ sprintf(sched, "FIFO priority %d", r->priority); }
+	else{ sprintf(sched, "OTHER nice %d", r->nice); }
+
+	if( !r->configured ){
+		cpuset_to_string(&housekeeping_cpus, cpus, sizeof(cpus));
+		syslog(LOG_NOTICE, "%s : cpus %s (not pinned), %s\n", role_names[role], cpus, sched);
+		continue;
+		}
+
+	for(i=0; i<r->number_of_groups; i++){
+		cpuset_to_string(&r->groups[i], cpus, sizeof(cpus));
+		syslog(LOG_NOTICE, "%s %d : cpus %s, %s\n", role_names[role], i, cpus, sched);
+		}
+	}
+}
+
+
+
+/*HELPER_FUNCTIONS____________________________________________________________*/
+/**
+ * Parses a cpu list in the sysfs format, e.g. "0-3,8". The keyword "iso" adds
+ * all isolated cpus.
+ *
+ * @param *cpulist	: cpu list
+ * @param *set		: resulting cpu set
+ *
+ * @returns	 EXIT_SUCCESS or EXIT_FAILURE on a malformed list
+ */
+
+HOST static int parse_cpulist(char *cpulist, cpu_set_t *set)
+{
+char buffer[256];
+char *token;
+char *save;
+char *end;
+long first, last;
+int i;
+
+CPU_ZERO(set);
+
+if( strlen(cpulist) >= sizeof(buffer) ){ return EXIT_FAILURE; }
+strcpy(buffer, cpulist);
+
+for(token = strtok_r(buffer, ",\n", &save); token != NULL; token = strtok_r(NULL, ",\n", &save)){
+	if( strcmp(token, "iso") == 0 ){
+		CPU_OR(set, set, &isolated_cpus);
+		continue;
+		}
+
+	first = strtol(token, &end, 10);
+	last  = first;
+	if( end == token ){ return EXIT_FAILURE; }
+	if( *end == '-' ){
+		token = end+1;
+		last = strtol(token, &end, 10);
+		if( end == token ){ return EXIT_FAILURE; }
+		}
+	if( (*end != '\0') || (first < 0) || (last < first) || (last >= AFFINITY_MAX_CPUS) ){
+		return EXIT_FAILURE;
+		}
+
+	for(i=first; i<=last; i++){
+		CPU_SET(i, set);
+		}
+	}
+
+return (CPU_COUNT(set) > 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+
+
+/**
+ * Reads a cpu list from a sysfs file.
+ *
+ * @param *path		: sysfs file
+ * @param *set		: resulting cpu set
+ *
+ * @returns	 EXIT_SUCCESS or EXIT_FAILURE if the file is missing or empty
+ */
+
+HOST static int read_sysfs_cpulist(char *path, cpu_set_t *set)
+{
+FILE *fpointer;
+char buffer[256];
+
+CPU_ZERO(set);
+
+fpointer = fopen(path, "r");
+if(fpointer == NULL){ return EXIT_FAILURE; }
+
+if( fgets(buffer, sizeof(buffer), fpointer) == NULL ){
+	fclose(fpointer);
+	return EXIT_FAILURE;
+	}
+fclose(fpointer);
+
+return parse_cpulist(buffer, set);
+}
+
+
+
+/**
+ * Formats a cpu set as cpu list. Isolated cpus are marked with a '*'.
+ *
+ * @param *set		: cpu set
+ * @param *buffer	: output buffer
+ * @param length	: size of the output buffer
+ *
+ * @returns	 void
+ */
+
+HOST static void cpuset_to_string(cpu_set_t *set, char *buffer, int length)
+{
+int i, j;
+int used = 0;
+
+buffer[0] = '\0';
+
+for(i=0; i<AFFINITY_MAX_CPUS && i<CPU_SETSIZE; i++){
+	if( !CPU_ISSET(i, set) ){ continue; }
+
+	for(j=i; (j+1)<CPU_SETSIZE && CPU_ISSET(j+1, set); j++);
+
+	if(j == i){
+		used += snprintf(&buffer[used], length-used, "%s%d%s", used ? "," : "", i,
+						 CPU_ISSET(i, &isolated_cpus) ? "*" : "");
+		}
+	else{
+		used += snprintf(&buffer[used], length-used, "%s%d-%d%s", used ? "," : "", i, j,
+						 CPU_ISSET(i, &isolated_cpus) ? "*" : "");
+		}
+	if(used >= length){ return; }
+	i = j;
+	}
+
+if(used == 0){ snprintf(buffer, length, "none"); }
+}
@@ -0,0 +1,115 @@
+/**
+ * \file
+ * \brief	CPU pinning and scheduling class configuration for the daemon threads
+ *
+ * @author	Dominic Eschweiler weiler@upb.de
+ *
+ * Status	: STABLE \n
+ * Date of creation : 18.10.2026
+ *
+ */
+
+
+/*****************************************************************
+ *
+ * Barracuda is a experimental microdriver extension to the 
+ * linux-kernel that is able to outsource common functions to
+ * the userspace. It was intensionally designed to accelerate
+ * CPU-intensive Tasks on a GPU.
+ *
+ * Copyright (C) 2009 Dominic Eschweiler
+ *
+ * This program is free software; you can redistribute it and/or 
+ * modify it under the terms of the GNU General Public License as 
+ * published by the Free Software Foundation; either only GPLv2 - 
+ * version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful, 
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of 
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the 
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public 
+ * License along with this program; 
+ * if not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************/
+
+#ifndef __AFFINITY__
+#define __AFFINITY__
+
+# include "definitions.h"
+
+/*! \def AFFINITY_SERVER
+	\brief Role of the transport/server thread */
+
+/*! \def AFFINITY_WORKER
+	\brief Role of the compute worker threads */
+
+#define AFFINITY_SERVER		0
+#define AFFINITY_WORKER		1
+#define AFFINITY_ROLES		2
+
+/**
+ * Reads the online and the isolated (isolcpus=) cpus of the system. Threads of
+ * a role without an explicit cpu list are kept away from isolated cpus.
+ *
+ * @returns	 void
+ */
+
+HOST void affinity_init(void);
+
+
+
+/**
+ * Sets the cpus of a role. The list uses the sysfs format (e.g. "0-3,8") and
+ * the keyword "iso" stands for all isolated cpus. Workers are pinned round
+ * robin to the single cpus of the list; groups separated by '/' (e.g.
+ * "2-3/4-5") give every worker a cpuset instead.
+ *
+ * @param role		: AFFINITY_SERVER or AFFINITY_WORKER
+ * @param *cpulist	: cpu list
+ *
+ * @returns	 EXIT_SUCCESS or EXIT_FAILURE on a malformed list
+ */
+
+HOST int affinity_set_cpus(int role, char *cpulist);
+
+
+
+/**
+ * Sets the scheduling class of a role. Valid are "FIFO:<priority>" and
+ * "OTHER:<nice>".
+ *
+ * @param role		: AFFINITY_SERVER or AFFINITY_WORKER
+ * @param *policy	: policy string
+ *
+ * @returns	 EXIT_SUCCESS or EXIT_FAILURE on a malformed policy
+ */
+
+HOST int affinity_set_sched(int role, char *policy);
+
+
+
+/**
+ * Pins the calling thread and applies its scheduling class. Every call of the
+ * worker role takes the next worker slot.
+ *
+ * @param role		: AFFINITY_SERVER or AFFINITY_WORKER
+ *
+ * @returns	 EXIT_SUCCESS or EXIT_FAILURE if a setting was refused
+ */
+
+HOST int affinity_apply(int role);
+
+
+
+/**
+ * Reports the pinning map to the syslog.
+ *
+ * @returns	 void
+ */
+
+HOST void affinity_report(void);
+
+#endif
@@ -0,0 +1,336 @@
+/**
+ * \file
+ * \brief	Arrays of one daemon and the routing of their requests
+ *
+ * @author	Dominic Eschweiler weiler@upb.de
+ *
+ * Status	: STABLE \n
+ * Date of creation : 18.10.2026
+ *
+ */
+
+
+/*****************************************************************
+ *
+ * Barracuda is a experimental microdriver extension to the 
+ * linux-kernel that is able to outsource common functions to
+ * the userspace. It was intensionally designed to accelerate
+ * CPU-intensive Tasks on a GPU.
+ *
+ * Copyright (C) 2009 Dominic Eschweiler
+ *
+ * This program is free software; you can redistribute it and/or 
+ * modify it under the terms of the GNU General Public License as 
+ * published by the Free Software Foundation; either only GPLv2 - 
+ * version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful, 
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of 
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the 
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public 
+ * License along with this program; 
+ * if not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <syslog.h>
+
+# include "arrays.h"
+# include "backends.h"
+
+static const char *array_codes[] = { "RAID6", "MULTI" };
+
+static barracuda_array arrays[ARRAY_MAX];
+static int number_of_arrays = 0;
+
+
+
+/**
+ * Tells how many check symbols the gen_syndrome of a backend writes, P and Q
+ * or those of the multi failure code.
+ *
+ * @param *backend	: implementation
+ *
+ * @returns	 int : number of check symbols
+ */
+
+static int array_backend_parities(syndrome_backend *backend)
+{
+return (strcmp(backend->name, "MULTI") == 0) ? DESC_MAX_FAILED : 2;
+}
+
+
+
+/**
+ * Searches a registered array.
+ *
+ * @param id		: id of the array
+ *
+ * @returns	 barracuda_array * : the array or NULL
+ */
+
+static barracuda_array *array_find(unsigned int id)
+{
+int i;
+
+for(i=0; i < number_of_arrays; i++){
+	if(arrays[i].id == id){ return &arrays[i]; }
+	}
+
+return NULL;
+}
+
+
+
+/**
+ * Registers an array, before array_start().
+ *
+ * @param *spec		: <id>:<code>[:<disks>[:<backend>[:<workers>]]], code is 
+ *					  RAID6, MULTI or MULTI<m> with m check symbols, empty 
+ *					  fields keep their defaults. Array 0 is the one of the 
+ *					  daemon, its stripes also come over the arena, the ring 
+ *					  and as page lists, which are not routed, so id is above 0
+ *
+ * @returns	 EXIT_SUCCESS or EXIT_FAILURE if the spec is invalid or the id taken
+ */
+
+HOST int array_register(const char *spec)
+{
+barracuda_array a;
+char buffer[128];
+char *field[5];
+char *rest = buffer;
+char *end;
+long value;
+int i;
+
+if( (number_of_arrays == ARRAY_MAX) || (strlen(spec) >= sizeof(buffer)) ){ return EXIT_FAILURE; }
+
+strcpy(buffer, spec);
+for(i=0; i < 5; i++){ field[i] = strsep(&rest, ":"); }
+if( (rest != NULL) || (field[1] == NULL) ){ return EXIT_FAILURE; }
+
+memset(&a, 0, sizeof(barracuda_array));
+
+value = strtol(field[0], &end, 10);
+if( (*field[0] == '\0') || (*end != '\0') || (value <= 0) ){ return EXIT_FAILURE; }
+a.id = (unsigned int)value;
+if( array_find(a.id) != NULL ){ return EXIT_FAILURE; }
+
+/* RAID6 or MULTI[<m>] */
+if( strcmp(field[1], "RAID6") == 0 ){
+	a.code	   = ARRAY_CODE_RAID6;
+	a.parities = 2;
+	}
+else if( strncmp(field[1], "MULTI", 5) == 0 ){
+	a.code	   = ARRAY_CODE_MULTI;
+	a.parities = DESC_MAX_FAILED;
+	if(field[1][5] != '\0'){
+		value = strtol(field[1]+5, &end, 10);
+		if( (*end != '\0') || (value < 1) || (value > DESC_MAX_FAILED) ){ return EXIT_FAILURE; }
+		a.parities = (int)value;
+		}
+	}
+else{ return EXIT_FAILURE; }
+
+if( (field[2] != NULL) && (*field[2] != '\0') ){
+	value = strtol(field[2], &end, 10);
+	if( (*end != '\0') || (value > ARENA_MAX_DISKS) || ((value != 0) && (value < a.parities + 2)) ){ 
+		return EXIT_FAILURE; 
+		}
+	a.disks = (int)value;
+	}
+
+/* the backend has to write the check symbols of the code */
+if( (field[3] != NULL) && (*field[3] != '\0') ){
+	a.backend = find_syndrome_backend(field[3]);
+	if(a.backend == NULL){ return EXIT_FAILURE; }
+	}
+if(a.code == ARRAY_CODE_MULTI){
+	if( (a.backend != NULL) && (array_backend_parities(a.backend) != DESC_MAX_FAILED) ){ return EXIT_FAILURE; }
+	a.backend = find_syndrome_backend((char *)"MULTI");
+	}
+else if( (a.backend != NULL) && (array_backend_parities(a.backend) != 2) ){ return EXIT_FAILURE; }
+
+if( (field[4] != NULL) && (*field[4] != '\0') ){
+	value = strtol(field[4], &end, 10);
+	if( (*end != '\0') || (value < 0) || (value > 64) ){ return EXIT_FAILURE; }
+	a.workers = (int)value;
+	}
+
+arrays[number_of_arrays++] = a;
+
+return EXIT_SUCCESS;
+}
+
+
+
+/**
+ * Prepares the registered arrays: their contexts and their worker pools.
+ *
+ * @param *backend	: backend of the daemon, for arrays without one
+ * @param depth		: slots of the submission queue of a worker pool
+ *
+ * @returns	 EXIT_SUCCESS or EXIT_FAILURE if an array can't be prepared
+ */
+
+HOST int array_start(syndrome_backend *backend, int depth)
+{
+barracuda_array *a;
+char geometry[16];
+int i;
+
+for(i=0; i < number_of_arrays; i++){
+	a = &arrays[i];
+	
+	/* a RAID6 array can't take over the MULTI backend of the daemon */
+	if(a->backend == NULL){
+		a->backend = (array_backend_parities(backend) == 2) ? backend : get_syndrome_backend(0);
+		}
+	
+	if( syndrome_context_init(a->backend, &a->ctx) == EXIT_FAILURE ){
+		syslog(LOG_NOTICE, "Can't initialise the %s context of array %u\n", a->backend->name, a->id);
+		number_of_arrays = i;
+		return EXIT_FAILURE;
+		}
+	pthread_mutex_init(&a->ctx_lock, NULL);
+	pthread_mutex_init(&a->lock, NULL);
+	
+	if(a->workers > 0){
+		a->pool = syndrome_pool_create(a->backend, a->workers, depth);
+		if(a->pool == NULL){
+			syslog(LOG_NOTICE, "Can't start the compute workers of array %u, it computes inline\n", a->id);
+			}
+		}
+	
+	if(a->disks == 0){ strcpy(geometry, "any"); }
+	else{ sprintf(geometry, "%d", a->disks); }
+	syslog(LOG_NOTICE, "Array %u : %s with %d check symbols, %s disks, %s, %d compute workers\n", a->id,
+			array_codes[a->code], a->parities, geometry, a->backend->name, (a->pool != NULL) ? a->workers : 0);
+	}
+
+return EXIT_SUCCESS;
+}
+
+
+
+/**
+ * Reports and releases the arrays.
+ *
+ * @returns	 void
+ */
+
+HOST void array_stop(void)
+{
+barracuda_array *a;
+int i;
+
+for(i=0; i < number_of_arrays; i++){
+	a = &arrays[i];
+	
+	syslog(LOG_NOTICE, "Array %u : %lu requests, %lu rejected, %lu on its compute workers\n", 
+			a->id, a->requests, a->rejected, a->queued);
+	
+	syndrome_pool_destroy(a->pool);
+	a->pool = NULL;
+	syndrome_context_release(a->backend, &a->ctx);
+	pthread_mutex_destroy(&a->ctx_lock);
+	pthread_mutex_destroy(&a->lock);
+	}
+
+number_of_arrays = 0;
+}
+
+
+
+/**
+ * Routes an operation to its array and checks it against the code and the 
+ * geometry of the array. Requests of array 0 stay with the daemon.
+ *
+ * @param *op		: operation taken with ops_take(), adjusted to the code
+ * @param disks		: number of disks of the request
+ * @param **array	: the array or NULL for the daemon
+ *
+ * @returns	 int : 0, -ENODEV for an unknown array or -EINVAL
+ */
+
+HOST int array_route(request_op *op, int disks, barracuda_array **array)
+{
+barracuda_array *a = array_find(op->array);
+int valid = 1;
+
+*array = NULL;
+if(a == NULL){ return (op->array == 0) ? 0 : -ENODEV; }
+
+if( (a->disks != 0) && (disks != a->disks) ){ valid = 0; }
+
+switch(a->code){
+	case ARRAY_CODE_RAID6 :	if( (op->opcode == OP_MULTI_ENCODE) || (op->opcode == OP_MULTI_DECODE) ){ valid = 0; }
+							break;
+	
+	case ARRAY_CODE_MULTI :	op->parities = a->parities;
+							if(op->opcode == OP_GEN){ op->opcode = OP_MULTI_ENCODE; }
+							if( (op->opcode != OP_MULTI_ENCODE) && (op->opcode != OP_MULTI_DECODE) ){ valid = 0; }
+							if( (disks <= a->parities) || (op->nfailed > a->parities) ){ valid = 0; }
+							break;
+	}
+
+pthread_mutex_lock(&a->lock);
+a->requests++;
+if(!valid){ a->rejected++; }
+pthread_mutex_unlock(&a->lock);
+
+if(!valid){ return -EINVAL; }
+
+*array = a;
+return 0;
+}
+
+
+
+/**
+ * Computes a routed operation. OP_GEN goes to the workers of the array if it
+ * has some, the calling thread computes everything else.
+ *
+ * @param *a		: the array
+ * @param *op		: the operation, op->result is set
+ * @param disks		: # of disks
+ * @param bytes		: # number of bytes
+ * @param **ptrs	: processing data
+ *
+ * @returns	 void
+ */
+
+HOST void array_compute(barracuda_array *a, request_op *op, int disks, size_t bytes, void **ptrs)
+{
+syndrome_request req;
+int locked;
+
+if( (op->opcode == OP_GEN) && (a->pool != NULL) ){
+	syndrome_request_init(&req, disks, bytes, ptrs, NULL, NULL);
+	
+	if( syndrome_pool_submit(a->pool, &req) == EXIT_SUCCESS ){
+		syndrome_wait(&req);
+		op->result = 0;
+		
+		pthread_mutex_lock(&a->lock);
+		a->queued++;
+		pthread_mutex_unlock(&a->lock);
+		return;
+		}
+	}
+
+/* a full queue is absorbed inline, on the context all callers share */
+locked = (a->backend->concurrency == BACKEND_PER_CONTEXT);
+if(locked){ pthread_mutex_lock(&a->ctx_lock); }
+
+ops_call(a->backend, &a->ctx, op, disks, bytes, ptrs);
+
+if(locked){ pthread_mutex_unlock(&a->ctx_lock); }
+}
@@ -0,0 +1,155 @@
+/**
+ * \file
+ * \brief	Arrays of one daemon and the routing of their requests
+ *
+ * @author	Dominic Eschweiler weiler@upb.de
+ *
+ * Status	: STABLE \n
+ * Date of creation : 18.10.2026
+ *
+ */
+
+
+/*****************************************************************
+ *
+ * Barracuda is a experimental microdriver extension to the 
+ * linux-kernel that is able to outsource common functions to
+ * the userspace. It was intensionally designed to accelerate
+ * CPU-intensive Tasks on a GPU.
+ *
+ * Copyright (C) 2009 Dominic Eschweiler
+ *
+ * This program is free software; you can redistribute it and/or 
+ * modify it under the terms of the GNU General Public License as 
+ * published by the Free Software Foundation; either only GPLv2 - 
+ * version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful, 
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of 
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the 
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public 
+ * License along with this program; 
+ * if not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************/
+
+#ifndef __ARRAYS__
+#define __ARRAYS__
+
+#include <pthread.h>
+
+# include "definitions.h"
+# include "async.h"
+# include "ops.h"
+
+/*! \def ARRAY_MAX
+	\brief Arrays one daemon serves */
+
+#define ARRAY_MAX	16
+
+/*! \def ARRAY_CODE_RAID6
+	\brief P and Q, OP_GEN, OP_XOR_UPDATE, OP_RECOV_* and OP_CHECK */
+
+/*! \def ARRAY_CODE_MULTI
+	\brief The multi failure Reed-Solomon code with 1 to DESC_MAX_FAILED check
+	symbols, OP_GEN is computed as OP_MULTI_ENCODE */
+
+#define ARRAY_CODE_RAID6	0
+#define ARRAY_CODE_MULTI	1
+
+/*! \var typedef struct barracuda_array;
+	\brief An array the daemon serves. disks is 0 if the geometry is free, 
+	workers the compute workers of its own pool, 0 if the calling thread 
+	computes. ctx is shared by the callers which compute themselves, it is
+	locked for backends which are not reentrant */
+
+typedef struct barracuda_array{
+	unsigned int id;
+	int code;
+	int disks;
+	int parities;
+	syndrome_backend *backend;
+	int workers;
+	syndrome_pool *pool;
+	syndrome_context ctx;
+	pthread_mutex_t ctx_lock;
+	pthread_mutex_t lock;
+	unsigned long requests;
+	unsigned long rejected;
+	unsigned long queued;
+	}barracuda_array;
+
+
+
+/**
+ * Registers an array, before array_start().
+ *
+ * @param *spec		: <id>:<code>[:<disks>[:<backend>[:<workers>]]], code is 
+ *					  RAID6, MULTI or MULTI<m> with m check symbols, empty 
+ *					  fields keep their defaults. Array 0 is the one of the 
+ *					  daemon, its stripes also come over the arena, the ring 
+ *					  and as page lists, which are not routed, so id is above 0
+ *
+ * @returns	 EXIT_SUCCESS or EXIT_FAILURE if the spec is invalid or the id taken
+ */
+
+HOST int array_register(const char *spec);
+
+
+
+/**
+ * Prepares the registered arrays: their contexts and their worker pools.
+ *
+ * @param *backend	: backend of the daemon, for arrays without one
+ * @param depth		: slots of the submission queue of a worker pool
+ *
+ * @returns	 EXIT_SUCCESS or EXIT_FAILURE if an array can't be prepared
+ */
+
+HOST int array_start(syndrome_backend *backend, int depth);
+
+
+
+/**
+ * Reports and releases the arrays.
+ *
+ * @returns	 void
+ */
+
+HOST void array_stop(void);
+
+
+
+/**
+ * Routes an operation to its array and checks it against the code and the 
+ * geometry of the array. Requests of array 0 stay with the daemon.
+ *
+ * @param *op		: operation taken with ops_take(), adjusted to the code
+ * @param disks		: number of disks of the request
+ * @param **array	: the array or NULL for the daemon
+ *
+ * @returns	 int : 0, -ENODEV for an unknown array or -EINVAL
+ */
+
+HOST int array_route(request_op *op, int disks, barracuda_array **array);
+
+
+
+/**
+ * Computes a routed operation. OP_GEN goes to the workers of the array if it
+ * has some, the calling thread computes everything else.
+ *
+ * @param *a		: the array
+ * @param *op		: the operation, op->result is set
+ * @param disks		: # of disks
+ * @param bytes		: # number of bytes
+ * @param **ptrs	: processing data
+ *
+ * @returns	 void
+ */
+
+HOST void array_compute(barracuda_array *a, request_op *op, int disks, size_t bytes, void **ptrs);
+
+#endif
@@ -0,0 +1,448 @@
+/**
+ * \file
+ * \brief	Asynchronous gen_syndrome submission on a pool of compute workers
+ *
+ * @author	Dominic Eschweiler weiler@upb.de
+ *
+ * Status	: STABLE \n
+ * Date of creation : 18.10.2026
+ *
+ */
+
+
+/*****************************************************************
+ *
+ * Barracuda is a experimental microdriver extension to the 
+ * linux-kernel that is able to outsource common functions to
+ * the userspace. It was intensionally designed to accelerate
+ * CPU-intensive Tasks on a GPU.
+ *
+ * Copyright (C) 2009 Dominic Eschweiler
+ *
+ * This program is free software; you can redistribute it and/or 
+ * modify it under the terms of the GNU General Public License as 
+ * published by the Free Software Foundation; either only GPLv2 - 
+ * version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful, 
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of 
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the 
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public 
+ * License along with this program; 
+ * if not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <syslog.h>
+#include <pthread.h>
+#include <semaphore.h>
+
+# include "async.h"
+# include "backends.h"
+# include "affinity.h"
+
+/* The compute workers and the queue they take requests from */
+struct syndrome_pool{
+	syndrome_backend *backend;
+	mpmc_queue queue;
+	sem_t items;
+	pthread_t *threads;
+	int number_of_workers;
+	volatile int stop;
+	};
+
+/* The pool of the daemon, the syndrome_async_* functions work on it */
+static syndrome_pool pool;
+
+
+
+/**
+ * Body of a compute worker. It takes requests until the pool is stopped.
+ *
+ * @param *arg		: the pool
+ *
+ * @returns			NULL
+ */
+
+static void *async_worker(void *arg)
+{
+syndrome_pool *p = (syndrome_pool *)arg;
+syndrome_context ctx;
+syndrome_request *req;
+
+affinity_apply(AFFINITY_WORKER);
+
+if( syndrome_context_init(p->backend, &ctx) == EXIT_FAILURE ){
+	syslog(LOG_NOTICE, "Compute worker can't initialise the %s context\n", p->backend->name);
+	return NULL;
+	}
+
+for(;;){
+	while( sem_wait(&p->items) != 0 );
+	
+	if( mpmc_dequeue(&p->queue, (void **)&req) == EXIT_FAILURE ){
+		if(p->stop){ break; }
+		continue;
+		}
+	
+	syndrome_call(p->backend, &ctx, req->disks, req->bytes, req->ptrs);
+	
+	/* the request may be gone as soon as it is completed */
+	if(req->callback != NULL){ req->callback(req, req->arg); }
+	else{ sem_post(&req->done); }
+	}
+
+syndrome_context_release(p->backend, &ctx);
+return NULL;
+}
+
+
+
+/**
+ * Starts the workers of a pool.
+ *
+ * @param *p		: the pool, zeroed
+ * @param *backend	: backend the workers use
+ * @param workers	: number of workers
+ * @param depth		: slots of the submission queue
+ *
+ * @returns	 EXIT_SUCCESS or EXIT_FAILURE if no worker could be started
+ */
+
+static int pool_start(syndrome_pool *p, syndrome_backend *backend, int workers, int depth)
+{
+int i;
+
+if( (workers <= 0) || (p->number_of_workers > 0) ){ return EXIT_FAILURE; }
+
+if( mpmc_init(&p->queue, depth) == EXIT_FAILURE ){ return EXIT_FAILURE; }
+
+p->threads = (pthread_t *)malloc(workers * sizeof(pthread_t));
+if(p->threads == NULL){
+	mpmc_destroy(&p->queue);
+	return EXIT_FAILURE;
+	}
+
+p->backend = backend;
+p->stop    = 0;
+sem_init(&p->items, 0, 0);
+
+for(i=0; i<workers; i++){
+	if( pthread_create(&p->threads[i], NULL, async_worker, p) != 0 ){
+		syslog(LOG_NOTICE, "Only %d compute workers could be started\n", i);
+		break;
+		}
+	p->number_of_workers++;
+	}
+
+if(p->number_of_workers == 0){
+	free(p->threads);
+	sem_destroy(&p->items);
+	mpmc_destroy(&p->queue);
+	return EXIT_FAILURE;
+	}
+
+return EXIT_SUCCESS;
+}
+
+
+
+/**
+ * Stops the workers of a pool.
+ *
+ * @param *p		: the pool
+ *
+ * @returns	 void
+ */
+
+static void pool_stop(syndrome_pool *p)
+{
+int i;
+
+if(p->number_of_workers == 0){ return; }
+
+p->stop = 1;
+for(i=0; i<p->number_of_workers; i++){ sem_post(&p->items); }
+for(i=0; i<p->number_of_workers; i++){ pthread_join(p->threads[i], NULL); }
+
+free(p->threads);
+sem_destroy(&p->items);
+mpmc_destroy(&p->queue);
+p->number_of_workers = 0;
+}
+
+
+
+/**
+ * Submits a request to a pool without blocking.
+ *
+ * @param *p		: the pool
+ * @param *req		: prepared request
+ *
+ * @returns	 EXIT_SUCCESS or EXIT_FAILURE if the request is not submitted
+ */
+
+static int pool_submit(syndrome_pool *p, syndrome_request *req)
+{
+if(p->number_of_workers == 0){ return EXIT_FAILURE; }
+
+if(req->callback == NULL){ sem_init(&req->done, 0, 0); }
+
+if( mpmc_enqueue(&p->queue, req) == EXIT_FAILURE ){
+	if(req->callback == NULL){ sem_destroy(&req->done); }
+	return EXIT_FAILURE;
+	}
+
+sem_post(&p->items);
+return EXIT_SUCCESS;
+}
+
+
+
+/**
+ * Starts the compute workers.
+ *
+ * @param *backend	: backend the workers use
+ * @param workers	: number of workers
+ * @param depth		: slots of the submission queue
+ *
+ * @returns	 EXIT_SUCCESS or EXIT_FAILURE if no worker could be started
+ */
+
+HOST int syndrome_async_start(syndrome_backend *backend, int workers, int depth)
+{
+return pool_start(&pool, backend, workers, depth);
+}
+
+
+
+/**
+ * Stops the compute workers.
+ *
+ * @returns	 void
+ */
+
+HOST void syndrome_async_stop(void)
+{
+pool_stop(&pool);
+}
+
+
+
+/**
+ * Tells if the compute workers are running.
+ *
+ * @returns	 int : 1 if requests can be submitted, 0 if not
+ */
+
+HOST int syndrome_async_active(void)
+{
+return (pool.number_of_workers > 0);
+}
+
+
+
+/**
+ * Prepares a request.
+ *
+ * @param *req		: request
+ * @param disks		: # of disks
+ * @param bytes		: # number of bytes
+ * @param **ptrs	: processing data
+ * @param callback	: completion callback or NULL
+ * @param *arg		: argument of the callback
+ *
+ * @returns	 void
+ */
+
+HOST void syndrome_request_init(syndrome_request *req, int disks, size_t bytes, void **ptrs,
+								syndrome_callback callback, void *arg)
+{
+req->disks		= disks;
+req->bytes		= bytes;
+req->ptrs		= ptrs;
+req->callback	= callback;
+req->arg		= arg;
+}
+
+
+
+/**
+ * Submits a request without blocking. The completion semaphore is set up 
+ * here, it is destroyed again when the request is reaped.
+ *
+ * @param *req		: prepared request
+ *
+ * @returns	 EXIT_SUCCESS or EXIT_FAILURE if the request is not submitted
+ */
+
+HOST int syndrome_submit(syndrome_request *req)
+{
+return pool_submit(&pool, req);
+}
+
+
+
+/**
+ * Checks a submitted request without blocking.
+ *
+ * @param *req		: submitted request without callback
+ *
+ * @returns	 int : 1 if the request is completed, 0 if it is still in flight
+ */
+
+HOST int syndrome_poll(syndrome_request *req)
+{
+if( sem_trywait(&req->done) != 0 ){ return 0; }
+
+sem_destroy(&req->done);
+return 1;
+}
+
+
+
+/**
+ * Waits until a submitted request is completed.
+ *
+ * @param *req		: submitted request without callback
+ *
+ * @returns	 void
+ */
+
+HOST void syndrome_wait(syndrome_request *req)
+{
+while( sem_wait(&req->done) != 0 );
+
+sem_destroy(&req->done);
+}
+
+
+
+/**
+ * Synchronous wrapper with the signature of syndrome_func.
+ *
+ * @param disks		: # of disks
+ * @param bytes		: # number of bytes
+ * @param **ptrs	: processing data
+ *
+ * @returns	 void
+ */
+
+HOST void syndrome_async_gen_syndrome(int disks, size_t bytes, void **ptrs)
+{
+syndrome_request req;
+
+syndrome_request_init(&req, disks, bytes, ptrs, NULL, NULL);
+
+if( syndrome_submit(&req) == EXIT_SUCCESS ){
+	syndrome_wait(&req);
+	return;
+	}
+
+/* without workers the reference implementation stands in */
+if(pool.backend == NULL){ get_syndrome_backend(0)->gen_syndrome(disks, bytes, ptrs); }
+else{ pool.backend->gen_syndrome(disks, bytes, ptrs); }
+}
+
+
+
+/**
+ * Reads the counters of the submission queue.
+ *
+ * @param *stats	: the counters are stored here
+ *
+ * @returns	 void
+ */
+
+HOST void syndrome_async_stats(mpmc_stats *stats)
+{
+if(pool.number_of_workers == 0){
+	memset(stats, 0, sizeof(mpmc_stats));
+	return;
+	}
+
+mpmc_get_stats(&pool.queue, stats);
+}
+
+
+
+/**
+ * Starts a pool of compute workers of its own, next to the one of the 
+ * daemon.
+ *
+ * @param *backend	: backend the workers use
+ * @param workers	: number of workers
+ * @param depth		: slots of the submission queue
+ *
+ * @returns	 syndrome_pool * : the pool or NULL if no worker could be started
+ */
+
+HOST syndrome_pool *syndrome_pool_create(syndrome_backend *backend, int workers, int depth)
+{
+syndrome_pool *p = (syndrome_pool *)calloc(1, sizeof(syndrome_pool));
+
+if(p == NULL){ return NULL; }
+
+if( pool_start(p, backend, workers, depth) == EXIT_FAILURE ){
+	free(p);
+	return NULL;
+	}
+
+return p;
+}
+
+
+
+/**
+ * Stops the workers of a pool of syndrome_pool_create() and frees it.
+ *
+ * @param *p		: the pool
+ *
+ * @returns	 void
+ */
+
+HOST void syndrome_pool_destroy(syndrome_pool *p)
+{
+if(p == NULL){ return; }
+
+pool_stop(p);
+free(p);
+}
+
+
+
+/**
+ * Submits a request to a pool of syndrome_pool_create() without blocking, 
+ * it is reaped with syndrome_poll() or syndrome_wait() like any other.
+ *
+ * @param *p		: the pool
+ * @param *req		: prepared request
+ *
+ * @returns	 EXIT_SUCCESS or EXIT_FAILURE if the request is not submitted
+ */
+
+HOST int syndrome_pool_submit(syndrome_pool *p, syndrome_request *req)
+{
+return pool_submit(p, req);
+}
+
+
+
+/**
+ * Reads the counters of the submission queue of a pool.
+ *
+ * @param *p		: the pool
+ * @param *stats	: the counters are stored here
+ *
+ * @returns	 void
+ */
+
+HOST void syndrome_pool_stats(syndrome_pool *p, mpmc_stats *stats)
+{
+mpmc_get_stats(&p->queue, stats);
+}
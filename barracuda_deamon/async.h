@@ -0,0 +1,246 @@
+/**
+ * \file
+ * \brief	Asynchronous gen_syndrome submission on a pool of compute workers
+ *
+ * @author	Dominic Eschweiler weiler@upb.de
+ *
+ * Status	: STABLE \n
+ * Date of creation : 18.10.2026
+ *
+ */
+
+
+/*****************************************************************
+ *
+ * Barracuda is a experimental microdriver extension to the 
+ * linux-kernel that is able to outsource common functions to
+ * the userspace. It was intensionally designed to accelerate
+ * CPU-intensive Tasks on a GPU.
+ *
+ * Copyright (C) 2009 Dominic Eschweiler
+ *
+ * This program is free software; you can redistribute it and/or 
+ * modify it under the terms of the GNU General Public License as 
+ * published by the Free Software Foundation; either only GPLv2 - 
+ * version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful, 
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of 
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the 
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public 
+ * License along with this program; 
+ * if not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************/
+
+#ifndef __ASYNC__
+#define __ASYNC__
+
+#include <semaphore.h>
+
+# include "definitions.h"
+# include "mpmc.h"
+
+struct syndrome_request;
+
+/*! \var typedef struct syndrome_pool;
+	\brief Compute workers of one backend and the queue they take requests 
+	from. The daemon has one, an array with a worker share has its own */
+
+typedef struct syndrome_pool syndrome_pool;
+
+/*! \var typedef syndrome_callback
+	\brief Completion callback of a request, it runs on the compute worker */
+
+typedef void (*syndrome_callback)(struct syndrome_request *req, void *arg);
+
+/*! \var typedef struct syndrome_request;
+	\brief One asynchronous gen_syndrome call. The caller owns the storage, the 
+	request itself is the handle and must stay valid until it is reaped. */
+
+typedef struct syndrome_request{
+	int disks;
+	size_t bytes;
+	void **ptrs;
+	syndrome_callback callback;
+	void *arg;
+	sem_t done;
+	}syndrome_request;
+
+
+
+/**
+ * Starts the compute workers. Every worker owns a context of the backend, so 
+ * the backend doesn't need to be reentrant on a single context.
+ *
+ * @param *backend	: backend the workers use
+ * @param workers	: number of workers
+ * @param depth		: slots of the submission queue
+ *
+ * @returns	 EXIT_SUCCESS or EXIT_FAILURE if no worker could be started
+ */
+
+HOST int syndrome_async_start(syndrome_backend *backend, int workers, int depth);
+
+
+
+/**
+ * Stops the compute workers. All submitted requests must be reaped before.
+ *
+ * @returns	 void
+ */
+
+HOST void syndrome_async_stop(void);
+
+
+
+/**
+ * Tells if the compute workers are running.
+ *
+ * @returns	 int : 1 if requests can be submitted, 0 if not
+ */
+
+HOST int syndrome_async_active(void);
+
+
+
+/**
+ * Prepares a request. A callback is optional; a request with a callback is 
+ * reaped by the callback, a request without one by syndrome_poll() or 
+ * syndrome_wait().
+ *
+ * @param *req		: request
+ * @param disks		: # of disks
+ * @param bytes		: # number of bytes
+ * @param **ptrs	: processing data
+ * @param callback	: completion callback or NULL
+ * @param *arg		: argument of the callback
+ *
+ * @returns	 void
+ */
+
+HOST void syndrome_request_init(syndrome_request *req, int disks, size_t bytes, void **ptrs,
+								syndrome_callback callback, void *arg);
+
+
+
+/**
+ * Submits a request without blocking.
+ *
+ * @param *req		: prepared request
+ *
+ * @returns	 EXIT_SUCCESS or EXIT_FAILURE if the queue is full or the workers
+ *			 are not running, the request is not submitted in this case
+ */
+
+HOST int syndrome_submit(syndrome_request *req);
+
+
+
+/**
+ * Checks a submitted request without blocking. A completed request is reaped.
+ *
+ * @param *req		: submitted request without callback
+ *
+ * @returns	 int : 1 if the request is completed, 0 if it is still in flight
+ */
+
+HOST int syndrome_poll(syndrome_request *req);
+
+
+
+/**
+ * Waits until a submitted request is completed and reaps it.
+ *
+ * @param *req		: submitted request without callback
+ *
+ * @returns	 void
+ */
+
+HOST void syndrome_wait(syndrome_request *req);
+
+
+
+/**
+ * Synchronous wrapper with the signature of syndrome_func. It submits to the 
+ * workers and waits, and computes inline if the workers are not running or
+ * the queue is full.
+ *
+ * @param disks		: # of disks
+ * @param bytes		: # number of bytes
+ * @param **ptrs	: processing data
+ *
+ * @returns	 void
+ */
+
+HOST void syndrome_async_gen_syndrome(int disks, size_t bytes, void **ptrs);
+
+
+
+/**
+ * Reads the counters of the submission queue.
+ *
+ * @param *stats	: the counters are stored here
+ *
+ * @returns	 void
+ */
+
+HOST void syndrome_async_stats(mpmc_stats *stats);
+
+
+
+/**
+ * Starts a pool of compute workers of its own, next to the one of the 
+ * daemon.
+ *
+ * @param *backend	: backend the workers use
+ * @param workers	: number of workers
+ * @param depth		: slots of the submission queue
+ *
+ * @returns	 syndrome_pool * : the pool or NULL if no worker could be started
+ */
+
+HOST syndrome_pool *syndrome_pool_create(syndrome_backend *backend, int workers, int depth);
+
+
+
+/**
+ * Stops the workers of a pool of syndrome_pool_create() and frees it.
+ *
+ * @param *p		: the pool
+ *
+ * @returns	 void
+ */
+
+HOST void syndrome_pool_destroy(syndrome_pool *p);
+
+
+
+/**
+ * Submits a request to a pool of syndrome_pool_create() without blocking, 
+ * it is reaped with syndrome_poll() or syndrome_wait() like any other.
+ *
+ * @param *p		: the pool
+ * @param *req		: prepared request
+ *
+ * @returns	 EXIT_SUCCESS or EXIT_FAILURE if the request is not submitted
+ */
+
+HOST int syndrome_pool_submit(syndrome_pool *p, syndrome_request *req);
+
+
+
+/**
+ * Reads the counters of the submission queue of a pool.
+ *
+ * @param *p		: the pool
+ * @param *stats	: the counters are stored here
+ *
+ * @returns	 void
+ */
+
+HOST void syndrome_pool_stats(syndrome_pool *p, mpmc_stats *stats);
+
+#endif
@@ -0,0 +1,230 @@
+/**
+ * \file
+ * \brief	Registry of all gen_syndrome implementations and their contexts
+ *
+ * @author	Dominic Eschweiler weiler@upb.de
+ *
+ * Status	: STABLE \n
+ * Date of creation : 18.10.2026
+ *
+ */
+
+
+/*****************************************************************
+ *
+ * Barracuda is a experimental microdriver extension to the 
+ * linux-kernel that is able to outsource common functions to
+ * the userspace. It was intensionally designed to accelerate
+ * CPU-intensive Tasks on a GPU.
+ *
+ * Copyright (C) 2009 Dominic Eschweiler
+ *
+ * This program is free software; you can redistribute it and/or 
+ * modify it under the terms of the GNU General Public License as 
+ * published by the Free Software Foundation; either only GPLv2 - 
+ * version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful, 
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of 
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the 
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public 
+ * License along with this program; 
+ * if not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+# include "backends.h"
+# include "vanilla/raid6vanilla.h"
+# include "smp/raid6smp.h"
+# include "dummy/raid6dummy.h"
+# include "multrs/raid6multrs.h"
+#ifndef NOCUDA
+	# include "cuda/raid6cuda.h"
+#endif
+
+/*
+ * The order of this table is the order of the implementation lists which are
+ * passed to the validator and the benchmarker. SOFT must stay the first entry,
+ * it is the reference implementation.
+ */
+static syndrome_backend syndrome_backends[] =
+{
+	{ "SOFT",	raid6_vanilla_gen_syndrome,	NULL,	NULL,	NULL,	BACKEND_REENTRANT },
+	{ "SMP",	raid6_smp_gen_syndrome,		NULL,	raid6_smp_context_init,	NULL,	BACKEND_REENTRANT },
+	{ "DUMMY",	raid6_dummy_gen_syndrome,	NULL,	NULL,	NULL,	BACKEND_REENTRANT },
+#ifdef NOCUDA
+	{ "MULTI",	multi_rs_gen_syndrome,		NULL,	NULL,	NULL,	BACKEND_REENTRANT },
+#endif
+#ifndef NOCUDA
+	{ "MULTI",	multi_rs_gen_syndrome,		multi_rs_gen_syndrome_ctx,
+				multi_rs_context_init,		multi_rs_context_release,	BACKEND_PER_CONTEXT },
+	{ "CUDA",	raid6_cuda_gen_syndrome,	raid6_cuda_gen_syndrome_ctx,
+				raid6_cuda_context_init,	raid6_cuda_context_release,	BACKEND_PER_CONTEXT },
+#endif
+};
+
+
+
+/**
+ * Returns the number of registered implementations.
+ *
+ * @returns	 int : number of implementations
+ */
+
+HOST int get_number_of_backends(void)
+{
+return sizeof(syndrome_backends) / sizeof(syndrome_backend);
+}
+
+
+
+/**
+ * Returns a registered implementation.
+ *
+ * @param i		: index of the implementation
+ *
+ * @returns	 syndrome_backend * : the implementation, NULL if i is out of range
+ */
+
+HOST syndrome_backend *get_syndrome_backend(int i)
+{
+if( (i < 0) || (i >= get_number_of_backends()) ){ return NULL; }
+
+return &syndrome_backends[i];
+}
+
+
+
+/**
+ * Searches an implementation by its name (SOFT, SMP, ...).
+ *
+ * @param *name	: name of the implementation
+ *
+ * @returns	 syndrome_backend * : the implementation, NULL if there is none
+ */
+
+HOST syndrome_backend *find_syndrome_backend(char *name)
+{
+int i;
+
+for(i=0; i<get_number_of_backends(); i++){
+	if( strcmp(name, syndrome_backends[i].name) == 0 ){
+		return &syndrome_backends[i];
+		}
+	}
+
+return NULL;
+}
+
+
+
+/**
+ * Initialises a context for one worker.
+ *
+ * @param *backend	: implementation
+ * @param *ctx		: context to initialise
+ *
+ * @returns	 EXIT_SUCCESS or EXIT_FAILURE if the buffers can't be allocated
+ */
+
+HOST int syndrome_context_init(syndrome_backend *backend, syndrome_context *ctx)
+{
+memset(ctx, 0, sizeof(syndrome_context));
+
+if(backend->context_init == NULL){ return EXIT_SUCCESS; }
+
+return backend->context_init(ctx);
+}
+
+
+
+/**
+ * Releases all buffers of a context.
+ *
+ * @param *backend	: implementation
+ * @param *ctx		: context to release
+ *
+ * @returns	 void
+ */
+
+HOST void syndrome_context_release(syndrome_backend *backend, syndrome_context *ctx)
+{
+if(backend->context_release != NULL){
+	backend->context_release(ctx);
+	}
+
+ctx->scratch = NULL;
+}
+
+
+
+/**
+ * Stops the threads which implementations keep across calls.
+ *
+ * @returns	 void
+ */
+
+HOST void stop_syndrome_backends(void)
+{
+raid6_smp_stop();
+}
+
+
+
+/**
+ * Calls the gen_syndrome function of an implementation for a scatter-gather
+ * stripe. The segments of all disks are walked side by side, every call gets
+ * the longest range which is contiguous on all disks; nothing is gathered.
+ *
+ * @param *backend	: implementation
+ * @param *ctx		: context of the calling worker
+ * @param *sg		: segment table of the stripe, checked by the caller
+ * @param *window	: the mapping the segment offsets count from
+ *
+ * @returns	 void
+ */
+
+HOST void syndrome_call_sg(syndrome_backend *backend, syndrome_context *ctx, sg_table *sg, char *window)
+{
+unsigned int seg[ARENA_MAX_DISKS];
+size_t used[ARENA_MAX_DISKS];
+void *ptrs[ARENA_MAX_DISKS];
+int disks	 = sg->disks;
+size_t bytes = sg->bytes;
+size_t done;
+size_t chunk;
+sg_segment *s;
+int i;
+
+for(i=0; i < disks; i++){
+	seg[i]	= sg->first[i];
+	used[i] = 0;
+	}
+
+for(done = 0; done < bytes; done += chunk){
+	chunk = bytes - done;
+	
+	/* the chunk ends where the first of the actual segments ends */
+	for(i=0; i < disks; i++){
+		s = &sg->segs[seg[i]];
+		if(s->len - used[i] < chunk){ chunk = s->len - used[i]; }
+		ptrs[i] = window + s->offset + used[i];
+		}
+	
+	syndrome_call(backend, ctx, disks, chunk, ptrs);
+	
+	for(i=0; i < disks; i++){
+		used[i] += chunk;
+		if(used[i] == sg->segs[seg[i]].len){
+			seg[i]++;
+			used[i] = 0;
+			}
+		}
+	}
+}
@@ -0,0 +1,166 @@
+/**
+ * \file
+ * \brief	Registry of all gen_syndrome implementations and their contexts
+ *
+ * @author	Dominic Eschweiler weiler@upb.de
+ *
+ * Status	: STABLE \n
+ * Date of creation : 18.10.2026
+ *
+ */
+
+
+/*****************************************************************
+ *
+ * Barracuda is a experimental microdriver extension to the 
+ * linux-kernel that is able to outsource common functions to
+ * the userspace. It was intensionally designed to accelerate
+ * CPU-intensive Tasks on a GPU.
+ *
+ * Copyright (C) 2009 Dominic Eschweiler
+ *
+ * This program is free software; you can redistribute it and/or 
+ * modify it under the terms of the GNU General Public License as 
+ * published by the Free Software Foundation; either only GPLv2 - 
+ * version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful, 
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of 
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the 
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public 
+ * License along with this program; 
+ * if not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************/
+
+#ifndef __BACKENDS__
+#define __BACKENDS__
+
+# include "definitions.h"
+
+/*
+ * Concurrency guarantees of the implementations :
+ *
+ * SOFT  : stateless, BACKEND_REENTRANT
+ * SMP   : BACKEND_REENTRANT. The worker pool is shared, a call which finds it
+ *         busy computes inline on the calling thread instead of waiting.
+ * DUMMY : stateless, BACKEND_REENTRANT
+ * MULTI : stateless on the cpu (BACKEND_REENTRANT). With CUDA the device 
+ *         buffers live in the context (BACKEND_PER_CONTEXT).
+ * CUDA  : device buffers live in the context, BACKEND_PER_CONTEXT
+ */
+
+/**
+ * Returns the number of registered implementations.
+ *
+ * @returns	 int : number of implementations
+ */
+
+HOST int get_number_of_backends(void);
+
+
+
+/**
+ * Returns a registered implementation.
+ *
+ * @param i		: index of the implementation
+ *
+ * @returns	 syndrome_backend * : the implementation, NULL if i is out of range
+ */
+
+HOST syndrome_backend *get_syndrome_backend(int i);
+
+
+
+/**
+ * Searches an implementation by its name (SOFT, SMP, ...).
+ *
+ * @param *name	: name of the implementation
+ *
+ * @returns	 syndrome_backend * : the implementation, NULL if there is none
+ */
+
+HOST syndrome_backend *find_syndrome_backend(char *name);
+
+
+
+/**
+ * Initialises a context for one worker.
+ *
+ * @param *backend	: implementation
+ * @param *ctx		: context to initialise
+ *
+ * @returns	 EXIT_SUCCESS or EXIT_FAILURE if the buffers can't be allocated
+ */
+
+HOST int syndrome_context_init(syndrome_backend *backend, syndrome_context *ctx);
+
+
+
+/**
+ * Releases all buffers of a context.
+ *
+ * @param *backend	: implementation
+ * @param *ctx		: context to release
+ *
+ * @returns	 void
+ */
+
+HOST void syndrome_context_release(syndrome_backend *backend, syndrome_context *ctx);
+
+
+
+/**
+ * Stops the threads which implementations keep across calls (the pool of 
+ * SMP). The implementations stay usable and compute inline afterwards.
+ *
+ * @returns	 void
+ */
+
+HOST void stop_syndrome_backends(void);
+
+
+
+/**
+ * Calls the gen_syndrome function of an implementation with a context.
+ *
+ * @param *backend	: implementation
+ * @param *ctx		: context of the calling worker
+ * @param disks		: # of disks
+ * @param bytes		: # number of bytes
+ * @param **ptrs	: processing data
+ *
+ * @returns	 void
+ */
+
+HOST static inline void syndrome_call(	syndrome_backend *backend, syndrome_context *ctx,
+										int disks, size_t bytes, void **ptrs )
+{
+if(backend->gen_syndrome_ctx != NULL){
+	backend->gen_syndrome_ctx(ctx, disks, bytes, ptrs);
+	}
+else{
+	backend->gen_syndrome(disks, bytes, ptrs);
+	}
+}
+
+
+
+/**
+ * Calls the gen_syndrome function of an implementation for a scatter-gather
+ * stripe. The segments of all disks are walked side by side, every call gets
+ * the longest range which is contiguous on all disks; nothing is gathered.
+ *
+ * @param *backend	: implementation
+ * @param *ctx		: context of the calling worker
+ * @param *sg		: segment table of the stripe, checked by the caller
+ * @param *window	: the mapping the segment offsets count from
+ *
+ * @returns	 void
+ */
+
+HOST void syndrome_call_sg(syndrome_backend *backend, syndrome_context *ctx, sg_table *sg, char *window);
+
+#endif
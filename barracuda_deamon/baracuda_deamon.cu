@@ -66,6 +66,17 @@
 # include "validator.h"
 # include "benchmarker.h"
 # include "userspace_driver.h"
+# include "affinity.h"
+# include "backends.h"
+# include "arrays.h"
+# include "ring.h"
+# include "spinwait.h"
+# include "marshal.h"
+# include "usock.h"
+# include "bench/loadgen.h"
+
+/* stack of the cloned daemon process */
+static char stack[10000];
 
 int helper();
 HOST syndrome_func choose_implementation(	syndrome_func gen_syndrome,
@@ -136,6 +147,29 @@ HOST int main( int argc, char *argv[] )
 	 * -k           : kill all deamons
 	 * -B <type>	: Benchmark Mode = PP_NL BW_NL PP_CB BW_CB
 	 * -V			: Validation Mode ( Validate all RS implementations against the pure software Version
+	 * --server-cpus <list>		: pin the server thread
+	 * --worker-cpus <list>		: pin the compute workers
+	 * --server-sched <policy>	: scheduling class of the server thread
+	 * --worker-sched <policy>	: scheduling class of the compute workers
+	 * --compute-workers <n>	: compute workers behind the request queue
+	 * --queue-depth <n>		: slots of the request queue
+	 * --arena <KB>			: shared arena instead of mmap per request
+	 * --ring-entries <n>		: slots of the submission/completion ring
+	 * --ring-slot <KB>		: size of one ring slot
+	 * --spin <us>			: busy-poll bound of the doorbell before sleeping
+	 * --coalesce <n>[:<us>]	: completions announced with one notification
+	 * --batch <n>			: stripes handed over with one handshake
+	 * --slice <KB>			: larger requests are served slice by slice
+	 * --server-threads <n>	: server threads, each with a ring shard of its own
+	 * --shard-by <key>		: CPU or STRIPE, spreads the stripes over the shards
+	 * --pipeline			: fetch, compute and complete on three threads
+	 * --marshal <mode>		: MAP, COPY, AUTO or SG marshalling of stripes outside the arena
+	 * --sched <classes>		: credits, weight and latency target of the priority classes
+	 * --array <spec>		: an array with its own code, geometry, backend and workers
+	 * --socket <path>		: serve userspace clients on a UNIX socket
+	 * --lock-memory		: lock the daemon in memory and prefault its mappings
+	 * --copy-buffers <disks>:<KB>	: copy buffers allocated at startup
+	 * --loopback <spec>		: run against the loopback stand-in with a load generator
 	 * --help -h	: show help
  	 */
 	
@@ -152,9 +186,30 @@ HOST int main( int argc, char *argv[] )
 	int  kill		= 0;
 	int	 c_mode		= 0;
 	int  rs_mode    = 0;
+	int  compute_workers = 0;
+	int  queue_depth     = 64;
+	long arena_kb        = 0;
+	long ring_entries    = RING_DEFAULT_ENTRIES;
+	long ring_slot_kb    = RING_DEFAULT_SLOT / 1024;
+	long spin_us         = SPIN_DEFAULT_US;
+	long coalesce_count  = 0;
+	long coalesce_us     = 0;
+	long slice_kb        = 0;
+	int  batch           = 1;
+	int  server_threads  = 1;
+	int  shard_by        = RING_SHARD_CPU;
+	int  pipeline        = 0;
+	int  marshalling     = -1;
+	char *sched          = NULL;
+	char *socket_path    = NULL;
+	char *loopback_spec  = NULL;
+	int  lock_memory     = 0;
+	long copy_disks      = 0;
+	long copy_kb         = 0;
 	
 	/* Init all internal variables */
 	set_internal_vars();
+	affinity_init();
 
 	/*
 	 * Go through all command-line arguments and set all coresponding 
@@ -207,6 +262,186 @@ HOST int main( int argc, char *argv[] )
 			if( strcmp(argv[i+1], "NL")    == 0 ){ c_mode = 1; }
 			if( strcmp(argv[i+1], "IOCTL") == 0 ){ c_mode = 2; }
 			if( strcmp(argv[i+1], "PFS")   == 0 ){ c_mode = 3; }
+			if( strcmp(argv[i+1], "RING")  == 0 ){ c_mode = 4; }
+			if( strcmp(argv[i+1], "DOORBELL") == 0 ){ c_mode = 5; }
+			if( strcmp(argv[i+1], "AUTO")  == 0 ){ c_mode = 6; }
+			}
+		
+		if( (strcmp(argv[i], "--server-cpus") == 0) && (i < argc-1) ){
+			if( affinity_set_cpus(AFFINITY_SERVER, argv[i+1]) == EXIT_FAILURE ){
+				printf("Invalid cpu list for the server thread : %s\n", argv[i+1]);
+				return EXIT_FAILURE;
+				}
+			}
+		
+		if( (strcmp(argv[i], "--worker-cpus") == 0) && (i < argc-1) ){
+			if( affinity_set_cpus(AFFINITY_WORKER, argv[i+1]) == EXIT_FAILURE ){
+				printf("Invalid cpu list for the compute workers : %s\n", argv[i+1]);
+				return EXIT_FAILURE;
+				}
+			}
+		
+		if( (strcmp(argv[i], "--server-sched") == 0) && (i < argc-1) ){
+			if( affinity_set_sched(AFFINITY_SERVER, argv[i+1]) == EXIT_FAILURE ){
+				printf("Invalid scheduling class for the server thread : %s\n", argv[i+1]);
+				return EXIT_FAILURE;
+				}
+			}
+		
+		if( (strcmp(argv[i], "--worker-sched") == 0) && (i < argc-1) ){
+			if( affinity_set_sched(AFFINITY_WORKER, argv[i+1]) == EXIT_FAILURE ){
+				printf("Invalid scheduling class for the compute workers : %s\n", argv[i+1]);
+				return EXIT_FAILURE;
+				}
+			}
+		
+		if( (strcmp(argv[i], "--compute-workers") == 0) && (i < argc-1) ){
+			compute_workers = atoi(argv[i+1]);
+			if(compute_workers < 0){
+				printf("Invalid number of compute workers : %s\n", argv[i+1]);
+				return EXIT_FAILURE;
+				}
+			}
+		
+		if( (strcmp(argv[i], "--queue-depth") == 0) && (i < argc-1) ){
+			queue_depth = atoi(argv[i+1]);
+			if(queue_depth <= 0){
+				printf("Invalid request queue depth : %s\n", argv[i+1]);
+				return EXIT_FAILURE;
+				}
+			}
+		
+		if( (strcmp(argv[i], "--arena") == 0) && (i < argc-1) ){
+			arena_kb = atol(argv[i+1]);
+			if(arena_kb <= 0){
+				printf("Invalid arena size : %s\n", argv[i+1]);
+				return EXIT_FAILURE;
+				}
+			}
+		
+		if( (strcmp(argv[i], "--slice") == 0) && (i < argc-1) ){
+			slice_kb = atol(argv[i+1]);
+			if(slice_kb <= 0){
+				printf("Invalid slice size : %s\n", argv[i+1]);
+				return EXIT_FAILURE;
+				}
+			}
+		
+		if( (strcmp(argv[i], "--ring-entries") == 0) && (i < argc-1) ){
+			ring_entries = atol(argv[i+1]);
+			if( (ring_entries <= 0) || (ring_entries > RING_MAX_ENTRIES) || (ring_entries & (ring_entries-1)) ){
+				printf("Invalid number of ring entries : %s\n", argv[i+1]);
+				return EXIT_FAILURE;
+				}
+			}
+		
+		if( (strcmp(argv[i], "--ring-slot") == 0) && (i < argc-1) ){
+			ring_slot_kb = atol(argv[i+1]);
+			if( ring_slot_kb < (long)(RING_MIN_SLOT / 1024) ){
+				printf("Invalid ring slot size : %s, at least %lu KB\n", argv[i+1], (unsigned long)(RING_MIN_SLOT / 1024));
+				return EXIT_FAILURE;
+				}
+			}
+		
+		if( (strcmp(argv[i], "--batch") == 0) && (i < argc-1) ){
+			batch = atoi(argv[i+1]);
+			if( (batch <= 0) || (batch > BATCH_MAX_STRIPES) ){
+				printf("Invalid batch size : %s (1 to %d)\n", argv[i+1], BATCH_MAX_STRIPES);
+				return EXIT_FAILURE;
+				}
+			}
+		
+		if( (strcmp(argv[i], "--server-threads") == 0) && (i < argc-1) ){
+			server_threads = atoi(argv[i+1]);
+			if( (server_threads <= 0) || (server_threads > RING_MAX_SHARDS) ){
+				printf("Invalid number of server threads : %s (1 to %d)\n", argv[i+1], RING_MAX_SHARDS);
+				return EXIT_FAILURE;
+				}
+			}
+		
+		if( (strcmp(argv[i], "--shard-by") == 0) && (i < argc-1) ){
+			if( strcmp(argv[i+1], "CPU") == 0 ){ shard_by = RING_SHARD_CPU; }
+			else if( strcmp(argv[i+1], "STRIPE") == 0 ){ shard_by = RING_SHARD_STRIPE; }
+			else{
+				printf("Invalid shard key : %s\n", argv[i+1]);
+				return EXIT_FAILURE;
+				}
+			}
+		
+		if( (strcmp(argv[i], "--marshal") == 0) && (i < argc-1) ){
+			marshalling = marshal_parse(argv[i+1]);
+			if(marshalling < 0){
+				printf("Invalid marshalling mode : %s\n", argv[i+1]);
+				return EXIT_FAILURE;
+				}
+			}
+		
+		if( strcmp(argv[i], "--pipeline") == 0 ){
+			pipeline = 1;
+			}
+		
+		if( strcmp(argv[i], "--lock-memory") == 0 ){
+			lock_memory = 1;
+			}
+		
+		if( (strcmp(argv[i], "--copy-buffers") == 0) && (i < argc-1) ){
+			if( (sscanf(argv[i+1], "%ld:%ld", &copy_disks, &copy_kb) != 2) ||
+				(copy_disks <= 0) || (copy_disks > ARENA_MAX_DISKS) || (copy_kb <= 0) ){
+				printf("Invalid copy buffers : %s\n", argv[i+1]);
+				return EXIT_FAILURE;
+				}
+			}
+		
+		if( (strcmp(argv[i], "--sched") == 0) && (i < argc-1) ){
+			unsigned int c[PRIO_CLASSES], w[PRIO_CLASSES];
+			unsigned long t[PRIO_CLASSES];
+			
+			sched = argv[i+1];
+			if( (strlen(sched) > 32) || 
+				(sscanf(sched, "%u/%u/%lu:%u/%u/%lu:%u/%u/%lu", &c[0], &w[0], &t[0], &c[1], &w[1], &t[1], 
+						&c[2], &w[2], &t[2]) != 3*PRIO_CLASSES) ||
+				!c[0] || !c[1] || !c[2] || !w[0] || !w[1] || !w[2] || !t[0] || !t[1] || !t[2] ){
+				printf("Invalid scheduler classes : %s\n", argv[i+1]);
+				return EXIT_FAILURE;
+				}
+			}
+		
+		if( (strcmp(argv[i], "--array") == 0) && (i < argc-1) ){
+			if( array_register(argv[i+1]) == EXIT_FAILURE ){
+				printf("Invalid or duplicate array : %s\n", argv[i+1]);
+				return EXIT_FAILURE;
+				}
+			}
+		
+		if( (strcmp(argv[i], "--spin") == 0) && (i < argc-1) ){
+			spin_us = atol(argv[i+1]);
+			if( (spin_us < 0) || (spin_us > 1000000) ){
+				printf("Invalid spin bound : %s\n", argv[i+1]);
+				return EXIT_FAILURE;
+				}
+			}
+		
+		if( (strcmp(argv[i], "--socket") == 0) && (i < argc-1) ){
+			socket_path = argv[i+1];
+			if( (socket_path[0] == '\0') || (strlen(socket_path) >= 108) ){
+				printf("Invalid socket path : %s\n", argv[i+1]);
+				return EXIT_FAILURE;
+				}
+			}
+		
+		if( (strcmp(argv[i], "--coalesce") == 0) && (i < argc-1) ){
+			coalesce_us = 0;
+			if( (sscanf(argv[i+1], "%ld:%ld", &coalesce_count, &coalesce_us) < 1) ||
+				(coalesce_count < 0) || (coalesce_count > RING_MAX_ENTRIES) ||
+				(coalesce_us < 0) || (coalesce_us > 1000000) || 
+				((coalesce_count == 0) && (coalesce_us == 0)) ){
+				printf("Invalid completion coalescing : %s\n", argv[i+1]);
+				return EXIT_FAILURE;
+				}
+			}
+		
+		if( (strcmp(argv[i], "--loopback") == 0) && (i < argc-1) ){
+			loopback_spec = argv[i+1];
 			}
 		}
 
@@ -295,7 +530,42 @@ HOST int main( int argc, char *argv[] )
 
 	thread_container tc;
 	tc.c_mode = c_mode;
-	tc.gen_syndrome = gen_syndrome;
+	tc.backend = get_syndrome_backend(0);
+	tc.compute_workers = compute_workers;
+	tc.queue_depth = queue_depth;
+	tc.arena_size = (size_t)arena_kb * 1024;
+	tc.slice_bytes = (size_t)slice_kb * 1024;
+	tc.ring_entries = (unsigned int)ring_entries;
+	tc.ring_slot_bytes = (unsigned long)ring_slot_kb * 1024;
+	tc.spin_us = (unsigned int)spin_us;
+	tc.coalesce_count = (unsigned int)coalesce_count;
+	tc.coalesce_us = (unsigned int)coalesce_us;
+	tc.batch = batch;
+	tc.server_threads = server_threads;
+	tc.shard_by = shard_by;
+	tc.pipeline = pipeline;
+	tc.marshalling = marshalling;
+	tc.sched = sched;
+	tc.socket = socket_path;
+	tc.loopback = 0;
+	tc.lock_memory = lock_memory;
+	tc.copy_disks = (int)copy_disks;
+	tc.copy_bytes = (size_t)copy_kb * 1024;
+	
+	for(i = 0; i < get_number_of_backends(); i++){
+		if(get_syndrome_backend(i)->gen_syndrome == gen_syndrome){
+			tc.backend = get_syndrome_backend(i);
+			}
+		}
+	
+	/*
+	 * The loopback stand-in replaces the kernel module, the daemon runs in a 
+	 * thread of this process and a load generator plays md.
+	 */
+	
+	if(loopback_spec != NULL){
+		return loadgen_run(&tc, loopback_spec);
+		}
 	
 	if( deamonize == 1){
 		if(c_mode == 0){
@@ -375,10 +645,76 @@ HOST int helper()
 	printf("Valid modes are SOFT, MULTI, SMP\n");
 #endif	
 	printf(" -c <mode>    : Setup the connection mode\n");
-	printf("Valid modes are NL, IOCTL, PFS\n");
+	printf("Valid modes are NL, IOCTL, PFS, RING, DOORBELL, AUTO\n");
+	printf("AUTO times NL, IOCTL, PFS and DOORBELL at startup and takes the best one\n");
+	printf(" --server-cpus <list>    : pin the server thread to a cpuset, e.g. 1 or 0-1\n");
+	printf(" --worker-cpus <list>    : pin the compute workers round robin to these cpus,\n");
+	printf("                           e.g. 2-7, or to cpusets separated by '/', e.g. 2-3/4-5\n");
+	printf("                           \"iso\" stands for all isolated (isolcpus=) cpus\n");
+	printf(" --server-sched <policy> : scheduling class of the server thread\n");
+	printf(" --worker-sched <policy> : scheduling class of the compute workers\n");
+	printf("Valid policies are FIFO:<priority>, OTHER:<nice>\n");
+	printf(" --compute-workers <n>   : compute requests on n worker threads behind a\n");
+	printf("                           lock-free request queue (default 0 = inline)\n");
+	printf(" --queue-depth <n>       : slots of the request queue (default 64)\n");
+	printf("                           kill -USR1 <pid> reports the queue counters\n");
+	printf(" --arena <KB>            : share one long-lived buffer with the kernel and pass\n");
+	printf("                           offsets instead of mapping every stripe\n");
+	printf(" --ring-entries <n>      : stripes in flight with -c RING (power of two, default %d)\n", RING_DEFAULT_ENTRIES);
+	printf(" --ring-slot <KB>        : size of one ring slot (default and least %lu)\n", (unsigned long)(RING_DEFAULT_SLOT / 1024));
+	printf(" --server-threads <n>    : serve -c RING with n threads, each with a ring of its own\n");
+	printf("                           and its own compute context (default 1, at most %d)\n", RING_MAX_SHARDS);
+	printf(" --shard-by <key>        : CPU spreads the stripes by the submitting cpu, STRIPE by a\n");
+	printf("                           hash of the stripe (default CPU)\n");
+	printf(" --batch <n>             : let the kernel hand up to n waiting stripes over with one\n");
+	printf("                           handshake (needs --arena, default 1, at most %d)\n", BATCH_MAX_STRIPES);
+	printf(" --marshal <mode>        : how stripes outside of the arena reach the daemon, MAP\n");
+	printf("                           maps every disk, COPY copies into reused buffers, AUTO\n");
+	printf("                           measures both per size and takes the cheaper one, SG\n");
+	printf("                           maps all disks at once as page lists\n");
+	printf(" --pipeline              : fetch, compute and complete the requests of NL, IOCTL, PFS\n");
+	printf("                           and DOORBELL on three threads, the release of a request\n");
+	printf("                           overlaps with the next one\n");
+	printf(" --sched <classes>       : <credits>/<weight>/<target us> of the foreground, recovery\n");
+	printf("                           and background class, separated by ':' (default\n");
+	printf("                           %s); a class has at most credits stripes\n", SCHED_DEFAULT);
+	printf("                           in flight, the stub admits by weight unless a class\n");
+	printf("                           waits longer than its target\n");
+	printf(" --array <spec>          : serve one more array, spec is <id>:<code>[:<disks>[:<backend>\n");
+	printf("                           [:<workers>]]] with code RAID6, MULTI or MULTI<m> (m check\n");
+	printf("                           symbols, up to %d), disks 0 for any geometry, the backend\n", DESC_MAX_FAILED);
+	printf("                           of -m by default and workers of its own (default 0, the\n");
+	printf("                           serving thread computes); requests are routed by the array\n");
+	printf("                           id of their descriptor, id is above 0, array 0 is the\n");
+	printf("                           one of -m; may be repeated up to %d times\n", ARRAY_MAX);
+	printf(" --socket <path>         : serve encode, decode and check requests of userspace\n");
+	printf("                           clients on a UNIX socket (e.g. %s), the\n", USOCK_DEFAULT_PATH);
+	printf("                           clients pass memfd buffers once\n");
+	printf(" --lock-memory           : lock all pages of the daemon with mlockall() and prefault\n");
+	printf("                           the mappings of the kernel module, the page faults per\n");
+	printf("                           request are reported at the end\n");
+	printf(" --copy-buffers <d>:<KB> : allocate and touch the buffers of the COPY marshalling for\n");
+	printf("                           stripes of up to d disks with KB each at startup instead\n");
+	printf("                           of with the first requests\n");
+	printf(" --spin <us>             : busy-poll the doorbell of -c DOORBELL for up to us\n");
+	printf("                           microseconds before sleeping, the budget follows the\n");
+	printf("                           arrival rate (default %d = always sleep)\n", SPIN_DEFAULT_US);
+	printf(" --coalesce <n>[:<us>]   : announce the completions of -c RING and NL with one\n");
+	printf("                           notification after n stripes or us microseconds,\n");
+	printf("                           whichever comes first, n = 0 is the capacity of the\n");
+	printf("                           transport; an idle daemon always announces at once\n");
+	printf(" --slice <KB>            : serve requests with more than KB per disk slice by slice,\n");
+	printf("                           every slice is admitted on its own so that small requests\n");
+	printf("                           get in between within the --sched targets (default off,\n");
+	printf("                           -c RING chunks the stripes by its slots anyway)\n");
+	printf(" --loopback <spec>       : run the daemon against an in-process stand-in of the kernel\n");
+	printf("                           module, driven by a load generator (needs -c), spec is\n");
+	printf("                           <producers>:<disks>:<bytes>[/<bytes>...]:<seconds>,\n");
+	printf("                           producers may be split as <fg>/<recovery>/<background>,\n");
+	printf("                           empty fields default to %s\n", LOADGEN_DEFAULT_SPEC);
 	printf(" -V           : Validation-mode (Validate the choosen RS implementations against the pure software-version)\n");
 	printf(" -B <mode>    : Benchmark-mode\n");
-	printf("Valid modes are	DRYRUN, CUDA_BANDWIDTH, CUDA_XOR, CUDA_SHIFT\n");
+	printf("Valid modes are	DRYRUN, RING_MOCK, CUDA_BANDWIDTH, CUDA_XOR, CUDA_SHIFT\n");
 	
 	return EXIT_SUCCESS;
 }
@@ -0,0 +1,484 @@
+/**
+ * \file
+ * \brief	Load generator which drives stripe streams through the daemon and the loopback stand-in
+ *
+ * @author	Dominic Eschweiler weiler@upb.de
+ *
+ * Status	: STABLE \n
+ * Date of creation : 18.10.2026
+ *
+ */
+
+
+/*****************************************************************
+ *
+ * Barracuda is a experimental microdriver extension to the 
+ * linux-kernel that is able to outsource common functions to
+ * the userspace. It was intensionally designed to accelerate
+ * CPU-intensive Tasks on a GPU.
+ *
+ * Copyright (C) 2009 Dominic Eschweiler
+ *
+ * This program is free software; you can redistribute it and/or 
+ * modify it under the terms of the GNU General Public License as 
+ * published by the Free Software Foundation; either only GPLv2 - 
+ * version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful, 
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of 
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the 
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public 
+ * License along with this program; 
+ * if not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <string.h>
+#include <syslog.h>
+#include <errno.h>
+#include <pthread.h>
+
+# include "loadgen.h"
+# include "../loopback.h"
+# include "../userspace_driver.h"
+# include "../backends.h"
+# include "../service.h"
+# include "../ring.h"
+
+#define LOADGEN_MAX_SIZES	8
+#define LOADGEN_BUCKETS		24
+#define LOADGEN_CHECK_EVERY	64
+
+/* The stream every producer generates */
+static struct{
+	int producers;
+	int classes[PRIO_CLASSES];
+	int disks;
+	size_t sizes[LOADGEN_MAX_SIZES];
+	int nsizes;
+	size_t max_bytes;
+	double seconds;
+	volatile int running;
+	volatile int active;
+	int daemon_ret;
+	}lg;
+
+/* State and counters of one producer */
+typedef struct loadgen_producer{
+	pthread_t thread;
+	unsigned int seed;
+	int prio;
+	void **dptrs;
+	void **check;
+	unsigned long stripes;
+	double bytes;
+	double total_us;
+	double max_us;
+	unsigned long hist[LOADGEN_BUCKETS];
+	unsigned long ops;
+	int errors;
+	int wrong;
+	}loadgen_producer;
+
+
+
+/**
+ * Splits a string at ':' into at most n fields, empty fields are kept.
+ *
+ * @param *s		: string, gets modified
+ * @param **fields	: fields, missing ones are NULL
+ * @param n			: number of fields
+ *
+ * @returns		void
+ */
+
+static void loadgen_split(char *s, char **fields, int n)
+{
+int i = 0;
+
+memset(fields, 0, n * sizeof(char *));
+fields[i++] = s;
+
+for(; *s; s++){
+	if(*s == ':'){
+		*s = '\0';
+		if(i < n){ fields[i++] = s+1; }
+		}
+	}
+}
+
+
+
+/**
+ * Parses the load spec, see loadgen_run().
+ *
+ * @param *spec		: load spec
+ *
+ * @returns		EXIT_SUCCESS or EXIT_FAILURE
+ */
+
+static int loadgen_parse(char *spec)
+{
+char buffer[256];
+char defaults[] = LOADGEN_DEFAULT_SPEC;
+char *fields[4];
+char *dfields[4];
+char *size;
+char *count;
+int i;
+
+strncpy(buffer, spec, sizeof(buffer)-1);
+buffer[sizeof(buffer)-1] = '\0';
+
+loadgen_split(buffer, fields, 4);
+loadgen_split(defaults, dfields, 4);
+for(i=0; i < 4; i++){
+	if( (fields[i] == NULL) || (fields[i][0] == '\0') ){ fields[i] = dfields[i]; }
+	}
+
+/* <foreground>[/<recovery>[/<background>]] producers */
+lg.producers = 0;
+memset(lg.classes, 0, sizeof(lg.classes));
+for(i = 0, count = strtok(fields[0], "/"); count != NULL; count = strtok(NULL, "/"), i++){
+	if( (i == PRIO_CLASSES) || (atoi(count) < 0) ){ return EXIT_FAILURE; }
+	lg.classes[i]  = atoi(count);
+	lg.producers  += lg.classes[i];
+	}
+
+lg.disks	 = atoi(fields[1]);
+lg.seconds	 = atof(fields[3]);
+lg.nsizes	 = 0;
+lg.max_bytes = 0;
+
+for(size = strtok(fields[2], "/"); size != NULL; size = strtok(NULL, "/")){
+	if(lg.nsizes == LOADGEN_MAX_SIZES){ return EXIT_FAILURE; }
+	lg.sizes[lg.nsizes] = (size_t)atol(size);
+	if( (lg.sizes[lg.nsizes] == 0) || (lg.sizes[lg.nsizes] > (16UL << 20)) ){ return EXIT_FAILURE; }
+	if(lg.sizes[lg.nsizes] > lg.max_bytes){ lg.max_bytes = lg.sizes[lg.nsizes]; }
+	lg.nsizes++;
+	}
+
+if( (lg.producers <= 0) || (lg.producers > 1024) ){ return EXIT_FAILURE; }
+if( (lg.disks < 4) || (lg.disks > ARENA_MAX_DISKS) ){ return EXIT_FAILURE; }
+if( (lg.nsizes == 0) || (lg.seconds <= 0) ){ return EXIT_FAILURE; }
+
+return EXIT_SUCCESS;
+}
+
+
+
+/**
+ * Rebuilds two data disks of a checked stripe through the daemon and checks 
+ * the stripe afterwards, the data must match the reference copy again.
+ *
+ * @param *p		: producer, check holds the reference of the stripe
+ * @param bytes		: bytes per disk
+ *
+ * @returns		0, 1 if the daemon got it wrong or -EOPNOTSUPP
+ */
+
+static int loadgen_recover(loadgen_producer *p, size_t bytes)
+{
+int failed[2];
+int ret;
+int i;
+
+failed[0] = rand_r(&p->seed) % (lg.disks-2);
+failed[1] = (failed[0] + 1 + rand_r(&p->seed) % (lg.disks-3)) % (lg.disks-2);
+for(i=0; i < 2; i++){ memset(p->dptrs[failed[i]], 0, bytes); }
+
+ret = loopback_submit_op(0, OP_RECOV_2DATA, PRIO_RECOVERY, lg.disks, bytes, 0, lg.disks-3, 2, failed, 0, p->dptrs);
+if(ret == -EOPNOTSUPP){
+	for(i=0; i < 2; i++){ memcpy(p->dptrs[failed[i]], p->check[failed[i]], bytes); }
+	return ret;
+	}
+
+for(i=0; i < 2; i++){
+	if( memcmp(p->dptrs[failed[i]], p->check[failed[i]], bytes) ){
+		memcpy(p->dptrs[failed[i]], p->check[failed[i]], bytes);
+		ret = 1;
+		}
+	}
+if(ret != 0){ return 1; }
+
+if( loopback_submit_op(0, OP_CHECK, PRIO_BACKGROUND, lg.disks, bytes, 0, lg.disks-3, 0, NULL, 0, p->dptrs) != 0 ){ return 1; }
+
+p->ops += 2;
+return 0;
+}
+
+
+
+/**
+ * Body of a producer thread: a stream of stripes, back to back.
+ *
+ * @param *arg		: producer
+ *
+ * @returns		NULL
+ */
+
+static void *loadgen_producer_main(void *arg)
+{
+loadgen_producer *p = (loadgen_producer *)arg;
+int recover = 1;
+size_t bytes;
+double t;
+double us;
+int b;
+int i;
+
+while(lg.running){
+	bytes = lg.sizes[ rand_r(&p->seed) % lg.nsizes ];
+	
+	/* a new stripe, some data of every data disk changes */
+	for(i=0; i < lg.disks-2; i++){
+		((unsigned char *)p->dptrs[i])[ rand_r(&p->seed) % bytes ] = (unsigned char)rand_r(&p->seed);
+		}
+	
+	t = gtd_second();
+	if( loopback_gen_syndrome_prio(lg.disks, bytes, p->dptrs, p->prio) != 0 ){
+		p->errors++;
+		break;
+		}
+	us = (gtd_second() - t) * 1e6;
+	
+	for(b = 0; (b < LOADGEN_BUCKETS-1) && ((double)(1UL << b) < us); b++);
+	p->hist[b]++;
+	p->total_us += us;
+	if(us > p->max_us){ p->max_us = us; }
+	
+	/* compare with the reference implementation now and then */
+	if( (p->stripes % LOADGEN_CHECK_EVERY) == 0 ){
+		for(i=0; i < lg.disks-2; i++){ memcpy(p->check[i], p->dptrs[i], bytes); }
+		get_syndrome_backend(0)->gen_syndrome(lg.disks, bytes, p->check);
+		if( memcmp(p->check[lg.disks-2], p->dptrs[lg.disks-2], bytes) ||
+			memcmp(p->check[lg.disks-1], p->dptrs[lg.disks-1], bytes) ){
+			p->wrong++;
+			}
+		
+		/* the other paths of the descriptor, as long as the daemon speaks them */
+		if(recover){
+			switch( loadgen_recover(p, bytes) ){
+				case 1 :			p->wrong++;
+									break;
+				case -EOPNOTSUPP :	recover = 0;
+									break;
+				}
+			}
+		}
+	
+	p->stripes++;
+	p->bytes += (double)bytes * (lg.disks-2);
+	}
+
+__sync_fetch_and_sub(&lg.active, 1);
+return NULL;
+}
+
+
+
+/**
+ * Body of the daemon thread.
+ *
+ * @param *arg		: thread container
+ *
+ * @returns		NULL
+ */
+
+static void *loadgen_daemon(void *arg)
+{
+lg.daemon_ret = userspace_driver_main(arg);
+
+/* a daemon which failed early must not leave the producers waiting */
+loopback_stop();
+return NULL;
+}
+
+
+
+/**
+ * Returns the upper bound of the bucket which holds a quantile.
+ *
+ * @param *hist		: latency histogram, bucket b holds latencies <= 2^b us
+ * @param total		: number of samples
+ * @param q			: quantile
+ *
+ * @returns		latency in us
+ */
+
+static unsigned long loadgen_quantile(unsigned long *hist, unsigned long total, double q)
+{
+unsigned long sum = 0;
+int b;
+
+for(b=0; b < LOADGEN_BUCKETS-1; b++){
+	sum += hist[b];
+	if(sum >= q * total){ break; }
+	}
+
+return 1UL << b;
+}
+
+
+
+/**
+ * Runs the daemon against the loopback stand-in and drives it.
+ *
+ * @param *tc		: configuration of the daemon
+ * @param *spec		: load spec
+ *
+ * @returns		EXIT_SUCCESS or EXIT_FAILURE
+ */
+
+HOST int loadgen_run(thread_container *tc, char *spec)
+{
+char *transports[] = { "", "NL", "IOCTL", "PFS", "RING", "DOORBELL", "AUTO" };
+char *classes[] = { "foreground", "recovery", "background" };
+unsigned long class_hist[PRIO_CLASSES][LOADGEN_BUCKETS];
+unsigned long class_stripes[PRIO_CLASSES];
+double class_us[PRIO_CLASSES];
+loopback_class_stats *cs;
+int bound;
+int c;
+loadgen_producer *producers;
+loopback_stats stats;
+pthread_t daemon;
+unsigned long hist[LOADGEN_BUCKETS];
+unsigned long stripes = 0;
+unsigned long ops = 0;
+double bytes = 0;
+double total_us = 0;
+double max_us = 0;
+int errors = 0;
+int wrong = 0;
+size_t pool;
+double t;
+int i;
+int j;
+
+if( loadgen_parse(spec) == EXIT_FAILURE ){
+	printf("Invalid load spec : %s\n", spec);
+	return EXIT_FAILURE;
+	}
+
+if( (tc->c_mode < 1) || (tc->c_mode > 6) ){
+	printf("The loopback needs a connection mode, see -c\n");
+	return EXIT_FAILURE;
+	}
+
+/* the disks of all producers, the arena, the ring and the segment table live in the shared pool */
+pool = (size_t)lg.producers * lg.disks * RING_STRIDE(lg.max_bytes) + tc->arena_size + RING_ALIGN;
+if(tc->c_mode == 4){ pool += tc->server_threads * ring_region_size(tc->ring_entries, tc->ring_slot_bytes); }
+if(tc->marshalling == MARSHAL_SG){ pool += RING_STRIDE(sizeof(sg_table)); }
+if(tc->c_mode == 6){ pool += PING_DISKS * RING_STRIDE(PING_MAX_BYTES); }
+
+if( loopback_init(pool + 16*RING_ALIGN) == EXIT_FAILURE ){
+	printf("Can't create the loopback stand-in with %lu bytes\n", (unsigned long)pool);
+	return EXIT_FAILURE;
+	}
+
+/* the daemon reports to the syslog, show it on the console as well */
+openlog("barracuda-loopback", LOG_PERROR | LOG_PID, LOG_USER);
+
+producers = (loadgen_producer *)calloc(lg.producers, sizeof(loadgen_producer));
+for(i = 0, c = 0, bound = lg.classes[0]; i < lg.producers; i++){
+	/* producers are handed out foreground first, then recovery, then background */
+	while(i >= bound){ bound += lg.classes[++c]; }
+	producers[i].prio	= c;
+	producers[i].seed	= 1 + i;
+	producers[i].dptrs	= (void **)malloc(lg.disks * sizeof(void *));
+	producers[i].check	= allocate_host_example_dpointer(lg.max_bytes, lg.disks);
+	for(j=0; j < lg.disks; j++){
+		producers[i].dptrs[j] = loopback_alloc(lg.max_bytes);
+		memset(producers[i].dptrs[j], rand(), lg.max_bytes);
+		}
+	}
+
+tc->loopback = 1;
+pthread_create(&daemon, NULL, loadgen_daemon, tc);
+
+lg.running	= 1;
+lg.active	= lg.producers;
+t = gtd_second();
+for(i=0; i < lg.producers; i++){
+	pthread_create(&producers[i].thread, NULL, loadgen_producer_main, &producers[i]);
+	}
+
+while( (gtd_second() - t < lg.seconds) && lg.active ){ usleep(10000); }
+lg.running = 0;
+
+for(i=0; i < lg.producers; i++){ pthread_join(producers[i].thread, NULL); }
+t = gtd_second() - t;
+
+userspace_driver_stop();
+loopback_stop();
+pthread_join(daemon, NULL);
+
+memset(hist, 0, sizeof(hist));
+memset(class_hist, 0, sizeof(class_hist));
+memset(class_stripes, 0, sizeof(class_stripes));
+memset(class_us, 0, sizeof(class_us));
+for(i=0; i < lg.producers; i++){
+	c = producers[i].prio;
+	class_stripes[c] += producers[i].stripes;
+	class_us[c]		 += producers[i].total_us;
+	for(j=0; j < LOADGEN_BUCKETS; j++){ class_hist[c][j] += producers[i].hist[j]; }
+
+	stripes  += producers[i].stripes;
+	bytes	 += producers[i].bytes;
+	total_us += producers[i].total_us;
+	ops		 += producers[i].ops;
+	errors	 += producers[i].errors;
+	wrong	 += producers[i].wrong;
+	if(producers[i].max_us > max_us){ max_us = producers[i].max_us; }
+	for(j=0; j < LOADGEN_BUCKETS; j++){ hist[j] += producers[i].hist[j]; }
+	}
+
+loopback_get_stats(&stats);
+
+printf("%s via %s, %s, %d producers, %d disks, %d stripe sizes up to %lu bytes\n", transports[tc->c_mode],
+		loopback_kernel_ops()->name, tc->backend->name, lg.producers, lg.disks, lg.nsizes, (unsigned long)lg.max_bytes);
+printf("\"stripes\" ; \"stripes/s\" ; \"MB/s\" ; \"mean us\" ; \"p50 us\" ; \"p99 us\" ; \"max us\"\n");
+printf("%lu ; %.0f ; %.1f ; %.1f ; %lu ; %lu ; %.0f\n", stripes, stripes / t, bytes / (t * 1e6),
+		stripes ? total_us / stripes : 0.0, loadgen_quantile(hist, stripes, 0.5), 
+		loadgen_quantile(hist, stripes, 0.99), max_us);
+printf("  stand-in : %lu requests, %lu handshakes, %lu handshake errors, %lu mmap calls, %lu copy calls\n",
+		stats.requests, stats.handshakes, stats.handshake_errors, stats.mmap_calls, stats.copy_calls);
+if(stats.notifications){
+	printf("  completions : %lu stripes announced with %lu doorbell calls, %.1f each\n",
+			stats.requests, stats.notifications, (double)stats.requests / stats.notifications);
+	}
+if(stats.pings){
+	printf("  calibration : %lu ping stripes before con=\n", stats.pings);
+	}
+if(stats.sliced){
+	printf("  slices : %lu requests served in %lu slices\n", stats.sliced, stats.slices);
+	}
+for(c=0; c < PRIO_CLASSES; c++){
+	cs = &stats.classes[c];
+	if(cs->served == 0){ continue; }
+	printf("  %-10s : %lu stripes, mean %.1f us, p99 %lu us, admission wait mean %.1f us, max %llu us, %lu over target\n",
+			classes[c], class_stripes[c], class_stripes[c] ? class_us[c] / class_stripes[c] : 0.0,
+			loadgen_quantile(class_hist[c], class_stripes[c], 0.99), (double)cs->wait_us / cs->served, 
+			cs->max_wait_us, cs->overdue);
+	}
+if(ops){ printf("  operations : %lu RECOV_2DATA and CHECK requests, every %d stripes\n", ops, LOADGEN_CHECK_EVERY); }
+
+if(errors){ printf("!!! %d producers could not submit, see the syslog !!!\n", errors); }
+if(wrong){ printf("!!! The daemon returned wrong checksums !!!\n"); }
+
+for(i=0; i < lg.producers; i++){
+	free(producers[i].dptrs);
+	deallocate_host_example_dpointer(lg.disks, producers[i].check);
+	}
+free(producers);
+closelog();
+loopback_release();
+
+return (errors || wrong || lg.daemon_ret || stats.handshake_errors) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,68 @@
+/**
+ * \file
+ * \brief	Load generator which drives stripe streams through the daemon and the loopback stand-in
+ *
+ * @author	Dominic Eschweiler weiler@upb.de
+ *
+ * Status	: STABLE \n
+ * Date of creation : 18.10.2026
+ *
+ */
+
+
+/*****************************************************************
+ *
+ * Barracuda is a experimental microdriver extension to the 
+ * linux-kernel that is able to outsource common functions to
+ * the userspace. It was intensionally designed to accelerate
+ * CPU-intensive Tasks on a GPU.
+ *
+ * Copyright (C) 2009 Dominic Eschweiler
+ *
+ * This program is free software; you can redistribute it and/or 
+ * modify it under the terms of the GNU General Public License as 
+ * published by the Free Software Foundation; either only GPLv2 - 
+ * version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful, 
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of 
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the 
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public 
+ * License along with this program; 
+ * if not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************/
+
+#ifndef LOADGEN
+#define LOADGEN
+
+# include "../definitions.h"
+
+/*! \def LOADGEN_DEFAULT_SPEC
+	\brief 4 producers, 10 disks, stripes of 4, 16 and 64 KB per disk, 5 seconds */
+
+#define LOADGEN_DEFAULT_SPEC	"4:10:4096/16384/65536:5"
+
+/**
+ * Runs the daemon of tc in a thread against the loopback stand-in and drives
+ * it with a number of producer threads which play the md stripe threads. 
+ * Every producer submits stripes of a size chosen at random from the list, 
+ * back to back, and measures the latency of each. Throughput, the latency 
+ * distribution and the counters of the stand-in are printed at the end, 
+ * every 64th stripe is checked against the SOFT implementation. Producers 
+ * can be split into foreground, recovery and background classes, the 
+ * latency and the admission wait are then reported per class.
+ *
+ * @param *tc		: configuration of the daemon, c_mode selects the transport
+ * @param *spec		: <producers>:<disks>:<bytes>[/<bytes>...]:<seconds>, 
+ *					  producers is <foreground>[/<recovery>[/<background>]],
+ *					  omitted fields are taken from LOADGEN_DEFAULT_SPEC
+ *
+ * @returns		EXIT_SUCCESS or EXIT_FAILURE
+ */
+
+HOST int loadgen_run(thread_container *tc, char *spec);
+
+#endif
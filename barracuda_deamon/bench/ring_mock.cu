@@ -0,0 +1,311 @@
+/**
+ * \file
+ * \brief	Userspace mock of the kernel side of the submission/completion ring
+ *
+ * @author	Dominic Eschweiler weiler@upb.de
+ *
+ * Status	: STABLE \n
+ * Date of creation : 18.10.2026
+ *
+ */
+
+
+/*****************************************************************
+ *
+ * Barracuda is a experimental microdriver extension to the 
+ * linux-kernel that is able to outsource common functions to
+ * the userspace. It was intensionally designed to accelerate
+ * CPU-intensive Tasks on a GPU.
+ *
+ * Copyright (C) 2009 Dominic Eschweiler
+ *
+ * This program is free software; you can redistribute it and/or 
+ * modify it under the terms of the GNU General Public License as 
+ * published by the Free Software Foundation; either only GPLv2 - 
+ * version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful, 
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of 
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the 
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public 
+ * License along with this program; 
+ * if not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <string.h>
+#include <signal.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <sys/mman.h>
+
+# include "ring_mock.h"
+# include "../ring.h"
+# include "../async.h"
+# include "../backends.h"
+# include "../service.h"
+
+#define RING_MOCK_ENTRIES	32
+#define RING_MOCK_DISKS		10
+#define RING_MOCK_BYTES		4096
+#define RING_MOCK_SECONDS	2.0
+
+/* The producer side, this is what the kernel stub does with its locks */
+static struct{
+	ring_header *ring;
+	pthread_mutex_t lock;
+	sem_t slots;
+	sem_t doorbell;
+	sem_t *done;
+	unsigned int *free_slots;
+	int free_top;
+	volatile int running;
+	volatile unsigned long stripes;
+	volatile int failed;
+	}mock;
+
+static volatile sig_atomic_t mock_keep_going;
+
+
+
+/**
+ * Doorbell of the mock: reaps the completions and waits for submissions.
+ *
+ * @param *arg		: unused
+ * @param wait		: wait for submissions
+ *
+ * @returns		number of pending submissions
+ */
+
+static int ring_mock_enter(void *arg, int wait)
+{
+ring_header *ring = mock.ring;
+unsigned int head = ring->cq_head;
+
+while(head != ring->cq_tail){
+	__sync_synchronize();
+	if(ring->cq[head & (ring->entries-1)].result != 0){ mock.failed = 1; }
+	sem_post( &mock.done[ ring->cq[head & (ring->entries-1)].slot ] );
+	head++;
+	}
+ring->cq_head = head;
+
+while( wait && (ring->sq_head == ring->sq_tail) && mock_keep_going ){
+	sem_wait(&mock.doorbell);
+	}
+
+return ring->sq_tail - ring->sq_head;
+}
+
+
+
+/**
+ * Body of a producer thread.
+ *
+ * @param *arg		: unused
+ *
+ * @returns		NULL
+ */
+
+static void *ring_mock_producer(void *arg)
+{
+ring_header *ring = mock.ring;
+void **dptrs = allocate_host_example_dpointer(RING_MOCK_BYTES, RING_MOCK_DISKS);
+void **check = allocate_host_example_dpointer(RING_MOCK_BYTES, RING_MOCK_DISKS);
+unsigned int slot;
+unsigned int tail;
+char *base;
+int first = 1;
+int i;
+
+for(i=0; i < RING_MOCK_DISKS*RING_MOCK_BYTES; i++){
+	((unsigned char *)dptrs[i / RING_MOCK_BYTES])[i % RING_MOCK_BYTES] = rand();
+	}
+
+while(mock.running){
+	/* claim a slot */
+	while( sem_wait(&mock.slots) != 0 );
+	pthread_mutex_lock(&mock.lock);
+	slot = mock.free_slots[--mock.free_top];
+	pthread_mutex_unlock(&mock.lock);
+	
+	base = (char *)ring + ring->data_offset + slot*ring->slot_bytes;
+	for(i=0; i < RING_MOCK_DISKS-2; i++){
+		memcpy(base + i*RING_STRIDE(RING_MOCK_BYTES), dptrs[i], RING_MOCK_BYTES);
+		}
+	
+	/* publish the submission */
+	pthread_mutex_lock(&mock.lock);
+	tail = ring->sq_tail;
+	ring->sq[tail & (ring->entries-1)].slot  = slot;
+	ring->sq[tail & (ring->entries-1)].disks = RING_MOCK_DISKS;
+	ring->sq[tail & (ring->entries-1)].bytes = RING_MOCK_BYTES;
+	__sync_synchronize();
+	ring->sq_tail = tail + 1;
+	pthread_mutex_unlock(&mock.lock);
+	sem_post(&mock.doorbell);
+	
+	while( sem_wait(&mock.done[slot]) != 0 );
+	
+	memcpy(dptrs[RING_MOCK_DISKS-2], base + (RING_MOCK_DISKS-2)*RING_STRIDE(RING_MOCK_BYTES), RING_MOCK_BYTES);
+	memcpy(dptrs[RING_MOCK_DISKS-1], base + (RING_MOCK_DISKS-1)*RING_STRIDE(RING_MOCK_BYTES), RING_MOCK_BYTES);
+	
+	/* give the slot back */
+	pthread_mutex_lock(&mock.lock);
+	mock.free_slots[mock.free_top++] = slot;
+	pthread_mutex_unlock(&mock.lock);
+	sem_post(&mock.slots);
+	
+	/* the first stripe of every producer is checked against the reference */
+	if(first){
+		for(i=0; i < RING_MOCK_DISKS; i++){ memcpy(check[i], dptrs[i], RING_MOCK_BYTES); }
+		get_syndrome_backend(0)->gen_syndrome(RING_MOCK_DISKS, RING_MOCK_BYTES, check);
+		if( memcmp(check[RING_MOCK_DISKS-2], dptrs[RING_MOCK_DISKS-2], RING_MOCK_BYTES) ||
+			memcmp(check[RING_MOCK_DISKS-1], dptrs[RING_MOCK_DISKS-1], RING_MOCK_BYTES) ){
+			mock.failed = 1;
+			}
+		first = 0;
+		}
+	
+	__sync_fetch_and_add(&mock.stripes, 1);
+	}
+
+deallocate_host_example_dpointer(RING_MOCK_DISKS, dptrs);
+deallocate_host_example_dpointer(RING_MOCK_DISKS, check);
+return NULL;
+}
+
+
+
+/**
+ * Body of the consumer thread, the same loop as the daemons server_ring().
+ *
+ * @param *arg		: backend
+ *
+ * @returns		NULL
+ */
+
+static void *ring_mock_consumer(void *arg)
+{
+syndrome_backend *backend = (syndrome_backend *)arg;
+syndrome_context ctx;
+ring_consumer rc;
+
+syndrome_context_init(backend, &ctx);
+
+if( ring_consumer_init(&rc, mock.ring, backend, &ctx, ring_mock_enter, NULL, &mock_keep_going) == EXIT_SUCCESS ){
+	ring_consumer_run(&rc);
+	printf("  batches : %lu, average batch : %.2f, largest batch : %lu\n", rc.batches,
+			rc.batches ? (double)rc.submissions / rc.batches : 0.0, rc.max_batch);
+	ring_consumer_destroy(&rc);
+	}
+
+syndrome_context_release(backend, &ctx);
+return NULL;
+}
+
+
+
+/**
+ * Runs the mock with a number of producers.
+ *
+ * @param *backend	: implementation
+ * @param producers	: number of producer threads
+ *
+ * @returns		void
+ */
+
+static void ring_mock_run(syndrome_backend *backend, int producers)
+{
+pthread_t consumer;
+pthread_t *threads = (pthread_t *)malloc(producers * sizeof(pthread_t));
+double t;
+int i;
+
+ring_init_header(mock.ring, RING_MOCK_ENTRIES, RING_MOCK_DISKS*RING_STRIDE(RING_MOCK_BYTES));
+for(i=0; i < RING_MOCK_ENTRIES; i++){
+	mock.free_slots[i] = i;
+	sem_init(&mock.done[i], 0, 0);
+	}
+mock.free_top	= RING_MOCK_ENTRIES;
+mock.stripes	= 0;
+mock.running	= 1;
+mock_keep_going	= 1;
+sem_init(&mock.slots, 0, RING_MOCK_ENTRIES);
+sem_init(&mock.doorbell, 0, 0);
+
+pthread_create(&consumer, NULL, ring_mock_consumer, backend);
+
+t = gtd_second();
+for(i=0; i < producers; i++){ pthread_create(&threads[i], NULL, ring_mock_producer, NULL); }
+
+usleep((useconds_t)(RING_MOCK_SECONDS * 1e6));
+mock.running = 0;
+
+for(i=0; i < producers; i++){ pthread_join(threads[i], NULL); }
+t = gtd_second() - t;
+
+mock_keep_going = 0;
+sem_post(&mock.doorbell);
+pthread_join(consumer, NULL);
+
+printf("%d ; %.0f ; %.1f\n", producers, mock.stripes / t,
+		(mock.stripes * (double)RING_MOCK_BYTES * (RING_MOCK_DISKS-2)) / (t * 1e6));
+
+for(i=0; i < RING_MOCK_ENTRIES; i++){ sem_destroy(&mock.done[i]); }
+sem_destroy(&mock.slots);
+sem_destroy(&mock.doorbell);
+free(threads);
+}
+
+
+
+/**
+ * Benchmarks the ring consumer without the kernel module.
+ *
+ * @param *backend	: implementation which computes the syndromes
+ *
+ * @returns		void
+ */
+
+HOST void ring_mock_benchmark(syndrome_backend *backend)
+{
+size_t size = ring_region_size(RING_MOCK_ENTRIES, RING_MOCK_DISKS*RING_STRIDE(RING_MOCK_BYTES));
+int workers = get_number_of_phys_cpus() - 1;
+int producers;
+
+mock.ring = (ring_header *)mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+if(mock.ring == MAP_FAILED){
+	printf("Can't allocate the mock ring\n");
+	return;
+	}
+
+mock.done		= (sem_t *)malloc(RING_MOCK_ENTRIES * sizeof(sem_t));
+mock.free_slots	= (unsigned int *)malloc(RING_MOCK_ENTRIES * sizeof(unsigned int));
+mock.failed		= 0;
+pthread_mutex_init(&mock.lock, NULL);
+
+printf("%s, %d disks, %d bytes, %d slots, inline compute\n", backend->name, 
+		RING_MOCK_DISKS, RING_MOCK_BYTES, RING_MOCK_ENTRIES);
+printf("\"producers\" ; \"stripes/s\" ; \"MB/s\"\n");
+for(producers = 1; producers <= 16; producers *= 2){ ring_mock_run(backend, producers); }
+
+if( (workers > 0) && (syndrome_async_start(backend, workers, RING_MOCK_ENTRIES) == EXIT_SUCCESS) ){
+	printf("%s, %d compute workers, completions out of order\n", backend->name, workers);
+	printf("\"producers\" ; \"stripes/s\" ; \"MB/s\"\n");
+	for(producers = 1; producers <= 16; producers *= 2){ ring_mock_run(backend, producers); }
+	syndrome_async_stop();
+	}
+
+if(mock.failed){ printf("!!! The ring returned wrong checksums !!!\n"); }
+
+pthread_mutex_destroy(&mock.lock);
+free(mock.done);
+free(mock.free_slots);
+munmap(mock.ring, size);
+}
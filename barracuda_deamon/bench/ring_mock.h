@@ -0,0 +1,57 @@
+/**
+ * \file
+ * \brief	Userspace mock of the kernel side of the submission/completion ring
+ *
+ * @author	Dominic Eschweiler weiler@upb.de
+ *
+ * Status	: STABLE \n
+ * Date of creation : 18.10.2026
+ *
+ */
+
+
+/*****************************************************************
+ *
+ * Barracuda is a experimental microdriver extension to the 
+ * linux-kernel that is able to outsource common functions to
+ * the userspace. It was intensionally designed to accelerate
+ * CPU-intensive Tasks on a GPU.
+ *
+ * Copyright (C) 2009 Dominic Eschweiler
+ *
+ * This program is free software; you can redistribute it and/or 
+ * modify it under the terms of the GNU General Public License as 
+ * published by the Free Software Foundation; either only GPLv2 - 
+ * version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful, 
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of 
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the 
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public 
+ * License along with this program; 
+ * if not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************/
+
+#ifndef RING_MOCK
+#define RING_MOCK
+
+# include "../definitions.h"
+
+/**
+ * Benchmarks the ring consumer of the daemon without the kernel module. A 
+ * number of producer threads plays the md stripe threads: each copies a 
+ * stripe into a free slot, submits it, waits for its completion and copies 
+ * the checksums back. The consumer is the same code the daemon runs against 
+ * /dev/barracuda, only the doorbell is replaced.
+ *
+ * @param *backend	: implementation which computes the syndromes
+ *
+ * @returns		void
+ */
+
+HOST void ring_mock_benchmark(syndrome_backend *backend);
+
+#endif
@@ -53,9 +53,11 @@
 #endif
 
 # include "bench/gen_syndrome_test.h"
+# include "bench/ring_mock.h"
 
 # include "benchmarker.h"
 # include "service.h"
+# include "backends.h"
 
 
 
@@ -86,6 +88,11 @@ if( strcmp(mode, "DRYRUN") == 0 ){
 									c_mode );
 	}
 
+if( strcmp(mode, "RING_MOCK") == 0 ){
+	printf("Starting RING_MOCK for testing the submission/completion ring without the kernel module.\n");
+	ring_mock_benchmark( get_syndrome_backend(c_mode) );
+	}
+
 #ifndef NOCUDA
 if( strcmp(mode, "CUDA_BANDWIDTH") == 0 ){
 	printf("Starting CUDA_BANDWIDTH for testing the bandwidth beteween host and cuda device.\n");
@@ -45,6 +45,7 @@
  * @param *mode						: what shall we benchmark.
  *									  Valid modes are :\n
  *									  DRYRUN -> for benchmarking the pure implementation speed\n
+ *									  RING_MOCK -> for benchmarking the ring without the kernel module\n
  * @param gen_syndrome_list[]		: function pointers
  * @param **implemenatation_names	: related names of each function
  * @param number_of_implementations	: # of implementations
@@ -0,0 +1,175 @@
+/**
+ * \file
+ * \brief	Calibration of the connection for -c AUTO
+ *
+ * @author	Dominic Eschweiler weiler@upb.de
+ *
+ * Status	: STABLE \n
+ * Date of creation : 18.10.2026
+ *
+ */
+
+
+/*****************************************************************
+ *
+ * Barracuda is a experimental microdriver extension to the 
+ * linux-kernel that is able to outsource common functions to
+ * the userspace. It was intensionally designed to accelerate
+ * CPU-intensive Tasks on a GPU.
+ *
+ * Copyright (C) 2009 Dominic Eschweiler
+ *
+ * This program is free software; you can redistribute it and/or 
+ * modify it under the terms of the GNU General Public License as 
+ * published by the Free Software Foundation; either only GPLv2 - 
+ * version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful, 
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of 
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the 
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public 
+ * License along with this program; 
+ * if not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <syslog.h>
+
+# include "calibrate.h"
+
+/* Round trips of one page and stripes of PING_MAX_BYTES for the throughput */
+#define CALIBRATE_ROUNDS	512
+#define CALIBRATE_STRIPES	64
+
+/* A connection as seen by the calibration */
+typedef struct calibration{
+	int c_mode;
+	char *name;
+	double rtt_us;
+	double mbs;
+	}calibration;
+
+
+
+/**
+ * Lets the kernel stub hand rounds ping stripes over a connection and serves
+ * exactly these, see ping= in global_def.h.
+ *
+ * @param *dc		: driver context of the main thread
+ * @param *tc		: configuration of the daemon
+ * @param *cal		: the connection
+ * @param rounds	: number of stripes, at least 2
+ * @param bytes		: bytes per disk
+ *
+ * @returns			seconds from the arrival of one stripe to the next, < 0 on error
+ */
+
+static double calibrate_run(driver_context *dc, thread_container *tc, calibration *cal, int rounds, size_t bytes)
+{
+char command[50];
+
+sprintf(command, "ping=%s:%d:%lu", cal->name, rounds, (unsigned long)bytes);
+if( dc->kops->conf_write(command) == EXIT_FAILURE ){ return -1; }
+
+dc->budget		 = rounds;
+dc->budget_first = 0;
+dc->budget_last	 = 0;
+
+switch( cal->c_mode ){
+	case 1 :	server_netlink(dc, 0);
+				break;
+	case 2 :	server_ioctl_callback(dc, 0);
+				break;
+	case 3 :	server_procfs(dc, 0);
+				break;
+	case 5 :	server_doorbell(dc, tc->spin_us, 0);
+				break;
+}
+
+/* the daemon was stopped before the last stripe */
+if(dc->budget != 0){
+	dc->budget = 0;
+	return -1;
+	}
+
+return (double)(dc->budget_last - dc->budget_first) / 1e9 / (rounds - 1);
+}
+
+
+
+/**
+ * Implements -c AUTO. Every single-slot connection the kernel stub offers is
+ * timed with round trips of one page and with stripes of PING_MAX_BYTES, 
+ * like the ping-pong prototypes do. Both figures count the same, relative to
+ * the best connection in each; the connection with the lowest sum is taken.
+ * RING is left out, it doesn't hand the stripes over one by one.
+ *
+ * @param *dc		: driver context of the main thread
+ * @param *tc		: configuration of the daemon
+ *
+ * @returns			the connection mode, IOCTL if the stub can't be timed
+ */
+
+HOST int calibrate_connection(driver_context *dc, thread_container *tc)
+{
+calibration cal[] = { {1, (char *)"NL"}, {2, (char *)"IOCTL"}, {3, (char *)"PROCFS"}, {5, (char *)"DOORBELL"} };
+int n = sizeof(cal) / sizeof(calibration);
+double best_rtt = 0;
+double best_mbs = 0;
+double best_score = 0;
+double score;
+double t;
+int best = -1;
+int i;
+
+if(dc->proto < 4){
+	syslog(LOG_NOTICE, "The kernel stub doesn't answer ping=, -c AUTO takes IOCTL\n");
+	return 2;
+	}
+
+for(i=0; (i < n) && keep_going; i++){
+	cal[i].rtt_us = 0;
+	cal[i].mbs	  = 0;
+	if( (cal[i].c_mode == 5) && (dc->doorbell_submit < 0) ){ continue; }
+	
+	t = calibrate_run(dc, tc, &cal[i], CALIBRATE_ROUNDS, getpagesize());
+	if(t <= 0){
+		syslog(LOG_NOTICE, "Calibration : %s doesn't answer\n", cal[i].name);
+		continue;
+		}
+	cal[i].rtt_us = t * 1e6;
+	
+	t = calibrate_run(dc, tc, &cal[i], CALIBRATE_STRIPES, PING_MAX_BYTES);
+	if(t <= 0){
+		syslog(LOG_NOTICE, "Calibration : %s doesn't answer\n", cal[i].name);
+		continue;
+		}
+	cal[i].mbs = (double)(PING_DISKS-2) * PING_MAX_BYTES / t / 1e6;
+	
+	syslog(LOG_NOTICE, "Calibration : %-8s round trip %8.1f us, %8.1f MB/s\n", cal[i].name, cal[i].rtt_us, cal[i].mbs);
+	if( (best_rtt == 0) || (cal[i].rtt_us < best_rtt) ){ best_rtt = cal[i].rtt_us; }
+	if(cal[i].mbs > best_mbs){ best_mbs = cal[i].mbs; }
+	}
+
+for(i=0; i < n; i++){
+	if(cal[i].mbs == 0){ continue; }
+	score = cal[i].rtt_us / best_rtt + best_mbs / cal[i].mbs;
+	if( (best < 0) || (score < best_score) ){
+		best		= i;
+		best_score	= score;
+		}
+	}
+
+if(best < 0){
+	syslog(LOG_NOTICE, "Calibration : no connection answered, -c AUTO takes IOCTL\n");
+	return 2;
+	}
+
+syslog(LOG_NOTICE, "Calibration : -c AUTO takes %s\n", cal[best].name);
+return cal[best].c_mode;
+}
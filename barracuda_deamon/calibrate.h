@@ -0,0 +1,59 @@
+/**
+ * \file
+ * \brief	Calibration of the connection for -c AUTO
+ *
+ * @author	Dominic Eschweiler weiler@upb.de
+ *
+ * Status	: STABLE \n
+ * Date of creation : 18.10.2026
+ *
+ */
+
+
+/*****************************************************************
+ *
+ * Barracuda is a experimental microdriver extension to the 
+ * linux-kernel that is able to outsource common functions to
+ * the userspace. It was intensionally designed to accelerate
+ * CPU-intensive Tasks on a GPU.
+ *
+ * Copyright (C) 2009 Dominic Eschweiler
+ *
+ * This program is free software; you can redistribute it and/or 
+ * modify it under the terms of the GNU General Public License as 
+ * published by the Free Software Foundation; either only GPLv2 - 
+ * version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful, 
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of 
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the 
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public 
+ * License along with this program; 
+ * if not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************/
+
+#ifndef __CALIBRATE__
+#define __CALIBRATE__
+
+# include "userspace_driver.h"
+
+
+
+/**
+ * Implements -c AUTO. Every single-slot connection the kernel stub offers is
+ * timed with round trips of one page and with stripes of PING_MAX_BYTES, the
+ * connection with the best sum of both figures is taken. The server loops 
+ * run on the calling thread with a budget in dc.
+ *
+ * @param *dc		: driver context of the main thread
+ * @param *tc		: configuration of the daemon
+ *
+ * @returns			the connection mode, IOCTL if the stub can't be timed
+ */
+
+HOST int calibrate_connection(driver_context *dc, thread_container *tc);
+
+#endif
@@ -0,0 +1,198 @@
+/**
+ * \file
+ * \brief	Coalescing of completion notifications
+ *
+ * @author	Dominic Eschweiler weiler@upb.de
+ *
+ * Status	: STABLE \n
+ * Date of creation : 18.10.2026
+ *
+ */
+
+
+/*****************************************************************
+ *
+ * Barracuda is a experimental microdriver extension to the 
+ * linux-kernel that is able to outsource common functions to
+ * the userspace. It was intensionally designed to accelerate
+ * CPU-intensive Tasks on a GPU.
+ *
+ * Copyright (C) 2009 Dominic Eschweiler
+ *
+ * This program is free software; you can redistribute it and/or 
+ * modify it under the terms of the GNU General Public License as 
+ * published by the Free Software Foundation; either only GPLv2 - 
+ * version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful, 
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of 
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the 
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public 
+ * License along with this program; 
+ * if not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <syslog.h>
+
+# include "coalesce.h"
+
+
+
+/**
+ * Monotonic time in nanoseconds.
+ *
+ * @returns	 unsigned long long : nanoseconds
+ */
+
+static unsigned long long coalesce_now(void)
+{
+struct timespec ts;
+
+clock_gettime(CLOCK_MONOTONIC, &ts);
+return (unsigned long long)ts.tv_sec * 1000000000ULL + (unsigned long long)ts.tv_nsec;
+}
+
+
+
+/**
+ * Prepares a coalescer.
+ *
+ * @param *co		: coalescer
+ * @param count		: completions per notification
+ * @param us		: upper bound of the time a completion is held back
+ * @param capacity	: most completions one notification can carry
+ *
+ * @returns	 void
+ */
+
+HOST void coalesce_init(completion_coalescer *co, unsigned int count, unsigned int us, unsigned int capacity)
+{
+memset(co, 0, sizeof(completion_coalescer));
+
+co->max_completions = ( (count == 0) || (count > capacity) ) ? capacity : count;
+co->max_ns			= (unsigned long long)us * 1000;
+}
+
+
+
+/**
+ * Holds back one completion.
+ *
+ * @param *co		: coalescer
+ *
+ * @returns	 void
+ */
+
+HOST void coalesce_add(completion_coalescer *co)
+{
+if( (co->pending == 0) && (co->max_ns > 0 || co->max_completions > 1) ){ co->first_ns = coalesce_now(); }
+co->pending++;
+}
+
+
+
+/**
+ * Tells whether the held completions have reached a bound.
+ *
+ * @param *co		: coalescer
+ *
+ * @returns	 1 if the notification is due
+ */
+
+HOST int coalesce_due(completion_coalescer *co)
+{
+if(co->pending == 0){ return 0; }
+if(co->pending >= co->max_completions){ return 1; }
+
+return (co->max_ns > 0) && (coalesce_now() - co->first_ns >= co->max_ns);
+}
+
+
+
+/**
+ * Returns the time at which the oldest held completion is due.
+ *
+ * @param *co		: coalescer
+ * @param *deadline	: the time is stored here
+ *
+ * @returns	 0 if there is a deadline, -1 if nothing is held or there is no time bound
+ */
+
+HOST int coalesce_deadline(completion_coalescer *co, struct timespec *deadline)
+{
+unsigned long long age;
+unsigned long long left;
+
+if( (co->pending == 0) || (co->max_ns == 0) ){ return -1; }
+
+age	 = coalesce_now() - co->first_ns;
+left = (age < co->max_ns) ? co->max_ns - age : 0;
+
+/* sem_timedwait measures against the wall clock */
+clock_gettime(CLOCK_REALTIME, deadline);
+left += deadline->tv_nsec;
+deadline->tv_sec += left / 1000000000ULL;
+deadline->tv_nsec = left % 1000000000ULL;
+
+return 0;
+}
+
+
+
+/**
+ * Accounts one notification which carried all held completions.
+ *
+ * @param *co		: coalescer
+ * @param idle		: the server notifies because it has nothing else to do
+ *
+ * @returns	 void
+ */
+
+HOST void coalesce_flushed(completion_coalescer *co, int idle)
+{
+unsigned long long held = 0;
+
+if(co->pending == 0){ return; }
+
+if(co->max_completions > 1 || co->max_ns > 0){ held = coalesce_now() - co->first_ns; }
+
+if(idle){ co->reasons[COALESCE_BY_IDLE]++; }
+else if(co->pending >= co->max_completions){ co->reasons[COALESCE_BY_COUNT]++; }
+else{ co->reasons[COALESCE_BY_TIME]++; }
+
+co->completions += co->pending;
+co->notifications++;
+co->held_ns += held;
+if(held > co->max_held_ns){ co->max_held_ns = held; }
+if(co->pending > co->largest){ co->largest = co->pending; }
+
+co->pending = 0;
+}
+
+
+
+/**
+ * Writes the batching statistics to the syslog.
+ *
+ * @param *co		: coalescer
+ * @param *name		: name of the server loop
+ *
+ * @returns	 void
+ */
+
+HOST void coalesce_report(completion_coalescer *co, char *name)
+{
+if(co->notifications == 0){ return; }
+
+syslog(LOG_NOTICE, "%s : %lu completions in %lu notifications (%.1f each, largest %u), "
+		"%lu by count, %lu by time, %lu when idle, held %.1f us mean, %.1f us max\n", name,
+		co->completions, co->notifications, (double)co->completions / co->notifications, co->largest,
+		co->reasons[COALESCE_BY_COUNT], co->reasons[COALESCE_BY_TIME], co->reasons[COALESCE_BY_IDLE],
+		co->held_ns / 1000.0 / co->notifications, co->max_held_ns / 1000.0);
+}
@@ -0,0 +1,158 @@
+/**
+ * \file
+ * \brief	Coalescing of completion notifications
+ *
+ * @author	Dominic Eschweiler weiler@upb.de
+ *
+ * Status	: STABLE \n
+ * Date of creation : 18.10.2026
+ *
+ */
+
+
+/*****************************************************************
+ *
+ * Barracuda is a experimental microdriver extension to the 
+ * linux-kernel that is able to outsource common functions to
+ * the userspace. It was intensionally designed to accelerate
+ * CPU-intensive Tasks on a GPU.
+ *
+ * Copyright (C) 2009 Dominic Eschweiler
+ *
+ * This program is free software; you can redistribute it and/or 
+ * modify it under the terms of the GNU General Public License as 
+ * published by the Free Software Foundation; either only GPLv2 - 
+ * version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful, 
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of 
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the 
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public 
+ * License along with this program; 
+ * if not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************/
+
+#ifndef __COALESCE__
+#define __COALESCE__
+
+#include <time.h>
+
+# include "definitions.h"
+
+/*! \def COALESCE_BY_COUNT
+	\brief The notification was sent because N completions were held */
+
+/*! \def COALESCE_BY_TIME
+	\brief The notification was sent because the oldest completion was T old */
+
+/*! \def COALESCE_BY_IDLE
+	\brief The notification was sent because the server had nothing else to do */
+
+#define COALESCE_BY_COUNT	0
+#define COALESCE_BY_TIME	1
+#define COALESCE_BY_IDLE	2
+#define COALESCE_REASONS	3
+
+/*! \var typedef struct completion_coalescer;
+	\brief Completions of one server loop which are held back until one 
+	notification (doorbell call, message) carries all of them */
+
+typedef struct completion_coalescer{
+	unsigned int max_completions;
+	unsigned long long max_ns;
+	unsigned int pending;
+	unsigned long long first_ns;
+	unsigned long completions;
+	unsigned long notifications;
+	unsigned long reasons[COALESCE_REASONS];
+	unsigned int largest;
+	unsigned long long held_ns;
+	unsigned long long max_held_ns;
+	}completion_coalescer;
+
+
+
+/**
+ * Prepares a coalescer. A count of 0 or above the capacity of the transport
+ * is bounded by the capacity, a time of 0 holds completions without a time 
+ * bound. Whatever the bounds, the server notifies before it goes to sleep.
+ *
+ * @param *co		: coalescer
+ * @param count		: completions per notification
+ * @param us		: upper bound of the time a completion is held back
+ * @param capacity	: most completions one notification can carry
+ *
+ * @returns	 void
+ */
+
+HOST void coalesce_init(completion_coalescer *co, unsigned int count, unsigned int us, unsigned int capacity);
+
+
+
+/**
+ * Holds back one completion.
+ *
+ * @param *co		: coalescer
+ *
+ * @returns	 void
+ */
+
+HOST void coalesce_add(completion_coalescer *co);
+
+
+
+/**
+ * Tells whether the held completions have reached the count or the time 
+ * bound, whichever comes first.
+ *
+ * @param *co		: coalescer
+ *
+ * @returns	 1 if the notification is due
+ */
+
+HOST int coalesce_due(completion_coalescer *co);
+
+
+
+/**
+ * Returns the absolute CLOCK_REALTIME time at which the oldest held 
+ * completion reaches the time bound, for sem_timedwait().
+ *
+ * @param *co		: coalescer
+ * @param *deadline	: the time is stored here
+ *
+ * @returns	 0 if there is a deadline, -1 if nothing is held or there is no time bound
+ */
+
+HOST int coalesce_deadline(completion_coalescer *co, struct timespec *deadline);
+
+
+
+/**
+ * Accounts one notification which carried all held completions.
+ *
+ * @param *co		: coalescer
+ * @param idle		: the server notifies because it has nothing else to do
+ *
+ * @returns	 void
+ */
+
+HOST void coalesce_flushed(completion_coalescer *co, int idle);
+
+
+
+/**
+ * Writes the batching statistics to the syslog.
+ *
+ * @param *co		: coalescer
+ * @param *name		: name of the server loop
+ *
+ * @returns	 void
+ */
+
+HOST void coalesce_report(completion_coalescer *co, char *name);
+
+#endif
@@ -62,37 +62,45 @@
 
 #define NBYTES_CUDA(x) ((x) * 0x0101010101010101UL)
 
-static u8 *DEVICE_DP_1;
-static u8 *DEVICE_PQ_1;
+/*
+ * All device and staging buffers of one worker. With CUDA a context belongs to
+ * the host thread that allocated it, so every worker needs its own.
+ */
+struct cuda_scratch{
+	u8 *DEVICE_DP_1;
+	u8 *DEVICE_PQ_1;
 	
-static u8 *DEVICE_DP_2;
-static u8 *DEVICE_PQ_2;
+	u8 *DEVICE_DP_2;
+	u8 *DEVICE_PQ_2;
 
 #ifdef ASYNC
-	static u8 *HOST_DP_1;
-	static u8 *HOST_PQ_1;
+	u8 *HOST_DP_1;
+	u8 *HOST_PQ_1;
 	
-	static u8 *HOST_DP_2;
-	static u8 *HOST_PQ_2;
+	u8 *HOST_DP_2;
+	u8 *HOST_PQ_2;
 #endif
+	};
 
+/* context of the legacy raid6_cuda_gen_syndrome() entry point */
+static syndrome_context default_context;
 static int mem_tag = 0;
 
 // function prototypes
 #ifdef ASYNC
-static void raid6_cuda_gen_syndrome_asynccopy(int disks, size_t bytes, void **ptrs);
+static void raid6_cuda_gen_syndrome_asynccopy(struct cuda_scratch *s, int disks, size_t bytes, void **ptrs);
 #endif
 #ifndef ASYNC
-static void raid6_cuda_gen_syndrome_synccopy(int disks, size_t bytes, void **ptrs);
+static void raid6_cuda_gen_syndrome_synccopy(struct cuda_scratch *s, int disks, size_t bytes, void **ptrs);
 #endif
 
-static void inline get_card_mem(void);
-
 __global__ void syndrome_block( u8 *DEVICE_DP, u8 *DEVICE_PQ, int z0);
 
 
 /**
- * This is NVIDIA CUDA version of gen_syndrome
+ * This is NVIDIA CUDA version of gen_syndrome. It works on a process wide 
+ * default context and is therefore not reentrant, concurrent callers must use
+ * raid6_cuda_gen_syndrome_ctx() with a context each.
  *
  * @param disks		: # of disks
  * @param bytes		: # number of bytes
@@ -102,13 +110,42 @@ __global__ void syndrome_block( u8 *DEVICE_DP, u8 *DEVICE_PQ, int z0);
  */
 
 extern void raid6_cuda_gen_syndrome(int disks, size_t bytes, void **ptrs)
-{	 
+{
+if(mem_tag == 0){
+	if( raid6_cuda_context_init(&default_context) == EXIT_FAILURE ){
+		printf("Device allocation failed!\n");
+		exit(1);
+		}
+	mem_tag = 1;
+	}
+
+raid6_cuda_gen_syndrome_ctx(&default_context, disks, bytes, ptrs);
+}
+
+
+
+/**
+ * This is NVIDIA CUDA version of gen_syndrome with an explicit context. Calls
+ * with different contexts can run concurrently.
+ *
+ * @param *ctx		: context of the calling worker
+ * @param disks		: # of disks
+ * @param bytes		: # number of bytes
+ * @param **ptrs	: processing data
+ *
+ * @returns			void
+ */
+
+extern void raid6_cuda_gen_syndrome_ctx(syndrome_context *ctx, int disks, size_t bytes, void **ptrs)
+{
+struct cuda_scratch *s = (struct cuda_scratch *)ctx->scratch;
+
 #ifdef ASYNC
-	raid6_cuda_gen_syndrome_asynccopy(disks, bytes, ptrs);
+	raid6_cuda_gen_syndrome_asynccopy(s, disks, bytes, ptrs);
 #endif
 	
 #ifndef ASYNC
-	raid6_cuda_gen_syndrome_synccopy(disks, bytes, ptrs);
+	raid6_cuda_gen_syndrome_synccopy(s, disks, bytes, ptrs);
 #endif
 }
 
@@ -125,16 +162,24 @@ extern void raid6_cuda_gen_syndrome(int disks, size_t bytes, void **ptrs)
  * @returns			void
  */
 #ifdef ASYNC
-static void raid6_cuda_gen_syndrome_asynccopy(int disks, size_t bytes, void **ptrs)
+static void raid6_cuda_gen_syndrome_asynccopy(struct cuda_scratch *s, int disks, size_t bytes, void **ptrs)
 {
 dim3 dimBlock;
 dim3 dimGrid;
 	
 // variables
 int i, j;
-static u8 **dptrs = (u8 **)ptrs;
+u8 **dptrs = (u8 **)ptrs;
+
+u8 *DEVICE_DP_1 = s->DEVICE_DP_1;
+u8 *DEVICE_PQ_1 = s->DEVICE_PQ_1;
+u8 *DEVICE_DP_2 = s->DEVICE_DP_2;
+u8 *DEVICE_PQ_2 = s->DEVICE_PQ_2;
 
-get_card_mem();
+u8 *HOST_DP_1 = s->HOST_DP_1;
+u8 *HOST_PQ_1 = s->HOST_PQ_1;
+u8 *HOST_DP_2 = s->HOST_DP_2;
+u8 *HOST_PQ_2 = s->HOST_PQ_2;
 	
 unsigned long runs = floor(bytes/(DMA_BLOCKSIZE*2));
 unsigned long carry_off = 0;
@@ -391,16 +436,19 @@ if(carry_off > 0){
  * @returns			void
  */
 #ifndef ASYNC
-static void raid6_cuda_gen_syndrome_synccopy(int disks, size_t bytes, void **ptrs)
+static void raid6_cuda_gen_syndrome_synccopy(struct cuda_scratch *s, int disks, size_t bytes, void **ptrs)
 {
 dim3 dimBlock;
 dim3 dimGrid;
 	
 /* variables */
 int i, j;
-static u8 **dptrs = (u8 **)ptrs;
+u8 **dptrs = (u8 **)ptrs;
 
-get_card_mem();
+u8 *DEVICE_DP_1 = s->DEVICE_DP_1;
+u8 *DEVICE_PQ_1 = s->DEVICE_PQ_1;
+u8 *DEVICE_DP_2 = s->DEVICE_DP_2;
+u8 *DEVICE_PQ_2 = s->DEVICE_PQ_2;
 	
 unsigned long runs = floor(bytes/(DMA_BLOCKSIZE*2));
 unsigned long carry_off = 0;
@@ -638,60 +686,101 @@ for ( z = z0-1; z >= 0; z-- ){
 
 
 
-static void inline get_card_mem(void)
+/**
+ * Allocates the device (and with ASYNC the page locked host) buffers of one
+ * context. This must be called by the thread which uses the context.
+ *
+ * @param *ctx		: context to initialise
+ *
+ * @returns			EXIT_SUCCESS or EXIT_FAILURE if the allocation failed
+ */
+
+extern int raid6_cuda_context_init(syndrome_context *ctx)
 {
-if(mem_tag == 0){
-	cudaMalloc((void **)&DEVICE_DP_1, DMA_BLOCKSIZE*256);
-	cudaMalloc((void **)&DEVICE_PQ_1, DMA_BLOCKSIZE*2);
-	
-	cudaMalloc((void **)&DEVICE_DP_2, DMA_BLOCKSIZE*256);
-	cudaMalloc((void **)&DEVICE_PQ_2, DMA_BLOCKSIZE*2);
+struct cuda_scratch *s;
 
-	#ifdef ASYNC
-	cudaMallocHost((void **)&HOST_DP_1, DMA_BLOCKSIZE*256);
-	cudaMallocHost((void **)&HOST_PQ_1, DMA_BLOCKSIZE*2);
-	
-	cudaMallocHost((void **)&HOST_DP_2, DMA_BLOCKSIZE*256);
-	cudaMallocHost((void **)&HOST_PQ_2, DMA_BLOCKSIZE*2);
-	#endif
-	
-	cudaError_t error_t;
-	error_t = cudaGetLastError();
-	if( 0 != strcmp(cudaGetErrorString(error_t), "no error") ){
-		printf("Device allocation failed!\n");
-		exit(1);
-		}
-	
-	#ifdef DEBUG_LEVEL_8 
-	printf("getting device memory : %s\n", cudaGetErrorString(error_t) );
-	#endif
-	
-	mem_tag = 1;
+s = (struct cuda_scratch *)malloc(sizeof(struct cuda_scratch));
+if(s == NULL){ return EXIT_FAILURE; }
+memset(s, 0, sizeof(struct cuda_scratch));
+
+cudaMalloc((void **)&s->DEVICE_DP_1, DMA_BLOCKSIZE*256);
+cudaMalloc((void **)&s->DEVICE_PQ_1, DMA_BLOCKSIZE*2);
+
+cudaMalloc((void **)&s->DEVICE_DP_2, DMA_BLOCKSIZE*256);
+cudaMalloc((void **)&s->DEVICE_PQ_2, DMA_BLOCKSIZE*2);
+
+#ifdef ASYNC
+cudaMallocHost((void **)&s->HOST_DP_1, DMA_BLOCKSIZE*256);
+cudaMallocHost((void **)&s->HOST_PQ_1, DMA_BLOCKSIZE*2);
+
+cudaMallocHost((void **)&s->HOST_DP_2, DMA_BLOCKSIZE*256);
+cudaMallocHost((void **)&s->HOST_PQ_2, DMA_BLOCKSIZE*2);
+#endif
+
+ctx->scratch = s;
+
+cudaError_t error_t;
+error_t = cudaGetLastError();
+
+#ifdef DEBUG_LEVEL_8 
+printf("getting device memory : %s\n", cudaGetErrorString(error_t) );
+#endif
+
+if( error_t != cudaSuccess ){
+	raid6_cuda_context_release(ctx);
+	return EXIT_FAILURE;
 	}
+
+return EXIT_SUCCESS;
 }
 
 
 
 /**
- * Free the memory from the device
+ * Frees all buffers of one context.
+ *
+ * @param *ctx		: context to release
  *
  * @returns			void
  */
 
-extern void release_card_memory(void)
+extern void raid6_cuda_context_release(syndrome_context *ctx)
 {
-cudaFree(DEVICE_DP_1);
-cudaFree(DEVICE_PQ_1);
+struct cuda_scratch *s = (struct cuda_scratch *)ctx->scratch;
+
+if(s == NULL){ return; }
+
+cudaFree(s->DEVICE_DP_1);
+cudaFree(s->DEVICE_PQ_1);
 	
-cudaFree(DEVICE_DP_2);
-cudaFree(DEVICE_PQ_2);
+cudaFree(s->DEVICE_DP_2);
+cudaFree(s->DEVICE_PQ_2);
 	
 #ifdef ASYNC
-cudaFree(HOST_DP_1);
-cudaFree(HOST_PQ_1);
+cudaFreeHost(s->HOST_DP_1);
+cudaFreeHost(s->HOST_PQ_1);
 	
-cudaFree(HOST_DP_2);
-cudaFree(HOST_PQ_2);
+cudaFreeHost(s->HOST_DP_2);
+cudaFreeHost(s->HOST_PQ_2);
 #endif
+
+free(s);
+ctx->scratch = NULL;
+}
+
+
+
+/**
+ * Free the memory from the device
+ *
+ * @returns			void
+ */
+
+extern void release_card_memory(void)
+{
+if(mem_tag == 1){
+	raid6_cuda_context_release(&default_context);
+	mem_tag = 0;
+	}
 }
 
@@ -40,7 +40,8 @@
 #include "../definitions.h"
 
 /**
- * This is NVIDIA CUDA version of gen_syndrome
+ * This is NVIDIA CUDA version of gen_syndrome. It works on a process wide 
+ * default context and is therefore not reentrant.
  *
  * @param disks		: # of disks
  * @param bytes		: # number of bytes
@@ -52,6 +53,46 @@ extern void raid6_cuda_gen_syndrome(int disks, size_t bytes, void **ptrs);
 
 
 
+/**
+ * This is NVIDIA CUDA version of gen_syndrome with an explicit context. Calls
+ * with different contexts can run concurrently, but a context must only be
+ * used by the thread which initialised it.
+ *
+ * @param *ctx		: context of the calling worker
+ * @param disks		: # of disks
+ * @param bytes		: # number of bytes
+ * @param **ptrs	: processing data
+ *
+ * @returns			void
+ */
+extern void raid6_cuda_gen_syndrome_ctx(syndrome_context *ctx, int disks, size_t bytes, void **ptrs);
+
+
+
+/**
+ * Allocates the device buffers of one context.
+ *
+ * @param *ctx		: context to initialise
+ *
+ * @returns			EXIT_SUCCESS or EXIT_FAILURE if the allocation failed
+ */
+
+extern int raid6_cuda_context_init(syndrome_context *ctx);
+
+
+
+/**
+ * Frees all buffers of one context.
+ *
+ * @param *ctx		: context to release
+ *
+ * @returns			void
+ */
+
+extern void raid6_cuda_context_release(syndrome_context *ctx);
+
+
+
 /**
  * Free the memory from the device
  *
@@ -106,12 +106,70 @@ typedef __u64 u64;
 
 typedef void (*syndrome_func)(int disks, size_t bytes, void **ptrs);
 
+/*! \var typedef struct syndrome_context;
+    \brief Per worker state of an implementation. It owns all scratch and staging
+	buffers (e.g. device memory), so calls with different contexts never share
+	any state. Stateless implementations leave it empty. */
+
+typedef struct syndrome_context{
+	void *scratch;
+	}syndrome_context;
+
+/*! \var typedef syndrome_ctx_func
+    \brief A gen_syndrome function which works on an explicit context */
+
+typedef void (*syndrome_ctx_func)(syndrome_context *ctx, int disks, size_t bytes, void **ptrs);
+
+/*! \def BACKEND_REENTRANT
+	\brief Any number of concurrent calls, they may even share one context */
+
+/*! \def BACKEND_PER_CONTEXT
+	\brief Concurrent calls need a context each, which must be used by the 
+	thread that created it */
+
+#define BACKEND_REENTRANT	1
+#define BACKEND_PER_CONTEXT	2
+
+/*! \var typedef struct syndrome_backend;
+    \brief Description of one implementation. gen_syndrome is the legacy entry
+	point, which works on a process wide default context for stateful 
+	implementations and is therefore not reentrant for them. */
+
+typedef struct syndrome_backend{
+	char				*name;
+	syndrome_func		gen_syndrome;
+	syndrome_ctx_func	gen_syndrome_ctx;
+	int					(*context_init)(syndrome_context *ctx);
+	void				(*context_release)(syndrome_context *ctx);
+	int					concurrency;
+	}syndrome_backend;
+
 /*! \var typedef struct thread_container;
     \brief Container which gets passed on thred-creation for the daemon mode */
 
 typedef struct thread_container{
 	int c_mode;
-	syndrome_func gen_syndrome;
+	syndrome_backend *backend;
+	int compute_workers;
+	int queue_depth;
+	size_t arena_size;
+	size_t slice_bytes;
+	unsigned int ring_entries;
+	unsigned long ring_slot_bytes;
+	unsigned int spin_us;
+	unsigned int coalesce_count;
+	unsigned int coalesce_us;
+	int batch;
+	int server_threads;
+	int shard_by;
+	int pipeline;
+	int marshalling;
+	char *sched;
+	char *socket;
+	int loopback;
+	int lock_memory;
+	int copy_disks;
+	size_t copy_bytes;
 	}thread_container;
 
 /* Defines which are used to make the code compile under non cuda systems */
@@ -0,0 +1,76 @@
+/**
+ * \file
+ * \brief	Interface of the daemon to the kernel stub, the device or the loopback stand-in
+ *
+ * @author	Dominic Eschweiler weiler@upb.de
+ *
+ * Status	: STABLE \n
+ * Date of creation : 18.10.2026
+ *
+ */
+
+
+/*****************************************************************
+ *
+ * Barracuda is a experimental microdriver extension to the 
+ * linux-kernel that is able to outsource common functions to
+ * the userspace. It was intensionally designed to accelerate
+ * CPU-intensive Tasks on a GPU.
+ *
+ * Copyright (C) 2009 Dominic Eschweiler
+ *
+ * This program is free software; you can redistribute it and/or 
+ * modify it under the terms of the GNU General Public License as 
+ * published by the Free Software Foundation; either only GPLv2 - 
+ * version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful, 
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of 
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the 
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public 
+ * License along with this program; 
+ * if not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************/
+
+#ifndef __KERNEL_OPS__
+#define __KERNEL_OPS__
+
+#include <sys/types.h>
+#include <sys/socket.h>
+
+/* Defines */
+#define NETLINK_RS_SERVER 25
+#define NL_COMMAND 0x11
+#define MAX_PAYLOAD 1024
+#define IOCTL_GETVALUE 0x0001
+#define IOCTL_RING_ENTER 0x0002
+
+/*! \var typedef struct kernel_ops;
+	\brief Every call the server loops make towards the kernel stub. The 
+	device version passes them to /proc/barracuda and /dev/barracuda, the 
+	loopback version (loopback.h) emulates the stub in the same process. */
+
+typedef struct kernel_ops{
+	char *name;
+	int (*conf_write)(char *command);
+	int (*dev_open)(int flags);
+	int (*dev_close)(int fd);
+	void *(*dev_mmap)(size_t length, int prot, int fd, off_t offset);
+	int (*dev_munmap)(void *addr, size_t length);
+	ssize_t (*dev_pread)(int fd, void *buf, size_t count, off_t offset);
+	ssize_t (*dev_pwrite)(int fd, const void *buf, size_t count, off_t offset);
+	int (*dev_ioctl)(int fd, unsigned long request, void *arg);
+	void *(*stub_open)(void);
+	size_t (*stub_read)(void *stub, void *buf, size_t count);
+	size_t (*stub_write)(void *stub, void *buf, size_t count);
+	void (*stub_close)(void *stub);
+	int (*nl_open)(void);
+	int (*nl_sendmmsg)(int sock, struct mmsghdr *msgs, unsigned int vlen);
+	int (*nl_recvmmsg)(int sock, struct mmsghdr *msgs, unsigned int vlen);
+	void (*nl_close)(int sock);
+	}kernel_ops;
+
+#endif
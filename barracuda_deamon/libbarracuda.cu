@@ -0,0 +1,409 @@
+/**
+ * \file
+ * \brief	Public C API of libbarracuda
+ *
+ * @author	Dominic Eschweiler weiler@upb.de
+ *
+ * Status	: STABLE \n
+ * Date of creation : 18.10.2026
+ *
+ */
+
+
+/*****************************************************************
+ *
+ * Barracuda is a experimental microdriver extension to the 
+ * linux-kernel that is able to outsource common functions to
+ * the userspace. It was intensionally designed to accelerate
+ * CPU-intensive Tasks on a GPU.
+ *
+ * Copyright (C) 2009 Dominic Eschweiler
+ *
+ * This program is free software; you can redistribute it and/or 
+ * modify it under the terms of the GNU General Public License as 
+ * published by the Free Software Foundation; either only GPLv2 - 
+ * version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful, 
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of 
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the 
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public 
+ * License along with this program; 
+ * if not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+# include "libbarracuda.h"
+# include "definitions.h"
+# include "backends.h"
+# include "ops.h"
+
+/* the public constants mirror the protocol of the daemon */
+#if (BARRACUDA_MAX_DISKS != ARENA_MAX_DISKS) || (BARRACUDA_MAX_FAILED != DESC_MAX_FAILED) || \
+	(BARRACUDA_CHECK_P != DESC_CHECK_P) || (BARRACUDA_CHECK_Q != DESC_CHECK_Q)
+	#error "libbarracuda.h is out of sync with global_def.h"
+#endif
+
+/* A context behind the opaque handle */
+struct barracuda_ctx{
+	syndrome_backend *backend;
+	syndrome_context ctx;
+	};
+
+
+
+/**
+ * Checks an operation and computes it.
+ *
+ * @param *ctx		: the context
+ * @param *desc		: the operation, as the kernel stub describes it
+ * @param **ptrs	: disks
+ *
+ * @returns	 int : result of the operation or -EINVAL
+ */
+
+static int barracuda_call(barracuda_ctx *ctx, request_desc *desc, void **ptrs)
+{
+request_op op;
+
+if( (ctx == NULL) || (ptrs == NULL) || (desc->bytes == 0) || (desc->bytes % BARRACUDA_ALIGN) ){ 
+	return -EINVAL; 
+	}
+
+desc->version = BARRACUDA_PROTO_VERSION;
+if( ops_take(&op, desc) == EXIT_FAILURE ){ return -EINVAL; }
+
+ops_call(ctx->backend, &ctx->ctx, &op, desc->disks, desc->bytes, ptrs);
+return op.result;
+}
+
+
+
+/**
+ * Returns the version of the library which is loaded.
+ *
+ * @returns	 unsigned int : BARRACUDA_API_VERSION of the library
+ */
+
+unsigned int barracuda_api_version(void)
+{
+return BARRACUDA_API_VERSION;
+}
+
+
+
+/**
+ * Returns the number of backends.
+ *
+ * @returns	 int : number of backends
+ */
+
+int barracuda_backend_count(void)
+{
+return get_number_of_backends();
+}
+
+
+
+/**
+ * Returns the name of a backend.
+ *
+ * @param backend	: index of the backend
+ *
+ * @returns	 const char * : the name, NULL if backend is out of range
+ */
+
+const char *barracuda_backend_name(int backend)
+{
+syndrome_backend *b = get_syndrome_backend(backend);
+
+return (b != NULL) ? b->name : NULL;
+}
+
+
+
+/**
+ * Searches a backend by its name.
+ *
+ * @param *name		: name of the backend
+ *
+ * @returns	 int : index of the backend or -ENOENT
+ */
+
+int barracuda_backend_find(const char *name)
+{
+int i;
+
+for(i=0; (name != NULL) && (i < get_number_of_backends()); i++){
+	if( strcmp(name, get_syndrome_backend(i)->name) == 0 ){ return i; }
+	}
+
+return -ENOENT;
+}
+
+
+
+/**
+ * Tells whether a context of a backend may be used by any thread.
+ *
+ * @param backend	: index of the backend
+ *
+ * @returns	 int : 1 if reentrant, 0 if not, -EINVAL if backend is out of range
+ */
+
+int barracuda_backend_reentrant(int backend)
+{
+syndrome_backend *b = get_syndrome_backend(backend);
+
+if(b == NULL){ return -EINVAL; }
+return (b->concurrency == BACKEND_REENTRANT);
+}
+
+
+
+/**
+ * Creates a context.
+ *
+ * @param backend	: index of the backend
+ *
+ * @returns	 barracuda_ctx * : the context or NULL
+ */
+
+barracuda_ctx *barracuda_ctx_create(int backend)
+{
+syndrome_backend *b = get_syndrome_backend(backend);
+barracuda_ctx *ctx;
+
+if(b == NULL){ return NULL; }
+
+ctx = (barracuda_ctx *)malloc(sizeof(barracuda_ctx));
+if(ctx == NULL){ return NULL; }
+
+ctx->backend = b;
+if( syndrome_context_init(b, &ctx->ctx) == EXIT_FAILURE ){
+	free(ctx);
+	return NULL;
+	}
+
+return ctx;
+}
+
+
+
+/**
+ * Releases a context and its buffers.
+ *
+ * @param *ctx		: the context
+ *
+ * @returns	 void
+ */
+
+void barracuda_ctx_destroy(barracuda_ctx *ctx)
+{
+if(ctx == NULL){ return; }
+
+syndrome_context_release(ctx->backend, &ctx->ctx);
+free(ctx);
+}
+
+
+
+/**
+ * Computes P and Q of a stripe with the backend of the context.
+ *
+ * @param *ctx		: the context
+ * @param disks		: # of disks with P and Q
+ * @param bytes		: # of bytes per disk
+ * @param **ptrs	: disks
+ *
+ * @returns	 int : 0 or -EINVAL
+ */
+
+int barracuda_gen(barracuda_ctx *ctx, int disks, size_t bytes, void **ptrs)
+{
+request_desc desc;
+
+memset(&desc, 0, sizeof(request_desc));
+desc.opcode = OP_GEN;
+desc.disks	= disks;
+desc.bytes	= bytes;
+
+return barracuda_call(ctx, &desc, ptrs);
+}
+
+
+
+/**
+ * XORs the share of the data disks start..stop into P and Q.
+ *
+ * @param *ctx		: the context
+ * @param disks		: # of disks with P and Q
+ * @param bytes		: # of bytes per disk
+ * @param start		: first data disk
+ * @param stop		: last data disk
+ * @param **ptrs	: disks
+ *
+ * @returns	 int : 0 or -EINVAL
+ */
+
+int barracuda_xor_update(barracuda_ctx *ctx, int disks, size_t bytes, int start, int stop, void **ptrs)
+{
+request_desc desc;
+
+memset(&desc, 0, sizeof(request_desc));
+desc.opcode = OP_XOR_UPDATE;
+desc.disks	= disks;
+desc.bytes	= bytes;
+desc.start	= start;
+desc.stop	= stop;
+
+return barracuda_call(ctx, &desc, ptrs);
+}
+
+
+
+/**
+ * Rebuilds two failed data disks from the others, P and Q.
+ *
+ * @param *ctx		: the context
+ * @param disks		: # of disks with P and Q
+ * @param bytes		: # of bytes per disk
+ * @param faila		: a failed data disk
+ * @param failb		: the other failed data disk
+ * @param **ptrs	: disks
+ *
+ * @returns	 int : 0 or -EINVAL
+ */
+
+int barracuda_recover_2data(barracuda_ctx *ctx, int disks, size_t bytes, int faila, int failb, void **ptrs)
+{
+request_desc desc;
+
+memset(&desc, 0, sizeof(request_desc));
+desc.opcode		= OP_RECOV_2DATA;
+desc.disks		= disks;
+desc.bytes		= bytes;
+desc.nfailed	= 2;
+desc.failed[0]	= faila;
+desc.failed[1]	= failb;
+
+return barracuda_call(ctx, &desc, ptrs);
+}
+
+
+
+/**
+ * Rebuilds a failed data disk and P from the others and Q.
+ *
+ * @param *ctx		: the context
+ * @param disks		: # of disks with P and Q
+ * @param bytes		: # of bytes per disk
+ * @param faila		: the failed data disk
+ * @param **ptrs	: disks
+ *
+ * @returns	 int : 0 or -EINVAL
+ */
+
+int barracuda_recover_datap(barracuda_ctx *ctx, int disks, size_t bytes, int faila, void **ptrs)
+{
+request_desc desc;
+
+memset(&desc, 0, sizeof(request_desc));
+desc.opcode		= OP_RECOV_DATAP;
+desc.disks		= disks;
+desc.bytes		= bytes;
+desc.nfailed	= 1;
+desc.failed[0]	= faila;
+
+return barracuda_call(ctx, &desc, ptrs);
+}
+
+
+
+/**
+ * Compares P and Q with the data disks.
+ *
+ * @param *ctx		: the context
+ * @param disks		: # of disks with P and Q
+ * @param bytes		: # of bytes per disk
+ * @param repair	: rewrite P and Q if they don't match
+ * @param **ptrs	: disks
+ *
+ * @returns	 int : mask of BARRACUDA_CHECK_P and BARRACUDA_CHECK_Q or -EINVAL
+ */
+
+int barracuda_check(barracuda_ctx *ctx, int disks, size_t bytes, int repair, void **ptrs)
+{
+request_desc desc;
+
+memset(&desc, 0, sizeof(request_desc));
+desc.opcode = OP_CHECK;
+desc.disks	= disks;
+desc.bytes	= bytes;
+desc.flags	= repair ? DESC_FLAG_REPAIR : 0;
+
+return barracuda_call(ctx, &desc, ptrs);
+}
+
+
+
+/**
+ * Computes the check symbols of the multi failure Reed-Solomon code.
+ *
+ * @param *ctx		: the context
+ * @param disks		: # of disks with the check symbols
+ * @param bytes		: # of bytes per disk
+ * @param **ptrs	: disks
+ *
+ * @returns	 int : 0 or -EINVAL
+ */
+
+int barracuda_multi_encode(barracuda_ctx *ctx, int disks, size_t bytes, void **ptrs)
+{
+request_desc desc;
+
+memset(&desc, 0, sizeof(request_desc));
+desc.opcode = OP_MULTI_ENCODE;
+desc.disks	= disks;
+desc.bytes	= bytes;
+
+return barracuda_call(ctx, &desc, ptrs);
+}
+
+
+
+/**
+ * Rebuilds up to BARRACUDA_MAX_FAILED failed disks of the multi failure code.
+ *
+ * @param *ctx		: the context
+ * @param disks		: # of disks with the check symbols
+ * @param bytes		: # of bytes per disk
+ * @param nfailed	: # of failed disks
+ * @param *failed	: the failed disks
+ * @param **ptrs	: disks
+ *
+ * @returns	 int : 0 or -EINVAL
+ */
+
+int barracuda_multi_decode(barracuda_ctx *ctx, int disks, size_t bytes, int nfailed, const int *failed, void **ptrs)
+{
+request_desc desc;
+int i;
+
+if( (nfailed <= 0) || (nfailed > BARRACUDA_MAX_FAILED) || (failed == NULL) ){ return -EINVAL; }
+
+memset(&desc, 0, sizeof(request_desc));
+desc.opcode		= OP_MULTI_DECODE;
+desc.disks		= disks;
+desc.bytes		= bytes;
+desc.nfailed	= nfailed;
+for(i=0; i < nfailed; i++){ desc.failed[i] = failed[i]; }
+
+return barracuda_call(ctx, &desc, ptrs);
+}
@@ -0,0 +1,294 @@
+/**
+ * \file
+ * \brief	Public C API of libbarracuda
+ *
+ * @author	Dominic Eschweiler weiler@upb.de
+ *
+ * Status	: STABLE \n
+ * Date of creation : 18.10.2026
+ *
+ */
+
+
+/*****************************************************************
+ *
+ * Barracuda is a experimental microdriver extension to the 
+ * linux-kernel that is able to outsource common functions to
+ * the userspace. It was intensionally designed to accelerate
+ * CPU-intensive Tasks on a GPU.
+ *
+ * Copyright (C) 2009 Dominic Eschweiler
+ *
+ * This program is free software; you can redistribute it and/or 
+ * modify it under the terms of the GNU General Public License as 
+ * published by the Free Software Foundation; either only GPLv2 - 
+ * version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful, 
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of 
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the 
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public 
+ * License along with this program; 
+ * if not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************/
+
+#ifndef __LIBBARRACUDA__
+#define __LIBBARRACUDA__
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* __Stable API__
+ * The backends of the daemon as an in-process library, libbarracuda.so and
+ * libbarracuda.a. Only this header is public, it doesn't include any header
+ * of the daemon. A program built against major version M runs with every 
+ * library of major version M and the same or a higher minor version; a minor
+ * version only adds calls. Calls return 0 or a negative errno, 
+ * barracuda_check() returns a mask of BARRACUDA_CHECK_P and BARRACUDA_CHECK_Q.
+ *
+ * ptrs holds disks pointers like md passes them: the data disks, then P and
+ * Q. Of the multi failure code the last BARRACUDA_MAX_FAILED disks are the 
+ * check symbols. bytes is a multiple of BARRACUDA_ALIGN.
+ */
+
+/*! \def BARRACUDA_API_MAJOR
+	\brief Changes on every incompatible change of the API */
+
+/*! \def BARRACUDA_API_MINOR
+	\brief Changes when calls are added */
+
+#define BARRACUDA_API_MAJOR		1
+#define BARRACUDA_API_MINOR		0
+#define BARRACUDA_API_VERSION	((BARRACUDA_API_MAJOR << 16) | BARRACUDA_API_MINOR)
+
+#define BARRACUDA_MAX_DISKS		256
+#define BARRACUDA_MAX_FAILED	4
+#define BARRACUDA_ALIGN			64
+
+#define BARRACUDA_CHECK_P		0x1
+#define BARRACUDA_CHECK_Q		0x2
+
+/*! \def BARRACUDA_EXPORT
+	\brief Marks the calls of the API. The library is built with hidden
+	visibility, libbarracuda.map lists the same calls */
+
+#if defined(__GNUC__) && (__GNUC__ >= 4)
+	#define BARRACUDA_EXPORT	__attribute__ ((visibility ("default")))
+#else
+	#define BARRACUDA_EXPORT
+#endif
+
+/*! \var typedef struct barracuda_ctx;
+	\brief A backend together with the buffers of one thread. Calls with 
+	different contexts never share state; a context of a backend which is not
+	reentrant must be used by the thread that created it */
+
+typedef struct barracuda_ctx barracuda_ctx;
+
+
+
+/**
+ * Returns the version of the library which is loaded.
+ *
+ * @returns	 unsigned int : BARRACUDA_API_VERSION of the library
+ */
+
+BARRACUDA_EXPORT unsigned int barracuda_api_version(void);
+
+
+
+/**
+ * Returns the number of backends.
+ *
+ * @returns	 int : number of backends
+ */
+
+BARRACUDA_EXPORT int barracuda_backend_count(void);
+
+
+
+/**
+ * Returns the name of a backend (SOFT, SMP, DUMMY, MULTI, CUDA).
+ *
+ * @param backend	: index of the backend
+ *
+ * @returns	 const char * : the name, NULL if backend is out of range
+ */
+
+BARRACUDA_EXPORT const char *barracuda_backend_name(int backend);
+
+
+
+/**
+ * Searches a backend by its name.
+ *
+ * @param *name		: name of the backend
+ *
+ * @returns	 int : index of the backend or -ENOENT
+ */
+
+BARRACUDA_EXPORT int barracuda_backend_find(const char *name);
+
+
+
+/**
+ * Tells whether a context of a backend may be used by any thread.
+ *
+ * @param backend	: index of the backend
+ *
+ * @returns	 int : 1 if reentrant, 0 if not, -EINVAL if backend is out of range
+ */
+
+BARRACUDA_EXPORT int barracuda_backend_reentrant(int backend);
+
+
+
+/**
+ * Creates a context.
+ *
+ * @param backend	: index of the backend
+ *
+ * @returns	 barracuda_ctx * : the context, NULL if backend is out of range or
+ *							   the buffers can't be allocated
+ */
+
+BARRACUDA_EXPORT barracuda_ctx *barracuda_ctx_create(int backend);
+
+
+
+/**
+ * Releases a context and its buffers.
+ *
+ * @param *ctx		: the context
+ *
+ * @returns	 void
+ */
+
+BARRACUDA_EXPORT void barracuda_ctx_destroy(barracuda_ctx *ctx);
+
+
+
+/**
+ * Computes P and Q of a stripe with the backend of the context.
+ *
+ * @param *ctx		: the context
+ * @param disks		: # of disks with P and Q
+ * @param bytes		: # of bytes per disk
+ * @param **ptrs	: disks
+ *
+ * @returns	 int : 0 or -EINVAL
+ */
+
+BARRACUDA_EXPORT int barracuda_gen(barracuda_ctx *ctx, int disks, size_t bytes, void **ptrs);
+
+
+
+/**
+ * XORs the share of the data disks start..stop into P and Q, the update of a
+ * partial stripe write.
+ *
+ * @param *ctx		: the context
+ * @param disks		: # of disks with P and Q
+ * @param bytes		: # of bytes per disk
+ * @param start		: first data disk
+ * @param stop		: last data disk
+ * @param **ptrs	: disks
+ *
+ * @returns	 int : 0 or -EINVAL
+ */
+
+BARRACUDA_EXPORT int barracuda_xor_update(barracuda_ctx *ctx, int disks, size_t bytes, int start, int stop, void **ptrs);
+
+
+
+/**
+ * Rebuilds two failed data disks from the others, P and Q.
+ *
+ * @param *ctx		: the context
+ * @param disks		: # of disks with P and Q
+ * @param bytes		: # of bytes per disk
+ * @param faila		: a failed data disk
+ * @param failb		: the other failed data disk
+ * @param **ptrs	: disks
+ *
+ * @returns	 int : 0 or -EINVAL
+ */
+
+BARRACUDA_EXPORT int barracuda_recover_2data(barracuda_ctx *ctx, int disks, size_t bytes, int faila, int failb, void **ptrs);
+
+
+
+/**
+ * Rebuilds a failed data disk and P from the others and Q.
+ *
+ * @param *ctx		: the context
+ * @param disks		: # of disks with P and Q
+ * @param bytes		: # of bytes per disk
+ * @param faila		: the failed data disk
+ * @param **ptrs	: disks
+ *
+ * @returns	 int : 0 or -EINVAL
+ */
+
+BARRACUDA_EXPORT int barracuda_recover_datap(barracuda_ctx *ctx, int disks, size_t bytes, int faila, void **ptrs);
+
+
+
+/**
+ * Compares P and Q with the data disks, the scrub of a stripe.
+ *
+ * @param *ctx		: the context
+ * @param disks		: # of disks with P and Q
+ * @param bytes		: # of bytes per disk
+ * @param repair	: rewrite P and Q if they don't match
+ * @param **ptrs	: disks
+ *
+ * @returns	 int : mask of BARRACUDA_CHECK_P and BARRACUDA_CHECK_Q or -EINVAL
+ */
+
+BARRACUDA_EXPORT int barracuda_check(barracuda_ctx *ctx, int disks, size_t bytes, int repair, void **ptrs);
+
+
+
+/**
+ * Computes the BARRACUDA_MAX_FAILED check symbols of the multi failure 
+ * Reed-Solomon code.
+ *
+ * @param *ctx		: the context
+ * @param disks		: # of disks with the check symbols
+ * @param bytes		: # of bytes per disk
+ * @param **ptrs	: disks
+ *
+ * @returns	 int : 0 or -EINVAL
+ */
+
+BARRACUDA_EXPORT int barracuda_multi_encode(barracuda_ctx *ctx, int disks, size_t bytes, void **ptrs);
+
+
+
+/**
+ * Rebuilds up to BARRACUDA_MAX_FAILED failed disks of the multi failure code.
+ *
+ * @param *ctx		: the context
+ * @param disks		: # of disks with the check symbols
+ * @param bytes		: # of bytes per disk
+ * @param nfailed	: # of failed disks
+ * @param *failed	: the failed disks
+ * @param **ptrs	: disks
+ *
+ * @returns	 int : 0 or -EINVAL
+ */
+
+BARRACUDA_EXPORT int barracuda_multi_decode(barracuda_ctx *ctx, int disks, size_t bytes, int nfailed, const int *failed, void **ptrs);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
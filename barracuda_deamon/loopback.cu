@@ -0,0 +1,2279 @@
+/**
+ * \file
+ * \brief	Loopback stand-in for the kernel stub, /proc/barracuda and /dev/barracuda
+ *
+ * @author	Dominic Eschweiler weiler@upb.de
+ *
+ * Status	: STABLE \n
+ * Date of creation : 18.10.2026
+ *
+ */
+
+
+/*****************************************************************
+ *
+ * Barracuda is a experimental microdriver extension to the 
+ * linux-kernel that is able to outsource common functions to
+ * the userspace. It was intensionally designed to accelerate
+ * CPU-intensive Tasks on a GPU.
+ *
+ * Copyright (C) 2009 Dominic Eschweiler
+ *
+ * This program is free software; you can redistribute it and/or 
+ * modify it under the terms of the GNU General Public License as 
+ * published by the Free Software Foundation; either only GPLv2 - 
+ * version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful, 
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of 
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the 
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public 
+ * License along with this program; 
+ * if not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <sched.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/eventfd.h>
+#include <linux/netlink.h>
+
+# include "loopback.h"
+# include "ring.h"
+# include "memlock.h"
+
+/* Handshake of the single request, the same states as the wait queues of the stub */
+#define LB_IDLE		0
+#define LB_POSTED	1
+#define LB_TAKEN	2
+#define LB_DONE		3
+
+/* Connection types, the numbers of thread_container.c_mode */
+#define LB_CON_NL		1
+#define LB_CON_IOCTL	2
+#define LB_CON_PROCFS	3
+#define LB_CON_RING		4
+#define LB_CON_DOORBELL	5
+
+#define LB_PAGE_ALIGN(x)	( ((x) + lb.page - 1) & ~((size_t)lb.page - 1) )
+
+/* One ring of the stand-in, see ring_shard of the kernel stub */
+typedef struct lb_ring{
+	ring_header *ring;
+	size_t size;
+	unsigned int entries;
+	unsigned long slot_bytes;
+	unsigned long data_offset;
+	unsigned int *free_slots;
+	int free_top;
+	sem_t slots;
+	sem_t *done;
+	pthread_mutex_t slot_lock;
+	pthread_mutex_t cq_lock;
+	}lb_ring;
+
+/* A stripe of a producer which waits for the daemon in a batch */
+typedef struct lb_stripe{
+	int disks;
+	size_t bytes;
+	int prio;
+	void **ptrs;
+	int finished;
+	int ret;
+	struct lb_stripe *next;
+	}lb_stripe;
+
+/* A stripe which waits for its admission, see sched_waiter of the kernel stub */
+typedef struct lb_waiter{
+	unsigned long long enqueued;
+	int granted;
+	struct lb_waiter *next;
+	}lb_waiter;
+
+/* One class of the admission scheduler, see sched_class of the kernel stub */
+typedef struct lb_class{
+	lb_waiter *head;
+	lb_waiter *tail;
+	unsigned int credits;
+	unsigned int admitted;
+	unsigned int weight;
+	unsigned long target_us;
+	unsigned long long vtime;
+	}lb_class;
+
+#define LB_VTIME_UNIT	65536
+
+/* Everything the kernel stub keeps in its statics */
+static struct{
+	int pool_fd;
+	char *pool;
+	size_t pool_size;
+	size_t pool_used;
+	size_t page;
+	pthread_mutex_t pool_lock;
+	
+	pthread_mutex_t gen_syndrome_mutex;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	int c_mode;
+	int configured;
+	int stopping;
+	int flag;
+	int nl_registered;
+	nl_request nl_req;
+	unsigned long token;
+	syndrome_container *snc;
+	void *ptrs[ARENA_MAX_DISKS];
+	
+	arena_header *arena;
+	size_t arena_size;
+	
+	int batch_max;
+	size_t slice_bytes;
+	lb_stripe *batch_head;
+	lb_stripe *batch_tail;
+	
+	lb_ring rings[RING_MAX_SHARDS];
+	int ring_shards;
+	int shard_by;
+	
+	doorbell_page *doorbell;
+	int doorbell_submit;
+	int doorbell_complete;
+	
+	sg_table *sg;
+	off_t sg_pages[SG_MAX_SEGMENTS];
+	
+	request_desc *desc;
+	unsigned int proto;
+	unsigned long desc_id;
+	
+	lb_class classes[PRIO_CLASSES];
+	unsigned int sched_slots;
+	unsigned int sched_inflight;
+	unsigned long long sched_vtime;
+	pthread_mutex_t sched_lock;
+	pthread_cond_t sched_cond;
+	
+	pthread_t ping_thread;
+	int ping_started;
+	int ping_rounds;
+	size_t ping_bytes;
+	void *ping_ptrs[PING_DISKS];
+	
+	loopback_stats stats;
+	}lb;
+
+static int loopback_sched_conf(const char *value);
+static void loopback_slot_lock(void);
+static int loopback_slot_call(int disks, size_t bytes, void **ptrs, int prio);
+static int loopback_ping_start(const char *value);
+static void loopback_ping_wait(void);
+static int loopback_conf_write(char *command);
+static int loopback_open(int flags);
+static void *loopback_mmap(size_t length, int prot, int fd, off_t offset);
+static ssize_t loopback_pread(int fd, void *buf, size_t count, off_t offset);
+static ssize_t loopback_pwrite(int fd, const void *buf, size_t count, off_t offset);
+static int loopback_ioctl(int fd, unsigned long request, void *arg);
+static void *loopback_stub_open(void);
+static size_t loopback_stub_read(void *stub, void *buf, size_t count);
+static size_t loopback_stub_write(void *stub, void *buf, size_t count);
+static void loopback_stub_close(void *stub);
+static int loopback_nl_open(void);
+static int loopback_nl_sendmmsg(int sock, struct mmsghdr *msgs, unsigned int vlen);
+static int loopback_nl_recvmmsg(int sock, struct mmsghdr *msgs, unsigned int vlen);
+static void loopback_nl_close(int sock);
+
+static kernel_ops loopback_ops = {
+	"loopback stand-in",
+	loopback_conf_write,
+	loopback_open,
+	close,
+	loopback_mmap,
+	munmap,
+	loopback_pread,
+	loopback_pwrite,
+	loopback_ioctl,
+	loopback_stub_open,
+	loopback_stub_read,
+	loopback_stub_write,
+	loopback_stub_close,
+	loopback_nl_open,
+	loopback_nl_sendmmsg,
+	loopback_nl_recvmmsg,
+	loopback_nl_close
+	};
+
+
+
+/*POOL________________________________________________________________________*/
+/**
+ * Creates the stand-in.
+ *
+ * @param pool_bytes	: size of the shared memory pool
+ *
+ * @returns	 EXIT_SUCCESS or EXIT_FAILURE
+ */
+
+HOST int loopback_init(size_t pool_bytes)
+{
+char path[]		= "/dev/shm/barracuda-loopback-XXXXXX";
+char fallback[]	= "/tmp/barracuda-loopback-XXXXXX";
+int i;
+
+memset(&lb, 0, sizeof(lb));
+lb.page = getpagesize();
+lb.doorbell_submit	 = -1;
+lb.doorbell_complete = -1;
+
+/* the file is only a handle for the pages, it vanishes with the last mapping */
+lb.pool_fd = mkstemp(path);
+if(lb.pool_fd >= 0){ unlink(path); }
+else{
+	lb.pool_fd = mkstemp(fallback);
+	if(lb.pool_fd < 0){ return EXIT_FAILURE; }
+	unlink(fallback);
+	}
+
+/* the first page holds the request struct, the daemon maps it at offset 0, the descriptor follows */
+lb.pool_size = lb.page + LB_PAGE_ALIGN(sizeof(request_desc)) + LB_PAGE_ALIGN(pool_bytes);
+if( ftruncate(lb.pool_fd, lb.pool_size) != 0 ){
+	close(lb.pool_fd);
+	return EXIT_FAILURE;
+	}
+
+lb.pool = (char *)mmap(0, lb.pool_size, PROT_READ | PROT_WRITE, MAP_SHARED, lb.pool_fd, 0);
+if(lb.pool == MAP_FAILED){
+	close(lb.pool_fd);
+	return EXIT_FAILURE;
+	}
+
+lb.snc		 = (syndrome_container *)lb.pool;
+lb.desc		 = (request_desc *)(lb.pool + lb.page);
+lb.pool_used = lb.page + LB_PAGE_ALIGN(sizeof(request_desc));
+lb.flag		 = LB_IDLE;
+
+pthread_mutex_init(&lb.pool_lock, NULL);
+pthread_mutex_init(&lb.gen_syndrome_mutex, NULL);
+pthread_mutex_init(&lb.sched_lock, NULL);
+pthread_cond_init(&lb.sched_cond, NULL);
+lb.sched_slots = 1;
+loopback_sched_conf(SCHED_DEFAULT);
+pthread_mutex_init(&lb.lock, NULL);
+pthread_cond_init(&lb.cond, NULL);
+for(i=0; i < RING_MAX_SHARDS; i++){
+	pthread_mutex_init(&lb.rings[i].slot_lock, NULL);
+	pthread_mutex_init(&lb.rings[i].cq_lock, NULL);
+	}
+
+return EXIT_SUCCESS;
+}
+
+
+
+/**
+ * Destroys the stand-in.
+ *
+ * @returns	 void
+ */
+
+HOST void loopback_release(void)
+{
+unsigned int i;
+int s;
+
+loopback_ping_wait();
+
+for(s=0; s < lb.ring_shards; s++){
+	lb_ring *r = &lb.rings[s];
+	
+	for(i=0; i < r->entries; i++){ sem_destroy(&r->done[i]); }
+	sem_destroy(&r->slots);
+	free(r->done);
+	free(r->free_slots);
+	}
+
+if(lb.doorbell_submit >= 0){ close(lb.doorbell_submit); }
+if(lb.doorbell_complete >= 0){ close(lb.doorbell_complete); }
+
+pthread_mutex_destroy(&lb.pool_lock);
+pthread_mutex_destroy(&lb.gen_syndrome_mutex);
+pthread_mutex_destroy(&lb.sched_lock);
+pthread_cond_destroy(&lb.sched_cond);
+pthread_mutex_destroy(&lb.lock);
+pthread_cond_destroy(&lb.cond);
+for(i=0; i < RING_MAX_SHARDS; i++){
+	pthread_mutex_destroy(&lb.rings[i].slot_lock);
+	pthread_mutex_destroy(&lb.rings[i].cq_lock);
+	}
+
+munmap(lb.pool, lb.pool_size);
+close(lb.pool_fd);
+memset(&lb, 0, sizeof(lb));
+}
+
+
+
+/**
+ * Returns the calls of the daemon towards the stand-in.
+ *
+ * @returns	 kernel_ops * : calls of the stand-in
+ */
+
+HOST kernel_ops *loopback_kernel_ops(void)
+{
+return &loopback_ops;
+}
+
+
+
+/**
+ * Allocates a page aligned buffer from the shared pool.
+ *
+ * @param bytes		: size of the buffer
+ *
+ * @returns	 void * : the buffer or NULL if the pool is exhausted
+ */
+
+HOST void *loopback_alloc(size_t bytes)
+{
+void *ret = NULL;
+
+bytes = LB_PAGE_ALIGN(bytes);
+
+pthread_mutex_lock(&lb.pool_lock);
+if( (bytes > 0) && (lb.pool_used + bytes <= lb.pool_size) ){
+	ret = lb.pool + lb.pool_used;
+	lb.pool_used += bytes;
+	}
+pthread_mutex_unlock(&lb.pool_lock);
+
+return ret;
+}
+
+
+
+/**
+ * Returns the offset of a pool buffer in the shared file.
+ *
+ * @param *ptr		: buffer
+ *
+ * @returns	 offset or -1 if the buffer is not part of the pool
+ */
+
+static off_t pool_offset(void *ptr)
+{
+char *p = (char *)ptr;
+
+if( (p < lb.pool) || (p >= lb.pool + lb.pool_size) ){ return -1; }
+if( (p - lb.pool) % lb.page ){ return -1; }
+
+return (off_t)(p - lb.pool);
+}
+
+
+
+/*SHARED_ARENA________________________________________________________________*/
+/**
+ * Sets up the arena on arena=<bytes>.
+ *
+ * @param size		: size of the arena
+ *
+ * @returns	 EXIT_SUCCESS or EXIT_FAILURE
+ */
+
+static int loopback_arena_alloc(size_t size)
+{
+size = LB_PAGE_ALIGN(size);
+
+if(lb.arena != NULL){ return (size <= lb.arena_size) ? EXIT_SUCCESS : EXIT_FAILURE; }
+if(size <= LB_PAGE_ALIGN(sizeof(arena_header))){ return EXIT_FAILURE; }
+
+lb.arena = (arena_header *)loopback_alloc(size);
+if(lb.arena == NULL){ return EXIT_FAILURE; }
+
+memset(lb.arena, 0, size);
+lb.arena_size = size;
+
+return EXIT_SUCCESS;
+}
+
+
+
+/**
+ * Offset of a disk of a stripe whose header is at base, see arena_offset() of
+ * the kernel stub. The offsets in the header are never read back.
+ *
+ * @param base		: arena offset of the header of the stripe
+ * @param i			: disk
+ * @param bytes		: number of bytes
+ *
+ * @returns	 size_t : the arena offset of the disk
+ */
+
+static size_t loopback_arena_offset(size_t base, int i, size_t bytes)
+{
+return base + LB_PAGE_ALIGN(sizeof(arena_header)) + (size_t)i * LB_PAGE_ALIGN(bytes);
+}
+
+
+
+/**
+ * Copies the data disks of a stripe into the arena, see arena_pack() of the
+ * kernel stub.
+ *
+ * @param disks		: number of disks
+ * @param bytes		: number of bytes
+ * @param **ptrs	: disks pointers
+ *
+ * @returns	 0 if the stripe was packed, -1 if not
+ */
+
+static int loopback_arena_pack(int disks, size_t bytes, void **ptrs)
+{
+int i;
+
+if(lb.arena == NULL){ return -1; }
+
+if( (disks > ARENA_MAX_DISKS) || (loopback_arena_offset(0, disks, bytes) > lb.arena_size) ){
+	lb.arena->mode = ARENA_MAPPED;
+	return -1;
+	}
+
+for(i=0; i < disks; i++){
+	lb.arena->offsets[i] = loopback_arena_offset(0, i, bytes);
+	if(i < disks-2){ memcpy( (char *)lb.arena + loopback_arena_offset(0, i, bytes), ptrs[i], bytes ); }
+	}
+
+lb.arena->disks = disks;
+lb.arena->bytes = bytes;
+lb.arena->mode  = ARENA_INLINE;
+lb.arena->next  = 0;
+
+return 0;
+}
+
+
+
+/*SCATTER_GATHER______________________________________________________________*/
+/**
+ * Sets up the segment table on sg=1.
+ *
+ * @returns	 EXIT_SUCCESS or EXIT_FAILURE
+ */
+
+static int loopback_sg_alloc(void)
+{
+if(lb.sg != NULL){ return EXIT_SUCCESS; }
+
+lb.sg = (sg_table *)loopback_alloc(sizeof(sg_table));
+if(lb.sg == NULL){ return EXIT_FAILURE; }
+
+memset(lb.sg, 0, sizeof(sg_table));
+
+return EXIT_SUCCESS;
+}
+
+
+
+/**
+ * Describes a stripe in the segment table, see sg_describe() of the kernel 
+ * stub. The pages of every disk follow each other in the window, a disk is
+ * one segment.
+ *
+ * @param disks		: number of disks
+ * @param bytes		: number of bytes
+ * @param **ptrs	: disks pointers
+ *
+ * @returns	 void
+ */
+
+static void loopback_sg_describe(int disks, size_t bytes, void **ptrs)
+{
+int i;
+unsigned int k;
+unsigned int n = 0;
+unsigned int pages = (unsigned int)(LB_PAGE_ALIGN(bytes) / lb.page);
+
+if(lb.sg == NULL){ return; }
+
+lb.sg->disks = 0;
+if( (bytes % SG_ALIGN) || ((size_t)disks * pages > SG_MAX_SEGMENTS) ){ return; }
+
+for(i=0; i < disks; i++){
+	lb.sg->first[i]			 = i;
+	lb.sg->segs[i].offset	 = (unsigned long)n * lb.page;
+	lb.sg->segs[i].len		 = bytes;
+	
+	for(k=0; k < pages; k++){ lb.sg_pages[n++] = pool_offset(ptrs[i]) + (off_t)k * lb.page; }
+	}
+
+lb.sg->first[disks]	  = disks;
+lb.sg->segments		  = disks;
+lb.sg->bytes		  = bytes;
+lb.sg->window_bytes	  = (unsigned long)n * lb.page;
+lb.sg->disks		  = disks;
+}
+
+
+
+/**
+ * Maps the window of the taken stripe. The kernel stub remaps page by page
+ * within one mmap(), the stand-in reserves the window and maps every run of
+ * consecutive pool pages over it; it counts as one call.
+ *
+ * @param length	: bytes to map
+ * @param prot		: protection
+ *
+ * @returns	 the mapping or MAP_FAILED
+ */
+
+static void *loopback_sg_map_window(size_t length, int prot)
+{
+char *window;
+size_t pages = length / lb.page;
+size_t first;
+size_t i;
+
+if( (lb.flag != LB_TAKEN) || (lb.sg == NULL) || (lb.sg->disks == 0) || (length > lb.sg->window_bytes) ){
+	errno = EINVAL;
+	return MAP_FAILED;
+	}
+
+window = (char *)mmap(0, length, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+if(window == MAP_FAILED){ return MAP_FAILED; }
+
+for(first = 0; first < pages; first = i){
+	for(i = first+1; (i < pages) && (lb.sg_pages[i] == lb.sg_pages[i-1] + (off_t)lb.page); i++);
+	
+	if( mmap(window + first * lb.page, (i - first) * lb.page, prot, MAP_SHARED | MAP_FIXED | memlock_map_flags(), 
+			 lb.pool_fd, lb.sg_pages[first]) == MAP_FAILED ){
+		munmap(window, length);
+		return MAP_FAILED;
+		}
+	}
+
+lb.stats.mmap_calls++;
+return window;
+}
+
+
+
+/*SUBMISSION_COMPLETION_RING__________________________________________________*/
+/**
+ * Sets up the rings on ring=<entries>:<slot bytes>[:<shards>].
+ *
+ * @param entries		: number of slots, a power of two
+ * @param slot_bytes	: size of one slot, at least RING_MIN_SLOT
+ * @param shards		: number of rings
+ *
+ * @returns	 EXIT_SUCCESS or EXIT_FAILURE
+ */
+
+static int loopback_ring_alloc(unsigned int entries, unsigned long slot_bytes, int shards)
+{
+unsigned int i;
+lb_ring *r;
+
+if( (entries == 0) || (entries > RING_MAX_ENTRIES) || (entries & (entries-1)) || (slot_bytes < RING_MIN_SLOT) ){
+	return EXIT_FAILURE;
+	}
+if( (shards <= 0) || (shards > RING_MAX_SHARDS) ){ return EXIT_FAILURE; }
+
+if(lb.ring_shards > 0){
+	r = &lb.rings[0];
+	return ( (lb.ring_shards == shards) && (r->entries == entries) && 
+			 (r->slot_bytes == RING_STRIDE(slot_bytes)) ) ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+while(lb.ring_shards < shards){
+	r = &lb.rings[lb.ring_shards];
+	
+	r->size = ring_region_size(entries, slot_bytes);
+	r->ring = (ring_header *)loopback_alloc(r->size);
+	if(r->ring == NULL){ return EXIT_FAILURE; }
+	
+	ring_init_header(r->ring, entries, slot_bytes);
+	r->entries		= r->ring->entries;
+	r->slot_bytes	= r->ring->slot_bytes;
+	r->data_offset	= r->ring->data_offset;
+	
+	r->free_slots = (unsigned int *)malloc(entries * sizeof(unsigned int));
+	r->done		  = (sem_t *)malloc(entries * sizeof(sem_t));
+	for(i=0; i < entries; i++){
+		r->free_slots[i] = i;
+		sem_init(&r->done[i], 0, 0);
+		}
+	r->free_top = entries;
+	sem_init(&r->slots, 0, entries);
+	
+	lb.ring_shards++;
+	}
+
+return EXIT_SUCCESS;
+}
+
+
+
+/**
+ * Chooses the ring of a stripe, see ring_pick() of the kernel stub.
+ *
+ * @param **ptrs	: disks pointers
+ *
+ * @returns	 lb_ring * : the ring
+ */
+
+static lb_ring *loopback_ring_pick(void **ptrs)
+{
+unsigned long key;
+int cpu;
+
+if(lb.ring_shards == 1){ return &lb.rings[0]; }
+
+if(lb.shard_by == RING_SHARD_STRIPE){
+	key = (unsigned long)pool_offset(ptrs[0]) / lb.page;
+	key = (key * 0x9e3779b97f4a7c15UL) >> 48;
+	}
+else{
+	cpu = sched_getcpu();
+	key = (cpu < 0) ? 0 : (unsigned long)cpu;
+	}
+
+return &lb.rings[key % lb.ring_shards];
+}
+
+
+
+/**
+ * Submits one stripe to its ring and waits for its completion, see 
+ * ring_gen_syndrome() of the kernel stub.
+ *
+ * @param disks		: number of disks
+ * @param bytes		: number of bytes
+ * @param **ptrs	: disks pointers
+ *
+ * @returns	 0 on success, -1 if not even a page of every disk fits
+ */
+
+static int loopback_ring_gen_syndrome(int disks, size_t bytes, void **ptrs)
+{
+lb_ring *r = loopback_ring_pick(ptrs);
+ring_header *ring = r->ring;
+int i;
+unsigned int slot;
+unsigned int tail;
+char *base;
+size_t done;
+size_t slice = (r->slot_bytes / disks) & ~(RING_ALIGN-1);
+
+if(slice == 0){ return -1; }
+
+/* claim a free slot */
+while( sem_wait(&r->slots) != 0 );
+pthread_mutex_lock(&r->slot_lock);
+slot = r->free_slots[--r->free_top];
+pthread_mutex_unlock(&r->slot_lock);
+
+base = (char *)ring + r->data_offset + slot*r->slot_bytes;
+
+for(done = 0; done < bytes; done += slice){
+	if(slice > bytes - done){ slice = bytes - done; }
+	
+	for(i=0; i < disks-2; i++){
+		memcpy( base + i*RING_STRIDE(slice), (char *)ptrs[i] + done, slice );
+		}
+	
+	/* publish the submission and ring the doorbell */
+	pthread_mutex_lock(&lb.lock);
+	tail = ring->sq_tail;
+	ring->sq[tail & (r->entries-1)].slot  = slot;
+	ring->sq[tail & (r->entries-1)].disks = disks;
+	ring->sq[tail & (r->entries-1)].bytes = slice;
+	__sync_synchronize();
+	ring->sq_tail = tail + 1;
+	pthread_cond_broadcast(&lb.cond);
+	pthread_mutex_unlock(&lb.lock);
+	
+	while( sem_wait(&r->done[slot]) != 0 );
+	
+	memcpy( (char *)ptrs[disks-2] + done, base + (disks-2)*RING_STRIDE(slice), slice );
+	memcpy( (char *)ptrs[disks-1] + done, base + (disks-1)*RING_STRIDE(slice), slice );
+	}
+
+/* give the slot back */
+pthread_mutex_lock(&r->slot_lock);
+r->free_slots[r->free_top++] = slot;
+pthread_mutex_unlock(&r->slot_lock);
+sem_post(&r->slots);
+
+return 0;
+}
+
+
+
+/**
+ * Doorbell of a server thread of the daemon, see ring_enter() of the kernel 
+ * stub.
+ *
+ * @param arg		: wait flag, the shard above RING_ENTER_SHARD_SHIFT
+ *
+ * @returns	 number of pending submissions, -1 if the stand-in was stopped
+ */
+
+static int loopback_ring_enter(unsigned long arg)
+{
+unsigned long shard = arg >> RING_ENTER_SHARD_SHIFT;
+unsigned long wait = arg & ((1UL << RING_ENTER_SHARD_SHIFT) - 1);
+lb_ring *r;
+ring_header *ring;
+unsigned int head;
+unsigned int slot;
+unsigned int reaped = 0;
+ring_cqe *cqe;
+int stopped = 0;
+
+if(shard >= (unsigned long)lb.ring_shards){
+	errno = EIO;
+	return -1;
+	}
+r	 = &lb.rings[shard];
+ring = r->ring;
+
+pthread_mutex_lock(&r->cq_lock);
+head = ring->cq_head;
+if(head != ring->cq_tail){
+	pthread_mutex_lock(&lb.lock);
+	lb.stats.notifications++;
+	pthread_mutex_unlock(&lb.lock);
+	}
+while( (head != ring->cq_tail) && (reaped++ < r->entries) ){
+	__sync_synchronize();
+	cqe  = &ring->cq[head & (r->entries-1)];
+	slot = *(volatile unsigned int *)&cqe->slot;
+	if(slot < r->entries){
+		pthread_mutex_lock(&lb.lock);
+		if(cqe->result != 0){ lb.stats.handshake_errors++; }
+		lb.stats.requests++;
+		pthread_mutex_unlock(&lb.lock);
+		sem_post(&r->done[slot]);
+		}
+	head++;
+	}
+ring->cq_head = head;
+pthread_mutex_unlock(&r->cq_lock);
+
+if(wait){
+	pthread_mutex_lock(&lb.lock);
+	while( (ring->sq_head == ring->sq_tail) && !lb.stopping ){ pthread_cond_wait(&lb.cond, &lb.lock); }
+	stopped = (ring->sq_head == ring->sq_tail);
+	pthread_mutex_unlock(&lb.lock);
+	}
+
+if(stopped){
+	errno = EINTR;
+	return -1;
+	}
+
+return ring->sq_tail - ring->sq_head;
+}
+
+
+
+/*DOORBELL____________________________________________________________________*/
+/**
+ * Takes the eventfds of the daemon on doorbell=<submit>:<complete>. The 
+ * stand-in keeps its own descriptors, as the kernel keeps references.
+ *
+ * @param submit_fd		: eventfd the stand-in signals on a submission
+ * @param complete_fd	: eventfd the daemon signals on a completion
+ *
+ * @returns	 EXIT_SUCCESS or EXIT_FAILURE
+ */
+
+static int loopback_doorbell_setup(int submit_fd, int complete_fd)
+{
+if(lb.doorbell == NULL){
+	lb.doorbell = (doorbell_page *)loopback_alloc(lb.page);
+	if(lb.doorbell == NULL){ return EXIT_FAILURE; }
+	memset(lb.doorbell, 0, lb.page);
+	}
+
+if(lb.doorbell_submit >= 0){ close(lb.doorbell_submit); }
+if(lb.doorbell_complete >= 0){ close(lb.doorbell_complete); }
+
+lb.doorbell_submit	 = dup(submit_fd);
+lb.doorbell_complete = dup(complete_fd);
+
+return ( (lb.doorbell_submit < 0) || (lb.doorbell_complete < 0) ) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+
+
+/**
+ * Publishes the request by the sequence word and waits for its completion, 
+ * see call_usp_doorbell() of the kernel stub.
+ *
+ * @returns	 0 on success, -1 if the stand-in was stopped
+ */
+
+static int loopback_doorbell_call(void)
+{
+doorbell_page *db = lb.doorbell;
+unsigned int seq = db->submit_seq + 1;
+eventfd_t count;
+int ret;
+
+pthread_mutex_lock(&lb.lock);
+lb.flag = LB_TAKEN;
+pthread_mutex_unlock(&lb.lock);
+
+__sync_synchronize();
+db->submit_seq = seq;
+
+/* a spinning daemon sees the sequence word without the syscall */
+__sync_synchronize();
+if(db->daemon_sleeping){ eventfd_write(lb.doorbell_submit, 1); }
+
+while( (db->complete_seq != seq) && !lb.stopping ){
+	eventfd_read(lb.doorbell_complete, &count);
+	}
+__sync_synchronize();
+
+pthread_mutex_lock(&lb.lock);
+ret = (db->complete_seq == seq) ? 0 : -1;
+if(ret == 0){ lb.stats.handshakes++; }
+lb.flag = LB_IDLE;
+pthread_mutex_unlock(&lb.lock);
+
+return ret;
+}
+
+
+
+/*REQUEST_HANDSHAKE___________________________________________________________*/
+/**
+ * Posts the request to the daemon and waits for its acknowledgement, the
+ * message based connections share this handshake.
+ *
+ * @returns	 0 on success, -1 if the stand-in was stopped
+ */
+
+static int loopback_message_call(void)
+{
+int ret;
+
+pthread_mutex_lock(&lb.lock);
+
+/* netlink needs the registration of the daemon to know where to send to */
+while( (lb.c_mode == LB_CON_NL) && !lb.nl_registered && !lb.stopping ){ pthread_cond_wait(&lb.cond, &lb.lock); }
+
+/* the token is echoed by the daemon, it has no zero byte to survive strcpy */
+lb.token = ~0UL - (lb.stats.handshakes & 0x7f);
+lb.flag	 = LB_POSTED;
+pthread_cond_broadcast(&lb.cond);
+
+while( (lb.flag != LB_DONE) && !lb.stopping ){ pthread_cond_wait(&lb.cond, &lb.lock); }
+
+ret = (lb.flag == LB_DONE) ? 0 : -1;
+if(ret == 0){ lb.stats.handshakes++; }
+lb.flag = LB_IDLE;
+
+pthread_mutex_unlock(&lb.lock);
+
+return ret;
+}
+
+
+
+/*REQUEST_DESCRIPTORS_________________________________________________________*/
+/**
+ * Fills the descriptor of the posted request, see desc_fill() of the kernel 
+ * stub. gen_syndrome_mutex must be held.
+ *
+ * @param opcode	: one of the OP_* codes
+ * @param prio		: priority class
+ * @param disks		: number of disks
+ * @param bytes		: number of bytes
+ *
+ * @returns	 void
+ */
+
+static void loopback_desc_fill(unsigned int opcode, int prio, int disks, size_t bytes)
+{
+int i;
+
+lb.desc->opcode	 = opcode;
+lb.desc->prio	 = prio;
+lb.desc->id		 = ++lb.desc_id;
+lb.desc->disks	 = disks;
+lb.desc->bytes	 = bytes;
+lb.desc->start	 = 0;
+lb.desc->stop	 = disks-3;
+lb.desc->nfailed = 0;
+lb.desc->flags	 = 0;
+lb.desc->result	 = 0;
+lb.desc->array	 = 0;
+
+for(i=0; i < disks; i++){ lb.desc->offsets[i] = (unsigned long)(i+1) * lb.page; }
+}
+
+
+
+/*ADMISSION_SCHEDULER_________________________________________________________*/
+/**
+ * Sets the priority classes from sched=, see sched_conf() of the kernel stub.
+ *
+ * @param *value	: <credits>/<weight>/<target us>:... foreground first
+ *
+ * @returns	 EXIT_SUCCESS or EXIT_FAILURE
+ */
+
+static int loopback_sched_conf(const char *value)
+{
+unsigned int credits[PRIO_CLASSES];
+unsigned int weight[PRIO_CLASSES];
+unsigned long target[PRIO_CLASSES];
+int i;
+
+if( sscanf(value, "%u/%u/%lu:%u/%u/%lu:%u/%u/%lu", &credits[0], &weight[0], &target[0],
+			&credits[1], &weight[1], &target[1], &credits[2], &weight[2], &target[2]) != 3*PRIO_CLASSES ){
+	return EXIT_FAILURE;
+	}
+for(i=0; i < PRIO_CLASSES; i++){
+	if( (credits[i] == 0) || (weight[i] == 0) || (target[i] == 0) ){ return EXIT_FAILURE; }
+	}
+
+pthread_mutex_lock(&lb.sched_lock);
+for(i=0; i < PRIO_CLASSES; i++){
+	lb.classes[i].credits	= credits[i];
+	lb.classes[i].weight	= weight[i];
+	lb.classes[i].target_us = target[i];
+	}
+pthread_mutex_unlock(&lb.sched_lock);
+
+return EXIT_SUCCESS;
+}
+
+
+
+/**
+ * Monotonic time in us.
+ *
+ * @returns	 time
+ */
+
+static unsigned long long loopback_now_us(void)
+{
+struct timespec ts;
+
+clock_gettime(CLOCK_MONOTONIC, &ts);
+return (unsigned long long)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+
+
+/**
+ * Chooses the class of the next admission, see sched_pick() of the kernel 
+ * stub. sched_lock must be held.
+ *
+ * @param now		: time in us
+ *
+ * @returns	 the class or -1
+ */
+
+static int loopback_sched_pick(unsigned long long now)
+{
+lb_class *c;
+unsigned long long waited;
+unsigned long long ratio;
+unsigned long long late_ratio = 0;
+int late = -1;
+int best = -1;
+int i;
+
+for(i=0; i < PRIO_CLASSES; i++){
+	c = &lb.classes[i];
+	if( (c->head == NULL) || (c->admitted >= c->credits) ){ continue; }
+	
+	waited = now - c->head->enqueued;
+	if(waited > c->target_us){
+		ratio = (waited << 8) / c->target_us;
+		if( (late < 0) || (ratio > late_ratio) ){
+			late		= i;
+			late_ratio	= ratio;
+			}
+		}
+	
+	if( (best < 0) || (c->vtime < lb.classes[best].vtime) ){ best = i; }
+	}
+
+return (late >= 0) ? late : best;
+}
+
+
+
+/**
+ * Admits waiting stripes as long as the connection has room for them. 
+ * sched_lock must be held.
+ *
+ * @returns	 void
+ */
+
+static void loopback_sched_dispatch(void)
+{
+unsigned long long now = loopback_now_us();
+unsigned long long waited;
+lb_class *c;
+lb_waiter *w;
+int woken = 0;
+int i;
+
+while(lb.sched_inflight < lb.sched_slots){
+	i = loopback_sched_pick(now);
+	if(i < 0){ break; }
+	
+	c = &lb.classes[i];
+	w = c->head;
+	c->head = w->next;
+	if(c->head == NULL){ c->tail = NULL; }
+	
+	waited = now - w->enqueued;
+	lb.stats.classes[i].served++;
+	lb.stats.classes[i].wait_us += waited;
+	if(waited > lb.stats.classes[i].max_wait_us){ lb.stats.classes[i].max_wait_us = waited; }
+	if(waited > c->target_us){ lb.stats.classes[i].overdue++; }
+	
+	c->admitted++;
+	lb.sched_inflight++;
+	lb.sched_vtime = c->vtime;
+	c->vtime	  += LB_VTIME_UNIT / c->weight;
+	
+	w->granted = 1;
+	woken = 1;
+	}
+
+if(woken){ pthread_cond_broadcast(&lb.sched_cond); }
+}
+
+
+
+/**
+ * Waits until the scheduler admits a stripe of a class, see sched_enter() of 
+ * the kernel stub.
+ *
+ * @param prio		: priority class
+ *
+ * @returns	 void
+ */
+
+static void loopback_sched_enter(int prio)
+{
+lb_class *c = &lb.classes[prio];
+lb_waiter w;
+
+w.enqueued = loopback_now_us();
+w.granted  = 0;
+w.next	   = NULL;
+
+pthread_mutex_lock(&lb.sched_lock);
+if( (c->head == NULL) && (c->admitted == 0) && (c->vtime < lb.sched_vtime) ){ c->vtime = lb.sched_vtime; }
+if(c->tail != NULL){ c->tail->next = &w; }
+else{ c->head = &w; }
+c->tail = &w;
+
+loopback_sched_dispatch();
+while( !w.granted ){ pthread_cond_wait(&lb.sched_cond, &lb.sched_lock); }
+pthread_mutex_unlock(&lb.sched_lock);
+}
+
+
+
+/**
+ * Gives the credit of a completed stripe back.
+ *
+ * @param prio		: priority class
+ *
+ * @returns	 void
+ */
+
+static void loopback_sched_leave(int prio)
+{
+pthread_mutex_lock(&lb.sched_lock);
+lb.classes[prio].admitted--;
+lb.sched_inflight--;
+loopback_sched_dispatch();
+pthread_mutex_unlock(&lb.sched_lock);
+}
+
+
+
+/*BATCHED_PICKUP______________________________________________________________*/
+/**
+ * Size of a stripe with its header in the arena.
+ *
+ * @param *s		: stripe
+ *
+ * @returns	 size_t : bytes
+ */
+
+static size_t loopback_batch_size(lb_stripe *s)
+{
+return LB_PAGE_ALIGN(sizeof(arena_header)) + s->disks * LB_PAGE_ALIGN(s->bytes);
+}
+
+
+
+/**
+ * Tells whether a stripe fits into the empty arena.
+ *
+ * @param *s		: stripe
+ *
+ * @returns	 1 if it fits
+ */
+
+static int loopback_batch_fits(lb_stripe *s)
+{
+return loopback_batch_size(s) <= lb.arena_size;
+}
+
+
+
+/**
+ * Copies the data disks of a stripe into the arena behind its own header.
+ *
+ * @param *hdr		: header of the stripe in the arena
+ * @param offset	: arena offset of the header
+ * @param *s		: stripe
+ *
+ * @returns	 void
+ */
+
+static void loopback_batch_pack(arena_header *hdr, size_t offset, lb_stripe *s)
+{
+int i;
+
+for(i=0; i < s->disks; i++){
+	hdr->offsets[i] = loopback_arena_offset(offset, i, s->bytes);
+	if(i < s->disks-2){ memcpy( (char *)lb.arena + loopback_arena_offset(offset, i, s->bytes), s->ptrs[i], s->bytes ); }
+	}
+
+hdr->disks = s->disks;
+hdr->bytes = s->bytes;
+hdr->mode  = ARENA_INLINE;
+hdr->next  = 0;
+}
+
+
+
+/**
+ * Hands the oldest waiting stripes to the daemon with one handshake, see
+ * batch_run() of the kernel stub. The caller holds gen_syndrome_mutex.
+ *
+ * @returns	 void
+ */
+
+static void loopback_batch_run(void)
+{
+lb_stripe *taken;
+lb_stripe *s;
+arena_header *hdr = NULL;
+size_t offset = 0;
+int n = 0;
+int packed;
+int ret;
+int i;
+
+pthread_mutex_lock(&lb.lock);
+taken = lb.batch_head;
+for(s = lb.batch_head; s != NULL; s = s->next){
+	if( (n > 0) && ( !loopback_batch_fits(s) || (offset + loopback_batch_size(s) > lb.arena_size) ) ){ break; }
+	offset += loopback_batch_size(s);
+	if( (++n == lb.batch_max) || !loopback_batch_fits(s) ){
+		s = s->next;
+		break;
+		}
+	}
+lb.batch_head = s;
+if(s == NULL){ lb.batch_tail = NULL; }
+pthread_mutex_unlock(&lb.lock);
+
+if(n == 0){ return; }
+
+/* the first stripe is the one the mmap path of the daemon sees */
+lb.snc->disks = taken->disks;
+lb.snc->bytes = taken->bytes;
+lb.snc->ptrs  = NULL;
+memcpy(lb.ptrs, taken->ptrs, taken->disks * sizeof(void *));
+loopback_desc_fill(OP_GEN, taken->prio, taken->disks, taken->bytes);
+
+packed = loopback_batch_fits(taken);
+if( !packed ){
+	lb.arena->mode = ARENA_MAPPED;
+	lb.arena->next = 0;
+	loopback_sg_describe(taken->disks, taken->bytes, taken->ptrs);
+	}
+else{
+	offset = 0;
+	for(s = taken, i = 0; i < n; s = s->next, i++){
+		if(hdr != NULL){ hdr->next = offset; }
+		hdr = (arena_header *)((char *)lb.arena + offset);
+		loopback_batch_pack(hdr, offset, s);
+		offset += loopback_batch_size(s);
+		}
+	}
+
+if(lb.c_mode == LB_CON_DOORBELL){ ret = loopback_doorbell_call(); }
+else{ ret = loopback_message_call(); }
+
+offset = 0;
+for(s = taken, i = 0; i < n; i++){
+	lb_stripe *next = s->next;
+	
+	if( (ret == 0) && packed ){
+		memcpy( s->ptrs[s->disks-2], (char *)lb.arena + loopback_arena_offset(offset, s->disks-2, s->bytes), s->bytes );
+		memcpy( s->ptrs[s->disks-1], (char *)lb.arena + loopback_arena_offset(offset, s->disks-1, s->bytes), s->bytes );
+		offset += loopback_batch_size(s);
+		}
+	if(ret == 0){ lb.stats.requests++; }
+	
+	/* the stripe lives on the stack of its producer, don't touch it after this */
+	s->ret		= ret;
+	s->finished = 1;
+	s = next;
+	}
+}
+
+
+
+/**
+ * gen_syndrome with batched pickup. Every producer queues its stripe, the one
+ * which holds gen_syndrome_mutex serves all queued stripes.
+ *
+ * @param disks		: number of disks, the last two are P and Q
+ * @param bytes		: bytes per disk
+ * @param prio		: priority class
+ * @param **ptrs	: disks, allocated with loopback_alloc()
+ *
+ * @returns	 0 on success, -1 on error
+ */
+
+static int loopback_batch_gen_syndrome(int disks, size_t bytes, int prio, void **ptrs)
+{
+lb_stripe self;
+
+self.disks	  = disks;
+self.bytes	  = bytes;
+self.prio	  = prio;
+self.ptrs	  = ptrs;
+self.finished = 0;
+self.ret	  = -1;
+self.next	  = NULL;
+
+pthread_mutex_lock(&lb.lock);
+if(lb.batch_tail != NULL){ lb.batch_tail->next = &self; }
+else{ lb.batch_head = &self; }
+lb.batch_tail = &self;
+pthread_mutex_unlock(&lb.lock);
+
+loopback_slot_lock();
+while( !self.finished ){ loopback_batch_run(); }
+pthread_mutex_unlock(&lb.gen_syndrome_mutex);
+
+return self.ret;
+}
+
+
+
+/**
+ * Checks the disks of a request and holds it back until the daemon has 
+ * configured the stand-in.
+ *
+ * @param disks		: number of disks
+ * @param **ptrs	: disks, allocated with loopback_alloc()
+ *
+ * @returns	 0 or -1 if the request can't be posted
+ */
+
+static int loopback_admit(int disks, void **ptrs)
+{
+int i;
+
+if( (disks < 4) || (disks > ARENA_MAX_DISKS) ){ return -1; }
+for(i=0; i < disks; i++){
+	if( pool_offset(ptrs[i]) < 0 ){ return -1; }
+	}
+
+/* the stub holds back every request until the daemon has configured it */
+pthread_mutex_lock(&lb.lock);
+while( (lb.c_mode == 0) && !lb.stopping ){ pthread_cond_wait(&lb.cond, &lb.lock); }
+pthread_mutex_unlock(&lb.lock);
+
+return (lb.c_mode == 0) ? -1 : 0;
+}
+
+
+
+/**
+ * The kernel side of a request.
+ *
+ * @param disks		: number of disks, the last two are P and Q
+ * @param bytes		: bytes per disk
+ * @param **ptrs	: disks, allocated with loopback_alloc()
+ *
+ * @returns	 0 on success, -1 on error
+ */
+
+HOST int loopback_gen_syndrome(int disks, size_t bytes, void **ptrs)
+{
+return loopback_gen_syndrome_prio(disks, bytes, ptrs, PRIO_FOREGROUND);
+}
+
+
+
+/**
+ * Takes gen_syndrome_mutex. Like md in front of the kernel stub, no stripe 
+ * gets it before con= is set.
+ *
+ * @returns	 void
+ */
+
+static void loopback_slot_lock(void)
+{
+pthread_mutex_lock(&lb.lock);
+while( !lb.configured && !lb.stopping ){ pthread_cond_wait(&lb.cond, &lb.lock); }
+pthread_mutex_unlock(&lb.lock);
+
+pthread_mutex_lock(&lb.gen_syndrome_mutex);
+}
+
+
+
+/**
+ * Hands a stripe over the single slot and waits for its syndromes. 
+ * gen_syndrome_mutex must be held, or nothing else may use the slot.
+ *
+ * @param disks		: number of disks, the last two are P and Q
+ * @param bytes		: bytes per disk
+ * @param **ptrs	: disks, allocated with loopback_alloc()
+ * @param prio		: priority class
+ *
+ * @returns	 0 on success, -1 on error
+ */
+
+static int loopback_slot_call(int disks, size_t bytes, void **ptrs, int prio)
+{
+int ret;
+int packed;
+
+/* kernel pointers mean nothing to the daemon, it maps the disks by index */
+lb.snc->disks = disks;
+lb.snc->bytes = bytes;
+lb.snc->ptrs  = NULL;
+memcpy(lb.ptrs, ptrs, disks * sizeof(void *));
+loopback_desc_fill(OP_GEN, prio, disks, bytes);
+
+packed = loopback_arena_pack(disks, bytes, ptrs);
+if(packed != 0){ loopback_sg_describe(disks, bytes, ptrs); }
+
+if(lb.c_mode == LB_CON_DOORBELL){ ret = loopback_doorbell_call(); }
+else{ ret = loopback_message_call(); }
+
+if( (ret == 0) && (packed == 0) ){
+	memcpy( ptrs[disks-2], (char *)lb.arena + loopback_arena_offset(0, disks-2, bytes), bytes );
+	memcpy( ptrs[disks-1], (char *)lb.arena + loopback_arena_offset(0, disks-1, bytes), bytes );
+	}
+
+return ret;
+}
+
+
+
+/**
+ * The kernel side of an admitted request on the single slot.
+ *
+ * @param disks		: number of disks, the last two are P and Q
+ * @param bytes		: bytes per disk
+ * @param **ptrs	: disks, allocated with loopback_alloc()
+ * @param prio		: priority class
+ *
+ * @returns	 0 on success, -1 on error
+ */
+
+static int loopback_slot_gen_syndrome(int disks, size_t bytes, void **ptrs, int prio)
+{
+int ret;
+
+loopback_slot_lock();
+ret = loopback_slot_call(disks, bytes, ptrs, prio);
+if(ret == 0){ lb.stats.requests++; }
+pthread_mutex_unlock(&lb.gen_syndrome_mutex);
+
+return ret;
+}
+
+
+
+/**
+ * The kernel side of one piece of a request, it waits for its admission first.
+ *
+ * @param disks		: number of disks, the last two are P and Q
+ * @param bytes		: bytes per disk
+ * @param **ptrs	: disks, allocated with loopback_alloc()
+ * @param prio		: priority class
+ *
+ * @returns	 0 on success, -1 on error
+ */
+
+static int loopback_piece_gen_syndrome(int disks, size_t bytes, void **ptrs, int prio)
+{
+int ret;
+
+loopback_sched_enter(prio);
+
+if(lb.c_mode == LB_CON_RING){ ret = loopback_ring_gen_syndrome(disks, bytes, ptrs); }
+else if( (lb.batch_max > 1) && (lb.arena != NULL) ){ ret = loopback_batch_gen_syndrome(disks, bytes, prio, ptrs); }
+else{ ret = loopback_slot_gen_syndrome(disks, bytes, ptrs, prio); }
+
+loopback_sched_leave(prio);
+
+return ret;
+}
+
+
+
+/**
+ * Tells if a request is served slice by slice. The ring chunks the stripes 
+ * by itself and holds many of them at once, so there is nothing to gain.
+ *
+ * @param bytes		: bytes per disk
+ *
+ * @returns	 the number of slices or 1 for a request which goes as a whole
+ */
+
+static size_t loopback_slices(size_t bytes)
+{
+size_t slices;
+
+if( (lb.slice_bytes == 0) || (bytes <= lb.slice_bytes) || (lb.c_mode == LB_CON_RING) ){ return 1; }
+
+slices = (bytes + lb.slice_bytes - 1) / lb.slice_bytes;
+
+pthread_mutex_lock(&lb.sched_lock);
+lb.stats.sliced++;
+lb.stats.slices += slices;
+pthread_mutex_unlock(&lb.sched_lock);
+
+return slices;
+}
+
+
+
+/**
+ * The kernel side of a request of a priority class, it waits for its 
+ * admission first. A request larger than the slice size of the daemon is 
+ * served slice by slice and every slice is admitted on its own, so the small 
+ * requests of the other classes get in between. It returns after its last 
+ * slice.
+ *
+ * @param disks		: number of disks, the last two are P and Q
+ * @param bytes		: bytes per disk
+ * @param **ptrs	: disks, allocated with loopback_alloc()
+ * @param prio		: PRIO_FOREGROUND, PRIO_RECOVERY or PRIO_BACKGROUND
+ *
+ * @returns	 0 on success, -1 on error
+ */
+
+HOST int loopback_gen_syndrome_prio(int disks, size_t bytes, void **ptrs, int prio)
+{
+void *slice[ARENA_MAX_DISKS];
+size_t offset;
+size_t length;
+int ret = 0;
+int i;
+
+if( (prio < 0) || (prio >= PRIO_CLASSES) ){ return -1; }
+if( loopback_admit(disks, ptrs) != 0 ){ return -1; }
+
+if( loopback_slices(bytes) == 1 ){ return loopback_piece_gen_syndrome(disks, bytes, ptrs, prio); }
+
+for(offset=0; (offset < bytes) && (ret == 0); offset += length){
+	length = (bytes - offset < lb.slice_bytes) ? bytes - offset : lb.slice_bytes;
+	for(i=0; i < disks; i++){ slice[i] = (char *)ptrs[i] + offset; }
+	ret = loopback_piece_gen_syndrome(disks, length, slice, prio);
+	}
+
+return ret;
+}
+
+
+
+/**
+ * One piece of an operation on the single slot, it waits for its admission 
+ * first.
+ *
+ * @param array		: array of the operation
+ * @param opcode	: one of the OP_* codes
+ * @param prio		: priority class
+ * @param disks		: number of disks
+ * @param bytes		: bytes per disk
+ * @param start		: first data disk of OP_XOR_UPDATE
+ * @param stop		: last data disk of OP_XOR_UPDATE
+ * @param nfailed	: number of failed disks
+ * @param *failed	: the failed disks
+ * @param flags		: DESC_FLAG_*
+ * @param **ptrs	: disks, allocated with loopback_alloc()
+ *
+ * @returns	 the result of the daemon or -1 on error
+ */
+
+static int loopback_piece_op(unsigned int array, unsigned int opcode, int prio, int disks, size_t bytes, 
+							 int start, int stop, int nfailed, int *failed, unsigned int flags, void **ptrs)
+{
+int ret;
+int i;
+
+loopback_sched_enter(prio);
+loopback_slot_lock();
+
+lb.snc->disks = disks;
+lb.snc->bytes = bytes;
+lb.snc->ptrs  = NULL;
+memcpy(lb.ptrs, ptrs, disks * sizeof(void *));
+loopback_desc_fill(opcode, prio, disks, bytes);
+
+lb.desc->start	 = start;
+lb.desc->stop	 = stop;
+lb.desc->nfailed = nfailed;
+lb.desc->flags	 = flags;
+lb.desc->array	 = array;
+for(i=0; i < nfailed; i++){ lb.desc->failed[i] = failed[i]; }
+
+if(lb.arena != NULL){
+	lb.arena->mode = ARENA_MAPPED;
+	lb.arena->next = 0;
+	}
+if(lb.sg != NULL){ lb.sg->disks = 0; }
+
+if(lb.c_mode == LB_CON_DOORBELL){ ret = loopback_doorbell_call(); }
+else{ ret = loopback_message_call(); }
+
+if(ret == 0){
+	ret = lb.desc->result;
+	lb.stats.requests++;
+	}
+
+pthread_mutex_unlock(&lb.gen_syndrome_mutex);
+loopback_sched_leave(prio);
+
+return ret;
+}
+
+
+
+/**
+ * The kernel side of an operation, see barracuda_op() of the kernel stub. The
+ * disks are always mapped one by one. Large operations are sliced like in
+ * loopback_gen_syndrome_prio(), the CHECK_* bits of the slices are merged.
+ *
+ * @param array		: array of the operation, 0 unless the daemon has more
+ * @param opcode	: one of the OP_* codes
+ * @param prio		: priority class
+ * @param disks		: number of disks
+ * @param bytes		: bytes per disk
+ * @param start		: first data disk of OP_XOR_UPDATE
+ * @param stop		: last data disk of OP_XOR_UPDATE
+ * @param nfailed	: number of failed disks
+ * @param *failed	: the failed disks
+ * @param flags		: DESC_FLAG_*
+ * @param **ptrs	: disks, allocated with loopback_alloc()
+ *
+ * @returns	 the result of the daemon, -EOPNOTSUPP if it doesn't speak 
+ *			 descriptors or -1 on error
+ */
+
+HOST int loopback_submit_op(unsigned int array, unsigned int opcode, int prio, int disks, size_t bytes, 
+							int start, int stop, int nfailed, int *failed, unsigned int flags, void **ptrs)
+{
+void *slice[ARENA_MAX_DISKS];
+size_t offset;
+size_t length;
+int result = 0;
+int ret;
+int i;
+
+if( (nfailed < 0) || (nfailed > DESC_MAX_FAILED) || (prio < 0) || (prio >= PRIO_CLASSES) ){ return -1; }
+if( loopback_admit(disks, ptrs) != 0 ){ return -1; }
+if( (lb.proto < 1) || (lb.c_mode == LB_CON_RING) || ((array != 0) && (lb.proto < 3)) ){ return -EOPNOTSUPP; }
+
+if( loopback_slices(bytes) == 1 ){
+	return loopback_piece_op(array, opcode, prio, disks, bytes, start, stop, nfailed, failed, flags, ptrs);
+	}
+
+for(offset=0; offset < bytes; offset += length){
+	length = (bytes - offset < lb.slice_bytes) ? bytes - offset : lb.slice_bytes;
+	for(i=0; i < disks; i++){ slice[i] = (char *)ptrs[i] + offset; }
+	
+	ret = loopback_piece_op(array, opcode, prio, disks, length, start, stop, nfailed, failed, flags, slice);
+	if(ret < 0){ return ret; }
+	result |= ret;
+	}
+
+return result;
+}
+
+
+
+/**
+ * Blocks the daemon until a request is posted and takes it.
+ *
+ * @returns	 0 or -1 if the stand-in was stopped
+ */
+
+static int loopback_take(void)
+{
+int ret = -1;
+
+pthread_mutex_lock(&lb.lock);
+while( (lb.flag != LB_POSTED) && !lb.stopping ){ pthread_cond_wait(&lb.cond, &lb.lock); }
+if(lb.flag == LB_POSTED){
+	lb.flag = LB_TAKEN;
+	ret = 0;
+	}
+pthread_mutex_unlock(&lb.lock);
+
+return ret;
+}
+
+
+
+/**
+ * Completes the taken request, lb.lock must be held.
+ *
+ * @param *token	: token echoed by the daemon, NULL if the call has none
+ *
+ * @returns	 0 or -1 if there was no taken request
+ */
+
+static int loopback_ack_locked(void *token)
+{
+if(lb.flag != LB_TAKEN){
+	if(token != NULL){ lb.stats.handshake_errors++; }
+	return -1;
+	}
+
+if( (token != NULL) && memcmp(token, &lb.token, sizeof(unsigned long)) ){
+	lb.stats.handshake_errors++;
+	}
+
+lb.flag = LB_DONE;
+pthread_cond_broadcast(&lb.cond);
+
+return 0;
+}
+
+
+
+/**
+ * Wakes up every blocked call of the daemon.
+ *
+ * @returns	 void
+ */
+
+HOST void loopback_stop(void)
+{
+pthread_mutex_lock(&lb.lock);
+if( !lb.stopping && (lb.doorbell_submit >= 0) ){
+	eventfd_write(lb.doorbell_complete, 1);
+	eventfd_write(lb.doorbell_submit, 1);
+	}
+lb.stopping = 1;
+pthread_cond_broadcast(&lb.cond);
+pthread_mutex_unlock(&lb.lock);
+}
+
+
+
+/**
+ * Returns the counters of the stand-in.
+ *
+ * @param *stats	: counters
+ *
+ * @returns	 void
+ */
+
+HOST void loopback_get_stats(loopback_stats *stats)
+{
+pthread_mutex_lock(&lb.sched_lock);
+pthread_mutex_lock(&lb.lock);
+*stats = lb.stats;
+pthread_mutex_unlock(&lb.lock);
+pthread_mutex_unlock(&lb.sched_lock);
+}
+
+
+
+/*CONNECTION_CALIBRATION______________________________________________________*/
+/**
+ * Thread of ping=, it hands the ping stripes over the single slot one after
+ * the other, see ping_thread() of the kernel stub.
+ *
+ * @param *arg		: unused
+ *
+ * @returns	 NULL
+ */
+
+static void *loopback_ping_main(void *arg)
+{
+int i;
+
+for(i=0; i < lb.ping_rounds; i++){
+	if( loopback_slot_call(PING_DISKS, lb.ping_bytes, lb.ping_ptrs, PRIO_FOREGROUND) != 0 ){ break; }
+	lb.stats.pings++;
+	}
+
+return NULL;
+}
+
+
+
+/**
+ * Starts the ping stripes of ping=, see ping_start() of the kernel stub. The
+ * disks are taken from the pool with the first ping and kept.
+ *
+ * @param *value	: <connection>:<rounds>:<bytes>
+ *
+ * @returns	 EXIT_SUCCESS or EXIT_FAILURE
+ */
+
+static int loopback_ping_start(const char *value)
+{
+char connection[16];
+unsigned long bytes;
+int rounds;
+int mode = 0;
+int i;
+
+if( sscanf(value, "%15[^:]:%d:%lu", connection, &rounds, &bytes) != 3 ){ return EXIT_FAILURE; }
+
+if( strcmp(connection, "NL")     == 0 ){ mode = LB_CON_NL; }
+if( strcmp(connection, "IOCTL")  == 0 ){ mode = LB_CON_IOCTL; }
+if( strcmp(connection, "PROCFS") == 0 ){ mode = LB_CON_PROCFS; }
+if( (strcmp(connection, "DOORBELL") == 0) && (lb.doorbell != NULL) ){ mode = LB_CON_DOORBELL; }
+
+bytes = LB_PAGE_ALIGN(bytes);
+if( (mode == 0) || (rounds <= 0) || (bytes == 0) || (bytes > PING_MAX_BYTES) || lb.configured ){ return EXIT_FAILURE; }
+
+loopback_ping_wait();
+
+for(i=0; (i < PING_DISKS) && (lb.ping_ptrs[i] == NULL); i++){
+	lb.ping_ptrs[i] = loopback_alloc(PING_MAX_BYTES);
+	if(lb.ping_ptrs[i] == NULL){ return EXIT_FAILURE; }
+	memset(lb.ping_ptrs[i], i, PING_MAX_BYTES);
+	}
+
+lb.ping_rounds = rounds;
+lb.ping_bytes  = bytes;
+
+pthread_mutex_lock(&lb.lock);
+lb.c_mode = mode;
+pthread_mutex_unlock(&lb.lock);
+
+if( pthread_create(&lb.ping_thread, NULL, loopback_ping_main, NULL) != 0 ){ return EXIT_FAILURE; }
+lb.ping_started = 1;
+
+return EXIT_SUCCESS;
+}
+
+
+
+/**
+ * Waits until the stripes of the last ping= are served.
+ *
+ * @returns	 void
+ */
+
+static void loopback_ping_wait(void)
+{
+if( !lb.ping_started ){ return; }
+
+pthread_join(lb.ping_thread, NULL);
+lb.ping_started = 0;
+}
+
+
+
+/*CALLS_OF_THE_DAEMON_________________________________________________________*/
+/**
+ * /proc/barracuda/conf
+ *
+ * @param *command	: pid=, proto=, sched=, arena=, batch=, ring=, shard=, sg=, doorbell=, ping= or con=
+ *
+ * @returns	 EXIT_SUCCESS or EXIT_FAILURE
+ */
+
+static int loopback_conf_write(char *command)
+{
+unsigned long value;
+unsigned int entries;
+int shards;
+int submit_fd;
+int complete_fd;
+int mode = 0;
+int i;
+
+if( strncmp(command, "pid=", 4) == 0 ){ return EXIT_SUCCESS; }
+if( sscanf(command, "proto=%lu", &value) == 1 ){
+	lb.proto		 = (value > BARRACUDA_PROTO_VERSION) ? BARRACUDA_PROTO_VERSION : (unsigned int)value;
+	lb.desc->version = lb.proto;
+	return EXIT_SUCCESS;
+	}
+if( strncmp(command, "sched=", 6) == 0 ){ return loopback_sched_conf(command+6); }
+if( sscanf(command, "arena=%lu", &value) == 1 ){ return loopback_arena_alloc(value); }
+if( sscanf(command, "batch=%lu", &value) == 1 ){
+	lb.batch_max = (value > BATCH_MAX_STRIPES) ? BATCH_MAX_STRIPES : (int)value;
+	return EXIT_SUCCESS;
+	}
+if( sscanf(command, "slice=%lu", &value) == 1 ){
+	lb.slice_bytes = (value == 0) ? 0 : LB_PAGE_ALIGN(value);
+	return EXIT_SUCCESS;
+	}
+if( sscanf(command, "ring=%u:%lu:%d", &entries, &value, &shards) == 3 ){ return loopback_ring_alloc(entries, value, shards); }
+if( sscanf(command, "ring=%u:%lu", &entries, &value) == 2 ){ return loopback_ring_alloc(entries, value, 1); }
+if( strncmp(command, "shard=", 6) == 0 ){
+	lb.shard_by = (strcmp(command+6, "STRIPE") == 0) ? RING_SHARD_STRIPE : RING_SHARD_CPU;
+	return EXIT_SUCCESS;
+	}
+if( sscanf(command, "sg=%lu", &value) == 1 ){ return (value != 0) ? loopback_sg_alloc() : EXIT_SUCCESS; }
+if( sscanf(command, "doorbell=%d:%d", &submit_fd, &complete_fd) == 2 ){ return loopback_doorbell_setup(submit_fd, complete_fd); }
+if( strncmp(command, "ping=", 5) == 0 ){ return loopback_ping_start(command+5); }
+if( strncmp(command, "con=", 4) != 0 ){ return EXIT_FAILURE; }
+
+if( strcmp(command+4, "NL")     == 0 ){ mode = LB_CON_NL; }
+if( strcmp(command+4, "IOCTL")  == 0 ){ mode = LB_CON_IOCTL; }
+if( strcmp(command+4, "PROCFS") == 0 ){ mode = LB_CON_PROCFS; }
+if( strcmp(command+4, "RING")   == 0 ){ mode = LB_CON_RING; }
+if( strcmp(command+4, "DOORBELL") == 0 ){ mode = LB_CON_DOORBELL; }
+
+if( (mode == 0) || ((mode == LB_CON_RING) && (lb.ring_shards == 0)) ){ return EXIT_FAILURE; }
+if( (mode == LB_CON_DOORBELL) && (lb.doorbell == NULL) ){ return EXIT_FAILURE; }
+
+loopback_ping_wait();
+
+/* the scheduler admits as many stripes as the connection holds at once */
+pthread_mutex_lock(&lb.sched_lock);
+lb.sched_slots = 1;
+if(mode == LB_CON_RING){
+	for(lb.sched_slots = 0, i = 0; i < lb.ring_shards; i++){ lb.sched_slots += lb.rings[i].entries; }
+	}
+else if( (lb.batch_max > 1) && (lb.arena != NULL) ){ lb.sched_slots = lb.batch_max; }
+loopback_sched_dispatch();
+pthread_mutex_unlock(&lb.sched_lock);
+
+pthread_mutex_lock(&lb.lock);
+lb.c_mode	  = mode;
+lb.configured = 1;
+pthread_cond_broadcast(&lb.cond);
+pthread_mutex_unlock(&lb.lock);
+
+return EXIT_SUCCESS;
+}
+
+
+
+/**
+ * open("/dev/barracuda")
+ *
+ * @param flags		: unused
+ *
+ * @returns	 a descriptor of the shared file
+ */
+
+static int loopback_open(int flags)
+{
+return dup(lb.pool_fd);
+}
+
+
+
+/**
+ * mmap() of /dev/barracuda. Page 0 is the request struct, page i the disk 
+ * i-1 of the taken request, ARENA_PGOFF, RING_PGOFF + shard, DOORBELL_PGOFF, 
+ * SG_TABLE_PGOFF, SG_WINDOW_PGOFF and DESC_PGOFF the arena, the rings, the 
+ * doorbell, the segment table, the window and the descriptor of the taken 
+ * request.
+ *
+ * @param length	: bytes to map
+ * @param prot		: protection
+ * @param fd		: unused
+ * @param offset	: offset into the device
+ *
+ * @returns	 the mapping or MAP_FAILED
+ */
+
+static void *loopback_mmap(size_t length, int prot, int fd, off_t offset)
+{
+unsigned long pgoff = offset / lb.page;
+off_t pool_off = -1;
+
+if(pgoff == ARENA_PGOFF){
+	if( (lb.arena != NULL) && (length <= lb.arena_size) ){ pool_off = pool_offset(lb.arena); }
+	}
+else if( (pgoff >= RING_PGOFF) && (pgoff < RING_PGOFF + lb.ring_shards) ){
+	lb_ring *r = &lb.rings[pgoff - RING_PGOFF];
+	
+	if(length <= r->size){ pool_off = pool_offset(r->ring); }
+	}
+else if(pgoff == DOORBELL_PGOFF){
+	if( (lb.doorbell != NULL) && (length <= lb.page) ){ pool_off = pool_offset(lb.doorbell); }
+	}
+else if(pgoff == SG_TABLE_PGOFF){
+	if( (lb.sg != NULL) && (length <= LB_PAGE_ALIGN(sizeof(sg_table))) ){ pool_off = pool_offset(lb.sg); }
+	}
+else if(pgoff == SG_WINDOW_PGOFF){
+	return loopback_sg_map_window(length, prot);
+	}
+else if(pgoff == DESC_PGOFF){
+	if( length <= LB_PAGE_ALIGN(sizeof(request_desc)) ){ pool_off = pool_offset(lb.desc); }
+	}
+else if(pgoff == 0){
+	pool_off = 0;
+	}
+else if( (lb.flag == LB_TAKEN) && (pgoff <= (unsigned long)lb.snc->disks) ){
+	pool_off = pool_offset(lb.ptrs[pgoff-1]);
+	}
+
+if(pool_off < 0){
+	errno = EINVAL;
+	return MAP_FAILED;
+	}
+
+lb.stats.mmap_calls++;
+return mmap(0, length, prot, MAP_SHARED | memlock_map_flags(), lb.pool_fd, pool_off);
+}
+
+
+
+/**
+ * pread() of /dev/barracuda, the offset is the disk index.
+ *
+ * @param fd		: unused
+ * @param *buf		: destination
+ * @param count		: bytes
+ * @param offset	: disk
+ *
+ * @returns	 bytes copied or -1
+ */
+
+static ssize_t loopback_pread(int fd, void *buf, size_t count, off_t offset)
+{
+if( (lb.flag != LB_TAKEN) || (offset < 0) || (offset >= lb.snc->disks) || (count > lb.snc->bytes) ){
+	errno = EINVAL;
+	return -1;
+	}
+
+lb.stats.copy_calls++;
+memcpy(buf, lb.ptrs[offset], count);
+return count;
+}
+
+
+
+/**
+ * pwrite() of /dev/barracuda, the offset is the disk index.
+ *
+ * @param fd		: unused
+ * @param *buf		: source
+ * @param count		: bytes
+ * @param offset	: disk
+ *
+ * @returns	 bytes copied or -1
+ */
+
+static ssize_t loopback_pwrite(int fd, const void *buf, size_t count, off_t offset)
+{
+if( (lb.flag != LB_TAKEN) || (offset < 0) || (offset >= lb.snc->disks) || (count > lb.snc->bytes) ){
+	errno = EINVAL;
+	return -1;
+	}
+
+lb.stats.copy_calls++;
+memcpy(lb.ptrs[offset], buf, count);
+return count;
+}
+
+
+
+/**
+ * ioctl() of /dev/barracuda. IOCTL_GETVALUE acknowledges the previous request
+ * and blocks until the next one, as ioctl_callback() of the stub.
+ *
+ * @param fd		: unused
+ * @param request	: IOCTL_GETVALUE or IOCTL_RING_ENTER
+ * @param *arg		: "flag" or the wait flag of the ring
+ *
+ * @returns	 0 or the result of the ring doorbell, -1 on error
+ */
+
+static int loopback_ioctl(int fd, unsigned long request, void *arg)
+{
+if(request == IOCTL_RING_ENTER){ return loopback_ring_enter((unsigned long)arg); }
+
+/* "done" acknowledges the last ping stripe without waiting for another one */
+if( (request == IOCTL_GETVALUE) && (strcmp((char *)arg, "done") == 0) ){
+	pthread_mutex_lock(&lb.lock);
+	loopback_ack_locked(NULL);
+	pthread_mutex_unlock(&lb.lock);
+	return 0;
+	}
+
+if( (request != IOCTL_GETVALUE) || strcmp((char *)arg, "flag") ){
+	errno = EINVAL;
+	return -1;
+	}
+
+pthread_mutex_lock(&lb.lock);
+loopback_ack_locked(NULL);
+pthread_mutex_unlock(&lb.lock);
+
+if( loopback_take() != 0 ){
+	errno = EINTR;
+	return -1;
+	}
+
+strcpy((char *)arg, "flag");
+return 0;
+}
+
+
+
+/**
+ * fopen("/proc/barracuda/stub")
+ *
+ * @returns	 handle of the stub
+ */
+
+static void *loopback_stub_open(void)
+{
+return (void *)&lb;
+}
+
+
+
+/**
+ * Read of /proc/barracuda/stub, blocks until a request is posted.
+ *
+ * @param *stub		: unused
+ * @param *buf		: buffer for the token
+ * @param count		: size of the buffer
+ *
+ * @returns	 bytes read, 0 if the stand-in was stopped
+ */
+
+static size_t loopback_stub_read(void *stub, void *buf, size_t count)
+{
+if( (count < sizeof(unsigned long)) || (loopback_take() != 0) ){ return 0; }
+
+memcpy(buf, &lb.token, sizeof(unsigned long));
+return sizeof(unsigned long);
+}
+
+
+
+/**
+ * Write of /proc/barracuda/stub, acknowledges the taken request.
+ *
+ * @param *stub		: unused
+ * @param *buf		: the echoed token
+ * @param count		: size of the buffer
+ *
+ * @returns	 bytes written, 0 if there was no taken request
+ */
+
+static size_t loopback_stub_write(void *stub, void *buf, size_t count)
+{
+int ret;
+
+if(count < sizeof(unsigned long)){ return 0; }
+
+pthread_mutex_lock(&lb.lock);
+ret = loopback_ack_locked(buf);
+pthread_mutex_unlock(&lb.lock);
+
+return (ret == 0) ? count : 0;
+}
+
+
+
+/**
+ * fclose() of the stub.
+ *
+ * @param *stub		: unused
+ *
+ * @returns	 void
+ */
+
+static void loopback_stub_close(void *stub)
+{
+}
+
+
+
+/**
+ * Netlink socket of the daemon.
+ *
+ * @returns	 a descriptor of the shared file
+ */
+
+static int loopback_nl_open(void)
+{
+return dup(lb.pool_fd);
+}
+
+
+
+/**
+ * Describes the stripes of the taken request, see nl_describe() of the kernel
+ * stub. lb.lock must be held.
+ *
+ * @param *req		: the descriptors are stored here
+ *
+ * @returns	 void
+ */
+
+static void loopback_nl_describe(nl_request *req)
+{
+unsigned long offset = 0;
+arena_header *hdr;
+
+req->seq++;
+req->count = 0;
+
+if( (lb.arena == NULL) || (lb.arena->mode != ARENA_INLINE) ){
+	req->desc[0].offset = NL_DESC_MAPPED;
+	req->desc[0].status = -EINPROGRESS;
+	req->count = 1;
+	return;
+	}
+
+do{
+	hdr = (arena_header *)((char *)lb.arena + offset);
+	req->desc[req->count].offset = offset;
+	req->desc[req->count].status = -EINPROGRESS;
+	req->count++;
+	offset = hdr->next;
+	}while( (offset != 0) && (req->count < NL_DESC_MAX) );
+}
+
+
+
+/**
+ * sendmmsg() towards the stub. It takes the registration of the daemon and 
+ * the completions of taken requests.
+ *
+ * @param sock		: unused
+ * @param *msgs		: packets
+ * @param vlen		: number of packets
+ *
+ * @returns	 number of packets sent
+ */
+
+static int loopback_nl_sendmmsg(int sock, struct mmsghdr *msgs, unsigned int vlen)
+{
+struct nlmsghdr *nlh;
+nl_request *done;
+unsigned int i;
+unsigned int d;
+
+pthread_mutex_lock(&lb.lock);
+for(i=0; i < vlen; i++){
+	nlh = (struct nlmsghdr *)msgs[i].msg_hdr.msg_iov->iov_base;
+	
+	if(nlh->nlmsg_type == NL_MSG_REGISTER){
+		lb.nl_registered = 1;
+		pthread_cond_broadcast(&lb.cond);
+		continue;
+		}
+	if(nlh->nlmsg_type != NL_MSG_COMPLETE){
+		lb.stats.handshake_errors++;
+		continue;
+		}
+	
+	done = (nl_request *)NLMSG_DATA(nlh);
+	if( (nlh->nlmsg_len < NLMSG_LENGTH(NL_REQUEST_BYTES(0))) || (done->seq != lb.nl_req.seq) || 
+		(done->count != lb.nl_req.count) ){
+		lb.stats.handshake_errors++;
+		}
+	else{
+		for(d=0; d < done->count; d++){
+			if(done->desc[d].status != 0){ lb.stats.handshake_errors++; }
+			}
+		}
+	loopback_ack_locked(NULL);
+	msgs[i].msg_len = nlh->nlmsg_len;
+	}
+pthread_mutex_unlock(&lb.lock);
+
+return vlen;
+}
+
+
+
+/**
+ * recvmmsg() from the stub, blocks until a request is posted. The stub has a
+ * single request in flight, there is never more than one packet.
+ *
+ * @param sock		: unused
+ * @param *msgs		: packets
+ * @param vlen		: unused
+ *
+ * @returns	 number of packets received, -1 if the stand-in was stopped
+ */
+
+static int loopback_nl_recvmmsg(int sock, struct mmsghdr *msgs, unsigned int vlen)
+{
+struct nlmsghdr *nlh = (struct nlmsghdr *)msgs[0].msg_hdr.msg_iov->iov_base;
+size_t len;
+
+if( loopback_take() != 0 ){
+	errno = EINTR;
+	return -1;
+	}
+
+pthread_mutex_lock(&lb.lock);
+loopback_nl_describe(&lb.nl_req);
+len = NL_REQUEST_BYTES(lb.nl_req.count);
+
+nlh->nlmsg_len	 = NLMSG_LENGTH(len);
+nlh->nlmsg_type	 = NL_MSG_REQUEST;
+nlh->nlmsg_seq	 = lb.nl_req.seq;
+memcpy(NLMSG_DATA(nlh), &lb.nl_req, len);
+pthread_mutex_unlock(&lb.lock);
+
+msgs[0].msg_len = nlh->nlmsg_len;
+return 1;
+}
+
+
+
+/**
+ * Closes the netlink socket.
+ *
+ * @param sock		: socket
+ *
+ * @returns	 void
+ */
+
+static void loopback_nl_close(int sock)
+{
+close(sock);
+}
@@ -0,0 +1,203 @@
+/**
+ * \file
+ * \brief	Loopback stand-in for the kernel stub, /proc/barracuda and /dev/barracuda
+ *
+ * @author	Dominic Eschweiler weiler@upb.de
+ *
+ * Status	: STABLE \n
+ * Date of creation : 18.10.2026
+ *
+ */
+
+
+/*****************************************************************
+ *
+ * Barracuda is a experimental microdriver extension to the 
+ * linux-kernel that is able to outsource common functions to
+ * the userspace. It was intensionally designed to accelerate
+ * CPU-intensive Tasks on a GPU.
+ *
+ * Copyright (C) 2009 Dominic Eschweiler
+ *
+ * This program is free software; you can redistribute it and/or 
+ * modify it under the terms of the GNU General Public License as 
+ * published by the Free Software Foundation; either only GPLv2 - 
+ * version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful, 
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of 
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the 
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public 
+ * License along with this program; 
+ * if not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************/
+
+#ifndef __LOOPBACK__
+#define __LOOPBACK__
+
+# include "definitions.h"
+# include "kernel_ops.h"
+
+/*! \var typedef struct loopback_class_stats;
+	\brief Counters of a priority class of the admission scheduler */
+
+typedef struct loopback_class_stats{
+	unsigned long served;
+	unsigned long overdue;
+	unsigned long long wait_us;
+	unsigned long long max_wait_us;
+	}loopback_class_stats;
+
+/*! \var typedef struct loopback_stats;
+	\brief Counters of the stand-in */
+
+typedef struct loopback_stats{
+	unsigned long requests;
+	unsigned long handshakes;
+	unsigned long handshake_errors;
+	unsigned long mmap_calls;
+	unsigned long copy_calls;
+	unsigned long notifications;	/* ring doorbell calls which reaped completions */
+	unsigned long sliced;			/* requests which were served slice by slice */
+	unsigned long slices;
+	unsigned long pings;			/* stripes of ping= before con= */
+	loopback_class_stats classes[PRIO_CLASSES];
+	}loopback_stats;
+
+
+
+/**
+ * Creates the stand-in. All memory the daemon may map, the request struct, the
+ * disks of the submitted stripes, the arena and the ring, is taken from one 
+ * shared file, so every mapping of the daemon is a real mmap() of real pages 
+ * as with /dev/barracuda.
+ *
+ * @param pool_bytes	: size of the shared memory pool
+ *
+ * @returns	 EXIT_SUCCESS or EXIT_FAILURE
+ */
+
+HOST int loopback_init(size_t pool_bytes);
+
+
+
+/**
+ * Destroys the stand-in, the daemon must have terminated.
+ *
+ * @returns	 void
+ */
+
+HOST void loopback_release(void);
+
+
+
+/**
+ * Returns the calls of the daemon towards the stand-in, userspace_driver_main
+ * uses these if thread_container.loopback is set.
+ *
+ * @returns	 kernel_ops * : calls of the stand-in
+ */
+
+HOST kernel_ops *loopback_kernel_ops(void);
+
+
+
+/**
+ * Allocates a page aligned buffer from the shared pool. Only buffers of the 
+ * pool can be submitted, they are never freed before loopback_release().
+ *
+ * @param bytes		: size of the buffer
+ *
+ * @returns	 void * : the buffer or NULL if the pool is exhausted
+ */
+
+HOST void *loopback_alloc(size_t bytes);
+
+
+
+/**
+ * The kernel side of a request, this is what md calls on raid6_cuda_gen_syndrome.
+ * The caller blocks until the daemon has computed the syndromes. Until the 
+ * daemon has configured a connection the call waits.
+ *
+ * @param disks		: number of disks, the last two are P and Q
+ * @param bytes		: bytes per disk
+ * @param **ptrs	: disks, allocated with loopback_alloc()
+ *
+ * @returns	 0 on success, -1 if the stand-in was stopped or a disk is not 
+ *			 part of the pool
+ */
+
+HOST int loopback_gen_syndrome(int disks, size_t bytes, void **ptrs);
+
+
+
+/**
+ * loopback_gen_syndrome() of a stripe of a priority class, as the kernel stub
+ * offers it with raid6_cuda_gen_syndrome_prio(). The stripe waits for its 
+ * admission by the scheduler first. A stripe above the slice= size of the
+ * daemon is admitted and served slice by slice.
+ *
+ * @param disks		: number of disks, the last two are P and Q
+ * @param bytes		: bytes per disk
+ * @param **ptrs	: disks, allocated with loopback_alloc()
+ * @param prio		: PRIO_FOREGROUND, PRIO_RECOVERY or PRIO_BACKGROUND
+ *
+ * @returns	 0 on success, -1 on error
+ */
+
+HOST int loopback_gen_syndrome_prio(int disks, size_t bytes, void **ptrs, int prio);
+
+
+
+/**
+ * The kernel side of an operation besides OP_GEN, see barracuda_op() of the 
+ * kernel stub. The disks are always mapped one by one, large operations are
+ * sliced like in loopback_gen_syndrome_prio().
+ *
+ * @param array		: array of the operation, 0 unless the daemon has more
+ * @param opcode	: one of the OP_* codes
+ * @param prio		: priority class
+ * @param disks		: number of disks
+ * @param bytes		: bytes per disk
+ * @param start		: first data disk of OP_XOR_UPDATE
+ * @param stop		: last data disk of OP_XOR_UPDATE
+ * @param nfailed	: number of failed disks
+ * @param *failed	: the failed disks
+ * @param flags		: DESC_FLAG_*
+ * @param **ptrs	: disks, allocated with loopback_alloc()
+ *
+ * @returns	 the result of the daemon, -EOPNOTSUPP if it doesn't speak 
+ *			 descriptors or -1 on error
+ */
+
+HOST int loopback_submit_op(unsigned int array, unsigned int opcode, int prio, int disks, size_t bytes, 
+							int start, int stop, int nfailed, int *failed, unsigned int flags, void **ptrs);
+
+
+
+/**
+ * Wakes up every blocked call of the daemon and lets it fail, the daemon 
+ * terminates if userspace_driver_stop() was called before.
+ *
+ * @returns	 void
+ */
+
+HOST void loopback_stop(void);
+
+
+
+/**
+ * Returns the counters of the stand-in.
+ *
+ * @param *stats	: counters
+ *
+ * @returns	 void
+ */
+
+HOST void loopback_get_stats(loopback_stats *stats);
+
+#endif
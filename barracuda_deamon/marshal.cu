@@ -0,0 +1,352 @@
+/**
+ * \file
+ * \brief	Runtime choice between mmap and copy marshalling and the buffers of the copy path
+ *
+ * @author	Dominic Eschweiler weiler@upb.de
+ *
+ * Status	: STABLE \n
+ * Date of creation : 18.10.2026
+ *
+ */
+
+
+/*****************************************************************
+ *
+ * Barracuda is a experimental microdriver extension to the 
+ * linux-kernel that is able to outsource common functions to
+ * the userspace. It was intensionally designed to accelerate
+ * CPU-intensive Tasks on a GPU.
+ *
+ * Copyright (C) 2009 Dominic Eschweiler
+ *
+ * This program is free software; you can redistribute it and/or 
+ * modify it under the terms of the GNU General Public License as 
+ * published by the Free Software Foundation; either only GPLv2 - 
+ * version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful, 
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of 
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the 
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public 
+ * License along with this program; 
+ * if not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <syslog.h>
+
+# include "marshal.h"
+
+/* weight of the newest sample in the average is 1/(1 << MARSHAL_AVG_SHIFT) */
+#define MARSHAL_AVG_SHIFT	3
+
+static const char *marshal_names[] = { "MAP", "COPY", "AUTO", "SG" };
+
+
+
+/**
+ * Size class of a request.
+ *
+ * @param bytes		: bytes per disk
+ *
+ * @returns	 int : class
+ */
+
+static int marshal_class_of(size_t bytes)
+{
+int c = 0;
+
+while( (c < MARSHAL_BUCKETS-1) && (bytes > (4096UL << c)) ){ c++; }
+
+return c;
+}
+
+
+
+/**
+ * Parses the name of a marshalling mode.
+ *
+ * @param *name		: MAP, COPY, AUTO or SG
+ *
+ * @returns	 int : the mode or -1
+ */
+
+HOST int marshal_parse(const char *name)
+{
+int i;
+
+for(i = MARSHAL_MAP; i <= MARSHAL_SG; i++){
+	if( strcmp(name, marshal_names[i]) == 0 ){ return i; }
+	}
+
+return -1;
+}
+
+
+
+/**
+ * Sets up the policy.
+ *
+ * @param *p		: policy
+ * @param mode		: MARSHAL_MAP, MARSHAL_COPY, MARSHAL_AUTO or MARSHAL_SG
+ *
+ * @returns	 void
+ */
+
+HOST void marshal_policy_init(marshal_policy *p, int mode)
+{
+memset(p, 0, sizeof(marshal_policy));
+p->mode = mode;
+pthread_mutex_init(&p->lock, NULL);
+
+syslog(LOG_NOTICE, "Marshalling is %s\n", marshal_names[mode]);
+}
+
+
+
+/**
+ * Releases the policy.
+ *
+ * @param *p		: policy
+ *
+ * @returns	 void
+ */
+
+HOST void marshal_policy_destroy(marshal_policy *p)
+{
+pthread_mutex_destroy(&p->lock);
+}
+
+
+
+/**
+ * Chooses the mode of a request.
+ *
+ * @param *p		: policy
+ * @param bytes		: bytes per disk
+ *
+ * @returns	 int : MARSHAL_MAP, MARSHAL_COPY or MARSHAL_SG
+ */
+
+HOST int marshal_choose(marshal_policy *p, size_t bytes)
+{
+marshal_class *mc;
+int best;
+unsigned long n;
+
+if(p->mode != MARSHAL_AUTO){ return p->mode; }
+
+mc = &p->classes[marshal_class_of(bytes)];
+
+pthread_mutex_lock(&p->lock);
+n = ++mc->requests;
+
+/* both modes are measured before the first decision */
+if(mc->samples[MARSHAL_MAP] < MARSHAL_WARMUP){ best = MARSHAL_MAP; }
+else if(mc->samples[MARSHAL_COPY] < MARSHAL_WARMUP){ best = MARSHAL_COPY; }
+else{
+	best = (mc->avg_ns[MARSHAL_COPY] < mc->avg_ns[MARSHAL_MAP]) ? MARSHAL_COPY : MARSHAL_MAP;
+	if( (n % MARSHAL_PROBE) == 0 ){ best = !best; }
+	}
+pthread_mutex_unlock(&p->lock);
+
+return best;
+}
+
+
+
+/**
+ * Records what the marshalling of a request cost, the fetch and the release
+ * together.
+ *
+ * @param *p		: policy
+ * @param mode		: MARSHAL_MAP or MARSHAL_COPY
+ * @param bytes		: bytes per disk
+ * @param ns		: nanoseconds
+ *
+ * @returns	 void
+ */
+
+HOST void marshal_record(marshal_policy *p, int mode, size_t bytes, unsigned long long ns)
+{
+marshal_class *mc = &p->classes[marshal_class_of(bytes)];
+
+/* only the modes AUTO chooses from are measured */
+if(mode > MARSHAL_COPY){ return; }
+
+pthread_mutex_lock(&p->lock);
+if(mc->samples[mode] == 0){ mc->avg_ns[mode] = ns; }
+else if(ns >= mc->avg_ns[mode]){ mc->avg_ns[mode] += (ns - mc->avg_ns[mode]) >> MARSHAL_AVG_SHIFT; }
+else{ mc->avg_ns[mode] -= (mc->avg_ns[mode] - ns) >> MARSHAL_AVG_SHIFT; }
+mc->samples[mode]++;
+pthread_mutex_unlock(&p->lock);
+}
+
+
+
+/**
+ * Writes the measured costs and the crossover to the syslog.
+ *
+ * @param *p		: policy
+ *
+ * @returns	 void
+ */
+
+HOST void marshal_report(marshal_policy *p)
+{
+marshal_class *mc;
+int crossover = -1;
+int c;
+
+pthread_mutex_lock(&p->lock);
+for(c=0; c < MARSHAL_BUCKETS; c++){
+	mc = &p->classes[c];
+	if( (mc->samples[MARSHAL_MAP] == 0) && (mc->samples[MARSHAL_COPY] == 0) ){ continue; }
+	
+	syslog(LOG_NOTICE, "marshalling up to %lu KB : map %.1f us (%lu), copy %.1f us (%lu)\n",
+			(4096UL << c) / 1024, 
+			mc->avg_ns[MARSHAL_MAP] / 1000.0, mc->samples[MARSHAL_MAP],
+			mc->avg_ns[MARSHAL_COPY] / 1000.0, mc->samples[MARSHAL_COPY]);
+	
+	/* the first class from which on mapping is cheaper */
+	if( (crossover < 0) && mc->samples[MARSHAL_MAP] && mc->samples[MARSHAL_COPY] &&
+		(mc->avg_ns[MARSHAL_MAP] < mc->avg_ns[MARSHAL_COPY]) ){
+		crossover = c;
+		}
+	}
+pthread_mutex_unlock(&p->lock);
+
+if(p->mode != MARSHAL_AUTO){ return; }
+
+if(crossover < 0){ syslog(LOG_NOTICE, "marshalling crossover : copy was cheaper for all measured sizes\n"); }
+else{ syslog(LOG_NOTICE, "marshalling crossover : map above %lu KB\n", (4096UL << crossover) / 2048); }
+}
+
+
+
+/**
+ * Hands out a buffer for every disk of a request, the buffers are reused and
+ * only reallocated if the request is larger than all before.
+ *
+ * @param *pool		: pool
+ * @param disks		: number of disks
+ * @param bytes		: bytes per disk
+ * @param **ptrs	: the buffers are stored here
+ *
+ * @returns	 EXIT_SUCCESS or EXIT_FAILURE
+ */
+
+HOST int marshal_pool_get(marshal_pool *pool, int disks, size_t bytes, void **ptrs)
+{
+size_t page = getpagesize();
+int grow_disks = disks;
+int i;
+
+if( (disks <= pool->disks) && (bytes <= pool->bytes) ){
+	pool->reuses++;
+	}
+else{
+	/* grow to the larger of both dimensions, the old buffers are dropped */
+	if(grow_disks < pool->disks){ grow_disks = pool->disks; }
+	if(bytes < pool->bytes){ bytes = pool->bytes; }
+	bytes = (bytes + page - 1) & ~(page - 1);
+	
+	marshal_pool_release(pool);
+	
+	pool->bufs = (void **)calloc(grow_disks, sizeof(void *));
+	if(pool->bufs == NULL){ return EXIT_FAILURE; }
+	
+	for(i=0; i < grow_disks; i++){
+		if( posix_memalign(&pool->bufs[i], page, bytes) != 0 ){
+			pool->disks = i;
+			marshal_pool_release(pool);
+			return EXIT_FAILURE;
+			}
+		}
+	pool->disks = grow_disks;
+	pool->bytes = bytes;
+	pool->grows++;
+	}
+
+/* the caller gets the buffers of its own disks, ptrs may hold no more */
+memcpy(ptrs, pool->bufs, disks * sizeof(void *));
+return EXIT_SUCCESS;
+}
+
+
+
+/**
+ * Grows a pool to disks buffers of bytes before the first request and writes
+ * every page once, a request of this size doesn't allocate or fault anymore.
+ *
+ * @param *pool		: pool
+ * @param disks		: number of disks
+ * @param bytes		: bytes per disk
+ *
+ * @returns	 EXIT_SUCCESS or EXIT_FAILURE
+ */
+
+HOST int marshal_pool_reserve(marshal_pool *pool, int disks, size_t bytes)
+{
+void **ptrs;
+int i;
+
+ptrs = (void **)malloc(disks * sizeof(void *));
+if(ptrs == NULL){ return EXIT_FAILURE; }
+
+if( marshal_pool_get(pool, disks, bytes, ptrs) == EXIT_FAILURE ){
+	free(ptrs);
+	return EXIT_FAILURE;
+	}
+
+for(i=0; i < pool->disks; i++){ memset(pool->bufs[i], 0, pool->bytes); }
+
+free(ptrs);
+return EXIT_SUCCESS;
+}
+
+
+
+/**
+ * Frees all buffers of a pool.
+ *
+ * @param *pool		: pool
+ *
+ * @returns	 void
+ */
+
+HOST void marshal_pool_release(marshal_pool *pool)
+{
+int i;
+
+if(pool->bufs != NULL){
+	for(i=0; i < pool->disks; i++){ free(pool->bufs[i]); }
+	free(pool->bufs);
+	}
+
+pool->bufs	= NULL;
+pool->disks = 0;
+pool->bytes = 0;
+}
+
+
+
+/**
+ * Monotonic time in nanoseconds.
+ *
+ * @returns	 unsigned long long : nanoseconds
+ */
+
+HOST unsigned long long marshal_clock_ns(void)
+{
+struct timespec ts;
+
+clock_gettime(CLOCK_MONOTONIC, &ts);
+return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
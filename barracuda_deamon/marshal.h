@@ -0,0 +1,234 @@
+/**
+ * \file
+ * \brief	Runtime choice between mmap and copy marshalling and the buffers of the copy path
+ *
+ * @author	Dominic Eschweiler weiler@upb.de
+ *
+ * Status	: STABLE \n
+ * Date of creation : 18.10.2026
+ *
+ */
+
+
+/*****************************************************************
+ *
+ * Barracuda is a experimental microdriver extension to the 
+ * linux-kernel that is able to outsource common functions to
+ * the userspace. It was intensionally designed to accelerate
+ * CPU-intensive Tasks on a GPU.
+ *
+ * Copyright (C) 2009 Dominic Eschweiler
+ *
+ * This program is free software; you can redistribute it and/or 
+ * modify it under the terms of the GNU General Public License as 
+ * published by the Free Software Foundation; either only GPLv2 - 
+ * version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful, 
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of 
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the 
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public 
+ * License along with this program; 
+ * if not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************/
+
+#ifndef __MARSHAL__
+#define __MARSHAL__
+
+# include <stddef.h>
+# include <pthread.h>
+# include "definitions.h"
+
+/* __Marshalling Modes__
+ * MAP maps every disk of a request, COPY copies the data disks into buffers
+ * of the daemon and the checksums back. AUTO measures both per size class and
+ * takes the cheaper one. SG maps the pages of all disks with one window and
+ * walks the segment lists of the kernel, it is never chosen by AUTO.
+ */
+#define MARSHAL_MAP		0
+#define MARSHAL_COPY	1
+#define MARSHAL_AUTO	2
+#define MARSHAL_SG		3
+
+/*! \def MARSHAL_BUCKETS
+	\brief Size classes of the automatic policy, class b holds requests of up 
+	to 4 KB << b bytes per disk, the last one everything above */
+
+#define MARSHAL_BUCKETS		16
+
+/*! \def MARSHAL_WARMUP
+	\brief Requests every mode gets in a size class before the policy decides */
+
+#define MARSHAL_WARMUP		8
+
+/*! \def MARSHAL_PROBE
+	\brief Every MARSHAL_PROBE-th request of a size class takes the other mode,
+	so the policy follows when the crossover moves */
+
+#define MARSHAL_PROBE		64
+
+/*! \var typedef struct marshal_class;
+	\brief Measured costs of both modes for one size class */
+
+typedef struct marshal_class{
+	unsigned long long avg_ns[2];
+	unsigned long samples[2];
+	unsigned long requests;
+	}marshal_class;
+
+/*! \var typedef struct marshal_policy;
+	\brief The marshalling mode of the daemon, shared by all server threads */
+
+typedef struct marshal_policy{
+	int mode;
+	marshal_class classes[MARSHAL_BUCKETS];
+	pthread_mutex_t lock;
+	}marshal_policy;
+
+/*! \var typedef struct marshal_pool;
+	\brief Page aligned disk buffers of the copy path. They are kept from one
+	request to the next and only grow, one pool belongs to one driver context */
+
+typedef struct marshal_pool{
+	void **bufs;
+	int disks;
+	size_t bytes;
+	unsigned long reuses;
+	unsigned long grows;
+	}marshal_pool;
+
+
+
+/**
+ * Parses the name of a marshalling mode.
+ *
+ * @param *name		: MAP, COPY, AUTO or SG
+ *
+ * @returns	 int : the mode or -1
+ */
+
+HOST int marshal_parse(const char *name);
+
+
+
+/**
+ * Sets up the policy.
+ *
+ * @param *p		: policy
+ * @param mode		: MARSHAL_MAP, MARSHAL_COPY, MARSHAL_AUTO or MARSHAL_SG
+ *
+ * @returns	 void
+ */
+
+HOST void marshal_policy_init(marshal_policy *p, int mode);
+
+
+
+/**
+ * Releases the policy.
+ *
+ * @param *p		: policy
+ *
+ * @returns	 void
+ */
+
+HOST void marshal_policy_destroy(marshal_policy *p);
+
+
+
+/**
+ * Chooses the mode of a request.
+ *
+ * @param *p		: policy
+ * @param bytes		: bytes per disk
+ *
+ * @returns	 int : MARSHAL_MAP, MARSHAL_COPY or MARSHAL_SG
+ */
+
+HOST int marshal_choose(marshal_policy *p, size_t bytes);
+
+
+
+/**
+ * Records what the marshalling of a request cost, the fetch and the release
+ * together.
+ *
+ * @param *p		: policy
+ * @param mode		: MARSHAL_MAP or MARSHAL_COPY
+ * @param bytes		: bytes per disk
+ * @param ns		: nanoseconds
+ *
+ * @returns	 void
+ */
+
+HOST void marshal_record(marshal_policy *p, int mode, size_t bytes, unsigned long long ns);
+
+
+
+/**
+ * Writes the measured costs and the crossover to the syslog.
+ *
+ * @param *p		: policy
+ *
+ * @returns	 void
+ */
+
+HOST void marshal_report(marshal_policy *p);
+
+
+
+/**
+ * Hands out a buffer for every disk of a request, the buffers are reused and
+ * only reallocated if the request is larger than all before.
+ *
+ * @param *pool		: pool
+ * @param disks		: number of disks
+ * @param bytes		: bytes per disk
+ * @param **ptrs	: the buffers are stored here
+ *
+ * @returns	 EXIT_SUCCESS or EXIT_FAILURE
+ */
+
+HOST int marshal_pool_get(marshal_pool *pool, int disks, size_t bytes, void **ptrs);
+
+
+
+/**
+ * Grows a pool to disks buffers of bytes before the first request and writes
+ * every page once, a request of this size doesn't allocate or fault anymore.
+ *
+ * @param *pool		: pool
+ * @param disks		: number of disks
+ * @param bytes		: bytes per disk
+ *
+ * @returns	 EXIT_SUCCESS or EXIT_FAILURE
+ */
+
+HOST int marshal_pool_reserve(marshal_pool *pool, int disks, size_t bytes);
+
+
+
+/**
+ * Frees all buffers of a pool.
+ *
+ * @param *pool		: pool
+ *
+ * @returns	 void
+ */
+
+HOST void marshal_pool_release(marshal_pool *pool);
+
+
+
+/**
+ * Monotonic time in nanoseconds.
+ *
+ * @returns	 unsigned long long : nanoseconds
+ */
+
+HOST unsigned long long marshal_clock_ns(void);
+
+#endif
@@ -0,0 +1,180 @@
+/**
+ * \file
+ * \brief	Locked and prefaulted memory of the daemon, page faults per request
+ *
+ * @author	Dominic Eschweiler weiler@upb.de
+ *
+ * Status	: STABLE \n
+ * Date of creation : 18.10.2026
+ *
+ */
+
+
+/*****************************************************************
+ *
+ * Barracuda is a experimental microdriver extension to the 
+ * linux-kernel that is able to outsource common functions to
+ * the userspace. It was intensionally designed to accelerate
+ * CPU-intensive Tasks on a GPU.
+ *
+ * Copyright (C) 2009 Dominic Eschweiler
+ *
+ * This program is free software; you can redistribute it and/or 
+ * modify it under the terms of the GNU General Public License as 
+ * published by the Free Software Foundation; either only GPLv2 - 
+ * version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful, 
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of 
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the 
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public 
+ * License along with this program; 
+ * if not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <syslog.h>
+
+#include <sys/mman.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+# include "memlock.h"
+
+/* __Thread Counters__
+ * RUSAGE_THREAD needs _GNU_SOURCE, without it the faults of the whole process
+ * are taken, which is the same for a daemon with a single server thread.
+ */
+#ifdef RUSAGE_THREAD
+	#define FAULT_WHO	RUSAGE_THREAD
+#else
+	#define FAULT_WHO	RUSAGE_SELF
+#endif
+
+/* set by memlock_start(), the mappings of the kernel stub are prefaulted */
+static int memlock_populate = 0;
+
+
+
+/**
+ * Locks all present and future pages of the daemon and lets dev_mmap() 
+ * prefault its mappings. If the lock is refused, e.g. by RLIMIT_MEMLOCK, the 
+ * mappings are still prefaulted.
+ *
+ * @returns	 EXIT_SUCCESS or EXIT_FAILURE if the pages are not locked
+ */
+
+HOST int memlock_start(void)
+{
+memlock_populate = 1;
+
+if( mlockall(MCL_CURRENT | MCL_FUTURE) != 0 ){
+	syslog(LOG_NOTICE, "Can't lock the daemon in memory (%s), the mappings are only prefaulted\n", 
+			strerror(errno));
+	return EXIT_FAILURE;
+	}
+
+syslog(LOG_NOTICE, "Daemon memory locked, the mappings are prefaulted\n");
+return EXIT_SUCCESS;
+}
+
+
+
+/**
+ * Flags a mapping of the kernel stub is created with in addition to 
+ * MAP_SHARED.
+ *
+ * @returns	 int : MAP_POPULATE after memlock_start(), otherwise 0
+ */
+
+HOST int memlock_map_flags(void)
+{
+return memlock_populate ? MAP_POPULATE : 0;
+}
+
+
+
+/**
+ * Takes the current fault counters of the calling thread.
+ *
+ * @param *mark		: the counters are stored here
+ *
+ * @returns	 void
+ */
+
+HOST void fault_mark(fault_sample *mark)
+{
+struct rusage ru;
+
+getrusage(FAULT_WHO, &ru);
+mark->minflt = ru.ru_minflt;
+mark->majflt = ru.ru_majflt;
+}
+
+
+
+/**
+ * Adds the faults the calling thread took since a mark to a sample.
+ *
+ * @param *mark		: taken by fault_mark() on the same thread
+ * @param *sum		: sample of the request
+ *
+ * @returns	 void
+ */
+
+HOST void fault_since(fault_sample *mark, fault_sample *sum)
+{
+fault_sample now;
+
+fault_mark(&now);
+sum->minflt += now.minflt - mark->minflt;
+sum->majflt += now.majflt - mark->majflt;
+}
+
+
+
+/**
+ * Accounts the faults of requests which were served together.
+ *
+ * @param *fc		: counter of the server loop
+ * @param *sum		: faults of the requests
+ * @param requests	: number of requests
+ *
+ * @returns	 void
+ */
+
+HOST void fault_record(fault_counter *fc, fault_sample *sum, unsigned long requests)
+{
+fc->requests += requests;
+fc->minflt	 += sum->minflt;
+fc->majflt	 += sum->majflt;
+
+if( (sum->minflt > 0) || (sum->majflt > 0) ){ fc->faulted += requests; }
+if(sum->minflt > fc->max_minflt){ fc->max_minflt = sum->minflt; }
+if(sum->majflt > fc->max_majflt){ fc->max_majflt = sum->majflt; }
+}
+
+
+
+/**
+ * Writes the faults per request to the syslog.
+ *
+ * @param *fc		: counter of the server loop
+ * @param *name		: the server loop
+ *
+ * @returns	 void
+ */
+
+HOST void fault_report(fault_counter *fc, const char *name)
+{
+if(fc->requests == 0){ return; }
+
+syslog(LOG_NOTICE, "%s page faults : %.2f minor and %.2f major per request, at most %ld and %ld, %lu of %lu requests faulted\n",
+		name, (double)fc->minflt / fc->requests, (double)fc->majflt / fc->requests,
+		fc->max_minflt, fc->max_majflt, fc->faulted, fc->requests);
+}
@@ -0,0 +1,139 @@
+/**
+ * \file
+ * \brief	Locked and prefaulted memory of the daemon, page faults per request
+ *
+ * @author	Dominic Eschweiler weiler@upb.de
+ *
+ * Status	: STABLE \n
+ * Date of creation : 18.10.2026
+ *
+ */
+
+
+/*****************************************************************
+ *
+ * Barracuda is a experimental microdriver extension to the 
+ * linux-kernel that is able to outsource common functions to
+ * the userspace. It was intensionally designed to accelerate
+ * CPU-intensive Tasks on a GPU.
+ *
+ * Copyright (C) 2009 Dominic Eschweiler
+ *
+ * This program is free software; you can redistribute it and/or 
+ * modify it under the terms of the GNU General Public License as 
+ * published by the Free Software Foundation; either only GPLv2 - 
+ * version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful, 
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of 
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the 
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public 
+ * License along with this program; 
+ * if not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************/
+
+#ifndef __MEMLOCK__
+#define __MEMLOCK__
+
+# include "definitions.h"
+
+/*! \var typedef struct fault_sample;
+	\brief Page faults the calling thread took, a mark or the sum of a request */
+
+typedef struct fault_sample{
+	long minflt;
+	long majflt;
+	}fault_sample;
+
+/*! \var typedef struct fault_counter;
+	\brief Page faults of the requests of one server loop, faulted counts the 
+	requests which took any */
+
+typedef struct fault_counter{
+	unsigned long requests;
+	unsigned long faulted;
+	unsigned long long minflt;
+	unsigned long long majflt;
+	long max_minflt;
+	long max_majflt;
+	}fault_counter;
+
+
+
+/**
+ * Locks all present and future pages of the daemon and lets dev_mmap() 
+ * prefault its mappings. If the lock is refused, e.g. by RLIMIT_MEMLOCK, the 
+ * mappings are still prefaulted.
+ *
+ * @returns	 EXIT_SUCCESS or EXIT_FAILURE if the pages are not locked
+ */
+
+HOST int memlock_start(void);
+
+
+
+/**
+ * Flags a mapping of the kernel stub is created with in addition to 
+ * MAP_SHARED.
+ *
+ * @returns	 int : MAP_POPULATE after memlock_start(), otherwise 0
+ */
+
+HOST int memlock_map_flags(void);
+
+
+
+/**
+ * Takes the current fault counters of the calling thread.
+ *
+ * @param *mark		: the counters are stored here
+ *
+ * @returns	 void
+ */
+
+HOST void fault_mark(fault_sample *mark);
+
+
+
+/**
+ * Adds the faults the calling thread took since a mark to a sample.
+ *
+ * @param *mark		: taken by fault_mark() on the same thread
+ * @param *sum		: sample of the request
+ *
+ * @returns	 void
+ */
+
+HOST void fault_since(fault_sample *mark, fault_sample *sum);
+
+
+
+/**
+ * Accounts the faults of requests which were served together.
+ *
+ * @param *fc		: counter of the server loop
+ * @param *sum		: faults of the requests
+ * @param requests	: number of requests
+ *
+ * @returns	 void
+ */
+
+HOST void fault_record(fault_counter *fc, fault_sample *sum, unsigned long requests);
+
+
+
+/**
+ * Writes the faults per request to the syslog.
+ *
+ * @param *fc		: counter of the server loop
+ * @param *name		: the server loop
+ *
+ * @returns	 void
+ */
+
+HOST void fault_report(fault_counter *fc, const char *name);
+
+#endif
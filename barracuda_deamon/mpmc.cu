@@ -0,0 +1,218 @@
+/**
+ * \file
+ * \brief	Bounded lock-free multi-producer/multi-consumer request queue
+ *
+ * @author	Dominic Eschweiler weiler@upb.de
+ *
+ * Status	: STABLE \n
+ * Date of creation : 18.10.2026
+ *
+ */
+
+
+/*****************************************************************
+ *
+ * Barracuda is a experimental microdriver extension to the 
+ * linux-kernel that is able to outsource common functions to
+ * the userspace. It was intensionally designed to accelerate
+ * CPU-intensive Tasks on a GPU.
+ *
+ * Copyright (C) 2009 Dominic Eschweiler
+ *
+ * This program is free software; you can redistribute it and/or 
+ * modify it under the terms of the GNU General Public License as 
+ * published by the Free Software Foundation; either only GPLv2 - 
+ * version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful, 
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of 
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the 
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public 
+ * License along with this program; 
+ * if not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+# include "mpmc.h"
+
+/**
+ * Allocates a queue. The size is rounded up to the next power of two.
+ *
+ * @param *q		: queue
+ * @param size		: number of slots
+ *
+ * @returns	 EXIT_SUCCESS or EXIT_FAILURE if the ring can't be allocated
+ */
+
+HOST int mpmc_init(mpmc_queue *q, size_t size)
+{
+size_t i;
+size_t slots = 2;
+
+while(slots < size){ slots = slots << 1; }
+
+memset(q, 0, sizeof(mpmc_queue));
+
+q->buffer = (mpmc_cell *)malloc(slots * sizeof(mpmc_cell));
+if(q->buffer == NULL){ return EXIT_FAILURE; }
+
+/* slot i is free for the producer which holds position i */
+for(i=0; i<slots; i++){
+	q->buffer[i].sequence = i;
+	q->buffer[i].data     = NULL;
+	}
+
+q->mask = slots - 1;
+
+return EXIT_SUCCESS;
+}
+
+
+
+/**
+ * Frees the ring of a queue.
+ *
+ * @param *q		: queue
+ *
+ * @returns	 void
+ */
+
+HOST void mpmc_destroy(mpmc_queue *q)
+{
+free(q->buffer);
+q->buffer = NULL;
+}
+
+
+
+/**
+ * Appends an element without blocking. A producer claims a position with a 
+ * single compare and swap and publishes the element by advancing the sequence
+ * number of its slot.
+ *
+ * @param *q		: queue
+ * @param *data		: element
+ *
+ * @returns	 EXIT_SUCCESS or EXIT_FAILURE if the queue is full
+ */
+
+HOST int mpmc_enqueue(mpmc_queue *q, void *data)
+{
+mpmc_cell *cell;
+size_t pos = q->enqueue_pos;
+size_t seq;
+size_t depth;
+size_t high;
+long diff;
+
+for(;;){
+	cell = &q->buffer[pos & q->mask];
+	seq  = cell->sequence;
+	__sync_synchronize();
+	diff = (long)seq - (long)pos;
+	
+	if(diff == 0){
+		/* the slot is free, try to claim the position */
+		if( __sync_bool_compare_and_swap(&q->enqueue_pos, pos, pos+1) ){ break; }
+		pos = q->enqueue_pos;
+		}
+	else if(diff < 0){
+		/* the slot still holds the element of the last round */
+		__sync_fetch_and_add(&q->enqueue_failures, 1);
+		return EXIT_FAILURE;
+		}
+	else{
+		pos = q->enqueue_pos;
+		}
+	}
+
+cell->data = data;
+__sync_synchronize();
+cell->sequence = pos + 1;
+
+/* the high-water mark is only a hint, a lost update is corrected later */
+depth = pos + 1 - q->dequeue_pos;
+high  = q->high_water;
+while( (depth > high) && (depth <= q->mask+1) ){
+	if( __sync_bool_compare_and_swap(&q->high_water, high, depth) ){ break; }
+	high = q->high_water;
+	}
+
+return EXIT_SUCCESS;
+}
+
+
+
+/**
+ * Takes the oldest element without blocking.
+ *
+ * @param *q		: queue
+ * @param **data	: the element is stored here
+ *
+ * @returns	 EXIT_SUCCESS or EXIT_FAILURE if the queue is empty
+ */
+
+HOST int mpmc_dequeue(mpmc_queue *q, void **data)
+{
+mpmc_cell *cell;
+size_t pos = q->dequeue_pos;
+size_t seq;
+long diff;
+
+for(;;){
+	cell = &q->buffer[pos & q->mask];
+	seq  = cell->sequence;
+	__sync_synchronize();
+	diff = (long)seq - (long)(pos+1);
+	
+	if(diff == 0){
+		/* the slot is published, try to claim the position */
+		if( __sync_bool_compare_and_swap(&q->dequeue_pos, pos, pos+1) ){ break; }
+		pos = q->dequeue_pos;
+		}
+	else if(diff < 0){
+		/* nothing published yet */
+		return EXIT_FAILURE;
+		}
+	else{
+		pos = q->dequeue_pos;
+		}
+	}
+
+*data = cell->data;
+__sync_synchronize();
+
+/* hand the slot to the producer of the next round */
+cell->sequence = pos + q->mask + 1;
+
+return EXIT_SUCCESS;
+}
+
+
+
+/**
+ * Reads the counters of a queue.
+ *
+ * @param *q		: queue
+ * @param *stats	: the counters are stored here
+ *
+ * @returns	 void
+ */
+
+HOST void mpmc_get_stats(mpmc_queue *q, mpmc_stats *stats)
+{
+size_t enq = q->enqueue_pos;
+size_t deq = q->dequeue_pos;
+
+stats->enqueued			= enq;
+stats->dequeued			= deq;
+stats->depth			= (enq > deq) ? enq - deq : 0;
+stats->high_water		= q->high_water;
+stats->enqueue_failures	= q->enqueue_failures;
+}
@@ -0,0 +1,148 @@
+/**
+ * \file
+ * \brief	Bounded lock-free multi-producer/multi-consumer request queue
+ *
+ * @author	Dominic Eschweiler weiler@upb.de
+ *
+ * Status	: STABLE \n
+ * Date of creation : 18.10.2026
+ *
+ */
+
+
+/*****************************************************************
+ *
+ * Barracuda is a experimental microdriver extension to the 
+ * linux-kernel that is able to outsource common functions to
+ * the userspace. It was intensionally designed to accelerate
+ * CPU-intensive Tasks on a GPU.
+ *
+ * Copyright (C) 2009 Dominic Eschweiler
+ *
+ * This program is free software; you can redistribute it and/or 
+ * modify it under the terms of the GNU General Public License as 
+ * published by the Free Software Foundation; either only GPLv2 - 
+ * version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful, 
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of 
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the 
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public 
+ * License along with this program; 
+ * if not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************/
+
+#ifndef __MPMC__
+#define __MPMC__
+
+# include "definitions.h"
+
+/*! \def MPMC_CACHELINE
+	\brief Padding which keeps the producer and the consumer index apart */
+
+#define MPMC_CACHELINE 64
+
+/*! \var typedef struct mpmc_cell;
+	\brief One slot of the ring with its sequence number */
+
+typedef struct mpmc_cell{
+	volatile size_t sequence;
+	void *data;
+	}mpmc_cell;
+
+/*! \var typedef struct mpmc_queue;
+	\brief Bounded ring after D. Vyukov, producers and consumers only meet on 
+	the sequence number of a slot */
+
+typedef struct mpmc_queue{
+	mpmc_cell *buffer;
+	size_t mask;
+	char pad0[MPMC_CACHELINE];
+	volatile size_t enqueue_pos;
+	volatile size_t high_water;
+	char pad1[MPMC_CACHELINE];
+	volatile size_t dequeue_pos;
+	char pad2[MPMC_CACHELINE];
+	volatile unsigned long enqueue_failures;
+	}mpmc_queue;
+
+/*! \var typedef struct mpmc_stats;
+	\brief Snapshot of the queue counters */
+
+typedef struct mpmc_stats{
+	size_t depth;
+	size_t high_water;
+	unsigned long enqueued;
+	unsigned long dequeued;
+	unsigned long enqueue_failures;
+	}mpmc_stats;
+
+
+
+/**
+ * Allocates a queue. The size is rounded up to the next power of two.
+ *
+ * @param *q		: queue
+ * @param size		: number of slots
+ *
+ * @returns	 EXIT_SUCCESS or EXIT_FAILURE if the ring can't be allocated
+ */
+
+HOST int mpmc_init(mpmc_queue *q, size_t size);
+
+
+
+/**
+ * Frees the ring of a queue.
+ *
+ * @param *q		: queue
+ *
+ * @returns	 void
+ */
+
+HOST void mpmc_destroy(mpmc_queue *q);
+
+
+
+/**
+ * Appends an element without blocking.
+ *
+ * @param *q		: queue
+ * @param *data		: element
+ *
+ * @returns	 EXIT_SUCCESS or EXIT_FAILURE if the queue is full
+ */
+
+HOST int mpmc_enqueue(mpmc_queue *q, void *data);
+
+
+
+/**
+ * Takes the oldest element without blocking.
+ *
+ * @param *q		: queue
+ * @param **data	: the element is stored here
+ *
+ * @returns	 EXIT_SUCCESS or EXIT_FAILURE if the queue is empty
+ */
+
+HOST int mpmc_dequeue(mpmc_queue *q, void **data);
+
+
+
+/**
+ * Reads the counters of a queue. The values are not taken atomically as a
+ * whole, they are meant for monitoring.
+ *
+ * @param *q		: queue
+ * @param *stats	: the counters are stored here
+ *
+ * @returns	 void
+ */
+
+HOST void mpmc_get_stats(mpmc_queue *q, mpmc_stats *stats);
+
+#endif
@@ -66,7 +66,6 @@ inline unsigned char mult_gf(unsigned char a, unsigned char b);
 extern void multi_rs_cuda_gen_syndrome(int disks, size_t bytes, void **ptrs);
 __global__ void rs_kernel( unsigned char *DEVICE_DP, unsigned char *DEVICE_PQ, int disks);
 __device__ inline unsigned char mult_gf_shader(unsigned char a, unsigned char b, unsigned char gflog[], unsigned char gfilog[]);
-static void inline get_card_mem(void);
 extern void release_cuda_memory(void);
 #endif
 
@@ -100,7 +99,7 @@ static unsigned char gflog[] = {
 118, 196, 23, 73, 236, 127, 12, 111, 246, 108, 161, 59, 82, 41, 157, 85, 170, 251,
 96, 134, 177, 187, 204, 62, 90, 203, 89, 95, 176, 156, 169, 160, 81, 11, 245, 22,
 235, 122, 117, 44, 215, 79, 174, 213, 233, 230, 231, 173, 232, 116, 214, 244, 234,
-168, 80, 88};
+168, 80, 88, 175};
 
 static unsigned char gfilog[] = {
 1, 2, 4, 8, 16, 32, 64, 128, 29, 58, 116, 232, 205, 135, 19, 38, 76, 152, 45, 90,
@@ -221,7 +220,7 @@ for(i=0; i<bytes; i++){
 
 inline unsigned char mult_gf(unsigned char a, unsigned char b)
 {
-unsigned char sum;
+unsigned int sum;
 int w = 8;
 	
 if(a==0 || b==0){return 0;}
@@ -243,8 +242,14 @@ return gfilog[sum];
 
 #ifndef NOCUDA
 
-static unsigned char *DEVICE_DP;
-static unsigned char *DEVICE_CS;
+/* device buffers of one worker, a CUDA context belongs to one host thread */
+struct multi_rs_scratch{
+	unsigned char *DEVICE_DP;
+	unsigned char *DEVICE_CS;
+	};
+
+/* context of the legacy multi_rs_gen_syndrome() entry point */
+static syndrome_context default_context;
 static int mem_tag = 0;
 
 /**
@@ -261,6 +266,33 @@ static int mem_tag = 0;
 
 extern void multi_rs_cuda_gen_syndrome(int disks, size_t bytes, void **ptrs)
 {
+if(mem_tag == 0){
+	if( multi_rs_context_init(&default_context) == EXIT_FAILURE ){
+		printf("Device allocation failed!\n");
+		exit(1);
+		}
+	mem_tag = 1;
+	}
+
+multi_rs_gen_syndrome_ctx(&default_context, disks, bytes, ptrs);
+}
+
+
+
+/**
+ * Context version of the multi failure correcting gen_syndrome. Calls with 
+ * different contexts can run concurrently.
+ *
+ * @param *ctx		: context of the calling worker
+ * @param disks		: # of disks
+ * @param bytes		: # number of bytes
+ * @param **ptrs	: processing data
+ *
+ * @returns			void
+ */
+
+extern void multi_rs_gen_syndrome_ctx(syndrome_context *ctx, int disks, size_t bytes, void **ptrs)
+{
 int i, j;
 dim3 dimBlock;
 dim3 dimGrid;
@@ -268,8 +300,10 @@ dim3 dimGrid;
 unsigned char **dptrs = (unsigned char **)ptrs;
 unsigned long runs  = floor(bytes/DMA_BLOCKSIZE);
 unsigned long carry = bytes - (runs * DMA_BLOCKSIZE);
-	
-get_card_mem();
+
+struct multi_rs_scratch *s = (struct multi_rs_scratch *)ctx->scratch;
+unsigned char *DEVICE_DP = s->DEVICE_DP;
+unsigned char *DEVICE_CS = s->DEVICE_CS;
 	
 #ifdef DEBUG_MULT_RS
 printf("block_x : %d, dimgrid_x : %d, runs : %d\n", dimBlock.x, dimGrid.x, runs);
@@ -537,7 +571,7 @@ k_gflog[236] = 122; k_gflog[237] = 117; k_gflog[238] = 44;  k_gflog[239] = 215;
 k_gflog[240] = 79;  k_gflog[241] = 174; k_gflog[242] = 213; k_gflog[243] = 233; 
 k_gflog[244] = 230; k_gflog[245] = 231; k_gflog[246] = 173; k_gflog[247] = 232; 
 k_gflog[248] = 116; k_gflog[249] = 214; k_gflog[250] = 244; k_gflog[251] = 234; 
-k_gflog[252] = 168; k_gflog[253] = 80;  k_gflog[254] = 88;
+k_gflog[252] = 168; k_gflog[253] = 80;  k_gflog[254] = 88;  k_gflog[255] = 175;
 
 // inverse logarithm
 k_gfilog[224] = 18; k_gfilog[225] = 36; k_gfilog[226] = 72; k_gfilog[227] = 144;
@@ -610,7 +644,7 @@ for(j=1; j<=CHECK_SYMBOLS; j++){
 
 __device__ inline unsigned char mult_gf_shader(unsigned char a, unsigned char b, unsigned char gflog[], unsigned char gfilog[])
 {
-unsigned char sum;
+unsigned int sum;
 int w = 8;
 	
 if(a==0 || b==0){return 0;}
@@ -625,32 +659,61 @@ return gfilog[sum];
 
 
 /**
- * Get cards buffer
+ * Allocates the device buffers of one context. This must be called by the 
+ * thread which uses the context.
  *
- * @returns			void
+ * @param *ctx		: context to initialise
+ *
+ * @returns			EXIT_SUCCESS or EXIT_FAILURE if the allocation failed
  */
 
-static void inline get_card_mem(void)
+extern int multi_rs_context_init(syndrome_context *ctx)
 {
+struct multi_rs_scratch *s;
 
-if(mem_tag == 0){
-	cudaMalloc((void **)&DEVICE_DP, DMA_BLOCKSIZE*256);
-	cudaMalloc((void **)&DEVICE_CS, DMA_BLOCKSIZE*256);
-	
-	cudaError_t error_t;
-	error_t = cudaGetLastError();
-	if( 0 != strcmp(cudaGetErrorString(error_t), "no error") ){
-		printf("Device allocation failed!\n");
-		exit(1);
-		}
-	
-	#ifdef DEBUG_LEVEL_8 
-	printf("getting device memory : %s\n", cudaGetErrorString(error_t) );
-	#endif
-	
-	mem_tag = 1;
+s = (struct multi_rs_scratch *)malloc(sizeof(struct multi_rs_scratch));
+if(s == NULL){ return EXIT_FAILURE; }
+
+cudaMalloc((void **)&s->DEVICE_DP, DMA_BLOCKSIZE*256);
+cudaMalloc((void **)&s->DEVICE_CS, DMA_BLOCKSIZE*256);
+ctx->scratch = s;
+
+cudaError_t error_t;
+error_t = cudaGetLastError();
+
+#ifdef DEBUG_LEVEL_8 
+printf("getting device memory : %s\n", cudaGetErrorString(error_t) );
+#endif
+
+if( error_t != cudaSuccess ){
+	multi_rs_context_release(ctx);
+	return EXIT_FAILURE;
 	}
 
+return EXIT_SUCCESS;
+}
+
+
+
+/**
+ * Frees the device buffers of one context.
+ *
+ * @param *ctx		: context to release
+ *
+ * @returns			void
+ */
+
+extern void multi_rs_context_release(syndrome_context *ctx)
+{
+struct multi_rs_scratch *s = (struct multi_rs_scratch *)ctx->scratch;
+
+if(s == NULL){ return; }
+
+cudaFree(s->DEVICE_DP);
+cudaFree(s->DEVICE_CS);
+
+free(s);
+ctx->scratch = NULL;
 }
 
 
@@ -663,8 +726,10 @@ if(mem_tag == 0){
 
 extern void release_cuda_memory(void)
 {
-cudaFree(DEVICE_DP);
-cudaFree(DEVICE_CS);
+if(mem_tag == 1){
+	multi_rs_context_release(&default_context);
+	mem_tag = 0;
+	}
 }
 
 #endif
@@ -51,4 +51,47 @@
 
 HOST void multi_rs_gen_syndrome(int disks, size_t bytes, void **ptrs);
 
+#ifndef NOCUDA
+
+/**
+ * Context version of the multi failure correcting gen_syndrome. Calls with 
+ * different contexts can run concurrently, but a context must only be used by
+ * the thread which initialised it.
+ *
+ * @param *ctx		: context of the calling worker
+ * @param disks		: # of disks
+ * @param bytes		: # number of bytes
+ * @param **ptrs	: processing data
+ *
+ * @returns			void
+ */
+
+extern void multi_rs_gen_syndrome_ctx(syndrome_context *ctx, int disks, size_t bytes, void **ptrs);
+
+
+
+/**
+ * Allocates the device buffers of one context.
+ *
+ * @param *ctx		: context to initialise
+ *
+ * @returns			EXIT_SUCCESS or EXIT_FAILURE if the allocation failed
+ */
+
+extern int multi_rs_context_init(syndrome_context *ctx);
+
+
+
+/**
+ * Frees the device buffers of one context.
+ *
+ * @param *ctx		: context to release
+ *
+ * @returns			void
+ */
+
+extern void multi_rs_context_release(syndrome_context *ctx);
+
+#endif
+
 #endif
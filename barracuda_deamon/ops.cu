@@ -0,0 +1,722 @@
+/**
+ * \file
+ * \brief	Operations of the request descriptor besides GEN: updates, recoveries, checks and the multi failure code
+ *
+ * @author	Dominic Eschweiler weiler@upb.de
+ *
+ * Status	: STABLE \n
+ * Date of creation : 18.10.2026
+ *
+ */
+
+
+/*****************************************************************
+ *
+ * Barracuda is a experimental microdriver extension to the 
+ * linux-kernel that is able to outsource common functions to
+ * the userspace. It was intensionally designed to accelerate
+ * CPU-intensive Tasks on a GPU.
+ *
+ * Copyright (C) 2009 Dominic Eschweiler
+ *
+ * This program is free software; you can redistribute it and/or 
+ * modify it under the terms of the GNU General Public License as 
+ * published by the Free Software Foundation; either only GPLv2 - 
+ * version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful, 
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of 
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the 
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public 
+ * License along with this program; 
+ * if not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+
+# include "ops.h"
+# include "backends.h"
+# include "multrs/raid6multrs.h"
+
+static const char *ops_names[] = { "GEN", "XOR_UPDATE", "RECOV_2DATA", "RECOV_DATAP", "CHECK", "MULTI_ENCODE", "MULTI_DECODE" };
+
+/* logarithms and powers of GF(2^8) with the raid6 polynomial 0x11d, the 
+ * powers are stored twice, so the sum of two logarithms needs no modulo */
+static u8 gf_log[256];
+static u8 gf_exp[510];
+static pthread_once_t gf_once = PTHREAD_ONCE_INIT;
+
+
+
+/**
+ * Fills the logarithm and power tables.
+ *
+ * @returns	 void
+ */
+
+static void gf_init(void)
+{
+unsigned int x = 1;
+int i;
+
+for(i=0; i < 255; i++){
+	gf_exp[i]		= (u8)x;
+	gf_exp[i+255]	= (u8)x;
+	gf_log[x]		= (u8)i;
+	
+	x <<= 1;
+	if(x & 0x100){ x ^= 0x11d; }
+	}
+}
+
+
+
+/**
+ * Multiplies two elements of GF(2^8).
+ *
+ * @param a		: first operand
+ * @param b		: second operand
+ *
+ * @returns	 u8 : the product
+ */
+
+static inline u8 gf_mul(u8 a, u8 b)
+{
+if( (a == 0) || (b == 0) ){ return 0; }
+
+return gf_exp[gf_log[a] + gf_log[b]];
+}
+
+
+
+/**
+ * Inverts an element of GF(2^8).
+ *
+ * @param a		: element, not 0
+ *
+ * @returns	 u8 : the inverse
+ */
+
+static inline u8 gf_inv(u8 a)
+{
+return gf_exp[255 - gf_log[a]];
+}
+
+
+
+/**
+ * Fills the multiplication table of a constant.
+ *
+ * @param c			: constant
+ * @param *table	: 256 products
+ *
+ * @returns	 void
+ */
+
+static void gf_mul_table(u8 c, u8 *table)
+{
+int x;
+
+for(x=0; x < 256; x++){ table[x] = gf_mul(c, (u8)x); }
+}
+
+
+
+/**
+ * Multiplies every byte of a word with the generator 2, see the vanilla
+ * gen_syndrome.
+ *
+ * @param v		: word
+ *
+ * @returns	 unative_t : the product
+ */
+
+static inline unative_t ops_mul2(unative_t v)
+{
+unative_t mask = v & NBYTES(0x80);
+
+mask = (mask << 1) - (mask >> 7);
+return ((v << 1) & NBYTES(0xfe)) ^ (mask & NBYTES(0x1d));
+}
+
+
+
+/**
+ * P and Q of the data disks at one word, the disks skipa and skipb count as 
+ * zero.
+ *
+ * @param **dptr	: disks
+ * @param z0		: highest data disk
+ * @param d			: byte offset of the word
+ * @param skipa		: disk which counts as zero or -1
+ * @param skipb		: disk which counts as zero or -1
+ * @param *wp		: P of the word
+ * @param *wq		: Q of the word
+ *
+ * @returns	 void
+ */
+
+static inline void ops_pq_word(u8 **dptr, int z0, size_t d, int skipa, int skipb, unative_t *wp, unative_t *wq)
+{
+unative_t p = 0;
+unative_t q = 0;
+unative_t wd;
+int z;
+
+for(z = z0; z >= 0; z--){
+	wd = ( (z == skipa) || (z == skipb) ) ? 0 : *(unative_t *)&dptr[z][d];
+	p ^= wd;
+	q  = ops_mul2(q) ^ wd;
+	}
+
+*wp = p;
+*wq = q;
+}
+
+
+
+/**
+ * XORs the P and Q share of the data disks start..stop into P and Q.
+ *
+ * @param *op		: the operation
+ * @param disks		: # of disks
+ * @param bytes		: # number of bytes
+ * @param **dptr	: processing data
+ *
+ * @returns	 int : 0
+ */
+
+static int ops_xor_update(request_op *op, int disks, size_t bytes, u8 **dptr)
+{
+u8 *p = dptr[disks-2];
+u8 *q = dptr[disks-1];
+unative_t wp;
+unative_t wq;
+unative_t wd;
+size_t d;
+int z;
+
+for(d = 0; d < bytes; d += NSIZE){
+	wq = wp = *(unative_t *)&dptr[op->stop][d];
+	for(z = op->stop-1; z >= op->start; z--){
+		wd  = *(unative_t *)&dptr[z][d];
+		wp ^= wd;
+		wq  = ops_mul2(wq) ^ wd;
+		}
+	
+	/* the disks below start only shift the share */
+	for(z = op->start-1; z >= 0; z--){ wq = ops_mul2(wq); }
+	
+	*(unative_t *)&p[d] ^= wp;
+	*(unative_t *)&q[d] ^= wq;
+	}
+
+return 0;
+}
+
+
+
+/**
+ * Compares P and Q with the data and rewrites them if DESC_FLAG_REPAIR is set.
+ *
+ * @param *op		: the operation
+ * @param disks		: # of disks
+ * @param bytes		: # number of bytes
+ * @param **dptr	: processing data
+ *
+ * @returns	 int : mask of DESC_CHECK_P and DESC_CHECK_Q
+ */
+
+static int ops_check(request_op *op, int disks, size_t bytes, u8 **dptr)
+{
+u8 *p = dptr[disks-2];
+u8 *q = dptr[disks-1];
+unative_t wp;
+unative_t wq;
+size_t d;
+int wrong = 0;
+
+for(d = 0; d < bytes; d += NSIZE){
+	ops_pq_word(dptr, disks-3, d, -1, -1, &wp, &wq);
+	
+	if(*(unative_t *)&p[d] != wp){
+		wrong |= DESC_CHECK_P;
+		if(op->flags & DESC_FLAG_REPAIR){ *(unative_t *)&p[d] = wp; }
+		}
+	if(*(unative_t *)&q[d] != wq){
+		wrong |= DESC_CHECK_Q;
+		if(op->flags & DESC_FLAG_REPAIR){ *(unative_t *)&q[d] = wq; }
+		}
+	}
+
+return wrong;
+}
+
+
+
+/**
+ * Rebuilds the data disks failed[0] < failed[1] from the others, P and Q. 
+ * With Pxy and Qxy as P and Q of the intact disks
+ *
+ *   Db = (Qxy + g^a Pxy) / (g^a + g^b),   Da = Pxy + Db
+ *
+ * @param *op		: the operation
+ * @param disks		: # of disks
+ * @param bytes		: # number of bytes
+ * @param **dptr	: processing data
+ *
+ * @returns	 int : 0
+ */
+
+static int ops_recov_2data(request_op *op, int disks, size_t bytes, u8 **dptr)
+{
+int a = op->failed[0];
+int b = op->failed[1];
+u8 tq[256];
+u8 tp[256];
+u8 denom = gf_inv( gf_exp[a] ^ gf_exp[b] );
+u8 pb[NSIZE];
+u8 qb[NSIZE];
+u8 db;
+unative_t wp;
+unative_t wq;
+size_t d;
+int j;
+
+gf_mul_table(denom, tq);
+gf_mul_table(gf_mul(gf_exp[a], denom), tp);
+
+for(d = 0; d < bytes; d += NSIZE){
+	ops_pq_word(dptr, disks-3, d, a, b, &wp, &wq);
+	wp ^= *(unative_t *)&dptr[disks-2][d];
+	wq ^= *(unative_t *)&dptr[disks-1][d];
+	memcpy(pb, &wp, NSIZE);
+	memcpy(qb, &wq, NSIZE);
+	
+	for(j=0; j < NSIZE; j++){
+		db = tq[qb[j]] ^ tp[pb[j]];
+		dptr[b][d+j] = db;
+		dptr[a][d+j] = pb[j] ^ db;
+		}
+	}
+
+return 0;
+}
+
+
+
+/**
+ * Rebuilds the data disk failed[0] from the others and Q, then P.
+ *
+ * @param *op		: the operation
+ * @param disks		: # of disks
+ * @param bytes		: # number of bytes
+ * @param **dptr	: processing data
+ *
+ * @returns	 int : 0
+ */
+
+static int ops_recov_datap(request_op *op, int disks, size_t bytes, u8 **dptr)
+{
+int a = op->failed[0];
+u8 ta[256];
+u8 qb[NSIZE];
+u8 *da;
+unative_t wp;
+unative_t wq;
+size_t d;
+int j;
+
+gf_mul_table(gf_inv(gf_exp[a]), ta);
+
+for(d = 0; d < bytes; d += NSIZE){
+	ops_pq_word(dptr, disks-3, d, a, -1, &wp, &wq);
+	wq ^= *(unative_t *)&dptr[disks-1][d];
+	memcpy(qb, &wq, NSIZE);
+	
+	da = &dptr[a][d];
+	for(j=0; j < NSIZE; j++){ da[j] = ta[qb[j]]; }
+	
+	*(unative_t *)&dptr[disks-2][d] = wp ^ *(unative_t *)da;
+	}
+
+return 0;
+}
+
+
+
+/**
+ * Inverts a matrix over GF(2^8) with Gauss-Jordan elimination.
+ *
+ * @param n			: rows and columns, at most DESC_MAX_FAILED
+ * @param m			: the matrix, gets destroyed
+ * @param inv		: the inverse is stored here
+ *
+ * @returns	 EXIT_SUCCESS or EXIT_FAILURE if the matrix is singular
+ */
+
+static int gf_invert(int n, u8 m[DESC_MAX_FAILED][DESC_MAX_FAILED], u8 inv[DESC_MAX_FAILED][DESC_MAX_FAILED])
+{
+int r;
+int c;
+int k;
+u8 f;
+u8 t;
+
+for(r=0; r < n; r++){
+	for(c=0; c < n; c++){ inv[r][c] = (r == c); }
+	}
+
+for(c=0; c < n; c++){
+	for(r=c; (r < n) && (m[r][c] == 0); r++);
+	if(r == n){ return EXIT_FAILURE; }
+	
+	for(k=0; k < n; k++){
+		t = m[c][k];   m[c][k]   = m[r][k];   m[r][k]   = t;
+		t = inv[c][k]; inv[c][k] = inv[r][k]; inv[r][k] = t;
+		}
+	
+	f = gf_inv(m[c][c]);
+	for(k=0; k < n; k++){
+		m[c][k]	  = gf_mul(f, m[c][k]);
+		inv[c][k] = gf_mul(f, inv[c][k]);
+		}
+	
+	for(r=0; r < n; r++){
+		if( (r == c) || (m[r][c] == 0) ){ continue; }
+		f = m[r][c];
+		for(k=0; k < n; k++){
+			m[r][k]	  ^= gf_mul(f, m[c][k]);
+			inv[r][k] ^= gf_mul(f, inv[c][k]);
+			}
+		}
+	}
+
+return EXIT_SUCCESS;
+}
+
+
+
+/**
+ * Encodes check symbol r+1 of the multi failure code, the sum of 
+ * (r+1)^(d+1) D_d over the data disks d.
+ *
+ * @param r			: check symbol, 0 to DESC_MAX_FAILED-1
+ * @param k			: # of data disks
+ * @param bytes		: # number of bytes
+ * @param **dptr	: processing data, the check symbols follow the data disks
+ *
+ * @returns	 void
+ */
+
+static void ops_multi_symbol(int r, int k, size_t bytes, u8 **dptr)
+{
+int clog[ARENA_MAX_DISKS];
+size_t i;
+u8 sum;
+u8 x;
+int d;
+
+for(d=0; d < k; d++){ clog[d] = (gf_log[r+1] * (d+1)) % 255; }
+
+for(i=0; i < bytes; i++){
+	for(sum = 0, d = 0; d < k; d++){
+		x = dptr[d][i];
+		if(x != 0){ sum ^= gf_exp[clog[d] + gf_log[x]]; }
+		}
+	dptr[k + r][i] = sum;
+	}
+}
+
+
+
+/**
+ * Encodes the first op->parities check symbols of the multi failure code, 
+ * an array with fewer than DESC_MAX_FAILED of them uses this instead of 
+ * multi_rs_gen_syndrome().
+ *
+ * @param *op		: the operation
+ * @param disks		: # of disks, the last op->parities are the check symbols
+ * @param bytes		: # number of bytes
+ * @param **dptr	: processing data
+ *
+ * @returns	 int : 0
+ */
+
+static int ops_multi_encode(request_op *op, int disks, size_t bytes, u8 **dptr)
+{
+int r;
+
+for(r=0; r < op->parities; r++){ ops_multi_symbol(r, disks - op->parities, bytes, dptr); }
+
+return 0;
+}
+
+
+
+/**
+ * Rebuilds the failed disks of the multi failure code. Check symbol y (1 to
+ * op->parities) is the sum of y^(d+1) D_d over the data disks d, see
+ * multi_rs_gen_syndrome(). Failed data disks are solved from as many intact
+ * check symbols, the first choice of them with an invertible matrix is taken;
+ * failed check symbols are encoded afterwards.
+ *
+ * @param *op		: the operation
+ * @param disks		: # of disks, the last op->parities are the check symbols
+ * @param bytes		: # number of bytes
+ * @param **dptr	: processing data
+ *
+ * @returns	 int : 0 or -EIO if the failures can't be solved
+ */
+
+static int ops_multi_decode(request_op *op, int disks, size_t bytes, u8 **dptr)
+{
+int k = disks - op->parities;
+int fdata[DESC_MAX_FAILED];
+int rows[DESC_MAX_FAILED];
+int sel[DESC_MAX_FAILED];
+int check_failed[DESC_MAX_FAILED];
+int failed[ARENA_MAX_DISKS];
+int clog[DESC_MAX_FAILED][ARENA_MAX_DISKS];
+u8 m[DESC_MAX_FAILED][DESC_MAX_FAILED];
+u8 inv[DESC_MAX_FAILED][DESC_MAX_FAILED];
+u8 s[DESC_MAX_FAILED];
+u8 x;
+u8 sum;
+unsigned int combo;
+int nf = 0;
+int nr = 0;
+int ns;
+size_t i;
+int r;
+int j;
+int d;
+
+memset(failed, 0, disks * sizeof(int));
+memset(check_failed, 0, sizeof(check_failed));
+for(j=0; j < op->nfailed; j++){
+	failed[op->failed[j]] = 1;
+	if(op->failed[j] < k){ fdata[nf++] = op->failed[j]; }
+	else{ check_failed[op->failed[j] - k] = 1; }
+	}
+
+/* the logarithm of the coefficient of data disk d in check symbol y+1 */
+for(r=0; r < op->parities; r++){
+	if(!check_failed[r]){ rows[nr++] = r; }
+	for(d=0; d < k; d++){ clog[r][d] = (gf_log[r+1] * (d+1)) % 255; }
+	}
+
+if(nf > 0){
+	for(combo = 0; combo < (1U << nr); combo++){
+		if(__builtin_popcount(combo) != nf){ continue; }
+		for(ns = 0, r = 0; r < nr; r++){
+			if(combo & (1U << r)){ sel[ns++] = rows[r]; }
+			}
+		
+		for(r=0; r < nf; r++){
+			for(j=0; j < nf; j++){ m[r][j] = gf_exp[clog[sel[r]][fdata[j]]]; }
+			}
+		if( gf_invert(nf, m, inv) == EXIT_SUCCESS ){ break; }
+		}
+	if(combo == (1U << nr)){ return -EIO; }
+	
+	for(i=0; i < bytes; i++){
+		for(r=0; r < nf; r++){
+			sum = dptr[k + sel[r]][i];
+			for(d=0; d < k; d++){
+				x = dptr[d][i];
+				if( (x != 0) && !failed[d] ){ sum ^= gf_exp[clog[sel[r]][d] + gf_log[x]]; }
+				}
+			s[r] = sum;
+			}
+		for(j=0; j < nf; j++){
+			for(sum = 0, r = 0; r < nf; r++){ sum ^= gf_mul(inv[j][r], s[r]); }
+			dptr[fdata[j]][i] = sum;
+			}
+		}
+	}
+
+for(r=0; r < op->parities; r++){
+	if(check_failed[r]){ ops_multi_symbol(r, k, bytes, dptr); }
+	}
+
+return 0;
+}
+
+
+
+/**
+ * Returns the name of an opcode.
+ *
+ * @param opcode	: OP_GEN ... OP_MULTI_DECODE
+ *
+ * @returns	 const char * : the name
+ */
+
+HOST const char *ops_name(int opcode)
+{
+if( (opcode < 0) || (opcode >= OP_MAX) ){ return "INVALID"; }
+
+return ops_names[opcode];
+}
+
+
+
+/**
+ * Takes the operation out of a request descriptor and checks it against the
+ * geometry of the stripe.
+ *
+ * @param *op		: the operation is stored here
+ * @param *desc		: request descriptor of the kernel stub
+ *
+ * @returns	 EXIT_SUCCESS or EXIT_FAILURE if the descriptor is invalid
+ */
+
+HOST int ops_take(request_op *op, request_desc *desc)
+{
+int disks = desc->disks;
+int data  = disks - 2;
+int i;
+int j;
+
+memset(op, 0, sizeof(request_op));
+op->opcode	= (int)desc->opcode;
+op->start	= desc->start;
+op->stop	= desc->stop;
+op->nfailed = desc->nfailed;
+op->flags	= desc->flags;
+op->prio	= (desc->version >= 2) ? (int)desc->prio : PRIO_FOREGROUND;
+op->array	= (desc->version >= 3) ? desc->array : 0;
+op->parities = DESC_MAX_FAILED;
+
+if( (disks <= 2) || (disks > ARENA_MAX_DISKS) ){ return EXIT_FAILURE; }
+if( (op->nfailed < 0) || (op->nfailed > DESC_MAX_FAILED) ){ return EXIT_FAILURE; }
+if( (op->prio < 0) || (op->prio >= PRIO_CLASSES) ){ return EXIT_FAILURE; }
+
+for(i=0; i < op->nfailed; i++){
+	op->failed[i] = desc->failed[i];
+	if( (op->failed[i] < 0) || (op->failed[i] >= disks) ){ return EXIT_FAILURE; }
+	for(j=0; j < i; j++){
+		if(op->failed[j] == op->failed[i]){ return EXIT_FAILURE; }
+		}
+	}
+
+switch(op->opcode){
+	case OP_GEN :
+	case OP_CHECK :			return EXIT_SUCCESS;
+	
+	case OP_XOR_UPDATE :	return ( (op->start >= 0) && (op->start <= op->stop) && (op->stop < data) ) ? 
+								   EXIT_SUCCESS : EXIT_FAILURE;
+	
+	case OP_RECOV_2DATA :	if( (op->nfailed != 2) || (op->failed[0] >= data) || (op->failed[1] >= data) ){ 
+								return EXIT_FAILURE; 
+								}
+							if(op->failed[0] > op->failed[1]){
+								i = op->failed[0]; op->failed[0] = op->failed[1]; op->failed[1] = i;
+								}
+							return EXIT_SUCCESS;
+	
+	case OP_RECOV_DATAP :	return ( (op->nfailed == 1) && (op->failed[0] < data) ) ? EXIT_SUCCESS : EXIT_FAILURE;
+	
+	case OP_MULTI_ENCODE :	return (disks > DESC_MAX_FAILED) ? EXIT_SUCCESS : EXIT_FAILURE;
+	
+	case OP_MULTI_DECODE :	return ( (disks > DESC_MAX_FAILED) && (op->nfailed > 0) ) ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+return EXIT_FAILURE;
+}
+
+
+
+/**
+ * Tells which disks an operation writes, these go back to the kernel on the
+ * copy path.
+ *
+ * @param *op		: the operation
+ * @param disks		: number of disks
+ * @param *outputs	: the disks are stored here, at most DESC_MAX_FAILED
+ *
+ * @returns	 int : number of disks
+ */
+
+HOST int ops_outputs(request_op *op, int disks, int *outputs)
+{
+int n = 0;
+int i;
+
+switch(op->opcode){
+	case OP_CHECK :			if( !(op->flags & DESC_FLAG_REPAIR) ){ break; }
+	case OP_GEN :
+	case OP_XOR_UPDATE :	outputs[n++] = disks-2;
+							outputs[n++] = disks-1;
+							break;
+	
+	case OP_RECOV_2DATA :	outputs[n++] = op->failed[0];
+							outputs[n++] = op->failed[1];
+							break;
+	
+	case OP_RECOV_DATAP :	outputs[n++] = op->failed[0];
+							outputs[n++] = disks-2;
+							break;
+	
+	case OP_MULTI_ENCODE :	for(i = disks-op->parities; i < disks; i++){ outputs[n++] = i; }
+							break;
+	
+	case OP_MULTI_DECODE :	for(i=0; i < op->nfailed; i++){ outputs[n++] = op->failed[i]; }
+							break;
+	}
+
+return n;
+}
+
+
+
+/**
+ * Computes an operation. OP_GEN goes to the backend, the other operations run
+ * on the cpu of the calling thread. op->result is set.
+ *
+ * @param *backend	: implementation for OP_GEN
+ * @param *ctx		: context of the calling worker
+ * @param *op		: the operation
+ * @param disks		: # of disks
+ * @param bytes		: # number of bytes
+ * @param **ptrs	: processing data
+ *
+ * @returns	 void
+ */
+
+HOST void ops_call(syndrome_backend *backend, syndrome_context *ctx, request_op *op, int disks, size_t bytes, void **ptrs)
+{
+u8 **dptr = (u8 **)ptrs;
+
+pthread_once(&gf_once, gf_init);
+
+switch(op->opcode){
+	case OP_GEN :			syndrome_call(backend, ctx, disks, bytes, ptrs);
+							op->result = 0;
+							break;
+	case OP_XOR_UPDATE :	op->result = ops_xor_update(op, disks, bytes, dptr);
+							break;
+	case OP_RECOV_2DATA :	op->result = ops_recov_2data(op, disks, bytes, dptr);
+							break;
+	case OP_RECOV_DATAP :	op->result = ops_recov_datap(op, disks, bytes, dptr);
+							break;
+	case OP_CHECK :			op->result = ops_check(op, disks, bytes, dptr);
+							break;
+	case OP_MULTI_ENCODE :	if(op->parities < DESC_MAX_FAILED){ op->result = ops_multi_encode(op, disks, bytes, dptr); }
+							else{
+								multi_rs_gen_syndrome(disks, bytes, ptrs);
+								op->result = 0;
+								}
+							break;
+	case OP_MULTI_DECODE :	op->result = ops_multi_decode(op, disks, bytes, dptr);
+							break;
+	default :				op->result = -EINVAL;
+}
+}
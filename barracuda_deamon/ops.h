@@ -0,0 +1,122 @@
+/**
+ * \file
+ * \brief	Operations of the request descriptor besides GEN: updates, recoveries, checks and the multi failure code
+ *
+ * @author	Dominic Eschweiler weiler@upb.de
+ *
+ * Status	: STABLE \n
+ * Date of creation : 18.10.2026
+ *
+ */
+
+
+/*****************************************************************
+ *
+ * Barracuda is a experimental microdriver extension to the 
+ * linux-kernel that is able to outsource common functions to
+ * the userspace. It was intensionally designed to accelerate
+ * CPU-intensive Tasks on a GPU.
+ *
+ * Copyright (C) 2009 Dominic Eschweiler
+ *
+ * This program is free software; you can redistribute it and/or 
+ * modify it under the terms of the GNU General Public License as 
+ * published by the Free Software Foundation; either only GPLv2 - 
+ * version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful, 
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of 
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the 
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public 
+ * License along with this program; 
+ * if not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************/
+
+#ifndef __OPS__
+#define __OPS__
+
+# include "definitions.h"
+
+/*! \var typedef struct request_op;
+	\brief The operation of the actual request, taken from the request 
+	descriptor of the kernel stub; result is stored back before the 
+	acknowledgement. prio is the class the stub admitted it in, array the
+	array it belongs to and parities the number of check symbols of the
+	multi failure code, DESC_MAX_FAILED unless the array has fewer */
+
+typedef struct request_op{
+	int opcode;
+	int prio;
+	unsigned int array;
+	int parities;
+	int start;
+	int stop;
+	int nfailed;
+	int failed[DESC_MAX_FAILED];
+	unsigned int flags;
+	int result;
+	}request_op;
+
+
+
+/**
+ * Returns the name of an opcode.
+ *
+ * @param opcode	: OP_GEN ... OP_MULTI_DECODE
+ *
+ * @returns	 const char * : the name
+ */
+
+HOST const char *ops_name(int opcode);
+
+
+
+/**
+ * Takes the operation out of a request descriptor and checks it against the
+ * geometry of the stripe.
+ *
+ * @param *op		: the operation is stored here
+ * @param *desc		: request descriptor of the kernel stub
+ *
+ * @returns	 EXIT_SUCCESS or EXIT_FAILURE if the descriptor is invalid
+ */
+
+HOST int ops_take(request_op *op, request_desc *desc);
+
+
+
+/**
+ * Tells which disks an operation writes, these go back to the kernel on the
+ * copy path.
+ *
+ * @param *op		: the operation
+ * @param disks		: number of disks
+ * @param *outputs	: the disks are stored here, at most DESC_MAX_FAILED
+ *
+ * @returns	 int : number of disks
+ */
+
+HOST int ops_outputs(request_op *op, int disks, int *outputs);
+
+
+
+/**
+ * Computes an operation. OP_GEN goes to the backend, the other operations run
+ * on the cpu of the calling thread. op->result is set.
+ *
+ * @param *backend	: implementation for OP_GEN
+ * @param *ctx		: context of the calling worker
+ * @param *op		: the operation
+ * @param disks		: # of disks
+ * @param bytes		: # number of bytes
+ * @param **ptrs	: processing data
+ *
+ * @returns	 void
+ */
+
+HOST void ops_call(syndrome_backend *backend, syndrome_context *ctx, request_op *op, int disks, size_t bytes, void **ptrs);
+
+#endif
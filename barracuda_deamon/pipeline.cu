@@ -0,0 +1,336 @@
+/**
+ * \file
+ * \brief	Fetch, compute and complete of single-slot requests on three threads
+ *
+ * @author	Dominic Eschweiler weiler@upb.de
+ *
+ * Status	: STABLE \n
+ * Date of creation : 18.10.2026
+ *
+ */
+
+
+/*****************************************************************
+ *
+ * Barracuda is a experimental microdriver extension to the 
+ * linux-kernel that is able to outsource common functions to
+ * the userspace. It was intensionally designed to accelerate
+ * CPU-intensive Tasks on a GPU.
+ *
+ * Copyright (C) 2009 Dominic Eschweiler
+ *
+ * This program is free software; you can redistribute it and/or 
+ * modify it under the terms of the GNU General Public License as 
+ * published by the Free Software Foundation; either only GPLv2 - 
+ * version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful, 
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of 
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the 
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public 
+ * License along with this program; 
+ * if not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include <sched.h>
+#include <pthread.h>
+#include <semaphore.h>
+
+# include "pipeline.h"
+# include "backends.h"
+# include "affinity.h"
+# include "mpmc.h"
+
+/* __Request Pipeline__
+ * Requests in the fetch, compute and complete stage at once. Each one is 
+ * fetched into a slot with a driver context of its own.
+ */
+#define PIPELINE_SLOTS 4
+
+typedef struct pipeline_slot{
+	driver_context dc;
+	syndrome_container *smc;
+	char token[MAX_PAYLOAD];
+	fault_sample faults;			/* of all three stages */
+	}pipeline_slot;
+
+typedef struct pipeline_stage{
+	mpmc_queue queue;
+	sem_t items;
+	pthread_t thread;
+	}pipeline_stage;
+
+typedef struct request_pipeline{
+	driver_context *dc;
+	request_transport *rt;
+	pipeline_slot slots[PIPELINE_SLOTS];
+	pipeline_stage compute;
+	pipeline_stage complete;
+	sem_t free_slots;
+	sem_t acked;					/* the next request may be waited for */
+	volatile int tearing_down;
+	unsigned long overlapped;
+	}request_pipeline;
+
+
+
+/**
+ * Hands a slot to the next stage.
+ *
+ * @param *stage	: the next stage
+ * @param *slot		: the slot, NULL lets the stage terminate
+ *
+ * @returns			void
+ */
+
+static void pipeline_push(pipeline_stage *stage, pipeline_slot *slot)
+{
+/* a stage never holds more slots than there are, the queue can't be full */
+while( mpmc_enqueue(&stage->queue, slot) == EXIT_FAILURE ){ sched_yield(); }
+sem_post(&stage->items);
+}
+
+
+
+/**
+ * Takes the next slot of a stage.
+ *
+ * @param *stage	: the stage
+ *
+ * @returns	 pipeline_slot * : the slot, NULL terminates the stage
+ */
+
+static pipeline_slot *pipeline_pop(pipeline_stage *stage)
+{
+pipeline_slot *slot;
+
+for(;;){
+	while( sem_wait(&stage->items) != 0 );
+	if( mpmc_dequeue(&stage->queue, (void **)&slot) == EXIT_SUCCESS ){ return slot; }
+	}
+}
+
+
+
+/**
+ * Body of the compute stage. It has a compute context of its own, the stripes
+ * go to the compute workers from here the same way as from a serial loop.
+ *
+ * @param *arg		: the pipeline
+ *
+ * @returns			NULL
+ */
+
+static void *pipeline_compute(void *arg)
+{
+request_pipeline *p = (request_pipeline *)arg;
+syndrome_context ctx;
+pipeline_slot *slot;
+fault_sample mark;
+int ready;
+
+affinity_apply(AFFINITY_SERVER);
+ready = (syndrome_context_init(p->dc->backend, &ctx) == EXIT_SUCCESS);
+if(!ready){
+	syslog(LOG_NOTICE, "Compute stage can't initialise the %s context, requests are passed on uncomputed\n", 
+			p->dc->backend->name);
+	}
+
+while( (slot = pipeline_pop(&p->compute)) != NULL ){
+	fault_mark(&mark);
+	if( ready && (slot->smc != NULL) ){
+		slot->dc.ctx = ctx;
+		compute_request(&slot->dc, slot->smc);
+		}
+	fault_since(&mark, &slot->faults);
+	pipeline_push(&p->complete, slot);
+	}
+
+pipeline_push(&p->complete, NULL);
+if(ready){ syndrome_context_release(p->dc->backend, &ctx); }
+return NULL;
+}
+
+
+
+/**
+ * Body of the complete stage. A request is acknowledged as soon as its 
+ * checksums are back in the kernel, the disks are unmapped afterwards while
+ * the transport thread already fetches the next request. The mappings of an
+ * acknowledged stripe are not touched anymore, the kernel may reuse the pages.
+ *
+ * @param *arg		: the pipeline
+ *
+ * @returns			NULL
+ */
+
+static void *pipeline_complete(void *arg)
+{
+request_pipeline *p = (request_pipeline *)arg;
+request_transport *rt = p->rt;
+pipeline_slot *slot;
+fault_sample mark;
+
+affinity_apply(AFFINITY_SERVER);
+
+while( (slot = pipeline_pop(&p->complete)) != NULL ){
+	p->tearing_down = 1;
+	fault_mark(&mark);
+	
+	/* copied checksums must be back before the acknowledgement */
+	if( (slot->smc != NULL) && (slot->dc.marshal_used == MARSHAL_COPY) ){
+		release_request(&slot->dc, slot->smc);
+		slot->smc = NULL;
+		}
+	complete_op(&slot->dc);
+	
+	if(rt->ack != NULL){ rt->ack(rt->arg, slot->token); }
+	sem_post(&p->acked);
+	
+	if(slot->smc != NULL){ release_request(&slot->dc, slot->smc); }
+	
+	/* only this stage writes the counter of the transport thread */
+	fault_since(&mark, &slot->faults);
+	fault_record(&p->dc->faults, &slot->faults, 1);
+	
+	p->tearing_down = 0;
+	sem_post(&p->free_slots);
+	}
+
+return NULL;
+}
+
+
+
+/**
+ * Serves the requests of a single-slot connection with three stages on three
+ * threads. The transport thread waits for a request and fetches its stripe, 
+ * the compute stage runs gen_syndrome and the complete stage acknowledges and
+ * releases it. The stages are connected by bounded queues and every slot of 
+ * the pipeline has a driver context of its own, so a stripe can be released
+ * while the next one is already fetched with other disk pointers.
+ *
+ * The kernel hands the next request over only after the acknowledgement of
+ * the previous one, hence the unmapping of a request overlaps with the fetch 
+ * and the compute of the next one, not the computes with each other.
+ *
+ * @param *dc		: driver context of the transport thread
+ * @param *rt		: the connection
+ *
+ * @returns			EXIT_SUCCESS or EXIT_FAILURE if the stages can't be started, no
+ *					request is served then
+ */
+
+HOST int serve_pipelined(driver_context *dc, request_transport *rt)
+{
+request_pipeline *p;
+pipeline_slot *slot;
+fault_sample mark;
+unsigned long n = 0;
+int ret = EXIT_SUCCESS;
+int i;
+
+p = (request_pipeline *)calloc(1, sizeof(request_pipeline));
+if(p == NULL){ return EXIT_FAILURE; }
+
+p->dc = dc;
+p->rt = rt;
+
+for(i=0; i < PIPELINE_SLOTS; i++){
+	slot = &p->slots[i];
+	slot->dc		= *dc;
+	slot->dc.dptrs	= (void **)malloc(ARENA_MAX_DISKS * sizeof(void*));
+	memset(&slot->dc.pool, 0, sizeof(marshal_pool));
+	if(dc->pool.disks > 0){ marshal_pool_reserve(&slot->dc.pool, dc->pool.disks, dc->pool.bytes); }
+	if(dc->batch != NULL){
+		slot->dc.batch		= (syndrome_container *)malloc(BATCH_MAX_STRIPES * sizeof(syndrome_container));
+		slot->dc.batch_ptrs = (void **)malloc(BATCH_MAX_STRIPES * ARENA_MAX_DISKS * sizeof(void *));
+		}
+	}
+
+mpmc_init(&p->compute.queue, PIPELINE_SLOTS);
+mpmc_init(&p->complete.queue, PIPELINE_SLOTS);
+sem_init(&p->compute.items, 0, 0);
+sem_init(&p->complete.items, 0, 0);
+sem_init(&p->free_slots, 0, PIPELINE_SLOTS);
+sem_init(&p->acked, 0, 1);
+
+if( pthread_create(&p->compute.thread, NULL, pipeline_compute, p) != 0 ){
+	syslog(LOG_NOTICE, "Can't start the compute stage, requests are served one by one\n");
+	ret = EXIT_FAILURE;
+	goto out;
+	}
+if( pthread_create(&p->complete.thread, NULL, pipeline_complete, p) != 0 ){
+	syslog(LOG_NOTICE, "Can't start the complete stage, requests are served one by one\n");
+	pipeline_push(&p->compute, NULL);
+	pthread_join(p->compute.thread, NULL);
+	ret = EXIT_FAILURE;
+	goto out;
+	}
+
+syslog(LOG_NOTICE, "Requests are served by a pipeline with %d slots\n", PIPELINE_SLOTS);
+
+/* the fetch stage */
+while( keep_going ){
+	while( sem_wait(&p->free_slots) != 0 );
+	while( sem_wait(&p->acked) != 0 );
+	
+	slot = &p->slots[n % PIPELINE_SLOTS];
+	if( !keep_going || (rt->wait(rt->arg, slot->token) == EXIT_FAILURE) ){
+		sem_post(&p->acked);
+		sem_post(&p->free_slots);
+		continue;
+		}
+	
+	if(p->tearing_down){ p->overlapped++; }
+	
+	memset(&slot->faults, 0, sizeof(fault_sample));
+	fault_mark(&mark);
+	slot->smc = transport_fetch(rt, &slot->dc, slot->token);
+	fault_since(&mark, &slot->faults);
+	pipeline_push(&p->compute, slot);
+	n++;
+	}
+
+pipeline_push(&p->compute, NULL);
+pthread_join(p->compute.thread, NULL);
+pthread_join(p->complete.thread, NULL);
+
+syslog(LOG_NOTICE, "pipeline : %lu requests, %lu fetched while the previous one was released\n", 
+		n, p->overlapped);
+
+out:
+for(i=0; i < PIPELINE_SLOTS; i++){
+	slot = &p->slots[i];
+	dc->batches		  += slot->dc.batches;
+	dc->batch_stripes += slot->dc.batch_stripes;
+	if(slot->dc.batch_largest > dc->batch_largest){ dc->batch_largest = slot->dc.batch_largest; }
+	
+	if( (slot->dc.smc != NULL) && (slot->dc.smc != dc->smc) ){
+		dc->kops->dev_munmap(slot->dc.smc, sizeof(syndrome_container));
+		}
+	if( (slot->dc.sg != NULL) && (slot->dc.sg != dc->sg) ){
+		dc->kops->dev_munmap(slot->dc.sg, sizeof(sg_table));
+		}
+	marshal_pool_release(&slot->dc.pool);
+	free(slot->dc.dptrs);
+	free(slot->dc.batch);
+	free(slot->dc.batch_ptrs);
+	}
+
+mpmc_destroy(&p->compute.queue);
+mpmc_destroy(&p->complete.queue);
+sem_destroy(&p->compute.items);
+sem_destroy(&p->complete.items);
+sem_destroy(&p->free_slots);
+sem_destroy(&p->acked);
+free(p);
+
+return ret;
+}
@@ -0,0 +1,61 @@
+/**
+ * \file
+ * \brief	Fetch, compute and complete of single-slot requests on three threads
+ *
+ * @author	Dominic Eschweiler weiler@upb.de
+ *
+ * Status	: STABLE \n
+ * Date of creation : 18.10.2026
+ *
+ */
+
+
+/*****************************************************************
+ *
+ * Barracuda is a experimental microdriver extension to the 
+ * linux-kernel that is able to outsource common functions to
+ * the userspace. It was intensionally designed to accelerate
+ * CPU-intensive Tasks on a GPU.
+ *
+ * Copyright (C) 2009 Dominic Eschweiler
+ *
+ * This program is free software; you can redistribute it and/or 
+ * modify it under the terms of the GNU General Public License as 
+ * published by the Free Software Foundation; either only GPLv2 - 
+ * version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful, 
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of 
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the 
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public 
+ * License along with this program; 
+ * if not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************/
+
+#ifndef __PIPELINE__
+#define __PIPELINE__
+
+# include "userspace_driver.h"
+
+
+
+/**
+ * Serves the requests of a single-slot connection with three stages on three
+ * threads: the calling thread waits for a request and fetches its stripe, 
+ * the compute stage runs gen_syndrome and the complete stage acknowledges and
+ * releases it. The unmapping of a request overlaps with the fetch and the 
+ * compute of the next one. Returns when the daemon is stopped.
+ *
+ * @param *dc		: driver context of the transport thread
+ * @param *rt		: the connection
+ *
+ * @returns			EXIT_SUCCESS or EXIT_FAILURE if the stages can't be started, no
+ *					request is served then
+ */
+
+HOST int serve_pipelined(driver_context *dc, request_transport *rt);
+
+#endif
@@ -0,0 +1,359 @@
+/**
+ * \file
+ * \brief	Consumer side of the submission/completion ring shared with the kernel stub
+ *
+ * @author	Dominic Eschweiler weiler@upb.de
+ *
+ * Status	: STABLE \n
+ * Date of creation : 18.10.2026
+ *
+ */
+
+
+/*****************************************************************
+ *
+ * Barracuda is a experimental microdriver extension to the 
+ * linux-kernel that is able to outsource common functions to
+ * the userspace. It was intensionally designed to accelerate
+ * CPU-intensive Tasks on a GPU.
+ *
+ * Copyright (C) 2009 Dominic Eschweiler
+ *
+ * This program is free software; you can redistribute it and/or 
+ * modify it under the terms of the GNU General Public License as 
+ * published by the Free Software Foundation; either only GPLv2 - 
+ * version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful, 
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of 
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the 
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public 
+ * License along with this program; 
+ * if not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+# include "ring.h"
+# include "backends.h"
+
+/**
+ * Returns the size of a ring with its data slots.
+ *
+ * @param entries		: number of slots
+ * @param slot_bytes	: size of one slot
+ *
+ * @returns	 size_t : bytes to map
+ */
+
+HOST size_t ring_region_size(unsigned int entries, unsigned long slot_bytes)
+{
+return RING_STRIDE(sizeof(ring_header)) + (size_t)entries * RING_STRIDE(slot_bytes);
+}
+
+
+
+/**
+ * Initialises an empty ring header.
+ *
+ * @param *ring			: ring
+ * @param entries		: number of slots, a power of two
+ * @param slot_bytes	: size of one slot
+ *
+ * @returns	 void
+ */
+
+HOST void ring_init_header(ring_header *ring, unsigned int entries, unsigned long slot_bytes)
+{
+memset(ring, 0, sizeof(ring_header));
+
+ring->entries		= entries;
+ring->slot_bytes	= RING_STRIDE(slot_bytes);
+ring->data_offset	= RING_STRIDE(sizeof(ring_header));
+}
+
+
+
+/**
+ * Prepares a consumer.
+ *
+ * @param *rc			: consumer
+ * @param *ring			: mapped ring
+ * @param *backend		: backend for inline computation
+ * @param *ctx			: context of the calling thread for inline computation
+ * @param enter			: doorbell of the producer
+ * @param *enter_arg	: argument of the doorbell
+ * @param *keep_going	: the consumer stops when this gets zero
+ *
+ * @returns	 EXIT_SUCCESS or EXIT_FAILURE
+ */
+
+HOST int ring_consumer_init(ring_consumer *rc, ring_header *ring, syndrome_backend *backend,
+							syndrome_context *ctx, ring_enter_func enter, void *enter_arg,
+							volatile sig_atomic_t *keep_going)
+{
+memset(rc, 0, sizeof(ring_consumer));
+
+if( (ring->entries == 0) || (ring->entries > RING_MAX_ENTRIES) ){ return EXIT_FAILURE; }
+
+rc->ring		= ring;
+rc->backend		= backend;
+rc->ctx			= ctx;
+rc->enter		= enter;
+rc->enter_arg	= enter_arg;
+rc->keep_going	= keep_going;
+
+/* one request and one pointer table for every slot */
+rc->requests = (syndrome_request *)malloc(ring->entries * sizeof(syndrome_request));
+rc->ptrs     = (void **)malloc(ring->entries * ARENA_MAX_DISKS * sizeof(void *));
+
+if( (rc->requests == NULL) || (rc->ptrs == NULL) ||
+	(mpmc_init(&rc->completions, ring->entries) == EXIT_FAILURE) ){
+	free(rc->requests);
+	free(rc->ptrs);
+	return EXIT_FAILURE;
+	}
+
+sem_init(&rc->completed, 0, 0);
+coalesce_init(&rc->coalesce, 1, 0, ring->entries);
+return EXIT_SUCCESS;
+}
+
+
+
+/**
+ * Frees a consumer.
+ *
+ * @param *rc			: consumer
+ *
+ * @returns	 void
+ */
+
+HOST void ring_consumer_destroy(ring_consumer *rc)
+{
+sem_destroy(&rc->completed);
+mpmc_destroy(&rc->completions);
+free(rc->requests);
+free(rc->ptrs);
+}
+
+
+
+/**
+ * Writes one completion entry. Only the consumer thread posts, so the 
+ * completion queue has a single producer.
+ *
+ * @param *rc			: consumer
+ * @param slot			: slot of the completed stripe
+ * @param result		: 0 on success
+ *
+ * @returns	 void
+ */
+
+static void ring_post(ring_consumer *rc, unsigned int slot, int result)
+{
+ring_header *ring = rc->ring;
+unsigned int tail = ring->cq_tail;
+
+ring->cq[tail & (ring->entries-1)].slot   = slot;
+ring->cq[tail & (ring->entries-1)].result = result;
+__sync_synchronize();
+ring->cq_tail = tail + 1;
+
+coalesce_add(&rc->coalesce);
+}
+
+
+
+/**
+ * Completion callback of the async workers. It runs on the worker and hands
+ * the request back to the consumer thread.
+ *
+ * @param *req			: completed request
+ * @param *arg			: consumer
+ *
+ * @returns	 void
+ */
+
+static void ring_worker_done(syndrome_request *req, void *arg)
+{
+ring_consumer *rc = (ring_consumer *)arg;
+
+/* the queue holds as many elements as there are slots, it can't overflow */
+mpmc_enqueue(&rc->completions, req);
+sem_post(&rc->completed);
+}
+
+
+
+/**
+ * Posts the completions which the workers have handed back.
+ *
+ * @param *rc			: consumer
+ *
+ * @returns	 void
+ */
+
+static void ring_reap_workers(ring_consumer *rc)
+{
+syndrome_request *req;
+
+while( mpmc_dequeue(&rc->completions, (void **)&req) == EXIT_SUCCESS ){
+	ring_post(rc, (unsigned int)(req - rc->requests), 0);
+	rc->inflight--;
+	}
+}
+
+
+
+/**
+ * Starts the computation of one submission entry.
+ *
+ * @param *rc			: consumer
+ * @param *sqe			: submission entry
+ *
+ * @returns	 void
+ */
+
+static void ring_start(ring_consumer *rc, ring_sqe *sqe)
+{
+int i;
+ring_header *ring = rc->ring;
+syndrome_request *req;
+void **ptrs;
+char *base;
+
+if( (sqe->slot >= ring->entries) || (sqe->disks > ARENA_MAX_DISKS) || (sqe->disks < 3) ||
+	((unsigned long)sqe->disks * RING_STRIDE(sqe->bytes) > ring->slot_bytes) ){
+	ring_post(rc, sqe->slot, -1);
+	return;
+	}
+
+ptrs = &rc->ptrs[sqe->slot * ARENA_MAX_DISKS];
+base = (char *)ring + ring->data_offset + sqe->slot * ring->slot_bytes;
+
+for(i=0; i < sqe->disks; i++){
+	ptrs[i] = (void *)(base + i*RING_STRIDE(sqe->bytes));
+	}
+
+req = &rc->requests[sqe->slot];
+syndrome_request_init(req, sqe->disks, sqe->bytes, ptrs, ring_worker_done, rc);
+
+if( syndrome_submit(req) == EXIT_SUCCESS ){
+	rc->inflight++;
+	return;
+	}
+
+syndrome_call(rc->backend, rc->ctx, sqe->disks, sqe->bytes, ptrs);
+ring_post(rc, sqe->slot, 0);
+}
+
+
+
+/**
+ * Takes all available submission entries as one batch.
+ *
+ * @param *rc			: consumer
+ *
+ * @returns	 int : number of entries taken
+ */
+
+static int ring_take_submissions(ring_consumer *rc)
+{
+ring_header *ring = rc->ring;
+unsigned int head = ring->sq_head;
+unsigned int tail = ring->sq_tail;
+ring_sqe sqe;
+int taken = 0;
+
+__sync_synchronize();
+
+while(head != tail){
+	sqe = ring->sq[head & (ring->entries-1)];
+	head++;
+	taken++;
+	ring_start(rc, &sqe);
+	}
+
+__sync_synchronize();
+ring->sq_head = head;
+
+if(taken > 0){
+	rc->batches++;
+	rc->submissions += taken;
+	if((unsigned long)taken > rc->max_batch){ rc->max_batch = taken; }
+	}
+
+return taken;
+}
+
+
+
+/**
+ * Waits for the next worker to hand a request back. Held completions bound
+ * the wait by their deadline.
+ *
+ * @param *rc			: consumer
+ *
+ * @returns	 void
+ */
+
+static void ring_wait_worker(ring_consumer *rc)
+{
+struct timespec deadline;
+
+if( coalesce_deadline(&rc->coalesce, &deadline) == 0 ){
+	while( (sem_timedwait(&rc->completed, &deadline) != 0) && (errno == EINTR) );
+	return;
+	}
+
+sem_wait(&rc->completed);
+}
+
+
+
+/**
+ * Drains the ring.
+ *
+ * @param *rc			: consumer
+ *
+ * @returns	 EXIT_SUCCESS
+ */
+
+HOST int ring_consumer_run(ring_consumer *rc)
+{
+ring_header *ring = rc->ring;
+int wait;
+
+for(;;){
+	ring_reap_workers(rc);
+	
+	if( !(*rc->keep_going) && (rc->inflight == 0) ){ break; }
+	
+	/* block in the doorbell only if there is nothing else to do */
+	wait = (rc->inflight == 0) && (ring->sq_head == ring->sq_tail) && *rc->keep_going;
+	
+	if( wait || coalesce_due(&rc->coalesce) ){
+		coalesce_flushed(&rc->coalesce, wait);
+		rc->enter(rc->enter_arg, wait);
+		}
+	
+	if( (ring_take_submissions(rc) == 0) && (rc->inflight > 0) ){
+		ring_wait_worker(rc);
+		}
+	}
+
+/* announce the last completions */
+if(rc->coalesce.pending > 0){
+	coalesce_flushed(&rc->coalesce, 1);
+	rc->enter(rc->enter_arg, 0);
+	}
+
+return EXIT_SUCCESS;
+}
@@ -0,0 +1,161 @@
+/**
+ * \file
+ * \brief	Consumer side of the submission/completion ring shared with the kernel stub
+ *
+ * @author	Dominic Eschweiler weiler@upb.de
+ *
+ * Status	: STABLE \n
+ * Date of creation : 18.10.2026
+ *
+ */
+
+
+/*****************************************************************
+ *
+ * Barracuda is a experimental microdriver extension to the 
+ * linux-kernel that is able to outsource common functions to
+ * the userspace. It was intensionally designed to accelerate
+ * CPU-intensive Tasks on a GPU.
+ *
+ * Copyright (C) 2009 Dominic Eschweiler
+ *
+ * This program is free software; you can redistribute it and/or 
+ * modify it under the terms of the GNU General Public License as 
+ * published by the Free Software Foundation; either only GPLv2 - 
+ * version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful, 
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of 
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the 
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public 
+ * License along with this program; 
+ * if not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************/
+
+#ifndef __RING__
+#define __RING__
+
+#include <signal.h>
+#include <semaphore.h>
+
+# include "definitions.h"
+# include "async.h"
+# include "mpmc.h"
+# include "coalesce.h"
+
+/*! \def RING_DEFAULT_ENTRIES
+	\brief Default number of ring slots */
+
+/*! \def RING_DEFAULT_SLOT
+	\brief Default size of a slot, one page for each of ARENA_MAX_DISKS disks */
+
+#define RING_DEFAULT_ENTRIES	32
+#define RING_DEFAULT_SLOT		RING_MIN_SLOT
+
+/*! \var typedef ring_enter_func
+	\brief Doorbell of the producer: reaps the completions and, with wait != 0,
+	blocks until there are submissions. Returns < 0 on error or interruption. */
+
+typedef int (*ring_enter_func)(void *arg, int wait);
+
+/*! \var typedef struct ring_consumer;
+	\brief State of the thread which drains the ring */
+
+typedef struct ring_consumer{
+	ring_header *ring;
+	syndrome_backend *backend;
+	syndrome_context *ctx;
+	ring_enter_func enter;
+	void *enter_arg;
+	volatile sig_atomic_t *keep_going;
+	syndrome_request *requests;
+	void **ptrs;
+	mpmc_queue completions;
+	sem_t completed;
+	int inflight;
+	completion_coalescer coalesce;
+	unsigned long batches;
+	unsigned long submissions;
+	unsigned long max_batch;
+	}ring_consumer;
+
+
+
+/**
+ * Returns the size of a ring with its data slots.
+ *
+ * @param entries		: number of slots
+ * @param slot_bytes	: size of one slot
+ *
+ * @returns	 size_t : bytes to map
+ */
+
+HOST size_t ring_region_size(unsigned int entries, unsigned long slot_bytes);
+
+
+
+/**
+ * Initialises an empty ring header, this is the job of the producer.
+ *
+ * @param *ring			: ring
+ * @param entries		: number of slots, a power of two
+ * @param slot_bytes	: size of one slot
+ *
+ * @returns	 void
+ */
+
+HOST void ring_init_header(ring_header *ring, unsigned int entries, unsigned long slot_bytes);
+
+
+
+/**
+ * Prepares a consumer. Requests are computed by the async workers if they are
+ * running and inline on ctx if not. Every batch of completions is announced
+ * right away, coalesce_init() on rc->coalesce holds them back for longer.
+ *
+ * @param *rc			: consumer
+ * @param *ring			: mapped ring
+ * @param *backend		: backend for inline computation
+ * @param *ctx			: context of the calling thread for inline computation
+ * @param enter			: doorbell of the producer
+ * @param *enter_arg	: argument of the doorbell
+ * @param *keep_going	: the consumer stops when this gets zero
+ *
+ * @returns	 EXIT_SUCCESS or EXIT_FAILURE
+ */
+
+HOST int ring_consumer_init(ring_consumer *rc, ring_header *ring, syndrome_backend *backend,
+							syndrome_context *ctx, ring_enter_func enter, void *enter_arg,
+							volatile sig_atomic_t *keep_going);
+
+
+
+/**
+ * Frees a consumer.
+ *
+ * @param *rc			: consumer
+ *
+ * @returns	 void
+ */
+
+HOST void ring_consumer_destroy(ring_consumer *rc);
+
+
+
+/**
+ * Drains the ring until keep_going gets zero and nothing is in flight. All 
+ * submissions found at once are taken as one batch; completions are posted 
+ * in the order the computations finish and announced with one doorbell call
+ * as soon as the coalescer allows it or the consumer runs out of work.
+ *
+ * @param *rc			: consumer
+ *
+ * @returns	 EXIT_SUCCESS
+ */
+
+HOST int ring_consumer_run(ring_consumer *rc);
+
+#endif
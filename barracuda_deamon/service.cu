@@ -210,9 +210,12 @@ else{
 	fgets( (char *)&buffer, 256, fpointer);
 	strtok((char *)&buffer, "-");
 	n_buffer = strtok(NULL, "-");
-	
-	NUMBER_OF_CPUS_INSTALLED = atoi(n_buffer)+1;
-	
+
+	/* A single online cpu is listed as "0" without any range */
+	if(n_buffer != NULL){
+		NUMBER_OF_CPUS_INSTALLED = atoi(n_buffer)+1;
+		}
+
 	fclose(fpointer);
 	}
 	
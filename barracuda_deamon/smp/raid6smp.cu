@@ -44,6 +44,8 @@
 #include <dirent.h>
 #include <math.h>
 #include <time.h>
+#include <errno.h>
+#include <syslog.h>
 
 #include <sys/time.h>
 #include <sys/mman.h>
@@ -52,17 +54,37 @@
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <pthread.h>
+#include <semaphore.h>
 
 #include <linux/types.h>
 
 
 # include "raid6smp.h"
 # include "../service.h"
-
-HOST static void *proc_thread_dep_syndrome(void *arg);
+# include "../affinity.h"
+
+HOST static void *smp_worker(void *arg);
+HOST static void *smp_calibrator(void *arg);
+HOST static void smp_pool_start(void);
+HOST static void smp_measure(void);
+HOST static int smp_plan_threads(int disks, size_t bytes);
+HOST static int smp_fan_out(int disks, size_t bytes, void **ptrs, int number_of_threads);
+HOST static void smp_dispatch(int disks, size_t bytes, void **ptrs, int number_of_threads);
+HOST static void smp_syndrome_range(int disks, void **ptrs, size_t start, size_t stop);
 HOST static inline unative_t SHLBYTE(unative_t v);
 HOST static inline unative_t MASK(unative_t v);
 
+/* A worker never gets a slice smaller than this */
+#define SMP_MIN_SLICE				4096
+
+/* Geometry which is used for measuring the compute and dispatch costs */
+#define SMP_CALIBRATION_BYTES		16384
+#define SMP_CALIBRATION_DISKS		8
+#define SMP_CALIBRATION_LOOPS		8
+
+/* Seconds between two refreshes of the calibration by the pool */
+#define SMP_RECALIBRATION_INTERVAL	10
+
 struct thread_data{
 	int disks;
 	size_t bytes; 
@@ -71,9 +93,45 @@ struct thread_data{
 	int number_of_threads;
 	};
 
+/*
+ * The worker pool is started once per process and shared by every call. The
+ * calling thread always computes slice 0 itself, so a fan-out to n threads only
+ * wakes n-1 workers. Only one caller at a time can fan out. The calibrator
+ * thread of the pool refreshes the costs, a call only reads them. stop ends
+ * the workers and the calibrator, see raid6_smp_stop().
+ */
+struct smp_pool{
+	pthread_mutex_t		dispatch_mutex;
+	pthread_t			calibrator;
+	int					calibrating;
+	pthread_mutex_t		stop_mutex;
+	pthread_cond_t		stop_cond;
+	volatile int		stop;
+	int					started;
+	pthread_t			*threads;
+	sem_t				*wake;
+	sem_t				done;
+	struct thread_data	job;
+	int					number_of_workers;
+	volatile int		pending;
+	};
+
+static struct smp_pool pool;
+static pthread_once_t pool_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t calibration_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* calibration results, see raid6_smp_calibrate() */
+static double dispatch_cost		= 0;	/* seconds per woken worker */
+static double byte_cost			= 0;	/* seconds per byte and disk */
+static double last_calibration	= 0;
+
+/* the stripe which is measured, allocated by the first calibration and kept */
+static void **calibration_ptrs	= NULL;
+
 /**
- * This is the SMP-version of the gen_syndrome function. It uses the systemcall
- * fork() for the thread as process execution.
+ * This is the SMP-version of the gen_syndrome function. Depending on the size
+ * of the stripe it runs inline on the calling thread, on a subset of the
+ * worker pool or on all of its threads.
  *
  * @param	disks 				: number of disks
  * @param	bytes				: number of bytes per disks
@@ -84,77 +142,404 @@ struct thread_data{
 
 void raid6_smp_gen_syndrome(int disks, size_t bytes, void **ptrs)
 {
-//printf("SMP\n");
+int number_of_threads;
+
+pthread_once(&pool_once, smp_pool_start);
+
+number_of_threads = smp_plan_threads(disks, bytes);
+
+/* a busy pool means another request is fanned out, so compute inline */
+if( (number_of_threads < 2) ||
+	(smp_fan_out(disks, bytes, ptrs, number_of_threads) == EXIT_FAILURE) ){
+	smp_syndrome_range(disks, ptrs, 0, bytes);
+	}
+}
+
+
+
+/**
+ * Starts the worker pool and runs the first calibration. The SMP implementation
+ * keeps no per worker state, so the context stays empty. It returns when the 
+ * first calibration is done, the first call already plans with its costs.
+ *
+ * @param	*ctx				: context of the calling worker
+ *
+ * @returns	 EXIT_SUCCESS
+ */
+
+int raid6_smp_context_init(syndrome_context *ctx)
+{
+pthread_once(&pool_once, smp_pool_start);
 
+return EXIT_SUCCESS;
+}
+
+
+
+/**
+ * Measures the cost of waking one pool worker and the cost of computing one
+ * byte of one disk inline. Both values are used by smp_plan_threads() to
+ * decide how many threads a stripe is worth. The pool measures them when it
+ * starts and its calibrator every SMP_RECALIBRATION_INTERVAL seconds, never a
+ * request. The fan-out is only measured if the pool is idle,
+ * a request never waits for the calibration.
+ *
+ * @returns	 void
+ */
+
+void raid6_smp_calibrate(void)
+{
+pthread_once(&pool_once, smp_pool_start);
+smp_measure();
+}
+
+
+
+/**
+ * Stops the calibrator and the workers of the pool and joins them. A call 
+ * which is fanned out is finished first; afterwards every call computes 
+ * inline on the calling thread.
+ *
+ * @returns	 void
+ */
+
+void raid6_smp_stop(void)
+{
 int i;
-int number_of_threads = get_number_of_phys_cpus();
+int n;
 
-//printf("%d\n", number_of_threads);
-	
-pthread_t threads[number_of_threads];
-struct thread_data thread_data_array[number_of_threads];
-int rc;
-void *status;
-   
-	for(i=0; i<number_of_threads; i++){
-		thread_data_array[i].disks				= disks;
-		thread_data_array[i].bytes				= bytes; 
-		thread_data_array[i].ptrs				= ptrs;
-		thread_data_array[i].thread_id			= i;
-		thread_data_array[i].number_of_threads	= number_of_threads;
-
-		rc = pthread_create(&threads[i], NULL, proc_thread_dep_syndrome, (void *)&thread_data_array[i]);
-
-		if(rc){
-			printf("ERROR; return code from pthread_create() is %d\n", rc);
-			exit(-1);
-			}
+if(!pool.started){ return; }
 
+pthread_mutex_lock(&pool.stop_mutex);
+if(pool.stop){
+	pthread_mutex_unlock(&pool.stop_mutex);
+	return;
+	}
+pool.stop = 1;
+pthread_cond_broadcast(&pool.stop_cond);
+pthread_mutex_unlock(&pool.stop_mutex);
+
+if(pool.calibrating){ pthread_join(pool.calibrator, NULL); }
+
+/* the dispatch mutex stays taken, no call fans out to the workers anymore */
+pthread_mutex_lock(&pool.dispatch_mutex);
+n = pool.number_of_workers;
+pool.number_of_workers = 0;
+
+for(i=0; i<n; i++){ sem_post(&pool.wake[i]); }
+for(i=0; i<n; i++){
+	pthread_join(pool.threads[i], NULL);
+	sem_destroy(&pool.wake[i]);
+	}
+}
+
+
+
+/**
+ * Measures the costs, see raid6_smp_calibrate(). The pool must be started.
+ *
+ * @returns	 void
+ */
+
+HOST static void smp_measure(void)
+{
+int i;
+double t;
+double inline_time		= 0;
+double fan_out_time		= 0;
+int fanned_out			= 0;
+void **dptrs;
+
+/* concurrent callers keep the old values while one of them measures */
+if( pthread_mutex_trylock(&calibration_mutex) != 0 ){ return; }
+
+if(calibration_ptrs == NULL){
+	calibration_ptrs = allocate_host_example_dpointer(SMP_CALIBRATION_BYTES, SMP_CALIBRATION_DISKS);
+	for(i=0; i<SMP_CALIBRATION_DISKS; i++){
+		memset(calibration_ptrs[i], i, SMP_CALIBRATION_BYTES);
 		}
-	
-	for(i=0; i<number_of_threads; i++){
-		rc = pthread_join(threads[i], &status);
-		if (rc){
-			printf("ERROR; return code from pthread_join() is %d\n", rc);
-			exit(-1);
-			}
+	}
+dptrs = calibration_ptrs;
+
+/* warm up the caches before anything gets measured */
+smp_syndrome_range(SMP_CALIBRATION_DISKS, dptrs, 0, SMP_CALIBRATION_BYTES);
+
+t = gtd_second();
+for(i=0; i<SMP_CALIBRATION_LOOPS; i++){
+	smp_syndrome_range(SMP_CALIBRATION_DISKS, dptrs, 0, SMP_CALIBRATION_BYTES);
+	}
+inline_time = (gtd_second() - t) / SMP_CALIBRATION_LOOPS;
+
+/* an empty fan-out to every worker measures the pure dispatch overhead */
+if( (pool.number_of_workers > 0) && (pthread_mutex_trylock(&pool.dispatch_mutex) == 0) ){
+	t = gtd_second();
+	for(i=0; i<SMP_CALIBRATION_LOOPS; i++){
+		smp_dispatch(SMP_CALIBRATION_DISKS, 0, dptrs, pool.number_of_workers+1);
 		}
+	fan_out_time = (gtd_second() - t) / SMP_CALIBRATION_LOOPS;
+	fanned_out	 = 1;
+	pthread_mutex_unlock(&pool.dispatch_mutex);
+	}
+
+byte_cost = inline_time / ((double)SMP_CALIBRATION_BYTES * SMP_CALIBRATION_DISKS);
+if(fanned_out){
+	dispatch_cost = fan_out_time / pool.number_of_workers;
+	}
+last_calibration = gtd_second();
 
-//pthread_exit(NULL);
+pthread_mutex_unlock(&calibration_mutex);
 
+#ifdef DEBUG_LEVEL_1
+syslog(LOG_NOTICE, "SMP calibration : %f usec dispatch per thread, %f nsec per byte\n",
+	dispatch_cost*1e6, byte_cost*1e9);
+#endif
 }
 
 
 
 /**
- * This function is the real thread-code which calculates the syndromes.
+ * Chooses the number of threads for one call. With w as the inline compute time
+ * of the stripe and c as the dispatch cost per woken worker, n threads need
+ * about w/n + (n-1)*c, which is minimal at n = sqrt(w/c).
+ *
+ * @param	disks 				: number of disks
+ * @param	bytes				: number of bytes per disks
+ *
+ * @returns	 int : number of threads including the caller, 1 means inline
+ */
+
+HOST static int smp_plan_threads(int disks, size_t bytes)
+{
+int number_of_threads;
+double work = (double)bytes * disks * byte_cost;
+
+if( (pool.number_of_workers == 0) || (bytes < 2*SMP_MIN_SLICE) ){
+	return 1;
+	}
+
+if(dispatch_cost <= 0){
+	number_of_threads = pool.number_of_workers + 1;
+	}
+else{
+	number_of_threads = (int)sqrt(work / dispatch_cost);
+	}
+
+if( number_of_threads > (int)(bytes / SMP_MIN_SLICE) ){
+	number_of_threads = bytes / SMP_MIN_SLICE;
+	}
+if( number_of_threads > pool.number_of_workers + 1 ){
+	number_of_threads = pool.number_of_workers + 1;
+	}
+
+return number_of_threads;
+}
+
+
+
+/**
+ * Splits one stripe into number_of_threads slices, if the worker pool is not
+ * used by another caller.
  *
  * @param	disks 				: number of disks
  * @param	bytes				: number of bytes per disks
  * @param	**ptrs				: pointers to the disks data
- * @param	thread_id			: number of the thread where this function is executed
- * @param	number_of_threads	: number of all threads
+ * @param	number_of_threads	: number of threads including the caller
+ *
+ * @returns	 EXIT_SUCCESS or EXIT_FAILURE if the pool is busy
+ */
+
+HOST static int smp_fan_out(int disks, size_t bytes, void **ptrs, int number_of_threads)
+{
+if( pthread_mutex_trylock(&pool.dispatch_mutex) != 0 ){
+	return EXIT_FAILURE;
+	}
+
+smp_dispatch(disks, bytes, ptrs, number_of_threads);
+
+pthread_mutex_unlock(&pool.dispatch_mutex);
+return EXIT_SUCCESS;
+}
+
+
+
+/**
+ * Slice 0 is computed by the calling thread, all others by the first 
+ * number_of_threads-1 pool workers. The caller must hold the dispatch mutex.
+ *
+ * @param	disks 				: number of disks
+ * @param	bytes				: number of bytes per disks
+ * @param	**ptrs				: pointers to the disks data
+ * @param	number_of_threads	: number of threads including the caller
+ *
+ * @returns	 void
+ */
+
+HOST static void smp_dispatch(int disks, size_t bytes, void **ptrs, int number_of_threads)
+{
+int i;
+size_t stop;
+
+pool.job.disks				= disks;
+pool.job.bytes				= bytes;
+pool.job.ptrs				= ptrs;
+pool.job.number_of_threads	= number_of_threads;
+pool.pending				= number_of_threads-1;
+
+for(i=0; i<number_of_threads-1; i++){
+	sem_post(&pool.wake[i]);
+	}
+
+stop = (bytes/number_of_threads) & ~(size_t)(NSIZE-1);
+smp_syndrome_range(disks, ptrs, 0, stop);
+
+sem_wait(&pool.done);
+}
+
+
+
+/**
+ * Starts the worker pool with one thread less than there are cpus, because the
+ * calling thread always takes part in the computation, and its calibrator.
+ *
+ * @returns	 void
+ */
+
+HOST static void smp_pool_start(void)
+{
+int i;
+int rc;
+
+pthread_mutex_init(&pool.dispatch_mutex, NULL);
+sem_init(&pool.done, 0, 0);
+
+pool.number_of_workers	= get_number_of_phys_cpus() - 1;
+pool.threads			= (pthread_t *)malloc(pool.number_of_workers * sizeof(pthread_t));
+pool.wake				= (sem_t *)malloc(pool.number_of_workers * sizeof(sem_t));
+
+for(i=0; i<pool.number_of_workers; i++){
+	sem_init(&pool.wake[i], 0, 0);
+
+	rc = pthread_create(&pool.threads[i], NULL, smp_worker, (void *)(long)i);
+	if(rc){
+		printf("ERROR; return code from pthread_create() is %d\n", rc);
+		exit(-1);
+		}
+	}
+
+/* every call waits on pool_once, so none plans without the costs */
+smp_measure();
+
+pthread_mutex_init(&pool.stop_mutex, NULL);
+pthread_cond_init(&pool.stop_cond, NULL);
+pool.started = 1;
+
+/* without a calibrator the costs of the first calibration are kept */
+pool.calibrating = (pthread_create(&pool.calibrator, NULL, smp_calibrator, NULL) == 0);
+if(!pool.calibrating){
+	syslog(LOG_NOTICE, "SMP calibration is not refreshed, no calibrator thread\n");
+	}
+}
+
+
+
+/**
+ * Body of the calibrator thread of the pool. It refreshes the costs every 
+ * SMP_RECALIBRATION_INTERVAL seconds until the pool is stopped. It fans out
+ * like a server thread does and sleeps most of the time, so it runs in the
+ * server role and leaves the worker slots to the compute threads.
+ *
+ * @param	*arg				: unused
+ *
+ * @returns	 void
+ */
+
+HOST static void *smp_calibrator(void *arg)
+{
+struct timespec deadline;
+
+affinity_apply(AFFINITY_SERVER);
+
+pthread_mutex_lock(&pool.stop_mutex);
+while(!pool.stop){
+	clock_gettime(CLOCK_REALTIME, &deadline);
+	deadline.tv_sec += SMP_RECALIBRATION_INTERVAL;
+	
+	if( (pthread_cond_timedwait(&pool.stop_cond, &pool.stop_mutex, &deadline) == ETIMEDOUT) && !pool.stop ){
+		pthread_mutex_unlock(&pool.stop_mutex);
+		smp_measure();
+		pthread_mutex_lock(&pool.stop_mutex);
+		}
+	}
+pthread_mutex_unlock(&pool.stop_mutex);
+
+return NULL;
+}
+
+
+
+/**
+ * This function is the real thread-code of a pool worker. Worker i computes
+ * slice i+1 of the stripe that was published in pool.job.
+ *
+ * @param	*arg				: index of the worker
  *
  * @returns	 void
  */
 
-HOST static void *proc_thread_dep_syndrome(void *arg)
+HOST static void *smp_worker(void *arg)
 {
-int start, stop;
-struct thread_data *data;
-data = (struct thread_data *)arg;
+int index = (int)(long)arg;
+int thread_id;
+int number_of_threads;
+size_t bytes;
+size_t slice;
+size_t start, stop;
+
+affinity_apply(AFFINITY_WORKER);
+
+while(TRUE){
+	sem_wait(&pool.wake[index]);
+	if(pool.stop){ break; }
+
+	thread_id			= index+1;
+	number_of_threads	= pool.job.number_of_threads;
+	bytes				= pool.job.bytes;
+	slice				= (bytes/number_of_threads) & ~(size_t)(NSIZE-1);
+
+	start = slice*thread_id;
+	if( (thread_id+1) == number_of_threads){ stop = bytes; }
+	else{ stop = start+slice; }
+
+	smp_syndrome_range(pool.job.disks, pool.job.ptrs, start, stop);
+
+	if( __sync_sub_and_fetch(&pool.pending, 1) == 0 ){
+		sem_post(&pool.done);
+		}
+	}
+
+return NULL;
+}
 
-int disks				= data->disks;
-size_t bytes			= data->bytes;
-void **ptrs				= data->ptrs;
-int thread_id			= data->thread_id;
-int number_of_threads	= data->number_of_threads;
 
 
+/**
+ * Calculates the syndromes for the byte range [start, stop) of every disk.
+ *
+ * @param	disks 				: number of disks
+ * @param	**ptrs				: pointers to the disks data
+ * @param	start				: first byte
+ * @param	stop				: first byte behind the range
+ *
+ * @returns	 void
+ */
+
+HOST static void smp_syndrome_range(int disks, void **ptrs, size_t start, size_t stop)
+{
 // RS DEPENDEND
 u8 **dptr = (u8 **)ptrs;
 u8 *p, *q;
-int d, z, z0;
+size_t d;
+int z, z0;
 
 unative_t wd0, wq0, wp0, w10, w20;
 
@@ -163,10 +548,6 @@ p = dptr[z0+1];		// XOR parity
 q = dptr[z0+2];		// RS syndrome
 // RS DEPENDEND
 
-start = (bytes/number_of_threads)*thread_id;
-if( (thread_id+1) == number_of_threads){ stop = bytes; }
-else{ stop  = start+(bytes/number_of_threads); }
-
 for ( d = start ; d < stop ; d += NSIZE ){
 	wq0 = wp0 = *(unative_t *)&dptr[z0][d];
 	for ( z = z0-1 ; z >= 0 ; z-- ){
@@ -181,8 +562,6 @@ for ( d = start ; d < stop ; d += NSIZE ){
 	*(unative_t *)&p[d] = wp0;
 	*(unative_t *)&q[d] = wq0;
 	}
-
-pthread_exit(NULL);
 }
 
 
@@ -41,8 +41,9 @@
 
 
 /**
- * This is the SMP-version of the gen_syndrome function. It uses the systemcall
- * fork() for the thread as process execution.
+ * This is the SMP-version of the gen_syndrome function. Depending on the size
+ * of the stripe it runs inline on the calling thread, on a subset of the
+ * worker pool or on all of its threads.
  *
  * @param	disks 				: number of disks
  * @param	bytes				: number of bytes per disks
@@ -53,4 +54,41 @@
 
 HOST void raid6_smp_gen_syndrome(int disks, size_t bytes, void **ptrs);
 
+
+
+/**
+ * Measures the per thread dispatch cost and the inline compute cost which are
+ * used to choose the number of threads per call.
+ *
+ * @returns	 void
+ */
+
+HOST void raid6_smp_calibrate(void);
+
+
+
+/**
+ * Stops the calibrator and the workers of the pool and joins them, later 
+ * calls compute inline.
+ *
+ * @returns	 void
+ */
+
+HOST void raid6_smp_stop(void);
+
+
+
+/**
+ * Starts the worker pool and runs the first calibration, it returns when the
+ * costs are known. The SMP implementation keeps no per worker state and is 
+ * reentrant: a call which finds the pool busy computes inline on the calling
+ * thread.
+ *
+ * @param	*ctx				: context of the calling worker
+ *
+ * @returns	 EXIT_SUCCESS
+ */
+
+HOST int raid6_smp_context_init(syndrome_context *ctx);
+
 #endif
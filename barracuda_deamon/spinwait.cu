@@ -0,0 +1,263 @@
+/**
+ * \file
+ * \brief	Adaptive busy-poll before a blocking wait for the request pickup
+ *
+ * @author	Dominic Eschweiler weiler@upb.de
+ *
+ * Status	: STABLE \n
+ * Date of creation : 18.10.2026
+ *
+ */
+
+
+/*****************************************************************
+ *
+ * Barracuda is a experimental microdriver extension to the 
+ * linux-kernel that is able to outsource common functions to
+ * the userspace. It was intensionally designed to accelerate
+ * CPU-intensive Tasks on a GPU.
+ *
+ * Copyright (C) 2009 Dominic Eschweiler
+ *
+ * This program is free software; you can redistribute it and/or 
+ * modify it under the terms of the GNU General Public License as 
+ * published by the Free Software Foundation; either only GPLv2 - 
+ * version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful, 
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of 
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the 
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public 
+ * License along with this program; 
+ * if not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <syslog.h>
+
+#include <sys/eventfd.h>
+
+#ifdef __WAITPKG__
+	#include <immintrin.h>
+	#include <cpuid.h>
+#endif
+
+# include "spinwait.h"
+
+/* __Pause__
+ * Tells the core that this is a spin loop, which frees the pipeline for the
+ * sibling hyperthread and avoids the memory order flush at the exit of the 
+ * loop. umwait is only compiled with -mwaitpkg and used if the CPU has it.
+ */
+#if defined(__x86_64__) || defined(__i386__)
+	#define spin_relax()	__builtin_ia32_pause()
+#else
+	#define spin_relax()	__sync_synchronize()
+#endif
+
+/* the clock is read only every SPIN_CLOCK_STRIDE rounds of the poll */
+#define SPIN_CLOCK_STRIDE	32
+
+/* weight of the newest wait in the average is 1/(1 << SPIN_AVG_SHIFT) */
+#define SPIN_AVG_SHIFT		3
+
+
+
+/**
+ * Monotonic time in nanoseconds.
+ *
+ * @returns	 unsigned long long : nanoseconds
+ */
+
+static unsigned long long spin_now(void)
+{
+struct timespec ts;
+
+clock_gettime(CLOCK_MONOTONIC, &ts);
+return (unsigned long long)ts.tv_sec * 1000000000ULL + (unsigned long long)ts.tv_nsec;
+}
+
+
+
+/**
+ * Checks for the user level monitor/wait instructions.
+ *
+ * @returns	 1 if umwait can be used
+ */
+
+static int spin_has_umwait(void)
+{
+#ifdef __WAITPKG__
+unsigned int eax, ebx, ecx, edx;
+
+if( !__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx) ){ return 0; }
+return (ecx >> 5) & 1;
+#else
+return 0;
+#endif
+}
+
+
+
+/**
+ * Prepares the wait strategy. The budget starts at the bound and follows the
+ * arrival rate from the first request on.
+ *
+ * @param *sw		: wait strategy
+ * @param spin_us	: upper bound of the busy-poll in microseconds
+ *
+ * @returns	 void
+ */
+
+HOST void spin_wait_init(spin_wait *sw, unsigned int spin_us)
+{
+memset(sw, 0, sizeof(spin_wait));
+
+sw->spin_max_ns = (unsigned long long)spin_us * 1000;
+sw->budget_ns	= sw->spin_max_ns;
+sw->use_umwait	= (spin_us > 0) ? spin_has_umwait() : 0;
+}
+
+
+
+/**
+ * Busy-polls the submission word for the current budget.
+ *
+ * @param *sw		: wait strategy
+ * @param *word		: submission word
+ * @param old		: value of the word while there is no request
+ *
+ * @returns	 1 if the word changed, 0 if the caller has to sleep
+ */
+
+HOST int spin_wait_poll(spin_wait *sw, volatile unsigned int *word, unsigned int old)
+{
+unsigned long long start;
+unsigned long long now;
+unsigned int rounds = 0;
+
+start = now = spin_now();
+if( !sw->waiting ){
+	sw->waiting	   = 1;
+	sw->wait_start = start;
+	}
+
+while( *word == old ){
+	if( (++rounds % SPIN_CLOCK_STRIDE) == 0 ){
+		now = spin_now();
+		if(now - start >= sw->budget_ns){ break; }
+		}
+	else if(sw->budget_ns == 0){
+		break;
+		}
+	
+#ifdef __WAITPKG__
+	if(sw->use_umwait){
+		/* sleeps in C0.1 until the word is written or the deadline of ~1us */
+		_umonitor((void *)word);
+		if(*word == old){ _umwait(1, __rdtsc() + 2000); }
+		continue;
+		}
+#endif
+	spin_relax();
+	}
+
+if(rounds > 0){ now = spin_now(); }
+sw->stats.spin_ns += now - start;
+
+if(*word != old){
+	if(rounds > 0){ sw->stats.spin_hits++; }
+	else{ sw->stats.pending++; }
+	return 1;
+	}
+
+return 0;
+}
+
+
+
+/**
+ * Blocks on the eventfd of the submissions and accounts the time as sleep.
+ *
+ * @param *sw		: wait strategy
+ * @param fd		: eventfd of the submissions
+ *
+ * @returns	 0 or -1 if the read was interrupted
+ */
+
+HOST int spin_wait_sleep(spin_wait *sw, int fd)
+{
+unsigned long long start = spin_now();
+eventfd_t count;
+int ret;
+
+ret = eventfd_read(fd, &count);
+
+sw->stats.sleep_ns += spin_now() - start;
+sw->stats.sleeps++;
+
+return ret;
+}
+
+
+
+/**
+ * Ends a wait on the arrival of a request and adapts the spin budget to the
+ * time the request took to come. Spinning for twice the mean wait catches
+ * most of the requests of a busy array; if the mean wait exceeds the bound 
+ * the spin would be wasted and the budget drops to zero until the arrivals
+ * speed up again. The waits are measured including the sleeps, so an idle 
+ * array costs no CPU and still notices when the load comes back.
+ *
+ * @param *sw		: wait strategy
+ *
+ * @returns	 void
+ */
+
+HOST void spin_wait_arrived(spin_wait *sw)
+{
+unsigned long long wait;
+
+if( !sw->waiting ){ return; }
+sw->waiting = 0;
+sw->stats.requests++;
+
+if(sw->spin_max_ns == 0){ return; }
+
+wait = spin_now() - sw->wait_start;
+
+if(sw->stats.requests == 1){ sw->wait_avg_ns = wait; }
+else{ sw->wait_avg_ns = sw->wait_avg_ns - (sw->wait_avg_ns >> SPIN_AVG_SHIFT) + (wait >> SPIN_AVG_SHIFT); }
+
+if(sw->wait_avg_ns >= sw->spin_max_ns){ sw->budget_ns = 0; }
+else if(2 * sw->wait_avg_ns >= sw->spin_max_ns){ sw->budget_ns = sw->spin_max_ns; }
+else{ sw->budget_ns = 2 * sw->wait_avg_ns; }
+}
+
+
+
+/**
+ * Writes the spin and the sleep time to the syslog.
+ *
+ * @param *sw		: wait strategy
+ *
+ * @returns	 void
+ */
+
+HOST void spin_wait_report(spin_wait *sw)
+{
+spin_wait_stats *st = &sw->stats;
+double total = (double)(st->spin_ns + st->sleep_ns);
+
+syslog(LOG_NOTICE, "Wait strategy : %lu requests, %lu already pending, %lu caught spinning, %lu sleeps\n",
+		st->requests, st->pending, st->spin_hits, st->sleeps);
+syslog(LOG_NOTICE, "Wait strategy : %.3f s spinning (%.1f%%), %.3f s sleeping, budget %llu us of %llu us%s\n",
+		(double)st->spin_ns / 1e9, (total > 0) ? 100.0 * (double)st->spin_ns / total : 0.0,
+		(double)st->sleep_ns / 1e9, sw->budget_ns / 1000, sw->spin_max_ns / 1000,
+		sw->use_umwait ? ", umwait" : "");
+}
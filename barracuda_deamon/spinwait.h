@@ -0,0 +1,139 @@
+/**
+ * \file
+ * \brief	Adaptive busy-poll before a blocking wait for the request pickup
+ *
+ * @author	Dominic Eschweiler weiler@upb.de
+ *
+ * Status	: STABLE \n
+ * Date of creation : 18.10.2026
+ *
+ */
+
+
+/*****************************************************************
+ *
+ * Barracuda is a experimental microdriver extension to the 
+ * linux-kernel that is able to outsource common functions to
+ * the userspace. It was intensionally designed to accelerate
+ * CPU-intensive Tasks on a GPU.
+ *
+ * Copyright (C) 2009 Dominic Eschweiler
+ *
+ * This program is free software; you can redistribute it and/or 
+ * modify it under the terms of the GNU General Public License as 
+ * published by the Free Software Foundation; either only GPLv2 - 
+ * version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful, 
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of 
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the 
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public 
+ * License along with this program; 
+ * if not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************/
+
+#ifndef __SPINWAIT__
+#define __SPINWAIT__
+
+# include "definitions.h"
+
+/*! \def SPIN_DEFAULT_US
+	\brief Default upper bound of the busy-poll, zero never spins */
+
+#define SPIN_DEFAULT_US		0
+
+/*! \var typedef struct spin_wait_stats;
+	\brief Where the waiting time of the daemon went */
+
+typedef struct spin_wait_stats{
+	unsigned long requests;
+	unsigned long pending;
+	unsigned long spin_hits;
+	unsigned long sleeps;
+	unsigned long long spin_ns;
+	unsigned long long sleep_ns;
+	}spin_wait_stats;
+
+/*! \var typedef struct spin_wait;
+	\brief State of the wait strategy of one server loop */
+
+typedef struct spin_wait{
+	unsigned long long spin_max_ns;
+	unsigned long long budget_ns;
+	unsigned long long wait_avg_ns;
+	unsigned long long wait_start;
+	int waiting;
+	int use_umwait;
+	spin_wait_stats stats;
+	}spin_wait;
+
+
+
+/**
+ * Prepares the wait strategy. The budget starts at the bound and follows the
+ * arrival rate from the first request on.
+ *
+ * @param *sw		: wait strategy
+ * @param spin_us	: upper bound of the busy-poll in microseconds
+ *
+ * @returns	 void
+ */
+
+HOST void spin_wait_init(spin_wait *sw, unsigned int spin_us);
+
+
+
+/**
+ * Busy-polls the submission word for the current budget.
+ *
+ * @param *sw		: wait strategy
+ * @param *word		: submission word
+ * @param old		: value of the word while there is no request
+ *
+ * @returns	 1 if the word changed, 0 if the caller has to sleep
+ */
+
+HOST int spin_wait_poll(spin_wait *sw, volatile unsigned int *word, unsigned int old);
+
+
+
+/**
+ * Blocks on the eventfd of the submissions and accounts the time as sleep.
+ *
+ * @param *sw		: wait strategy
+ * @param fd		: eventfd of the submissions
+ *
+ * @returns	 0 or -1 if the read was interrupted
+ */
+
+HOST int spin_wait_sleep(spin_wait *sw, int fd);
+
+
+
+/**
+ * Ends a wait on the arrival of a request and adapts the spin budget to the
+ * time the request took to come.
+ *
+ * @param *sw		: wait strategy
+ *
+ * @returns	 void
+ */
+
+HOST void spin_wait_arrived(spin_wait *sw);
+
+
+
+/**
+ * Writes the spin and the sleep time to the syslog.
+ *
+ * @param *sw		: wait strategy
+ *
+ * @returns	 void
+ */
+
+HOST void spin_wait_report(spin_wait *sw);
+
+#endif
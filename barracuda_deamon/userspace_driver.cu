@@ -47,6 +47,7 @@
 #include <sys/time.h>
 #include <math.h>
 #include <fcntl.h>
+#include <errno.h>
 #include <sched.h>
 #include <signal.h>
 #include <syslog.h>
@@ -58,57 +59,154 @@
 #include <memory.h>
 #include <malloc.h>
 #include <sys/ioctl.h>
+#include <sys/eventfd.h>
+#include <pthread.h>
+#include <semaphore.h>
 
 #ifndef NOCUDA
 	#include <cuda_runtime_api.h>
 	#include "cuda/raid6cuda.h"
 #endif
 
-#include "vanilla/raid6vanilla.h"
-#include "smp/raid6smp.h"
 #include "userspace_driver.h"
 #include "definitions.h"
+#include "backends.h"
 #include "service.h"
+#include "affinity.h"
+#include "async.h"
+#include "mpmc.h"
+#include "ring.h"
+#include "loopback.h"
+#include "spinwait.h"
+#include "coalesce.h"
+#include "usock.h"
+#include "calibrate.h"
+#include "pipeline.h"
+#include "libbarracuda.h"
 
 void kill_handler(int signum);
 void alarm_handler(int signum);
+void usr1_handler(int signum);
 
-int server_ioctl_callback(syndrome_func gen_syndrome);
-int server_netlink(syndrome_func gen_syndrome);
-int server_procfs(syndrome_func gen_syndrome);
+int compute_pool_start(syndrome_backend *backend, int workers, int depth);
+void compute_pool_stop(void);
+void compute_batch(driver_context *dc);
+void compute_pool_report(void);
 
-syndrome_container *copy_act_syndrome_block( void );
-void copyback_act_syndrome_block( syndrome_container *smc );
 
-syndrome_container *get_act_syndrome_block( void );
-void unget_act_syndrome_block( syndrome_container *smc );
+syndrome_container *copy_act_syndrome_block( driver_context *dc );
+void copyback_act_syndrome_block( driver_context *dc, syndrome_container *smc );
+
+syndrome_container *get_act_syndrome_block( driver_context *dc );
+void unget_act_syndrome_block( driver_context *dc, syndrome_container *smc );
+syndrome_container *sg_act_syndrome_block( driver_context *dc );
+void unget_sg_syndrome_block( driver_context *dc, syndrome_container *smc );
+
+syndrome_container *arena_act_syndrome_block( driver_context *dc );
+int arena_act_batch( driver_context *dc, syndrome_container *first );
+int arena_act_stripe( driver_context *dc, unsigned long offset, syndrome_container *smc, void **ptrs );
 
 void gen_message_container(struct msghdr *msg);
 void destroy_message_container(struct msghdr *msg);
-void add_payload(struct msghdr *msg, char *payload );
-void get_payload(struct msghdr *msg, char *payload);
+void put_message(struct msghdr *msg, int type, void *payload, size_t len);
+size_t take_message(struct msghdr *msg, size_t received, int type, void *payload, size_t max);
+
+static int device_conf_write(char *command);
+static int device_open(int flags);
+static void *device_mmap(size_t length, int prot, int fd, off_t offset);
+static int device_ioctl(int fd, unsigned long request, void *arg);
+static void *device_stub_open(void);
+static size_t device_stub_read(void *stub, void *buf, size_t count);
+static size_t device_stub_write(void *stub, void *buf, size_t count);
+static void device_stub_close(void *stub);
+static int device_nl_open(void);
+static int device_nl_sendmmsg(int sock, struct mmsghdr *msgs, unsigned int vlen);
+static int device_nl_recvmmsg(int sock, struct mmsghdr *msgs, unsigned int vlen);
+static void device_nl_close(int sock);
 
 
 /* Variables */
 volatile sig_atomic_t keep_going = 1;
-volatile static int fd;
-
-static syndrome_container *ret_global;
-static int smc_flag = 0;
-static void **global_dptrs;
-
-/* Defines */
-#define NETLINK_RS_SERVER 25
-#define NL_COMMAND 0x11
-#define MAX_PAYLOAD 1024
-#define IOCTL_GETVALUE 0x0001
+volatile sig_atomic_t report_stats = 0;
+
+/* A server thread of one ring shard */
+typedef struct ring_shard_server{
+	pthread_t thread;
+	driver_context dc;
+	unsigned int entries;
+	unsigned long slot_bytes;
+	}ring_shard_server;
+
+typedef struct ioctl_connection{
+	driver_context *dc;
+	int fd;
+	}ioctl_connection;
+
+/* request messages taken with one recvmmsg, completions sent with one sendmmsg */
+#define NL_MMSG_MAX 8
+
+typedef struct netlink_connection{
+	driver_context *dc;
+	int sock_fd;
+	struct mmsghdr in[NL_MMSG_MAX];
+	struct mmsghdr out[NL_MMSG_MAX];
+	int received;
+	int next;
+	int replies;
+	completion_coalescer coalesce;
+	unsigned long messages;
+	unsigned long recv_calls;
+	unsigned long send_calls;
+	}netlink_connection;
+
+/* the kernel passes the address of the request and two more bytes */
+#define PROCFS_TOKEN_BYTES	(sizeof(unsigned long)+2)
+
+typedef struct procfs_connection{
+	driver_context *dc;
+	void *fd;
+	}procfs_connection;
+
+typedef struct doorbell_connection{
+	driver_context *dc;
+	doorbell_page *db;
+	unsigned int seq;
+	spin_wait sw;
+	}doorbell_connection;
+
+/* The real kernel stub behind /proc/barracuda and /dev/barracuda */
+static kernel_ops device_kernel_ops = {
+	"device",
+	device_conf_write,
+	device_open,
+	close,
+	device_mmap,
+	munmap,
+	pread,
+	pwrite,
+	device_ioctl,
+	device_stub_open,
+	device_stub_read,
+	device_stub_write,
+	device_stub_close,
+	device_nl_open,
+	device_nl_sendmmsg,
+	device_nl_recvmmsg,
+	device_nl_close
+	};
 
 /* __Marshalling Method__
- * If this is undefined, the slow mmap method for marshalling is used. If this 
- * is defined, the copy_to_user method is used.
+ * The default of --marshal. If this is undefined, the slow mmap method for 
+ * marshalling is used. If this is defined, the copy_to_user method is used.
  */
 //#define COPY_MARSHALLING
 
+#ifdef COPY_MARSHALLING
+	#define MARSHAL_DEFAULT	MARSHAL_COPY
+#else
+	#define MARSHAL_DEFAULT	MARSHAL_MAP
+#endif
+
 
 /*MAIN_THREAD_________________________________________________________________*/
 /**
@@ -128,72 +226,168 @@ pid_t pid = getpid();
 struct stat status;
 thread_container *tc;
 int c_mode;
-syndrome_func gen_syndrome;
+driver_context dc;
+marshal_policy policy;
 
-/* Malloc the dptr array */
-global_dptrs = (void **)malloc(255 * sizeof(void*));
-	
-/* reassemble the function pointer and the mode number */	
+/* reassemble the backend and the mode number */	
 tc 				= (thread_container *)rs_function;
 c_mode			= tc->c_mode;
-gen_syndrome	= tc->gen_syndrome;
+
+memset(&dc, 0, sizeof(driver_context));
+dc.backend		= tc->backend;
+dc.kops			= tc->loopback ? loopback_kernel_ops() : &device_kernel_ops;
+dc.doorbell_submit		= -1;
+dc.doorbell_complete	= -1;
+dc.coalesce_count		= tc->coalesce_count;
+dc.coalesce_us			= tc->coalesce_us;
+
+/* Malloc the dptr array */
+dc.dptrs		= (void **)malloc(ARENA_MAX_DISKS * sizeof(void*));
+
+/* every stripe outside of the arena is mapped or copied as the policy says */
+marshal_policy_init(&policy, (tc->marshalling < 0) ? MARSHAL_DEFAULT : tc->marshalling);
+dc.marshal		= &policy;
 	
 syslog(LOG_NOTICE, "Daemon-Mode called\n");
 syslog(LOG_NOTICE, "Connection-Mode is %d\n", c_mode);
+syslog(LOG_NOTICE, "Kernel stub is the %s\n", dc.kops->name);
+syslog(LOG_NOTICE, "Backends of libbarracuda %u.%u\n", barracuda_api_version() >> 16, barracuda_api_version() & 0xffff);
+
+/* pin this thread, which serves the transport, and report the whole map */
+affinity_apply(AFFINITY_SERVER);
+affinity_report();
+
+/* lock before the mappings and buffers are set up, they are prefaulted then */
+if(tc->lock_memory){ memlock_start(); }
 	
 /* 
  store the pid into a file. This could also be used to look if there is 
- already baracuda process.
+ already baracuda process. The loopback stand-in may run next to a real daemon.
  */
 
-if( stat("/tmp/baracuda_pid", &status) == 0 ){
-	syslog(LOG_NOTICE, "There is already an existing pidfile !!!\n" );
-	syslog(LOG_NOTICE, "If the baracuda-process isn't already running, please delete /tmp/baracuda_pid\n");
-	return(EXIT_FAILURE);
-	}
+if( !tc->loopback ){
+	if( stat("/tmp/baracuda_pid", &status) == 0 ){
+		syslog(LOG_NOTICE, "There is already an existing pidfile !!!\n" );
+		syslog(LOG_NOTICE, "If the baracuda-process isn't already running, please delete /tmp/baracuda_pid\n");
+		return(EXIT_FAILURE);
+		}
 	
-FILE *fp = fopen("/tmp/baracuda_pid", "w+");
-if(fp == NULL){
-	syslog(LOG_NOTICE, "Can't open Pidfile %d\n", pid );
-	return EXIT_FAILURE;
-	}
+	FILE *fp = fopen("/tmp/baracuda_pid", "w+");
+	if(fp == NULL){
+		syslog(LOG_NOTICE, "Can't open Pidfile %d\n", pid );
+		return EXIT_FAILURE;
+		}
 	
-fwrite( (void *)&pid, sizeof(pid_t), 1, fp );
-fclose(fp);
+	fwrite( (void *)&pid, sizeof(pid_t), 1, fp );
+	fclose(fp);
+	}
 
-/* open /proc/baracuda/conf to pass the PID */
+/* pass the PID to /proc/baracuda/conf */
 char proc_pass[50];
 
-fp = fopen("/proc/barracuda/conf", "w+");
-if(fp == NULL){
+sprintf( (char *)&proc_pass, "pid=%d", pid);
+if( dc.kops->conf_write(proc_pass) == EXIT_FAILURE ){
 	syslog(LOG_NOTICE, "Can't open /proc/barracuda/conf for pid passing \n" );
 	return EXIT_FAILURE;
 	}
-sprintf( (char *)&proc_pass, "pid=%d", pid);
-fwrite( (void *)&proc_pass, strlen(proc_pass), 1, fp );
-fclose(fp);
-	
-/* open /proc/baracuda/conf to setup a connection type */
-fp = fopen("/proc/barracuda/conf", "w+");
-if(fp == NULL){
-	syslog(LOG_NOTICE, "Can't open /proc/barracuda/conf for mode passing \n" );
+
+/* offer our descriptor version, a stub which doesn't know descriptors ignores it */
+sprintf( (char *)&proc_pass, "proto=%d", BARRACUDA_PROTO_VERSION);
+if( dc.kops->conf_write(proc_pass) == EXIT_FAILURE ){
+	syslog(LOG_NOTICE, "Can't open /proc/barracuda/conf for proto passing \n" );
 	return EXIT_FAILURE;
 	}
 
-switch( c_mode ){
-	case 1 :	sprintf( (char *)&proc_pass, "con=NL");
-				fwrite( (void *)&proc_pass, strlen(proc_pass), 1, fp );
-				break;
-	case 2 :	sprintf( (char *)&proc_pass, "con=IOCTL");
-				fwrite( (void *)&proc_pass, strlen(proc_pass), 1, fp );
-				break;
-	case 3 :	sprintf( (char *)&proc_pass, "con=PROCFS");
-				fwrite( (void *)&proc_pass, strlen(proc_pass), 1, fp );
-				break;
-	default :	return EXIT_FAILURE; 
-}
-		
-fclose(fp);
+/* the priority classes of the admission scheduler, the stub has defaults */
+if(tc->sched != NULL){
+	sprintf( (char *)&proc_pass, "sched=%s", tc->sched);
+	if( dc.kops->conf_write(proc_pass) == EXIT_FAILURE ){
+		syslog(LOG_NOTICE, "Can't open /proc/barracuda/conf for sched passing \n" );
+		return EXIT_FAILURE;
+		}
+	}
+
+/* ask for a shared arena, this must happen before the connection type is set */
+if(tc->arena_size > 0){
+	sprintf( (char *)&proc_pass, "arena=%lu", (unsigned long)tc->arena_size);
+	if( dc.kops->conf_write(proc_pass) == EXIT_FAILURE ){
+		syslog(LOG_NOTICE, "Can't open /proc/barracuda/conf for arena passing \n" );
+		return EXIT_FAILURE;
+		}
+	}
+
+/* batches are handed over in the arena, the ring batches on its own */
+if( (tc->batch > 1) && (c_mode != 4) ){
+	if(tc->arena_size == 0){
+		syslog(LOG_NOTICE, "Batched pickup needs a shared arena, stripes are taken one by one\n" );
+		}
+	else{
+		sprintf( (char *)&proc_pass, "batch=%d", tc->batch);
+		if( dc.kops->conf_write(proc_pass) == EXIT_FAILURE ){
+			syslog(LOG_NOTICE, "Can't open /proc/barracuda/conf for batch passing \n" );
+			return EXIT_FAILURE;
+			}
+		dc.batch	  = (syndrome_container *)malloc(BATCH_MAX_STRIPES * sizeof(syndrome_container));
+		dc.batch_ptrs = (void **)malloc(BATCH_MAX_STRIPES * ARENA_MAX_DISKS * sizeof(void *));
+		}
+	}
+
+/* the stub serves larger requests slice by slice, the ring chunks by its slots */
+if( (tc->slice_bytes > 0) && (c_mode != 4) ){
+	sprintf( (char *)&proc_pass, "slice=%lu", (unsigned long)tc->slice_bytes);
+	if( dc.kops->conf_write(proc_pass) == EXIT_FAILURE ){
+		syslog(LOG_NOTICE, "Can't open /proc/barracuda/conf for slice passing \n" );
+		return EXIT_FAILURE;
+		}
+	}
+
+/* scatter-gather stripes need the segment table of the kernel */
+if(tc->marshalling == MARSHAL_SG){
+	if( dc.kops->conf_write("sg=1") == EXIT_FAILURE ){
+		syslog(LOG_NOTICE, "Can't open /proc/barracuda/conf for sg passing \n" );
+		return EXIT_FAILURE;
+		}
+	}
+
+/* the ring is allocated by the kernel before the connection type is set */
+if(c_mode == 4){
+	sprintf( (char *)&proc_pass, "ring=%u:%lu:%d", tc->ring_entries, tc->ring_slot_bytes, tc->server_threads);
+	if( dc.kops->conf_write(proc_pass) == EXIT_FAILURE ){
+		syslog(LOG_NOTICE, "Can't open /proc/barracuda/conf for ring passing \n" );
+		return EXIT_FAILURE;
+		}
+	sprintf( (char *)&proc_pass, "shard=%s", (tc->shard_by == RING_SHARD_STRIPE) ? "STRIPE" : "CPU");
+	if( dc.kops->conf_write(proc_pass) == EXIT_FAILURE ){
+		syslog(LOG_NOTICE, "Can't open /proc/barracuda/conf for shard passing \n" );
+		return EXIT_FAILURE;
+		}
+	}
+else if(tc->server_threads > 1){
+	syslog(LOG_NOTICE, "Several server threads need -c RING, the other connections have a single slot\n" );
+	}
+
+/* the ring consumer overlaps the requests on its own */
+if( tc->pipeline && (c_mode == 4) ){
+	syslog(LOG_NOTICE, "The request pipeline serves single-slot connections, -c RING is pipelined already\n" );
+	}
+	
+/* the doorbell needs two eventfds, the kernel takes them before the connection type is set */
+if( (c_mode == 5) || (c_mode == 6) ){
+	dc.doorbell_submit		= eventfd(0, 0);
+	dc.doorbell_complete	= eventfd(0, 0);
+	if( (dc.doorbell_submit < 0) || (dc.doorbell_complete < 0) ){
+		syslog(LOG_NOTICE, "Can't create the eventfds of the doorbell\n" );
+		return EXIT_FAILURE;
+		}
+	sprintf( (char *)&proc_pass, "doorbell=%d:%d", dc.doorbell_submit, dc.doorbell_complete);
+	if( dc.kops->conf_write(proc_pass) == EXIT_FAILURE ){
+		syslog(LOG_NOTICE, "Can't open /proc/barracuda/conf for doorbell passing \n" );
+		return EXIT_FAILURE;
+		}
+	}
+	
+/* the connection type is set once the daemon is ready to serve, see below */
+if( (c_mode < 1) || (c_mode > 6) ){ return EXIT_FAILURE; }
 
 /* Register a signal-handler which handles init.d stop call */
 
@@ -207,37 +401,163 @@ signal(SIGALRM, alarm_handler);
 signal(SIGTERM, kill_handler);
 signal(SIGKILL, kill_handler);
 
+/* SIGUSR1 writes the queue counters to the syslog */
+signal(SIGUSR1, usr1_handler);
+
 /* open a filepointer for mmaping or copy_to_user */
-fd=open("/dev/barracuda", O_RDWR);
-if(fd < 0){
+dc.fd=dc.kops->dev_open(O_RDWR);
+if(dc.fd < 0){
 	syslog(LOG_NOTICE, "fd opening failed !\n");
 	return(-1);
 	}
 
+/* map the shared arena once, it stays mapped until the daemon terminates */
+if(tc->arena_size > 0){
+	dc.arena = (arena_header *)dc.kops->dev_mmap(tc->arena_size, PROT_READ | PROT_WRITE, 
+												dc.fd, (off_t)ARENA_PGOFF*getpagesize());
+	if(dc.arena == MAP_FAILED){
+		syslog(LOG_NOTICE, "Mapping the shared arena failed, falling back to mmap per request\n");
+		dc.arena = NULL;
+		}
+	else{
+		dc.arena_size = tc->arena_size;
+		syslog(LOG_NOTICE, "Shared arena with %lu bytes mapped\n", (unsigned long)dc.arena_size);
+		}
+	}
+
+/* the descriptor page holds the negotiated version, without it every request is a GEN */
+dc.desc = (request_desc *)dc.kops->dev_mmap(sizeof(request_desc), PROT_READ | PROT_WRITE, 
+											dc.fd, (off_t)DESC_PGOFF*getpagesize());
+if(dc.desc == MAP_FAILED){ dc.desc = NULL; }
+dc.proto = (dc.desc != NULL) ? dc.desc->version : 0;
+syslog(LOG_NOTICE, "Protocol version %u\n", dc.proto);
+
+/* 
+ * The compute context is set up by the thread which serves the requests, 
+ * backends like CUDA bind their buffers to the calling thread.
+ */
+if( syndrome_context_init(dc.backend, &dc.ctx) == EXIT_FAILURE ){
+	syslog(LOG_NOTICE, "Can't initialise the %s context\n", dc.backend->name);
+	dc.kops->dev_close(dc.fd);
+	return EXIT_FAILURE;
+	}
+
+/* Start the compute workers, without them the transport computes inline */
+if( compute_pool_start(dc.backend, tc->compute_workers, tc->queue_depth) == EXIT_FAILURE ){
+	syslog(LOG_NOTICE, "Can't start the compute workers\n");
+	syndrome_context_release(dc.backend, &dc.ctx);
+	dc.kops->dev_close(dc.fd);
+	return EXIT_FAILURE;
+	}
+
+/* the arrays of --array bring their own backends and workers */
+if( array_start(dc.backend, tc->queue_depth) == EXIT_FAILURE ){
+	syslog(LOG_NOTICE, "Can't prepare the arrays\n");
+	array_stop();
+	compute_pool_stop();
+	syndrome_context_release(dc.backend, &dc.ctx);
+	dc.kops->dev_close(dc.fd);
+	return EXIT_FAILURE;
+	}
+
+/* the copy buffers are there before the first request instead of growing with them */
+if(tc->copy_disks > 0){
+	if( marshal_pool_reserve(&dc.pool, tc->copy_disks, tc->copy_bytes) == EXIT_FAILURE ){
+		syslog(LOG_NOTICE, "Can't allocate copy buffers of %d x %lu bytes, they grow with the requests\n",
+				tc->copy_disks, (unsigned long)tc->copy_bytes);
+		}
+	}
+
+/* -c AUTO times the connections with ping= and takes the best one */
+if(c_mode == 6){
+	c_mode = calibrate_connection(&dc, tc);
+	memset(&dc.faults, 0, sizeof(fault_counter));
+	}
+
+/* setup a connection type, md may send requests from now on */
+switch( c_mode ){
+	case 1 :	sprintf( (char *)&proc_pass, "con=NL");
+				break;
+	case 2 :	sprintf( (char *)&proc_pass, "con=IOCTL");
+				break;
+	case 3 :	sprintf( (char *)&proc_pass, "con=PROCFS");
+				break;
+	case 4 :	sprintf( (char *)&proc_pass, "con=RING");
+				break;
+	case 5 :	sprintf( (char *)&proc_pass, "con=DOORBELL");
+				break;
+}
+
+if( dc.kops->conf_write(proc_pass) == EXIT_FAILURE ){
+	syslog(LOG_NOTICE, "Can't open /proc/barracuda/conf for mode passing \n" );
+	array_stop();
+	compute_pool_stop();
+	syndrome_context_release(dc.backend, &dc.ctx);
+	dc.kops->dev_close(dc.fd);
+	return EXIT_FAILURE;
+	}
+
+/* userspace clients on the socket share the compute workers */
+if( (tc->socket != NULL) && (usock_start(tc->socket, dc.backend) == EXIT_FAILURE) ){
+	syslog(LOG_NOTICE, "Can't listen on %s, the socket service is off\n", tc->socket);
+	}
+
 /* Signal that everything is fine */
 syslog(LOG_NOTICE, "Daemon-Mode established %d\n", pid );
 
 /* Do something usefull */
 switch( c_mode ){
-	case 1 :	server_netlink(gen_syndrome);
+	case 1 :	server_netlink(&dc, tc->pipeline);
 				break;
-	case 2 :	server_ioctl_callback(gen_syndrome);
+	case 2 :	server_ioctl_callback(&dc, tc->pipeline);
 				break;
-	case 3 :	server_procfs(gen_syndrome);
+	case 3 :	server_procfs(&dc, tc->pipeline);
+				break;
+	case 4 :	server_ring_shards(&dc, tc);
+				break;
+	case 5 :	server_doorbell(&dc, tc->spin_us, tc->pipeline);
 				break;
 	default :	putchar('\a'); 
 }
 
 /* cleanup section */
+usock_stop();
+array_stop();
+compute_pool_stop();
+syndrome_context_release(dc.backend, &dc.ctx);
+stop_syndrome_backends();
 
 /* close the mmaping filepointer */
-if(fd >= 0){ close(fd); }
+if(dc.smc != NULL){ dc.kops->dev_munmap(dc.smc, sizeof(syndrome_container)); }
+if(dc.sg != NULL){ dc.kops->dev_munmap(dc.sg, sizeof(sg_table)); }
+if(dc.desc != NULL){ dc.kops->dev_munmap(dc.desc, sizeof(request_desc)); }
+if(dc.arena != NULL){ dc.kops->dev_munmap(dc.arena, dc.arena_size); }
+if(dc.fd >= 0){ dc.kops->dev_close(dc.fd); }
+if(dc.doorbell_submit >= 0){ close(dc.doorbell_submit); }
+if(dc.doorbell_complete >= 0){ close(dc.doorbell_complete); }
 
 /* delete lock */
-remove("/tmp/baracuda_pid");
+if( !tc->loopback ){ remove("/tmp/baracuda_pid"); }
 
 /* Free the dptr array */
-free(global_dptrs);
+free(dc.dptrs);
+
+marshal_report(&policy);
+if(dc.pool.grows > 0){
+	syslog(LOG_NOTICE, "copy buffers : %d x %lu bytes, reused %lu times, grown %lu times\n",
+			dc.pool.disks, (unsigned long)dc.pool.bytes, dc.pool.reuses, dc.pool.grows);
+	}
+marshal_pool_release(&dc.pool);
+marshal_policy_destroy(&policy);
+
+fault_report(&dc.faults, "request");
+
+if(dc.batch != NULL){
+	syslog(LOG_NOTICE, "batched pickup : %lu stripes in %lu batches, largest batch %d\n",
+			dc.batch_stripes, dc.batches, dc.batch_largest);
+	free(dc.batch);
+	free(dc.batch_ptrs);
+	}
 
 syslog(LOG_NOTICE, "Mode number was : %d.\n", c_mode);
 syslog(LOG_NOTICE, "Baracuda-Deamon terminated, please unload the kernel-module.\n");
@@ -246,6 +566,21 @@ return 0;
 
 
 
+/**
+ * Lets all server loops terminate, the same as the SIGALRM shutdown but 
+ * without the check for mounted md-devices. The loops leave with the next
+ * return from the kernel stub.
+ *
+ * @returns			void
+ */
+
+void userspace_driver_stop(void)
+{
+keep_going = 0;
+}
+
+
+
 /**
  * This is the handler which catchs the singnal SIGKILL and SIGTERM. This is 
  * necessary, because a simple kill can lead to an undefined state which could 
@@ -318,389 +653,1284 @@ if( signum == SIGALRM){
 
 
 
-/*SUB_THREADS_________________________________________________________________*/
 /**
- * This function is the userspace driver which is implementated with ioctl
- * callback method as the used connection technology.
+ * SIGUSR1 asks for a report of the queue counters. The report is written by
+ * the transport thread with the next request, syslog is not signal safe.
  *
- * @param gen_syndrome	: 	Function Pointer to one of the RS implementations, which
- *							are located in the raid6*.cu files.
+ * @param signum	: Signal number
  *
- * @returns				a pointer to the actual syndrome block.
+ * @returns			void
  */
 
-int server_ioctl_callback(syndrome_func gen_syndrome)
+void usr1_handler(int signum)
 {
-int fd;
-char buffer[] = "flag";
+report_stats = 1;
+signal(signum, usr1_handler);
+}
 
-/* syndrome data */
-int disks;
-size_t bytes;
-void **ptrs;
-syndrome_container *act_container;
 
-syslog(LOG_NOTICE, "IOCTL-Callback method called.\n");
-	
-/* Open device file for IOCTL handling */
-	
-fd = open("/dev/barracuda", O_RDONLY);
-if( fd < 0){
-	syslog(LOG_NOTICE, "IOCTL handler opening failed\n");
-	return -1;
-	}
-syslog(LOG_NOTICE, "IOCTL handler opened!\n");
-	
-/* Loop until the deamon is killed */
-	
-while( keep_going ){
-	/* Call the IOCTL */
-	ioctl(fd, IOCTL_GETVALUE, &buffer);
-	
-	/* get actual syndrome pointer */
-		
-	#ifdef DEBUG_LEVEL_3	
-	syslog(LOG_NOTICE, "next : get_act_syndrome_block\n");
-	#endif
 
-#ifdef COPY_MARSHALLING
-	act_container = copy_act_syndrome_block();
-#endif
-#ifndef COPY_MARSHALLING
-	act_container = get_act_syndrome_block();
-#endif
-	
-	/* Disassemble container */
-	disks = act_container->disks;
-	bytes = act_container->bytes;
-	ptrs  = act_container->ptrs;
-	
-	/* Pass to the gen syndrome function */
-	#ifdef DEBUG_LEVEL_3
-	syslog(LOG_NOTICE, "next : gen_syndrome\n");
-	#endif
-	
-	gen_syndrome(disks, bytes, ptrs);
-	
-	/* unmap everything */
-#ifdef COPY_MARSHALLING
-	copyback_act_syndrome_block(act_container);
-#endif
-#ifndef COPY_MARSHALLING
-	unget_act_syndrome_block(act_container);
-#endif
+/*COMPUTE_POOL________________________________________________________________*/
+/**
+ * Starts the compute workers behind the submission queue. With zero workers 
+ * the transport thread computes every request itself, which is the lowest 
+ * latency as long as the kernel hands out one stripe at a time.
+ *
+ * @param *backend	: backend the workers use
+ * @param workers	: number of workers
+ * @param depth		: slots of the submission queue
+ *
+ * @returns			EXIT_SUCCESS or EXIT_FAILURE
+ */
 
-	}
-	
-/* Close the opened IOCTL handler */
-if(fd >= 0){ close(fd); }
+int compute_pool_start(syndrome_backend *backend, int workers, int depth)
+{
+if(workers <= 0){ return EXIT_SUCCESS; }
 
-return 0;
+if( syndrome_async_start(backend, workers, depth) == EXIT_FAILURE ){ return EXIT_FAILURE; }
+
+syslog(LOG_NOTICE, "%d compute workers, request queue with %d slots\n", workers, depth);
+return EXIT_SUCCESS;
 }
 
 
 
 /**
- * This function is the userspace driver which is implemented with the netlink
- * method as the used connection technology.
- *
- * @param gen_syndrome	: 	Function Pointer to one of the RS implementations, which
- *							are located in the raid6*.cu files.
+ * Stops the compute workers and reports the queue counters.
  *
- * @returns				a pointer to the actual syndrome block.
+ * @returns			void
  */
 
-int server_netlink(syndrome_func gen_syndrome)
+void compute_pool_stop(void)
 {
-/* netlink related stuff */
-struct sockaddr_nl src_addr;
-int sock_fd;
-int bind_ret = 0;
-	
-struct msghdr msg_server;
-struct msghdr msg_client;
+if( !syndrome_async_active() ){ return; }
 
-/* syndrome data */
-int disks;
-size_t bytes;
-void **ptrs;
+compute_pool_report();
+syndrome_async_stop();
+}
 
-#ifdef DEBUG_LEVEL_1
-	unsigned long date;
-#endif
 
 
-char *buffer = (char *)malloc(sizeof(char)*MAX_PAYLOAD);
-syndrome_container *act_container;
+/**
+ * Computes one request. The request is submitted to the compute workers and
+ * the calling transport thread waits for its completion. If the queue is full
+ * the burst is absorbed by computing inline. A request which is the head of
+ * a batch in the shared arena is computed with the whole batch.
+ *
+ * @param *dc		: driver context of the transport thread
+ * @param *smc		: the request
+ *
+ * @returns			void
+ */
 
-syslog(LOG_NOTICE, "Netlink method called.\n");
+void compute_request(driver_context *dc, syndrome_container *smc)
+{
+syndrome_request req;
 
-/* create socket */
-sock_fd = socket(PF_NETLINK, SOCK_DGRAM, NETLINK_RS_SERVER);
-if(sock_fd < 0){
-	syslog(LOG_NOTICE, "Can't create netlink socket.\n");
-	exit(0);
+if(report_stats){
+	report_stats = 0;
+	compute_pool_report();
+	marshal_report(dc->marshal);
 	}
-	
-/* bind socket */
-memset( &src_addr, 0, sizeof(src_addr));
-src_addr.nl_family = AF_NETLINK;
-src_addr.nl_pid = getpid();
-src_addr.nl_groups = 0;
-	
-bind_ret = bind(sock_fd, (struct sockaddr*)&src_addr, sizeof(src_addr));
 
-if( bind_ret < 0 ){
-	syslog(LOG_NOTICE, "Can't bind netlink socket.\n");
-	exit(0);
+if( dc->arena_request && (dc->batch_count > 1) ){
+	compute_batch(dc);
+	return;
 	}
-	
-gen_message_container( &msg_client );
-gen_message_container( &msg_server );
-	
-while( keep_going ){
-	/** 
-	 * __first init every time__
-	 * Netlink communication must always be initialised from the userspace and
-	 * is not till then a bidirectional comunication method. For a correct 
-	 * working messaging modell, we first have to send an empty packet to the
-	 * kernelspace.
-	 */
-	
-	#ifdef DEBUG_LEVEL_1
-	syslog(LOG_NOTICE, "next : initial add_payload, sendmsg");
-	#endif
-		
-	add_payload( &msg_server, "init");
-	sendmsg(sock_fd, &msg_server, 0);
-	
-	/**
-	 * If there is a syndrome that must be calculated, the kernel sends a message 
-	 * to this handler.
-	 */
-	
-	#ifdef DEBUG_LEVEL_1
-	syslog(LOG_NOTICE, "next : recvmsg, get_payload");
-	#endif
-	
-	recvmsg(sock_fd, &msg_client, 0);
-	get_payload( &msg_client, buffer);
-	
-	#ifdef DEBUG_LEVEL_1
-	memcpy( &date, &buffer, sizeof(unsigned long));
-	syslog(LOG_NOTICE, "Adress is : %lu\n", date);
-	#endif
-		
-	#ifdef DEBUG_LEVEL_1	
-	syslog(LOG_NOTICE, "next : get_act_syndrome_block\n");
-	#endif
 
-	/* get actual syndrome pointer */
-#ifdef COPY_MARSHALLING
-	act_container = copy_act_syndrome_block();
-#endif
-#ifndef COPY_MARSHALLING
-	act_container = get_act_syndrome_block();
-#endif
-	
-	/* Disassemble container */
-	disks = act_container->disks;
-	bytes = act_container->bytes;
-	ptrs  = act_container->ptrs;
-	
-	/* Pass to the gen syndrome function */
-	#ifdef DEBUG_LEVEL_1
-	syslog(LOG_NOTICE, "next : gen_syndrome\n");
-	#endif
-	
-	gen_syndrome(disks, bytes, ptrs);
-	
-	/* unmap everything */
-#ifdef COPY_MARSHALLING
-	copyback_act_syndrome_block(act_container);
-#endif
-#ifndef COPY_MARSHALLING
-	unget_act_syndrome_block(act_container);
-#endif
-	
-	/* Acknowledge that all calculations are done */
-	#ifdef DEBUG_LEVEL_1
-	syslog(LOG_NOTICE, "next : add_payload\n");
-	#endif
-	
-	add_payload( &msg_server, buffer);
-	
-	#ifdef DEBUG_LEVEL_1
-	syslog(LOG_NOTICE, "next : sendmsg\n");
-	#endif
-		
-	sendmsg(sock_fd, &msg_server, 0);
+/* the arrays of --array compute with their own backend and workers */
+if(dc->array != NULL){
+	array_compute(dc->array, &dc->op, smc->disks, smc->bytes, smc->ptrs);
+	return;
 	}
-	
-close(sock_fd);
 
-destroy_message_container( &msg_server);
-destroy_message_container( &msg_client);
-free(buffer);
-	
-return 0;
+/* the operations besides OP_GEN are computed inline */
+if(dc->op.opcode != OP_GEN){
+	ops_call(dc->backend, &dc->ctx, &dc->op, smc->disks, smc->bytes, smc->ptrs);
+	return;
+	}
+
+/* the segments of a scatter-gather stripe are walked inline */
+if(dc->sg_request){
+	syndrome_call_sg(dc->backend, &dc->ctx, dc->sg, dc->sg_window);
+	return;
+	}
+
+syndrome_request_init(&req, smc->disks, smc->bytes, smc->ptrs, NULL, NULL);
+
+if( syndrome_submit(&req) == EXIT_SUCCESS ){
+	syndrome_wait(&req);
+	return;
+	}
+
+syndrome_call(dc->backend, &dc->ctx, smc->disks, smc->bytes, smc->ptrs);
 }
 
 
 
 /**
- * This function is the userspace driver which is implementated with the procfs
- * method as the used connection technology.
+ * Computes all stripes of a batch. They are submitted to the compute workers
+ * at once and waited for together, so the workers run them side by side; the
+ * stripes the queue can't take are computed inline meanwhile.
  *
- * @param gen_syndrome	: 	Function Pointer to one of the RS implementations, which
- *							are located in the raid6*.cu files.
+ * @param *dc		: driver context of the transport thread with the batch
  *
- * @returns				a pointer to the actual syndrome block.
+ * @returns			void
+ */
+
+void compute_batch(driver_context *dc)
+{
+syndrome_request req[BATCH_MAX_STRIPES];
+int submitted[BATCH_MAX_STRIPES];
+syndrome_container *smc;
+int i;
+
+for(i=0; i < dc->batch_count; i++){
+	smc = &dc->batch[i];
+	syndrome_request_init(&req[i], smc->disks, smc->bytes, smc->ptrs, NULL, NULL);
+	
+	submitted[i] = (syndrome_submit(&req[i]) == EXIT_SUCCESS);
+	if( !submitted[i] ){
+		syndrome_call(dc->backend, &dc->ctx, smc->disks, smc->bytes, smc->ptrs);
+		}
+	}
+
+for(i=0; i < dc->batch_count; i++){
+	if(submitted[i]){ syndrome_wait(&req[i]); }
+	}
+}
+
+
+
+/**
+ * Writes the counters of the request queue to the syslog.
+ *
+ * @returns			void
+ */
+
+void compute_pool_report(void)
+{
+mpmc_stats stats;
+
+if( !syndrome_async_active() ){
+	syslog(LOG_NOTICE, "Requests are computed inline, no request queue\n");
+	return;
+	}
+
+syndrome_async_stats(&stats);
+syslog(LOG_NOTICE, "request queue : depth %lu, high-water %lu, enqueued %lu, dequeued %lu, enqueue failures %lu\n",
+		(unsigned long)stats.depth, (unsigned long)stats.high_water, stats.enqueued, 
+		stats.dequeued, stats.enqueue_failures);
+}
+
+
+
+/*REQUEST_LOOP________________________________________________________________*/
+/**
+ * Maps the marshalling struct of the kernel stub, once per driver context.
+ *
+ * @param *dc		: driver context of the calling thread
+ *
+ * @returns	 EXIT_SUCCESS or EXIT_FAILURE
+ */
+
+static int map_marshalling_struct(driver_context *dc)
+{
+if(dc->smc != NULL){ return EXIT_SUCCESS; }
+
+dc->smc = (syndrome_container *)dc->kops->dev_mmap(sizeof(syndrome_container), PROT_READ, dc->fd, 0);
+if(dc->smc == MAP_FAILED){
+	dc->smc = NULL;
+	perror("MMAPing marshalling struct failed !\n");
+	return EXIT_FAILURE;
+	}
+
+return EXIT_SUCCESS;
+}
+
+
+
+/**
+ * Takes the operation of the actual request out of the request descriptor and
+ * routes it to its array, a stub of version 0 only knows OP_GEN.
+ *
+ * @param *dc		: driver context of the calling thread
+ *
+ * @returns	 EXIT_SUCCESS or EXIT_FAILURE if the descriptor is invalid
+ */
+
+static int take_op(driver_context *dc)
+{
+if( (dc->proto < 1) || (dc->desc == NULL) ){
+	memset(&dc->op, 0, sizeof(request_op));
+	return EXIT_SUCCESS;
+	}
+
+if( (ops_take(&dc->op, dc->desc) == EXIT_FAILURE) || (dc->desc->disks != dc->smc->disks) ||
+	(dc->desc->bytes != dc->smc->bytes) ){
+	dc->op.result = -EINVAL;
+	return EXIT_FAILURE;
+	}
+
+dc->op.result = array_route(&dc->op, dc->smc->disks, &dc->array);
+if(dc->op.result != 0){ return EXIT_FAILURE; }
+
+return EXIT_SUCCESS;
+}
+
+
+
+/**
+ * Stores the result of the actual operation in the request descriptor, this
+ * must happen before the acknowledgement.
+ *
+ * @param *dc		: driver context which fetched the request
+ *
+ * @returns			void
+ */
+
+void complete_op(driver_context *dc)
+{
+if( (dc->proto >= 1) && (dc->desc != NULL) ){ dc->desc->result = dc->op.result; }
+}
+
+
+
+/**
+ * Fetches the stripe of the actual request. A stripe outside of the shared 
+ * arena is mapped or copied, as the marshalling policy chooses for its size.
+ * An operation besides OP_GEN is never described as page lists.
+ *
+ * @param *dc		: driver context of the calling thread
+ *
+ * @returns	 syndrome_container * : the actual syndrome or NULL
+ */
+
+static syndrome_container *fetch_request(driver_context *dc)
+{
+syndrome_container *ret;
+unsigned long long start;
+
+dc->marshal_used = MARSHAL_MAP;
+dc->sg_request	 = 0;
+dc->array		 = NULL;
+memset(&dc->op, 0, sizeof(request_op));
+
+/* a stripe in the shared arena is neither mapped nor copied */
+ret = arena_act_syndrome_block(dc);
+if(ret != NULL){ return ret; }
+
+if( map_marshalling_struct(dc) == EXIT_FAILURE ){ return NULL; }
+
+/* the disk pointers of a driver context hold ARENA_MAX_DISKS */
+if( (dc->smc->disks <= 2) || (dc->smc->disks > ARENA_MAX_DISKS) ){
+	dc->op.result = -EINVAL;
+	return NULL;
+	}
+
+if( take_op(dc) == EXIT_FAILURE ){ return NULL; }
+
+start = marshal_clock_ns();
+dc->marshal_used = marshal_choose(dc->marshal, dc->smc->bytes);
+if( (dc->marshal_used == MARSHAL_SG) && (dc->op.opcode != OP_GEN) ){ dc->marshal_used = MARSHAL_MAP; }
+
+/* a stripe the kernel could not describe as page lists is mapped disk by disk */
+if(dc->marshal_used == MARSHAL_SG){
+	ret = sg_act_syndrome_block(dc);
+	if(ret != NULL){ return ret; }
+	dc->marshal_used = MARSHAL_MAP;
+	}
+
+if(dc->marshal_used == MARSHAL_COPY){ ret = copy_act_syndrome_block(dc); }
+else{ ret = get_act_syndrome_block(dc); }
+if(ret == NULL){ dc->op.result = -EIO; }
+
+dc->marshal_ns = marshal_clock_ns() - start;
+
+return ret;
+}
+
+
+
+/**
+ * Hands the checksums of a request back and releases its buffers. The cost of
+ * fetch and release goes to the marshalling policy.
+ *
+ * @param *dc		: driver context which fetched the request
+ * @param *smc		: the request
+ *
+ * @returns			void
+ */
+
+void release_request(driver_context *dc, syndrome_container *smc)
+{
+unsigned long long start = marshal_clock_ns();
+size_t bytes = smc->bytes;
+int measured = !dc->arena_request;
+
+if(dc->marshal_used == MARSHAL_COPY){ copyback_act_syndrome_block(dc, smc); }
+else if(dc->sg_request){ unget_sg_syndrome_block(dc, smc); }
+else{ unget_act_syndrome_block(dc, smc); }
+
+if(measured){
+	marshal_record(dc->marshal, dc->marshal_used, bytes, dc->marshal_ns + (marshal_clock_ns() - start));
+	}
+}
+
+
+
+/**
+ * Fetches the stripes of the actual request of a connection.
+ *
+ * @param *rt		: the connection
+ * @param *dc		: driver context which fetches
+ * @param *token	: token of the request
+ *
+ * @returns	 syndrome_container * : the actual syndrome or NULL
+ */
+
+syndrome_container *transport_fetch(request_transport *rt, driver_context *dc, char *token)
+{
+if(rt->fetch != NULL){ return rt->fetch(rt->arg, dc, token); }
+
+return fetch_request(dc);
+}
+
+
+
+/**
+ * Serves the requests of a single-slot connection one after the other. Every
+ * request is fetched, computed, released and acknowledged before the next one
+ * is waited for. With a budget the loop returns after that many requests.
+ *
+ * @param *dc		: driver context of the transport thread
+ * @param *rt		: the connection
+ *
+ * @returns			void
+ */
+
+static void serve_serial(driver_context *dc, request_transport *rt)
+{
+syndrome_container *act_container;
+char *token = (char *)malloc(MAX_PAYLOAD);
+fault_sample mark;
+fault_sample faults;
+
+while( keep_going ){
+	if( rt->wait(rt->arg, token) == EXIT_FAILURE ){ continue; }
+	
+	/* a bounded run times the arrivals of its requests */
+	if(dc->budget > 0){
+		dc->budget_last = marshal_clock_ns();
+		if(dc->budget_first == 0){ dc->budget_first = dc->budget_last; }
+		}
+	
+	/* the faults from the pickup to the acknowledgement */
+	memset(&faults, 0, sizeof(fault_sample));
+	fault_mark(&mark);
+	
+	#ifdef DEBUG_LEVEL_3	
+	syslog(LOG_NOTICE, "next : get_act_syndrome_block\n");
+	#endif
+	
+	act_container = transport_fetch(rt, dc, token);
+	
+	#ifdef DEBUG_LEVEL_3
+	syslog(LOG_NOTICE, "next : gen_syndrome\n");
+	#endif
+	
+	if(act_container != NULL){
+		compute_request(dc, act_container);
+		release_request(dc, act_container);
+		}
+	complete_op(dc);
+	
+	/* acknowledge that all calculations are done */
+	if(rt->ack != NULL){ rt->ack(rt->arg, token); }
+	
+	fault_since(&mark, &faults);
+	fault_record(&dc->faults, &faults, 1);
+	
+	if( (dc->budget > 0) && (--dc->budget == 0) ){ break; }
+	}
+
+free(token);
+}
+
+
+
+/**
+ * Serves the requests of a single-slot connection until the daemon is 
+ * stopped.
+ *
+ * @param *dc		: driver context of the transport thread
+ * @param *rt		: the connection
+ * @param pipeline	: fetch, compute and complete on three threads
+ *
+ * @returns			void
+ */
+
+static void serve_requests(driver_context *dc, request_transport *rt, int pipeline)
+{
+if( pipeline && (serve_pipelined(dc, rt) == EXIT_SUCCESS) ){ return; }
+
+serve_serial(dc, rt);
+}
+
+
+
+/*SUB_THREADS_________________________________________________________________*/
+/**
+ * Waits for the next request of the ioctl connection. The same ioctl 
+ * acknowledges the previous request.
+ *
+ * @param *arg		: ioctl connection
+ * @param *token	: unused
+ *
+ * @returns			EXIT_SUCCESS or EXIT_FAILURE if the call was interrupted
+ */
+
+static int ioctl_wait(void *arg, char *token)
+{
+ioctl_connection *con = (ioctl_connection *)arg;
+
+strcpy(token, "flag");
+if( con->dc->kops->dev_ioctl(con->fd, IOCTL_GETVALUE, token) < 0 ){ return EXIT_FAILURE; }
+
+return EXIT_SUCCESS;
+}
+
+
+
+/**
+ * This function is the userspace driver which is implementated with ioctl
+ * callback method as the used connection technology.
+ *
+ * @param *dc			: 	driver context with the backend and its compute
+ *							context
+ * @param pipeline		:	serve the requests with the three-stage pipeline
+ *
+ * @returns				a pointer to the actual syndrome block.
+ */
+
+int server_ioctl_callback(driver_context *dc, int pipeline)
+{
+ioctl_connection con;
+request_transport rt = { ioctl_wait, NULL, NULL, &con };
+int bounded = (dc->budget > 0);
+char done[5] = "done";
+
+syslog(LOG_NOTICE, "IOCTL-Callback method called.\n");
+	
+/* Open device file for IOCTL handling */
+con.dc = dc;
+con.fd = dc->kops->dev_open(O_RDONLY);
+if( con.fd < 0){
+	syslog(LOG_NOTICE, "IOCTL handler opening failed\n");
+	return -1;
+	}
+syslog(LOG_NOTICE, "IOCTL handler opened!\n");
+	
+/* Loop until the deamon is killed */
+serve_requests(dc, &rt, pipeline);
+
+/* the last request of a bounded run has no next ioctl which acknowledges it */
+if(bounded){ dc->kops->dev_ioctl(con.fd, IOCTL_GETVALUE, done); }
+	
+/* Close the opened IOCTL handler */
+dc->kops->dev_close(con.fd);
+
+return 0;
+}
+
+
+
+/**
+ * Takes the next request of the netlink connection. One recvmmsg takes all
+ * request messages the kernel has queued, they are handed out one by one.
+ *
+ * @param *arg		: netlink connection
+ * @param *token	: the nl_request is stored here
+ *
+ * @returns			EXIT_SUCCESS or EXIT_FAILURE if there is no request
+ */
+
+static int netlink_wait(void *arg, char *token)
+{
+netlink_connection *con = (netlink_connection *)arg;
+nl_request *req = (nl_request *)token;
+struct mmsghdr *in;
+size_t len;
+int n;
+
+if(con->next == con->received){
+	#ifdef DEBUG_LEVEL_1
+	syslog(LOG_NOTICE, "next : recvmmsg");
+	#endif
+	
+	n = con->dc->kops->nl_recvmmsg(con->sock_fd, con->in, NL_MMSG_MAX);
+	if(n <= 0){ return EXIT_FAILURE; }
+	
+	con->received = n;
+	con->next	  = 0;
+	con->recv_calls++;
+	}
+
+in = &con->in[con->next++];
+len = take_message(&in->msg_hdr, in->msg_len, NL_MSG_REQUEST, req, sizeof(nl_request));
+if( (len < NL_REQUEST_BYTES(1)) || (req->count == 0) || (req->count > NL_DESC_MAX) || 
+	(len < NL_REQUEST_BYTES(req->count)) ){
+	syslog(LOG_NOTICE, "Malformed netlink request dropped\n");
+	return EXIT_FAILURE;
+	}
+
+con->messages++;
+
+#ifdef DEBUG_LEVEL_1
+syslog(LOG_NOTICE, "Request %u with %u stripes\n", req->seq, req->count);
+#endif
+
+return EXIT_SUCCESS;
+}
+
+
+
+/**
+ * Fetches the stripes a netlink request describes. A stripe on the mmap/copy
+ * path comes alone, the stripes in the arena are collected like a batch.
+ *
+ * @param *arg		: netlink connection
+ * @param *dc		: driver context which fetches
+ * @param *token	: the nl_request, the statuses are filled in
+ *
+ * @returns	 syndrome_container * : the first stripe or NULL
+ */
+
+static syndrome_container *netlink_fetch(void *arg, driver_context *dc, char *token)
+{
+nl_request *req = (nl_request *)token;
+syndrome_container *ret;
+int max = (dc->batch != NULL) ? BATCH_MAX_STRIPES : 1;
+int i;
+
+dc->arena_request = 0;
+dc->batch_count	  = 0;
+dc->marshal_used  = MARSHAL_MAP;
+dc->sg_request	  = 0;
+dc->array		  = NULL;
+memset(&dc->op, 0, sizeof(request_op));
+
+for(i=0; i < req->count; i++){ req->desc[i].status = -EINVAL; }
+
+if(req->desc[0].offset == NL_DESC_MAPPED){
+	if(req->count != 1){ return NULL; }
+	
+	ret = fetch_request(dc);
+	if(ret != NULL){ req->desc[0].status = 0; }
+	return ret;
+	}
+
+ret = (syndrome_container *)malloc( sizeof(syndrome_container) );
+if( arena_act_stripe(dc, req->desc[0].offset, ret, dc->dptrs) == EXIT_FAILURE ){
+	free(ret);
+	return NULL;
+	}
+req->desc[0].status = 0;
+dc->arena_request	= 1;
+
+if(dc->batch == NULL){ return ret; }
+
+dc->batch[0]	= *ret;
+dc->batch_count = 1;
+for(i=1; (i < req->count) && (i < max); i++){
+	if( arena_act_stripe(dc, req->desc[i].offset, &dc->batch[dc->batch_count], 
+						 &dc->batch_ptrs[dc->batch_count * ARENA_MAX_DISKS]) == EXIT_SUCCESS ){
+		req->desc[i].status = 0;
+		dc->batch_count++;
+		}
+	}
+
+dc->batches++;
+dc->batch_stripes += dc->batch_count;
+if(dc->batch_count > dc->batch_largest){ dc->batch_largest = dc->batch_count; }
+
+return ret;
+}
+
+
+
+/**
+ * Acknowledges a request of the netlink connection. The completion is queued
+ * and all queued completions leave with one sendmmsg as soon as every
+ * received request is served, or earlier if the coalescer's count or time
+ * bound is reached.
+ *
+ * @param *arg		: netlink connection
+ * @param *token	: the nl_request with the statuses
+ *
+ * @returns			void
+ */
+
+static void netlink_ack(void *arg, char *token)
+{
+netlink_connection *con = (netlink_connection *)arg;
+nl_request *req = (nl_request *)token;
+int idle;
+
+put_message(&con->out[con->replies].msg_hdr, NL_MSG_COMPLETE, req, NL_REQUEST_BYTES(req->count));
+con->replies++;
+coalesce_add(&con->coalesce);
+
+idle = (con->next == con->received);
+if( !idle && !coalesce_due(&con->coalesce) ){ return; }
+coalesce_flushed(&con->coalesce, idle);
+
+#ifdef DEBUG_LEVEL_1
+syslog(LOG_NOTICE, "next : sendmmsg of %d completions\n", con->replies);
+#endif
+
+if( con->dc->kops->nl_sendmmsg(con->sock_fd, con->out, con->replies) < con->replies ){
+	syslog(LOG_NOTICE, "Sending netlink completions failed\n");
+	}
+con->send_calls++;
+con->replies = 0;
+}
+
+
+
+/**
+ * This function is the userspace driver which is implemented with the netlink
+ * method as the used connection technology. The daemon registers its port 
+ * once, afterwards every request is one binary message with a descriptor per
+ * stripe and is answered by one completion message.
+ *
+ * @param *dc			: 	driver context with the backend and its compute
+ *							context
+ * @param pipeline		:	serve the requests with the three-stage pipeline
+ *
+ * @returns				a pointer to the actual syndrome block.
+ */
+
+int server_netlink(driver_context *dc, int pipeline)
+{
+netlink_connection *con;
+request_transport rt = { netlink_wait, netlink_fetch, netlink_ack, NULL };
+int pid = getpid();
+int i;
+
+syslog(LOG_NOTICE, "Netlink method called.\n");
+
+con = (netlink_connection *)calloc(1, sizeof(netlink_connection));
+if(con == NULL){ return -1; }
+rt.arg = con;
+
+/* without --coalesce the replies only wait for the requests already received */
+coalesce_init(&con->coalesce, dc->coalesce_count, dc->coalesce_us, NL_MMSG_MAX);
+
+/* create and bind the socket */
+con->dc = dc;
+con->sock_fd = dc->kops->nl_open();
+if(con->sock_fd < 0){
+	free(con);
+	return -1;
+	}
+	
+for(i=0; i < NL_MMSG_MAX; i++){
+	gen_message_container( &con->in[i].msg_hdr );
+	gen_message_container( &con->out[i].msg_hdr );
+	}
+
+/* the registration replaces the init packet in front of every request */
+put_message( &con->out[0].msg_hdr, NL_MSG_REGISTER, &pid, sizeof(int) );
+if( dc->kops->nl_sendmmsg(con->sock_fd, con->out, 1) != 1 ){
+	syslog(LOG_NOTICE, "Netlink registration failed\n");
+	}
+else{
+	serve_requests(dc, &rt, pipeline);
+	}
+
+syslog(LOG_NOTICE, "netlink : %lu requests, %lu recvmmsg calls, %lu sendmmsg calls\n", 
+		con->messages, con->recv_calls, con->send_calls);
+coalesce_report(&con->coalesce, "netlink completions");
+
+dc->kops->nl_close(con->sock_fd);
+
+for(i=0; i < NL_MMSG_MAX; i++){
+	destroy_message_container( &con->in[i].msg_hdr );
+	destroy_message_container( &con->out[i].msg_hdr );
+	}
+free(con);
+	
+return 0;
+}
+
+
+
+/**
+ * Waits for the next request of the procfs connection.
+ *
+ * @param *arg		: procfs connection
+ * @param *token	: the address of the request is stored here
+ *
+ * @returns			EXIT_SUCCESS or EXIT_FAILURE if there is no request
+ */
+
+static int procfs_wait(void *arg, char *token)
+{
+procfs_connection *con = (procfs_connection *)arg;
+
+#ifdef DEBUG_LEVEL_1
+	unsigned long date;
+#endif
+
+if( con->dc->kops->stub_read(con->fd, token, PROCFS_TOKEN_BYTES) == 0 ){ return EXIT_FAILURE; }
+
+#ifdef DEBUG_LEVEL_1
+memcpy( &date, token, sizeof(unsigned long));
+syslog(LOG_NOTICE, "Adress is : %lu\n", date);
+#endif
+
+return EXIT_SUCCESS;
+}
+
+
+
+/**
+ * Acknowledges a request of the procfs connection.
+ *
+ * @param *arg		: procfs connection
+ * @param *token	: address of the request
+ *
+ * @returns			void
+ */
+
+static void procfs_ack(void *arg, char *token)
+{
+procfs_connection *con = (procfs_connection *)arg;
+
+con->dc->kops->stub_write(con->fd, token, PROCFS_TOKEN_BYTES);
+}
+
+
+
+/**
+ * This function is the userspace driver which is implementated with the procfs
+ * method as the used connection technology.
+ *
+ * @param *dc			: 	driver context with the backend and its compute
+ *							context
+ * @param pipeline		:	serve the requests with the three-stage pipeline
+ *
+ * @returns				a pointer to the actual syndrome block.
+ */
+
+int server_procfs(driver_context *dc, int pipeline)
+{
+procfs_connection con;
+request_transport rt = { procfs_wait, NULL, procfs_ack, &con };
+
+syslog(LOG_NOTICE, "Procfs method called.\n");
+	
+con.dc = dc;
+con.fd = dc->kops->stub_open();
+if( con.fd == NULL){
+	syslog(LOG_NOTICE, "Proc stub open failed!!\n");
+	return -1;
+	}
+syslog(LOG_NOTICE, "Procfs handler opened.\n");
+
+serve_requests(dc, &rt, pipeline);
+	
+/* Close the file-pointer */
+dc->kops->stub_close(con.fd);
+	
+return 0;
+}
+
+
+
+/**
+ * Doorbell of the kernel ring, one ioctl reaps all posted completions and 
+ * optionally waits for new submissions.
+ *
+ * @param *arg		: driver context
+ * @param wait		: wait for submissions
+ *
+ * @returns			number of pending submissions, < 0 if interrupted
+ */
+
+static int ring_enter_ioctl(void *arg, int wait)
+{
+driver_context *dc = (driver_context *)arg;
+unsigned long ring_arg = ((unsigned long)dc->shard << RING_ENTER_SHARD_SHIFT) | (unsigned long)wait;
+
+return dc->kops->dev_ioctl(dc->fd, IOCTL_RING_ENTER, (void *)ring_arg);
+}
+
+
+
+/**
+ * This function is the userspace driver which is implemented with the shared
+ * submission/completion ring as the used connection technology. Many stripes 
+ * can be in flight; they are taken from the ring in batches and completed in
+ * any order.
+ *
+ * @param *dc			: 	driver context with the backend, its compute
+ *							context and the shard of the ring
+ * @param entries		:	number of ring slots
+ * @param slot_bytes	:	size of one slot
+ *
+ * @returns				EXIT_SUCCESS or EXIT_FAILURE
+ */
+
+int server_ring(driver_context *dc, unsigned int entries, unsigned long slot_bytes)
+{
+ring_header *ring;
+ring_consumer rc;
+size_t size = ring_region_size(entries, slot_bytes);
+char name[32];
+fault_sample mark;
+fault_sample faults;
+
+syslog(LOG_NOTICE, "Ring method called for shard %d.\n", dc->shard);
+
+ring = (ring_header *)dc->kops->dev_mmap(size, PROT_READ | PROT_WRITE, dc->fd, 
+										(off_t)(RING_PGOFF + dc->shard)*getpagesize());
+if(ring == MAP_FAILED){
+	syslog(LOG_NOTICE, "Mapping ring %d failed\n", dc->shard);
+	return EXIT_FAILURE;
+	}
+
+if( ring_consumer_init(&rc, ring, dc->backend, &dc->ctx, ring_enter_ioctl, dc, &keep_going) == EXIT_FAILURE ){
+	syslog(LOG_NOTICE, "Ring with %u slots is not valid\n", ring->entries);
+	dc->kops->dev_munmap(ring, size);
+	return EXIT_FAILURE;
+	}
+
+syslog(LOG_NOTICE, "Ring with %u slots of %lu bytes mapped\n", ring->entries, ring->slot_bytes);
+
+if( (dc->coalesce_count > 0) || (dc->coalesce_us > 0) ){
+	coalesce_init(&rc.coalesce, dc->coalesce_count, dc->coalesce_us, ring->entries);
+	syslog(LOG_NOTICE, "Completions of ring %d are announced after %u stripes or %u us\n", 
+			dc->shard, rc.coalesce.max_completions, dc->coalesce_us);
+	}
+
+memset(&faults, 0, sizeof(fault_sample));
+fault_mark(&mark);
+
+ring_consumer_run(&rc);
+
+fault_since(&mark, &faults);
+
+syslog(LOG_NOTICE, "ring %d : %lu submissions in %lu batches, largest batch %lu\n", 
+		dc->shard, rc.submissions, rc.batches, rc.max_batch);
+if(rc.submissions > 0){
+	syslog(LOG_NOTICE, "ring %d page faults : %.2f minor and %.2f major per stripe\n", dc->shard,
+			(double)faults.minflt / rc.submissions, (double)faults.majflt / rc.submissions);
+	}
+sprintf(name, "ring %d completions", dc->shard);
+coalesce_report(&rc.coalesce, name);
+
+dc->ring_submissions = rc.submissions;
+dc->ring_batches	 = rc.batches;
+dc->ring_max_batch	 = rc.max_batch;
+
+ring_consumer_destroy(&rc);
+dc->kops->dev_munmap(ring, size);
+
+return EXIT_SUCCESS;
+}
+
+
+
+/**
+ * Server thread of one ring shard. It sets up its own compute context, the
+ * backends bind their buffers to the calling thread.
+ *
+ * @param *arg			:	ring_shard_server of the thread
+ *
+ * @returns				NULL
+ */
+
+static void *ring_shard_thread(void *arg)
+{
+ring_shard_server *rss = (ring_shard_server *)arg;
+driver_context *dc = &rss->dc;
+
+affinity_apply(AFFINITY_SERVER);
+
+if( syndrome_context_init(dc->backend, &dc->ctx) == EXIT_FAILURE ){
+	syslog(LOG_NOTICE, "Can't initialise the %s context of ring %d\n", dc->backend->name, dc->shard);
+	return NULL;
+	}
+
+server_ring(dc, rss->entries, rss->slot_bytes);
+
+syndrome_context_release(dc->backend, &dc->ctx);
+return NULL;
+}
+
+
+
+/**
+ * Serves every ring shard with its own thread, the calling thread serves 
+ * shard 0. The share of every shard is reported when all of them are done.
+ *
+ * @param *dc			: 	driver context of the calling thread
+ * @param *tc			:	configuration of the daemon
+ *
+ * @returns				EXIT_SUCCESS or EXIT_FAILURE
+ */
+
+int server_ring_shards(driver_context *dc, thread_container *tc)
+{
+ring_shard_server *shards;
+int n = tc->server_threads;
+int started;
+int i;
+unsigned long total;
+
+if(n <= 1){ return server_ring(dc, tc->ring_entries, tc->ring_slot_bytes); }
+
+shards = (ring_shard_server *)calloc(n, sizeof(ring_shard_server));
+if(shards == NULL){ return EXIT_FAILURE; }
+
+/* every thread gets a context of its own, only the stub and the fd are shared */
+for(started = 1; started < n; started++){
+	driver_context *sdc = &shards[started].dc;
+	
+	sdc->kops				= dc->kops;
+	sdc->fd					= dc->fd;
+	sdc->backend			= dc->backend;
+	sdc->shard				= started;
+	sdc->coalesce_count		= dc->coalesce_count;
+	sdc->coalesce_us		= dc->coalesce_us;
+	sdc->doorbell_submit	= -1;
+	sdc->doorbell_complete	= -1;
+	shards[started].entries		= tc->ring_entries;
+	shards[started].slot_bytes	= tc->ring_slot_bytes;
+	
+	if( pthread_create(&shards[started].thread, NULL, ring_shard_thread, &shards[started]) != 0 ){
+		syslog(LOG_NOTICE, "Can't start the server thread of ring %d, terminating\n", started);
+		keep_going = 0;
+		break;
+		}
+	}
+
+dc->shard = 0;
+server_ring(dc, tc->ring_entries, tc->ring_slot_bytes);
+
+for(i = 1; i < started; i++){ pthread_join(shards[i].thread, NULL); }
+
+/* the load balance over the shards */
+shards[0].dc.ring_submissions = dc->ring_submissions;
+shards[0].dc.ring_batches	  = dc->ring_batches;
+
+total = 0;
+for(i = 0; i < n; i++){ total += shards[i].dc.ring_submissions; }
+
+for(i = 0; i < n; i++){
+	syslog(LOG_NOTICE, "ring shard %d : %lu stripes (%.1f%%) in %lu batches\n", i, 
+			shards[i].dc.ring_submissions, 
+			total ? 100.0 * shards[i].dc.ring_submissions / total : 0.0,
+			shards[i].dc.ring_batches);
+	}
+
+free(shards);
+return (started == n) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+
+
+/**
+ * Waits for the next request of the doorbell connection. The sequence word is
+ * busy-polled before the daemon sleeps on the eventfd.
+ *
+ * @param *arg		: doorbell connection
+ * @param *token	: the sequence number of the request is stored here
+ *
+ * @returns			EXIT_SUCCESS or EXIT_FAILURE if there is no request
+ */
+
+static int doorbell_wait(void *arg, char *token)
+{
+doorbell_connection *con = (doorbell_connection *)arg;
+doorbell_page *db = con->db;
+
+if( !spin_wait_poll(&con->sw, &db->submit_seq, con->seq) ){
+	/* announce the sleep before the last look at the sequence word */
+	db->daemon_sleeping = 1;
+	__sync_synchronize();
+	if(db->submit_seq == con->seq){ spin_wait_sleep(&con->sw, con->dc->doorbell_submit); }
+	db->daemon_sleeping = 0;
+	
+	/* interrupted, or a signal left over from a request already served */
+	if(db->submit_seq == con->seq){ return EXIT_FAILURE; }
+	}
+spin_wait_arrived(&con->sw);
+
+con->seq = db->submit_seq;
+__sync_synchronize();
+memcpy(token, &con->seq, sizeof(unsigned int));
+
+if(report_stats){ spin_wait_report(&con->sw); }
+
+return EXIT_SUCCESS;
+}
+
+
+
+/**
+ * Acknowledges a request of the doorbell connection.
+ *
+ * @param *arg		: doorbell connection
+ * @param *token	: sequence number of the request
+ *
+ * @returns			void
+ */
+
+static void doorbell_ack(void *arg, char *token)
+{
+doorbell_connection *con = (doorbell_connection *)arg;
+unsigned int seq;
+
+memcpy(&seq, token, sizeof(unsigned int));
+
+/* publish the syndromes before the sequence word */
+__sync_synchronize();
+con->db->complete_seq = seq;
+eventfd_write(con->dc->doorbell_complete, 1);
+}
+
+
+
+/**
+ * This function is the userspace driver which is implemented with the doorbell
+ * as the used connection technology. No message carries the request, the 
+ * kernel bumps a sequence word in a shared page and signals an eventfd; the 
+ * completion goes back the same way. The sequence word is busy-polled for up
+ * to spin_us before the daemon sleeps on the eventfd.
+ *
+ * @param *dc			: 	driver context with the backend, its compute
+ *							context and the eventfds of the doorbell
+ * @param spin_us		:	upper bound of the busy-poll, 0 always sleeps
+ * @param pipeline		:	serve the requests with the three-stage pipeline
+ *
+ * @returns				EXIT_SUCCESS or EXIT_FAILURE
  */
 
-int server_procfs(syndrome_func gen_syndrome)
+int server_doorbell(driver_context *dc, unsigned int spin_us, int pipeline)
+{
+doorbell_connection con;
+request_transport rt = { doorbell_wait, NULL, doorbell_ack, &con };
+
+syslog(LOG_NOTICE, "Doorbell method called.\n");
+
+con.dc = dc;
+con.db = (doorbell_page *)dc->kops->dev_mmap(getpagesize(), PROT_READ | PROT_WRITE, dc->fd, 
+											(off_t)DOORBELL_PGOFF*getpagesize());
+if(con.db == MAP_FAILED){
+	syslog(LOG_NOTICE, "Mapping the doorbell failed\n");
+	return EXIT_FAILURE;
+	}
+
+con.seq = con.db->complete_seq;
+spin_wait_init(&con.sw, spin_us);
+
+serve_requests(dc, &rt, pipeline);
+
+spin_wait_report(&con.sw);
+dc->kops->dev_munmap(con.db, getpagesize());
+
+return EXIT_SUCCESS;
+}
+
+
+
+/*HELPER_FUNCTIONS____________________________________________________________*/
+/**
+ * Copy actual syndrome container from kernelspace via copy_to_user
+ *
+ * @param *dc		: driver context of the calling thread
+ *
+ * @returns	 syndrome_container * : A pointer to the actual syndrome
+ *									which should be calculated.
+ */
+
+syndrome_container *copy_act_syndrome_block( driver_context *dc )
 {
-FILE *fd;
-syndrome_container *act_container;
-char buffer[sizeof(unsigned long)+2];
 #ifdef DEBUG_LEVEL_1
-	double time;
-	unsigned long date;
+double time;
+double total_time = 0;
 #endif
 
-/*
-int i,j;
-char *tmp;
-*/
-	
-/* syndrome data */
+int i;
+syndrome_container *ret;
+unsigned int pagesizen = getpagesize();
+
 int disks;
 size_t bytes;
-void **ptrs;
-	
-syslog(LOG_NOTICE, "Procfs method called.\n");
-	
-fd = fopen("/proc/barracuda/stub", "w+");
-if( fd < 0){
-	syslog(LOG_NOTICE, "Proc stub open failed!!\n");
-	return -1;
-	}
-syslog(LOG_NOTICE, "Procfs handler opened.\n");
+void **dptrs = dc->dptrs;
 
-while( keep_going ){
-	fread( &buffer, sizeof(char), sizeof(unsigned long)+2, fd );
+/* a stripe in the shared arena needs no copy at all */
+ret = arena_act_syndrome_block(dc);
+if(ret != NULL){ return ret; }
+
+/* map the marshalling struct */
+if( map_marshalling_struct(dc) == EXIT_FAILURE ){ return NULL; }
 	
-	#ifdef DEBUG_LEVEL_1
-	memcpy( &date, &buffer, sizeof(unsigned long));
-	syslog(LOG_NOTICE, "Adress is : %lu\n", date);
-	#endif
+disks = dc->smc->disks;
+bytes = dc->smc->bytes;
 	
-	/* get actual syndrome pointer */
-#ifdef COPY_MARSHALLING
-	act_container = copy_act_syndrome_block();
-#endif
-#ifndef COPY_MARSHALLING
-	act_container = get_act_syndrome_block();
+#ifdef DEBUG_LEVEL_1
+	time = gtd_second();
 #endif
+
+/* take the data buffers from the pool, they outlive the request */
+if( marshal_pool_get(&dc->pool, disks, bytes, dptrs) == EXIT_FAILURE ){
+	syslog(LOG_NOTICE, "No buffers for a copied request of %d x %lu bytes\n", disks, (unsigned long)bytes);
+	return NULL;
+	}
 	
-	/* deassemble container */
-	disks = act_container->disks;
-	bytes = act_container->bytes;
-	ptrs  = act_container->ptrs;
-	
-	/*
-	for(i=0; i<disks; i++){
-		tmp = (char *)ptrs[i];
-		syslog(LOG_NOTICE, "%d\n", tmp[0]);
-		}
-	*/
-	
-	#ifdef DEBUG_LEVEL_1
-	time = gtd_second();
-	#endif
-	/* pass to the gen syndrome function */
-	gen_syndrome(disks, bytes, ptrs);
-	#ifdef DEBUG_LEVEL_1
+#ifdef DEBUG_LEVEL_1
 	time = gtd_second()-time;
-	syslog(LOG_NOTICE, "TIME for gensyn() : %f milli\n", time*1000);
-	#endif
+	total_time = total_time + time;
+	syslog(LOG_NOTICE, ">>> copy dpointer : %f milli\n", time*1000);
+#endif
+
+/* copy the stuff from the kernelspace, an operation besides OP_GEN reads the checksums as well */
+for( i=0; i < ( (dc->op.opcode == OP_GEN) ? disks-2 : disks ); i++){
+	dc->kops->dev_pread(dc->fd, dptrs[i], bytes, i);
+	}
 	
-	/* unmap everything */
-#ifdef COPY_MARSHALLING
-	copyback_act_syndrome_block(act_container);
+#ifdef DEBUG_LEVEL_1
+	time = gtd_second();
 #endif
-#ifndef COPY_MARSHALLING
-	unget_act_syndrome_block(act_container);
+	
+/* malloc a syndrome container that resides at the userspace */
+ret = (syndrome_container *)malloc( sizeof(syndrome_container) );
+
+/* put all arguments into the marshalling struct */
+ret->disks = disks;
+ret->bytes = bytes;
+ret->ptrs  = dptrs;
+
+#ifdef DEBUG_LEVEL_1
+	time = gtd_second()-time;
+	total_time = total_time + time;
+	syslog(LOG_NOTICE, ">>> put struct : %f milli\n", time*1000);
+	syslog(LOG_NOTICE, "TOTAL mmap() -> %f milli\n", total_time*1000);
 #endif
 	
-	/* acknowledge that all calculations are done */
-	fwrite( &buffer, sizeof(char), sizeof(unsigned long)+2, fd );
+return ret;
+}
+
+
+
+/**
+ * Copy back actual syndrome container to kernelspace via copy_to_user
+ *
+ * @param    *dc : driver context of the calling thread
+ * @param    smc : A pointer to the actual syndrome which should be calculated.
+ *
+ * @returns	 void
+ */
+
+void copyback_act_syndrome_block( driver_context *dc, syndrome_container *smc )
+{
+int disks		= smc->disks;
+size_t bytes	= smc->bytes;
+void **dptrs	= smc->ptrs;
+int outputs[DESC_MAX_FAILED];
+int n;
+int i;
+
+/* the kernel fetches the checksums of an arena stripe itself */
+if(dc->arena_request){
+	free(smc);
+	return;
 	}
 	
-/* Close the file-pointer */
-if(fd >= 0){ fclose(fd); }
+/* copy all checksums back to the kernelspace, the buffers stay in the pool */
+if(dc->op.opcode == OP_GEN){
+	dc->kops->dev_pwrite(dc->fd, dptrs[disks-2], bytes, disks-2);
+	dc->kops->dev_pwrite(dc->fd, dptrs[disks-1], bytes, disks-1);
+	}
+else if(dc->op.result >= 0){
+	n = ops_outputs(&dc->op, disks, outputs);
+	for(i=0; i < n; i++){ dc->kops->dev_pwrite(dc->fd, dptrs[outputs[i]], bytes, outputs[i]); }
+	}
 	
-return 0;
+free(smc);
 }
 
 
 
-/*HELPER_FUNCTIONS____________________________________________________________*/
 /**
- * Copy actual syndrome container from kernelspace via copy_to_user
+ * Get the actual syndrome container from the kernelspace
+ *
+ * @param *dc		: driver context of the calling thread
  *
  * @returns	 syndrome_container * : A pointer to the actual syndrome
  *									which should be calculated.
  */
 
-syndrome_container *copy_act_syndrome_block( )
+syndrome_container *get_act_syndrome_block( driver_context *dc )
 {
 #ifdef DEBUG_LEVEL_1
-double time;
-double total_time = 0;
+	double time;
+	double total_time = 0;
 #endif
-
 int i;
 syndrome_container *ret;
 unsigned int pagesizen = getpagesize();
 
 int disks;
 size_t bytes;
-void **dptrs = global_dptrs;
+void **dptrs = dc->dptrs;
 
-/* map the marshalling struct */
-if(smc_flag == 0){
-	ret_global = (syndrome_container *)mmap(0, sizeof(syndrome_container), PROT_READ, MAP_SHARED, fd, 0);
-	if(ret_global == MAP_FAILED){
-		perror("MMAPing marshalling struct failed !\n");
-		return NULL;
-		}
-	smc_flag = 1;
-	}
-	
-disks = ret_global->disks;
-bytes = ret_global->bytes;
+/* a stripe in the shared arena is already mapped */
+ret = arena_act_syndrome_block(dc);
+if(ret != NULL){ return ret; }
 	
 #ifdef DEBUG_LEVEL_1
 	time = gtd_second();
 #endif
+/* map the marshalling struct */
+if( map_marshalling_struct(dc) == EXIT_FAILURE ){ return NULL; }
+#ifdef DEBUG_LEVEL_1
+	time = gtd_second()-time;
+	total_time = total_time + time;
+	syslog(LOG_NOTICE, ">>> map marshal : %f milli\n", time*1000);
+#endif
 
-/* malloc all data buffers */
-for(i=0; i<disks; i++){
-	dptrs[i] = (void *)malloc(bytes);
-	}
+/* allocate pointers for the disks array */
+disks = dc->smc->disks;
+bytes = dc->smc->bytes;
+		
+/* map every disk pointer individually */
+#ifdef DEBUG_LEVEL_1
+	time = gtd_second();
+#endif
+for(i=1; i <= disks; i++){
+	if(dc->proto >= 1){
+		dptrs[i-1] = dc->kops->dev_mmap(bytes, PROT_WRITE, dc->fd, (off_t)dc->desc->offsets[i-1]);
+		}
+	else{
+		dptrs[i-1] = dc->kops->dev_mmap(bytes, PROT_WRITE, dc->fd, (off_t)i*pagesizen);
+		}
 	
+	if(dptrs[i-1] == MAP_FAILED){
+		perror("MMAPing disk data failed !\n");
+		return NULL;
+		}
+	}
 #ifdef DEBUG_LEVEL_1
 	time = gtd_second()-time;
 	total_time = total_time + time;
-	syslog(LOG_NOTICE, ">>> copy dpointer : %f milli\n", time*1000);
+	syslog(LOG_NOTICE, ">>> map dpointer : %f milli\n", time*1000);
 #endif
 
-/* copy the stuff from the kernelspace */
-for( i=0; i<disks-2; i++){
-	pread(fd, dptrs[i], bytes, i);
-	}
-	
 #ifdef DEBUG_LEVEL_1
 	time = gtd_second();
 #endif
@@ -719,121 +1949,265 @@ ret->ptrs  = dptrs;
 	syslog(LOG_NOTICE, ">>> put struct : %f milli\n", time*1000);
 	syslog(LOG_NOTICE, "TOTAL mmap() -> %f milli\n", total_time*1000);
 #endif
-	
+
+return ret;
+}
+
+
+
+/**
+ * Unmap the actual syndrome container via munmap
+ *
+ * @param *dc		: driver context of the calling thread
+ * @param *smc		: syndrome container to unmap
+ *
+ * @returns			void
+ */
+
+void unget_act_syndrome_block( driver_context *dc, syndrome_container *smc )
+{
+int i;
+int disks = smc->disks;
+size_t bytes = smc->bytes;
+
+#ifdef DEBUG_LEVEL_1
+	double time;
+	double total_time = 0;
+#endif
+
+/* an arena stripe stays mapped */
+if(dc->arena_request){
+	free(smc);
+	return;
+	}
+
+#ifdef DEBUG_LEVEL_1
+	time = gtd_second();
+#endif
+
+/* First unmap all datapointer stuff */
+for(i=0; i < disks; i++){
+	dc->kops->dev_munmap( smc->ptrs[i], bytes );
+	}
+
+#ifdef DEBUG_LEVEL_1
+	time = gtd_second()-time;
+	total_time = total_time + time;
+	syslog(LOG_NOTICE, ">>> unmap dpointer : %f milli\n", time*1000);
+#endif
+
+#ifdef DEBUG_LEVEL_1
+	time = gtd_second();
+#endif
+
+/* At last, free the marshalling struct */
+free(smc);
+
+#ifdef DEBUG_LEVEL_1
+	time = gtd_second()-time;
+	total_time = total_time + time;
+	syslog(LOG_NOTICE, ">>> free smc : %f milli\n", time*1000);
+	syslog(LOG_NOTICE, "TOTAL munmap() -> %f milli\n", total_time*1000);
+#endif
+}
+
+
+
+/**
+ * Builds the syndrome container of a stripe which the kernel has put into the
+ * shared arena. The disk pointers are computed from the offsets in the arena
+ * header, no syscall is needed. If the stripe heads a batch, the whole batch
+ * is collected in dc->batch.
+ *
+ * @param *dc		: driver context of the calling thread
+ *
+ * @returns	 syndrome_container * : the actual syndrome or NULL if the stripe 
+ *									is not in the arena
+ */
+
+syndrome_container *arena_act_syndrome_block( driver_context *dc )
+{
+int i;
+syndrome_container *ret;
+arena_header *arena = dc->arena;
+
+dc->arena_request = 0;
+dc->batch_count	  = 0;
+
+if( (arena == NULL) || (arena->mode != ARENA_INLINE) ){ return NULL; }
+
+for(i=0; i < arena->disks; i++){
+	dc->dptrs[i] = (void *)((char *)arena + arena->offsets[i]);
+	}
+
+ret = (syndrome_container *)malloc( sizeof(syndrome_container) );
+
+ret->disks = arena->disks;
+ret->bytes = arena->bytes;
+ret->ptrs  = dc->dptrs;
+
+dc->arena_request = 1;
+
+if(dc->batch != NULL){ arena_act_batch(dc, ret); }
+
 return ret;
 }
 
 
 
 /**
- * Copy back actual syndrome container to kernelspace via copy_to_user
+ * Follows the chain of stripe headers of a batch through the shared arena.
+ * A header outside of the arena ends the batch.
+ *
+ * @param *dc		: driver context of the calling thread
+ * @param *first	: container of the first stripe
+ *
+ * @returns	 int : number of stripes in the batch
+ */
+
+int arena_act_batch( driver_context *dc, syndrome_container *first )
+{
+int n = 1;
+unsigned long offset;
+arena_header *hdr = dc->arena;
+
+dc->batch[0] = *first;
+
+while( (hdr->next != 0) && (n < BATCH_MAX_STRIPES) ){
+	offset = hdr->next;
+	if( arena_act_stripe(dc, offset, &dc->batch[n], &dc->batch_ptrs[n * ARENA_MAX_DISKS]) == EXIT_FAILURE ){ break; }
+	hdr = (arena_header *)((char *)dc->arena + offset);
+	n++;
+	}
+
+dc->batch_count = n;
+dc->batches++;
+dc->batch_stripes += n;
+if(n > dc->batch_largest){ dc->batch_largest = n; }
+
+return n;
+}
+
+
+
+/**
+ * Builds the syndrome container of the stripe whose header is at an offset in
+ * the shared arena. A header or a disk outside of the arena is refused.
+ *
+ * @param *dc		: driver context of the calling thread
+ * @param offset	: arena offset of the stripe header
+ * @param *smc		: the container is filled in here
+ * @param **ptrs	: array for the disk pointers of the stripe
+ *
+ * @returns	 EXIT_SUCCESS or EXIT_FAILURE
+ */
+
+int arena_act_stripe( driver_context *dc, unsigned long offset, syndrome_container *smc, void **ptrs )
+{
+int i;
+arena_header *hdr;
+
+if( (dc->arena == NULL) || (offset + sizeof(arena_header) > dc->arena_size) ){ return EXIT_FAILURE; }
+
+hdr = (arena_header *)((char *)dc->arena + offset);
+if( (hdr->mode != ARENA_INLINE) || (hdr->disks <= 2) || (hdr->disks > ARENA_MAX_DISKS) ){ return EXIT_FAILURE; }
+
+for(i=0; i < hdr->disks; i++){
+	if(hdr->offsets[i] + hdr->bytes > dc->arena_size){ return EXIT_FAILURE; }
+	ptrs[i] = (void *)((char *)dc->arena + hdr->offsets[i]);
+	}
+
+smc->disks = hdr->disks;
+smc->bytes = hdr->bytes;
+smc->ptrs  = ptrs;
+
+return EXIT_SUCCESS;
+}
+
+
+
+/**
+ * Checks the segment table of the actual request. Every disk must be covered
+ * by its segments in full and every segment must lie in the window.
  *
- * @param    smc : A pointer to the actual syndrome which should be calculated.
+ * @param *sg		: segment table
  *
- * @returns	 void
+ * @returns	 EXIT_SUCCESS or EXIT_FAILURE
  */
 
-void copyback_act_syndrome_block( syndrome_container *smc )
+static int sg_table_check( sg_table *sg )
 {
-int disks		= smc->disks;
-size_t bytes	= smc->bytes;
-void **dptrs	= smc->ptrs;
-	
 int i;
+unsigned int j;
+size_t covered;
+sg_segment *s;
+
+if( (sg->disks <= 2) || (sg->disks > ARENA_MAX_DISKS) ){ return EXIT_FAILURE; }
+if( (sg->segments > SG_MAX_SEGMENTS) || (sg->first[0] != 0) || (sg->first[sg->disks] != sg->segments) ){ 
+	return EXIT_FAILURE; 
+	}
+
+for(i=0; i < sg->disks; i++){
+	if(sg->first[i] > sg->first[i+1]){ return EXIT_FAILURE; }
 	
-/* copy all checksums back to the kernelspace */
-pwrite(fd, dptrs[disks-2], bytes, disks-2);
-pwrite(fd, dptrs[disks-1], bytes, disks-1);
+	covered = 0;
+	for(j = sg->first[i]; j < sg->first[i+1]; j++){
+		s = &sg->segs[j];
+		if( (s->len == 0) || (s->offset % SG_ALIGN) || (s->len % SG_ALIGN) ){ return EXIT_FAILURE; }
+		if( (s->offset > sg->window_bytes) || (s->len > sg->window_bytes - s->offset) ){ return EXIT_FAILURE; }
+		covered += s->len;
+		}
 	
-/* free all buffers */
-for(i=0; i<disks; i++){
-	free(smc->ptrs[i]);
+	if(covered != sg->bytes){ return EXIT_FAILURE; }
 	}
-free(smc);
+
+return EXIT_SUCCESS;
 }
 
 
 
 /**
- * Get the actual syndrome container from the kernelspace
+ * Maps the actual stripe as the kernel described it in the segment table. 
+ * The table is mapped once, the pages of all disks with one window per 
+ * request instead of one mapping per disk.
  *
+ * @param *dc		: driver context of the calling thread
  *
- * @returns	 syndrome_container * : A pointer to the actual syndrome
- *									which should be calculated.
+ * @returns	 syndrome_container * : the actual syndrome, its ptrs are NULL, or 
+ *									NULL if the stripe has no valid table
  */
 
-syndrome_container *get_act_syndrome_block()
+syndrome_container *sg_act_syndrome_block( driver_context *dc )
 {
-#ifdef DEBUG_LEVEL_1
-	double time;
-	double total_time = 0;
-#endif
-int i;
 syndrome_container *ret;
-unsigned int pagesizen = getpagesize();
 
-int disks;
-size_t bytes;
-void **dptrs = global_dptrs;
-	
-#ifdef DEBUG_LEVEL_1
-	time = gtd_second();
-#endif
-/* map the marshalling struct */
-if(smc_flag == 0){
-	ret_global = (syndrome_container *)mmap(0, sizeof(syndrome_container), PROT_READ, MAP_SHARED, fd, 0);
-	if(ret_global == MAP_FAILED){
-		perror("MMAPing marshalling struct failed !\n");
+if(dc->sg == NULL){
+	dc->sg = (sg_table *)dc->kops->dev_mmap(sizeof(sg_table), PROT_READ, dc->fd, (off_t)SG_TABLE_PGOFF*getpagesize());
+	if(dc->sg == MAP_FAILED){
+		dc->sg = NULL;
+		perror("MMAPing the segment table failed !\n");
 		return NULL;
 		}
-	smc_flag = 1;
 	}
-#ifdef DEBUG_LEVEL_1
-	time = gtd_second()-time;
-	total_time = total_time + time;
-	syslog(LOG_NOTICE, ">>> map marshal : %f milli\n", time*1000);
-#endif
 
-/* allocate pointers for the disks array */
-disks = ret_global->disks;
-bytes = ret_global->bytes;
-		
-/* map every disk pointer individually */
-#ifdef DEBUG_LEVEL_1
-	time = gtd_second();
-#endif
-for(i=1; i <= disks; i++){
-	dptrs[i-1] = (void *)mmap(0, bytes, PROT_WRITE, MAP_SHARED, fd, i*pagesizen);
-	
-	if(dptrs[i-1] == MAP_FAILED){
-		perror("MMAPing disk data failed !\n");
-		return NULL;
-		}
+if( sg_table_check(dc->sg) == EXIT_FAILURE ){ return NULL; }
+
+dc->sg_window_bytes = dc->sg->window_bytes;
+dc->sg_window = (char *)dc->kops->dev_mmap(dc->sg_window_bytes, PROT_READ | PROT_WRITE, 
+										   dc->fd, (off_t)SG_WINDOW_PGOFF*getpagesize());
+if(dc->sg_window == MAP_FAILED){
+	dc->sg_window = NULL;
+	perror("MMAPing the scatter-gather window failed !\n");
+	return NULL;
 	}
-#ifdef DEBUG_LEVEL_1
-	time = gtd_second()-time;
-	total_time = total_time + time;
-	syslog(LOG_NOTICE, ">>> map dpointer : %f milli\n", time*1000);
-#endif
 
-#ifdef DEBUG_LEVEL_1
-	time = gtd_second();
-#endif
-	
-/* malloc a syndrome container that resides at the userspace */
 ret = (syndrome_container *)malloc( sizeof(syndrome_container) );
 
-/* put all arguments into the marshalling struct */
-ret->disks = disks;
-ret->bytes = bytes;
-ret->ptrs  = dptrs;
+ret->disks = dc->sg->disks;
+ret->bytes = dc->sg->bytes;
+ret->ptrs  = NULL;
 
-#ifdef DEBUG_LEVEL_1
-	time = gtd_second()-time;
-	total_time = total_time + time;
-	syslog(LOG_NOTICE, ">>> put struct : %f milli\n", time*1000);
-	syslog(LOG_NOTICE, "TOTAL mmap() -> %f milli\n", total_time*1000);
-#endif
+dc->sg_request = 1;
 
 return ret;
 }
@@ -841,52 +2215,22 @@ return ret;
 
 
 /**
- * Unmap the actual syndrome container via munmap
+ * Unmaps the window of a scatter-gather stripe, the table stays mapped.
  *
- * @param *smc		: syndrome container to unmap
+ * @param *dc		: driver context of the calling thread
+ * @param *smc		: syndrome container of the stripe
  *
  * @returns			void
  */
 
-void unget_act_syndrome_block( syndrome_container *smc )
+void unget_sg_syndrome_block( driver_context *dc, syndrome_container *smc )
 {
-int i;
-int disks = smc->disks;
-size_t bytes = smc->bytes;
-
-#ifdef DEBUG_LEVEL_1
-	double time;
-	double total_time = 0;
-#endif
-
-#ifdef DEBUG_LEVEL_1
-	time = gtd_second();
-#endif
-
-/* First unmap all datapointer stuff */
-for(i=0; i < disks; i++){
-	munmap( smc->ptrs[i], bytes );
-	}
-
-#ifdef DEBUG_LEVEL_1
-	time = gtd_second()-time;
-	total_time = total_time + time;
-	syslog(LOG_NOTICE, ">>> unmap dpointer : %f milli\n", time*1000);
-#endif
+dc->kops->dev_munmap(dc->sg_window, dc->sg_window_bytes);
 
-#ifdef DEBUG_LEVEL_1
-	time = gtd_second();
-#endif
+dc->sg_window  = NULL;
+dc->sg_request = 0;
 
-/* At last, free the marshalling struct */
 free(smc);
-
-#ifdef DEBUG_LEVEL_1
-	time = gtd_second()-time;
-	total_time = total_time + time;
-	syslog(LOG_NOTICE, ">>> free smc : %f milli\n", time*1000);
-	syslog(LOG_NOTICE, "TOTAL munmap() -> %f milli\n", total_time*1000);
-#endif
 }
 
 
@@ -956,15 +2300,17 @@ free(msg->msg_name);
 
 
 /**
- * Save the payload to a Netlink-Package for sending
+ * Puts a binary payload into a Netlink-Package for sending
  *
- * @param *msg					: Target function pointer
- * @param *payload				: Array pointer to the availaible implementations
+ * @param *msg		: packet datastructure
+ * @param type		: message type
+ * @param *payload	: payload
+ * @param len		: bytes of the payload, at most MAX_PAYLOAD
  *
  * @returns			void
  */
 
-void add_payload(struct msghdr *msg, char *payload )
+void put_message(struct msghdr *msg, int type, void *payload, size_t len)
 {
 struct nlmsghdr *nlh;
 
@@ -974,23 +2320,31 @@ struct nlmsghdr *nlh;
 	nlh = (nlmsghdr *)msg->msg_iov->iov_base;
 #endif
 
-strcpy( (char *)NLMSG_DATA(nlh), payload );	
+nlh->nlmsg_len	= NLMSG_LENGTH(len);
+nlh->nlmsg_type = type;
+memcpy( NLMSG_DATA(nlh), payload, len );
+
+msg->msg_iov->iov_len = NLMSG_SPACE(len);
 }
 
 
 
 /**
- * Get the payload from a received Netlink-Package
+ * Gets the binary payload of a received Netlink-Package
  *
- * @param *msg					: Target function pointer
- * @param *payload				: Array pointer to the availaible implementations
+ * @param *msg		: packet datastructure
+ * @param received	: bytes received into the packet
+ * @param type		: expected message type
+ * @param *payload	: the payload is stored here
+ * @param max		: size of the payload buffer
  *
- * @returns			void
+ * @returns	 size_t : bytes of the payload, 0 if the packet is not of the type
  */
 
-void get_payload(struct msghdr *msg, char *payload)
+size_t take_message(struct msghdr *msg, size_t received, int type, void *payload, size_t max)
 {
 struct nlmsghdr *nlh;
+size_t len;
 
 #ifdef NOCUDA
 	nlh = msg->msg_iov->iov_base;
@@ -998,5 +2352,236 @@ struct nlmsghdr *nlh;
 	nlh = (nlmsghdr *)msg->msg_iov->iov_base;
 #endif
 
-strcpy(payload, (char *)NLMSG_DATA(nlh));
+if( (received < NLMSG_HDRLEN) || (nlh->nlmsg_len > received) || (nlh->nlmsg_len < NLMSG_HDRLEN) ){ return 0; }
+if(nlh->nlmsg_type != type){ return 0; }
+
+len = nlh->nlmsg_len - NLMSG_HDRLEN;
+if(len > max){ len = max; }
+memcpy( payload, NLMSG_DATA(nlh), len );
+
+/* the receive buffer may be reused for a full packet */
+msg->msg_iov->iov_len = NLMSG_SPACE(MAX_PAYLOAD);
+
+return len;
+}
+
+
+
+/*KERNEL_STUB_CALLS___________________________________________________________*/
+/**
+ * Writes one command to /proc/barracuda/conf.
+ *
+ * @param *command	: command string, e.g. pid=<pid>
+ *
+ * @returns			EXIT_SUCCESS or EXIT_FAILURE
+ */
+
+static int device_conf_write(char *command)
+{
+FILE *fp = fopen("/proc/barracuda/conf", "w+");
+
+if(fp == NULL){ return EXIT_FAILURE; }
+
+fwrite( (void *)command, strlen(command), 1, fp );
+
+/* the stub refuses a command with the error of the write, e.g. ping= */
+if( fclose(fp) != 0 ){ return EXIT_FAILURE; }
+
+return EXIT_SUCCESS;
+}
+
+
+
+/**
+ * Opens /dev/barracuda.
+ *
+ * @param flags		: open flags
+ *
+ * @returns			file descriptor or -1
+ */
+
+static int device_open(int flags)
+{
+return open("/dev/barracuda", flags);
+}
+
+
+
+/**
+ * Maps a region of /dev/barracuda, the page offset selects the region.
+ *
+ * @param length	: bytes to map
+ * @param prot		: protection
+ * @param fd		: device file
+ * @param offset	: offset into the device
+ *
+ * @returns			the mapping or MAP_FAILED
+ */
+
+static void *device_mmap(size_t length, int prot, int fd, off_t offset)
+{
+return mmap(0, length, prot, MAP_SHARED | memlock_map_flags(), fd, offset);
+}
+
+
+
+/**
+ * Calls an ioctl of /dev/barracuda.
+ *
+ * @param fd		: device file
+ * @param request	: IOCTL_GETVALUE or IOCTL_RING_ENTER
+ * @param *arg		: argument of the request
+ *
+ * @returns			the result of the ioctl
+ */
+
+static int device_ioctl(int fd, unsigned long request, void *arg)
+{
+return ioctl(fd, request, arg);
+}
+
+
+
+/**
+ * Opens /proc/barracuda/stub.
+ *
+ * @returns			handle of the stub or NULL
+ */
+
+static void *device_stub_open(void)
+{
+return (void *)fopen("/proc/barracuda/stub", "w+");
+}
+
+
+
+/**
+ * Reads the address of the next request from the stub, blocks until there is
+ * one.
+ *
+ * @param *stub		: handle of the stub
+ * @param *buf		: buffer for the address
+ * @param count		: size of the buffer
+ *
+ * @returns			bytes read, 0 if interrupted
+ */
+
+static size_t device_stub_read(void *stub, void *buf, size_t count)
+{
+return fread( buf, sizeof(char), count, (FILE *)stub );
+}
+
+
+
+/**
+ * Acknowledges a request by writing its address back to the stub.
+ *
+ * @param *stub		: handle of the stub
+ * @param *buf		: the address
+ * @param count		: size of the buffer
+ *
+ * @returns			bytes written
+ */
+
+static size_t device_stub_write(void *stub, void *buf, size_t count)
+{
+return fwrite( buf, sizeof(char), count, (FILE *)stub );
+}
+
+
+
+/**
+ * Closes the stub.
+ *
+ * @param *stub		: handle of the stub
+ *
+ * @returns			void
+ */
+
+static void device_stub_close(void *stub)
+{
+if(stub != NULL){ fclose((FILE *)stub); }
+}
+
+
+
+/**
+ * Creates the netlink socket of the daemon and binds it to its pid.
+ *
+ * @returns			socket or -1
+ */
+
+static int device_nl_open(void)
+{
+struct sockaddr_nl src_addr;
+int sock_fd;
+
+sock_fd = socket(PF_NETLINK, SOCK_DGRAM, NETLINK_RS_SERVER);
+if(sock_fd < 0){
+	syslog(LOG_NOTICE, "Can't create netlink socket.\n");
+	return -1;
+	}
+
+memset( &src_addr, 0, sizeof(src_addr));
+src_addr.nl_family = AF_NETLINK;
+src_addr.nl_pid = getpid();
+src_addr.nl_groups = 0;
+
+if( bind(sock_fd, (struct sockaddr*)&src_addr, sizeof(src_addr)) < 0 ){
+	syslog(LOG_NOTICE, "Can't bind netlink socket.\n");
+	close(sock_fd);
+	return -1;
+	}
+
+return sock_fd;
+}
+
+
+
+/**
+ * Sends several netlink packets to the kernel with one call.
+ *
+ * @param sock		: socket
+ * @param *msgs		: packets
+ * @param vlen		: number of packets
+ *
+ * @returns			result of sendmmsg
+ */
+
+static int device_nl_sendmmsg(int sock, struct mmsghdr *msgs, unsigned int vlen)
+{
+return sendmmsg(sock, msgs, vlen, 0);
+}
+
+
+
+/**
+ * Receives the netlink packets the kernel has queued, blocks until there is
+ * at least one.
+ *
+ * @param sock		: socket
+ * @param *msgs		: packets
+ * @param vlen		: at most this many packets
+ *
+ * @returns			result of recvmmsg
+ */
+
+static int device_nl_recvmmsg(int sock, struct mmsghdr *msgs, unsigned int vlen)
+{
+return recvmmsg(sock, msgs, vlen, MSG_WAITFORONE, NULL);
+}
+
+
+
+/**
+ * Closes the netlink socket.
+ *
+ * @param sock		: socket
+ *
+ * @returns			void
+ */
+
+static void device_nl_close(int sock)
+{
+close(sock);
 }
@@ -35,8 +35,98 @@
  *
  *****************************************************************/
 
-static char stack[10000];
+#ifndef __USERSPACE_DRIVER__
+#define __USERSPACE_DRIVER__
+
+#include <signal.h>
+
+#include "definitions.h"
+#include "kernel_ops.h"
+#include "marshal.h"
+#include "ops.h"
+#include "arrays.h"
+#include "memlock.h"
+
+/*
+ * Everything a server loop touches while it serves one request: the calls 
+ * towards the kernel stub, the device file, the mapped marshalling struct, the disk pointer array and the compute
+ * context of the backend. batch holds the stripes of a batched pickup, pool the buffers of the copy path, sg the 
+ * segment table of the scatter-gather path, desc the request descriptor of protocol version proto and op the 
+ * operation taken from it, array the array it was routed to or NULL. budget bounds the requests of a serve loop for the 
+ * calibration of -c AUTO, 0 serves until the daemon is stopped; budget_first and budget_last are the arrivals of the 
+ * first and the last of them. faults counts the page faults of the requests served. Every serving thread owns one of 
+ * these, only the marshalling policy is shared between them.
+ */
+typedef struct driver_context{
+	kernel_ops *kops;
+	int fd;
+	syndrome_container *smc;
+	void **dptrs;
+	syndrome_backend *backend;
+	syndrome_context ctx;
+	arena_header *arena;
+	size_t arena_size;
+	int arena_request;
+	marshal_policy *marshal;
+	marshal_pool pool;
+	int marshal_used;
+	unsigned long long marshal_ns;
+	sg_table *sg;
+	char *sg_window;
+	size_t sg_window_bytes;
+	int sg_request;
+	request_desc *desc;
+	unsigned int proto;
+	request_op op;
+	barracuda_array *array;
+	syndrome_container *batch;
+	void **batch_ptrs;
+	int batch_count;
+	int batch_largest;
+	unsigned long batches;
+	unsigned long batch_stripes;
+	int shard;
+	unsigned long ring_submissions;
+	unsigned long ring_batches;
+	unsigned long ring_max_batch;
+	unsigned int coalesce_count;
+	unsigned int coalesce_us;
+	int doorbell_submit;
+	int doorbell_complete;
+	unsigned long budget;
+	unsigned long long budget_first;
+	unsigned long long budget_last;
+	fault_counter faults;
+	}driver_context;
+
+/* A single-slot connection as seen by the request loop */
+typedef struct request_transport{
+	int (*wait)(void *arg, char *token);	/* takes the next request */
+	syndrome_container *(*fetch)(void *arg, driver_context *dc, char *token);	/* NULL maps or copies */
+	void (*ack)(void *arg, char *token);	/* NULL if the next wait acknowledges */
+	void *arg;
+	}request_transport;
+
+/* cleared by the signal handlers, every server loop returns then */
+extern volatile sig_atomic_t keep_going;
 
 int userspace_driver_main(void *rs_function);
+void userspace_driver_stop(void);
+
+/* The server loops of the connections, a budget in dc bounds the first four */
+int server_ioctl_callback(driver_context *dc, int pipeline);
+int server_netlink(driver_context *dc, int pipeline);
+int server_procfs(driver_context *dc, int pipeline);
+int server_doorbell(driver_context *dc, unsigned int spin_us, int pipeline);
+int server_ring(driver_context *dc, unsigned int entries, unsigned long slot_bytes);
+int server_ring_shards(driver_context *dc, thread_container *tc);
+
+/* The stages of a request, a serve loop runs them in this order */
+syndrome_container *transport_fetch(request_transport *rt, driver_context *dc, char *token);
+void compute_request(driver_context *dc, syndrome_container *smc);
+void release_request(driver_context *dc, syndrome_container *smc);
+void complete_op(driver_context *dc);
+
+#endif
 
 
@@ -0,0 +1,485 @@
+/**
+ * \file
+ * \brief	UNIX socket service for userspace clients
+ *
+ * @author	Dominic Eschweiler weiler@upb.de
+ *
+ * Status	: STABLE \n
+ * Date of creation : 18.10.2026
+ *
+ */
+
+
+/*****************************************************************
+ *
+ * Barracuda is a experimental microdriver extension to the 
+ * linux-kernel that is able to outsource common functions to
+ * the userspace. It was intensionally designed to accelerate
+ * CPU-intensive Tasks on a GPU.
+ *
+ * Copyright (C) 2009 Dominic Eschweiler
+ *
+ * This program is free software; you can redistribute it and/or 
+ * modify it under the terms of the GNU General Public License as 
+ * published by the Free Software Foundation; either only GPLv2 - 
+ * version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful, 
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of 
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the 
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public 
+ * License along with this program; 
+ * if not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <syslog.h>
+#include <pthread.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+# include "usock.h"
+# include "backends.h"
+# include "async.h"
+# include "ops.h"
+# include "arrays.h"
+# include "affinity.h"
+# include "memlock.h"
+
+/* A buffer a client has registered */
+typedef struct usock_buffer{
+	char *base;
+	size_t size;
+	}usock_buffer;
+
+/* A connected client */
+typedef struct usock_client{
+	pthread_t thread;
+	int fd;
+	int active;
+	usock_buffer buffers[USOCK_MAX_BUFFERS];
+	unsigned long requests;
+	unsigned long failures;
+	unsigned long long bytes;
+	}usock_client;
+
+/* The service, there is one per daemon */
+static struct{
+	int fd;
+	char path[108];
+	syndrome_backend *backend;
+	pthread_t acceptor;
+	pthread_mutex_t lock;
+	usock_client *clients[USOCK_MAX_CLIENTS];
+	volatile int stopping;
+	unsigned long connections;
+	}us = { -1 };
+
+
+
+/**
+ * Maps the memfd of a registration.
+ *
+ * @param *c		: client
+ * @param fd		: the passed descriptor, it is closed here
+ *
+ * @returns	 int : id of the buffer or a negative errno
+ */
+
+static int usock_register(usock_client *c, int fd)
+{
+struct stat st;
+void *base;
+int err;
+int i;
+
+for(i=0; (i < USOCK_MAX_BUFFERS) && (c->buffers[i].base != NULL); i++);
+
+if(i == USOCK_MAX_BUFFERS){
+	close(fd);
+	return -ENOSPC;
+	}
+if( (fstat(fd, &st) != 0) || (st.st_size <= 0) ){
+	close(fd);
+	return -EINVAL;
+	}
+
+base = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED | memlock_map_flags(), fd, 0);
+err	 = errno;
+close(fd);
+if(base == MAP_FAILED){ return -err; }
+
+c->buffers[i].base = (char *)base;
+c->buffers[i].size = (size_t)st.st_size;
+
+return i;
+}
+
+
+
+/**
+ * Unmaps a buffer.
+ *
+ * @param *c		: client
+ * @param id		: id of the buffer
+ *
+ * @returns	 int : 0 or -EINVAL
+ */
+
+static int usock_unregister(usock_client *c, int id)
+{
+if( (id < 0) || (id >= USOCK_MAX_BUFFERS) || (c->buffers[id].base == NULL) ){ return -EINVAL; }
+
+munmap(c->buffers[id].base, c->buffers[id].size);
+c->buffers[id].base = NULL;
+c->buffers[id].size = 0;
+
+return 0;
+}
+
+
+
+/**
+ * Computes a submitted request in place in the registered buffer.
+ *
+ * @param *c		: client
+ * @param *ctx		: compute context of the client thread
+ * @param *msg		: the request
+ *
+ * @returns	 int : 0, the mask of OP_CHECK or a negative errno
+ */
+
+static int usock_submit(usock_client *c, syndrome_context *ctx, usock_msg *msg)
+{
+request_desc *desc = &msg->desc;
+usock_buffer *b;
+barracuda_array *array;
+request_op op;
+syndrome_request req;
+void *ptrs[ARENA_MAX_DISKS];
+int ret;
+int i;
+
+if( (msg->buffer < 0) || (msg->buffer >= USOCK_MAX_BUFFERS) || (c->buffers[msg->buffer].base == NULL) ){
+	return -EBADF;
+	}
+b = &c->buffers[msg->buffer];
+
+if( (ops_take(&op, desc) == EXIT_FAILURE) || (desc->bytes == 0) || (desc->bytes > b->size) ||
+	(desc->bytes % USOCK_ALIGN) ){ 
+	return -EINVAL; 
+	}
+
+/* every disk must lie in the buffer */
+for(i=0; i < desc->disks; i++){
+	if( (desc->offsets[i] > b->size - desc->bytes) || (desc->offsets[i] % USOCK_ALIGN) ){ return -ERANGE; }
+	ptrs[i] = (void *)(b->base + desc->offsets[i]);
+	}
+
+ret = array_route(&op, desc->disks, &array);
+if(ret != 0){ return ret; }
+
+c->requests++;
+c->bytes += (unsigned long long)desc->disks * desc->bytes;
+
+if(array != NULL){
+	array_compute(array, &op, desc->disks, desc->bytes, ptrs);
+	return op.result;
+	}
+
+if(op.opcode != OP_GEN){
+	ops_call(us.backend, ctx, &op, desc->disks, desc->bytes, ptrs);
+	return op.result;
+	}
+
+/* the compute workers of the daemon, inline if they are off or the queue is full */
+syndrome_request_init(&req, desc->disks, desc->bytes, ptrs, NULL, NULL);
+if( syndrome_submit(&req) == EXIT_SUCCESS ){
+	syndrome_wait(&req);
+	return 0;
+	}
+
+syndrome_call(us.backend, ctx, desc->disks, desc->bytes, ptrs);
+return 0;
+}
+
+
+
+/**
+ * Takes the next message of a client together with a passed descriptor.
+ *
+ * @param *c		: client
+ * @param *msg		: the message is stored here
+ * @param *fd		: the passed descriptor or -1
+ *
+ * @returns	 ssize_t : bytes received, <= 0 if the client is gone
+ */
+
+static ssize_t usock_receive(usock_client *c, usock_msg *msg, int *fd)
+{
+char control[CMSG_SPACE(sizeof(int))];
+struct msghdr mh;
+struct iovec iov;
+struct cmsghdr *cmsg;
+ssize_t len;
+
+iov.iov_base = msg;
+iov.iov_len	 = sizeof(usock_msg);
+
+memset(&mh, 0, sizeof(mh));
+mh.msg_iov			= &iov;
+mh.msg_iovlen		= 1;
+mh.msg_control		= control;
+mh.msg_controllen	= sizeof(control);
+
+*fd = -1;
+while( ((len = recvmsg(c->fd, &mh, MSG_CMSG_CLOEXEC)) < 0) && (errno == EINTR) );
+if(len <= 0){ return len; }
+
+for(cmsg = CMSG_FIRSTHDR(&mh); cmsg != NULL; cmsg = CMSG_NXTHDR(&mh, cmsg)){
+	if( (cmsg->cmsg_level == SOL_SOCKET) && (cmsg->cmsg_type == SCM_RIGHTS) && 
+		(cmsg->cmsg_len == CMSG_LEN(sizeof(int))) ){
+		memcpy(fd, CMSG_DATA(cmsg), sizeof(int));
+		}
+	}
+
+return len;
+}
+
+
+
+/**
+ * Serves one client until it disconnects or the service stops.
+ *
+ * @param *arg		: the client
+ *
+ * @returns			NULL
+ */
+
+static void *usock_client_thread(void *arg)
+{
+usock_client *c = (usock_client *)arg;
+syndrome_context ctx;
+usock_msg msg;
+int fd;
+int id;
+int i;
+
+affinity_apply(AFFINITY_SERVER);
+
+if( syndrome_context_init(us.backend, &ctx) == EXIT_FAILURE ){
+	syslog(LOG_NOTICE, "Can't initialise the %s context of a socket client\n", us.backend->name);
+	shutdown(c->fd, SHUT_RDWR);
+	c->active = 0;
+	return NULL;
+	}
+
+while( !us.stopping && (usock_receive(c, &msg, &fd) > 0) ){
+	if(msg.version != BARRACUDA_PROTO_VERSION){
+		msg.result = -EPROTO;
+		if(fd >= 0){ close(fd); }
+		}
+	else{
+		switch(msg.type){
+			case USOCK_MSG_REGISTER :	id = (fd >= 0) ? usock_register(c, fd) : -EBADF;
+										msg.buffer = (id >= 0) ? id : -1;
+										msg.result = (id >= 0) ? 0 : id;
+										fd = -1;
+										break;
+			case USOCK_MSG_UNREGISTER :	msg.result = usock_unregister(c, msg.buffer);
+										break;
+			case USOCK_MSG_SUBMIT :		msg.result = usock_submit(c, &ctx, &msg);
+										break;
+			default :					msg.result = -EOPNOTSUPP;
+			}
+		if(fd >= 0){ close(fd); }
+		}
+	
+	if(msg.result < 0){ c->failures++; }
+	
+	msg.type = USOCK_MSG_REPLY;
+	if( send(c->fd, &msg, sizeof(usock_msg), MSG_NOSIGNAL) != sizeof(usock_msg) ){ break; }
+	}
+
+syslog(LOG_NOTICE, "socket client : %lu requests, %llu bytes, %lu failed\n", 
+		c->requests, c->bytes, c->failures);
+
+for(i=0; i < USOCK_MAX_BUFFERS; i++){ usock_unregister(c, i); }
+syndrome_context_release(us.backend, &ctx);
+
+/* the socket is closed when the thread is joined, usock_stop() may still shut it down */
+c->active = 0;
+return NULL;
+}
+
+
+
+/**
+ * Joins the threads of the clients which have disconnected.
+ *
+ * @param all		: join all clients, they must have been shut down
+ *
+ * @returns	 int : a free entry of the client table or -1
+ */
+
+static int usock_reap(int all)
+{
+int i;
+int free_entry = -1;
+
+for(i=0; i < USOCK_MAX_CLIENTS; i++){
+	if( (us.clients[i] != NULL) && (all || !us.clients[i]->active) ){
+		pthread_join(us.clients[i]->thread, NULL);
+		close(us.clients[i]->fd);
+		free(us.clients[i]);
+		us.clients[i] = NULL;
+		}
+	if( (us.clients[i] == NULL) && (free_entry < 0) ){ free_entry = i; }
+	}
+
+return free_entry;
+}
+
+
+
+/**
+ * Accepts the clients until the service stops.
+ *
+ * @param *arg		: unused
+ *
+ * @returns			NULL
+ */
+
+static void *usock_accept_thread(void *arg)
+{
+usock_client *c;
+int fd;
+int slot;
+
+affinity_apply(AFFINITY_SERVER);
+
+while( !us.stopping ){
+	fd = accept(us.fd, NULL, NULL);
+	if(fd < 0){
+		if( (errno == EINTR) || (errno == ECONNABORTED) ){ continue; }
+		break;
+		}
+	
+	pthread_mutex_lock(&us.lock);
+	slot = us.stopping ? -1 : usock_reap(0);
+	c	 = (slot < 0) ? NULL : (usock_client *)calloc(1, sizeof(usock_client));
+	if(c != NULL){
+		c->fd	  = fd;
+		c->active = 1;
+		if( pthread_create(&c->thread, NULL, usock_client_thread, c) == 0 ){
+			us.clients[slot] = c;
+			us.connections++;
+			}
+		else{
+			free(c);
+			c = NULL;
+			}
+		}
+	pthread_mutex_unlock(&us.lock);
+	
+	if(c == NULL){
+		syslog(LOG_NOTICE, "Socket client refused, %d clients are served already\n", USOCK_MAX_CLIENTS);
+		close(fd);
+		}
+	}
+
+return NULL;
+}
+
+
+
+/**
+ * Creates the socket and starts the thread which accepts the clients.
+ *
+ * @param *path		: path of the socket, an old socket file is replaced
+ * @param *backend	: implementation for OP_GEN
+ *
+ * @returns	 EXIT_SUCCESS or EXIT_FAILURE
+ */
+
+HOST int usock_start(char *path, syndrome_backend *backend)
+{
+struct sockaddr_un addr;
+
+if(strlen(path) >= sizeof(addr.sun_path)){ return EXIT_FAILURE; }
+
+memset(&addr, 0, sizeof(addr));
+addr.sun_family = AF_UNIX;
+strcpy(addr.sun_path, path);
+
+us.fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+if(us.fd < 0){ return EXIT_FAILURE; }
+
+unlink(path);
+if( (bind(us.fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) || (listen(us.fd, 16) != 0) ){
+	close(us.fd);
+	us.fd = -1;
+	return EXIT_FAILURE;
+	}
+
+strcpy(us.path, path);
+us.backend	= backend;
+us.stopping = 0;
+pthread_mutex_init(&us.lock, NULL);
+
+if( pthread_create(&us.acceptor, NULL, usock_accept_thread, NULL) != 0 ){
+	pthread_mutex_destroy(&us.lock);
+	close(us.fd);
+	unlink(path);
+	us.fd = -1;
+	return EXIT_FAILURE;
+	}
+
+syslog(LOG_NOTICE, "Socket service listens on %s\n", path);
+return EXIT_SUCCESS;
+}
+
+
+
+/**
+ * Disconnects all clients, joins the threads and removes the socket file.
+ *
+ * @returns	 void
+ */
+
+HOST void usock_stop(void)
+{
+int i;
+
+if(us.fd < 0){ return; }
+
+us.stopping = 1;
+shutdown(us.fd, SHUT_RDWR);
+pthread_join(us.acceptor, NULL);
+
+/* a client thread leaves its recvmsg on the shutdown */
+pthread_mutex_lock(&us.lock);
+for(i=0; i < USOCK_MAX_CLIENTS; i++){
+	if(us.clients[i] != NULL){ shutdown(us.clients[i]->fd, SHUT_RDWR); }
+	}
+usock_reap(1);
+pthread_mutex_unlock(&us.lock);
+
+syslog(LOG_NOTICE, "Socket service : %lu connections\n", us.connections);
+
+close(us.fd);
+unlink(us.path);
+pthread_mutex_destroy(&us.lock);
+us.fd = -1;
+}
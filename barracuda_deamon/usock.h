@@ -0,0 +1,119 @@
+/**
+ * \file
+ * \brief	UNIX socket service for userspace clients
+ *
+ * @author	Dominic Eschweiler weiler@upb.de
+ *
+ * Status	: STABLE \n
+ * Date of creation : 18.10.2026
+ *
+ */
+
+
+/*****************************************************************
+ *
+ * Barracuda is a experimental microdriver extension to the 
+ * linux-kernel that is able to outsource common functions to
+ * the userspace. It was intensionally designed to accelerate
+ * CPU-intensive Tasks on a GPU.
+ *
+ * Copyright (C) 2009 Dominic Eschweiler
+ *
+ * This program is free software; you can redistribute it and/or 
+ * modify it under the terms of the GNU General Public License as 
+ * published by the Free Software Foundation; either only GPLv2 - 
+ * version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful, 
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of 
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the 
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public 
+ * License along with this program; 
+ * if not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************/
+
+#ifndef __USOCK__
+#define __USOCK__
+
+# include "definitions.h"
+
+/* __Socket Service__
+ * Userspace programs which do their own erasure coding reach the daemon on a
+ * UNIX socket of type SOCK_SEQPACKET, every message is one usock_msg. A 
+ * client registers its buffers once: USOCK_MSG_REGISTER carries a memfd (or 
+ * any file which can be mapped shared) as SCM_RIGHTS, the daemon maps it and
+ * replies with the id of the buffer. USOCK_MSG_SUBMIT names a buffer and 
+ * describes the operation with a request_desc as the kernel stub does; 
+ * offsets[i] is the offset of disk i in the buffer, so the data never leaves
+ * the shared pages. The offsets and bytes are multiples of USOCK_ALIGN. Every message is answered by a USOCK_MSG_REPLY with the 
+ * same seq, result is 0, the mask of OP_CHECK or a negative errno.
+ * USOCK_MSG_UNREGISTER unmaps a buffer, a closed connection unmaps all.
+ */
+
+/*! \def USOCK_DEFAULT_PATH
+	\brief Usual path of the socket, see --socket */
+
+/*! \def USOCK_MAX_BUFFERS
+	\brief Buffers a connection can have registered at once */
+
+/*! \def USOCK_MAX_CLIENTS
+	\brief Connections which are served at once */
+
+/*! \def USOCK_ALIGN
+	\brief Alignment of the disks in a buffer, the backends work on whole words */
+
+#define USOCK_DEFAULT_PATH		"/tmp/barracuda.sock"
+#define USOCK_MAX_BUFFERS		64
+#define USOCK_MAX_CLIENTS		64
+#define USOCK_ALIGN				64
+
+#define USOCK_MSG_REGISTER		1
+#define USOCK_MSG_UNREGISTER	2
+#define USOCK_MSG_SUBMIT		3
+#define USOCK_MSG_REPLY			4
+
+/*! \var typedef struct usock_msg;
+	\brief A message of the socket service in either direction. version is
+	BARRACUDA_PROTO_VERSION, desc is only looked at in a USOCK_MSG_SUBMIT, 
+	its array field routes the request like one of the kernel */
+
+typedef struct usock_msg{
+	unsigned int version;
+	unsigned int type;
+	unsigned long seq;
+	int buffer;
+	int result;
+	request_desc desc;
+	}usock_msg;
+
+
+
+/**
+ * Creates the socket and starts the thread which accepts the clients. Every
+ * client is served by a thread of its own with a compute context of its own,
+ * OP_GEN is handed to the compute workers of the daemon like a request of the
+ * kernel.
+ *
+ * @param *path		: path of the socket, an old socket file is replaced
+ * @param *backend	: implementation for OP_GEN
+ *
+ * @returns	 EXIT_SUCCESS or EXIT_FAILURE
+ */
+
+HOST int usock_start(char *path, syndrome_backend *backend);
+
+
+
+/**
+ * Disconnects all clients, joins the threads and removes the socket file.
+ * The compute workers must still be running.
+ *
+ * @returns	 void
+ */
+
+HOST void usock_stop(void);
+
+#endif
@@ -35,17 +35,26 @@
  *****************************************************************/
 
 #include <linux/cdev.h>
+#include <linux/completion.h>
+#include <linux/eventfd.h>
+#include <linux/file.h>
+#include <linux/hash.h>
+#include <linux/hrtimer.h>
 #include <linux/ioctl.h>
 #include <linux/init.h>
 #include <linux/kernel.h>
 #include <linux/kobject.h>
+#include <linux/kthread.h>
+#include <linux/list.h>
 #include <linux/module.h>
 #include <linux/mm.h>
 #include <linux/netlink.h>
 #include <linux/platform_device.h>
+#include <linux/poll.h>
 #include <linux/proc_fs.h>
 #include <linux/socket.h>
 #include <linux/stat.h>
+#include <linux/spinlock.h>
 #include <linux/sysfs.h>
 #include <linux/slab.h>
 #include <linux/skbuff.h>
@@ -76,7 +85,7 @@ static int conf_read(char *page, char **start, off_t off, int count, int *eof, v
 static int ioctl_callback( struct inode *inode, struct file *instanz, unsigned int cmd, unsigned long arg);
 
 static void nl_data_ready ( struct sk_buff *skb );
-static struct sk_buff *nl_recv_pkg( void );
+static void nl_describe(nl_request *req);
 
 static ssize_t barracuda_read( struct file *instance, char *user, size_t to_copy, loff_t *offset);
 static ssize_t barracuda_write( struct file *instance, const char *user, size_t to_copy, loff_t *offset);
@@ -90,10 +99,56 @@ int map_kmem(struct file *filp, struct vm_area_struct *vma, void *data);
 syndrome_container pack_smc(int disks, size_t bytes, void **ptrs);
 void kill_smc( syndrome_container *syndrome_conti );
 
+/* Shared arena handling functions */
+static int arena_alloc(size_t size);
+static void arena_free(void);
+static int arena_pack(int disks, size_t bytes, void **ptrs);
+static void arena_unpack(int disks, size_t bytes, void **ptrs);
+
+/* Batched pickup handling functions */
+static void batch_gen_syndrome(int disks, size_t bytes, int prio, void **ptrs);
+
+/* Submission/completion ring handling functions */
+static int ring_alloc(unsigned int entries, unsigned long slot_bytes, int shards);
+static void ring_release(void);
+static int ring_gen_syndrome(int disks, size_t bytes, void **ptrs);
+static int ring_enter(unsigned long arg);
+
+/* Doorbell handling functions */
+static int doorbell_setup(int submit_fd, int complete_fd);
+static void doorbell_release(void);
+
+/* Scatter-gather handling functions */
+static int sg_alloc(void);
+static void sg_release(void);
+static void sg_describe(int disks, size_t bytes, void **ptrs);
+static int sg_map_window(struct vm_area_struct *vma);
+
+/* Request descriptors */
+static void desc_fill(unsigned int opcode, int prio, int disks, size_t bytes);
+static int barracuda_op(unsigned int array, unsigned int opcode, int prio, int disks, size_t bytes, int start, 
+						int stop, int nfailed, int *failed, unsigned int flags, void **ptrs);
+
+/* Admission scheduler */
+static int sched_conf(char *value);
+static unsigned int sched_slot_count(void);
+static void sched_dispatch(void);
+static void sched_enter(int prio);
+static void sched_leave(int prio);
+static void sched_report(void);
+
+/* Time slicing of large requests */
+static void **slice_begin(int disks, size_t bytes);
+
+/* Connection calibration functions */
+static int ping_start(char *value);
+static void ping_wait(void);
+
 /* One of these functions are delegated to a function pointer */
 static int call_usp_proc(syndrome_container snc);
 static int call_usp_ioctl(syndrome_container snc);
 static int call_usp_nl(syndrome_container snc);
+static int call_usp_doorbell(syndrome_container snc);
 
 typedef int (*userspace_call)(syndrome_container snc);
 userspace_call call_usp;
@@ -101,6 +156,7 @@ userspace_call call_usp;
 /* Defines */
 #define MAJOR_NUM 240
 #define IOCTL_GETVALUE 0x0001
+#define IOCTL_RING_ENTER 0x0002
 #define NETLINK_RS_SERVER 25
 #define NL_COMMAND 0x11
 #define MAX_PAYLOAD 1024
@@ -138,6 +194,82 @@ static struct cdev mmap_cdev;
 
 static syndrome_container *actual_snc;
 
+static arena_header *arena = NULL;
+static size_t arena_size = 0;
+
+static int batch_max = 0;
+
+/* One ring for every server thread of the daemon, a stripe owns a slot of its
+ * ring while it is in flight and waits on its completion. The geometry is kept
+ * here, the copy in the mapped header may be overwritten by the daemon */
+typedef struct ring_shard{
+	ring_header *ring;
+	size_t size;
+	unsigned int entries;
+	unsigned long slot_bytes;
+	unsigned long data_offset;
+	struct semaphore slots;
+	spinlock_t slot_lock;
+	spinlock_t sq_lock;
+	struct mutex cq_mutex;
+	wait_queue_head_t sq_wq;
+	unsigned int *free_slots;
+	int free_top;
+	struct completion *done;
+	}ring_shard;
+
+static ring_shard ring_shard_table[RING_MAX_SHARDS];
+static int ring_shards = 0;
+static int ring_shard_by = RING_SHARD_CPU;
+static int ring_mode = 0;
+
+static doorbell_page *doorbell = NULL;
+
+/* The table of the actual stripe and the pages of its window in that order */
+static sg_table *sg = NULL;
+static struct page **sg_pages = NULL;
+static unsigned int sg_npages = 0;
+
+/* The descriptor of the actual request and the negotiated protocol version */
+static request_desc *desc = NULL;
+static unsigned int proto_version = 0;
+static unsigned long desc_id = 0;
+
+/* One class of the admission scheduler, the waiting stripes sleep in waiting */
+typedef struct sched_class{
+	struct list_head waiting;
+	unsigned int credits;
+	unsigned int admitted;
+	unsigned int weight;
+	unsigned long target_us;
+	unsigned long long vtime;
+	unsigned long served;
+	unsigned long overdue;
+	unsigned long long wait_us;
+	unsigned long max_wait_us;
+	}sched_class;
+
+/* A stripe which waits for its admission, it lives on the stack of its caller */
+typedef struct sched_waiter{
+	struct list_head list;
+	s64 enqueued;
+	int granted;
+	}sched_waiter;
+
+#define SCHED_VTIME_UNIT	65536
+
+/* Requests with more bytes per disk are served slice by slice, 0 never slices */
+static size_t slice_bytes = 0;
+static unsigned long slice_requests = 0;
+static unsigned long slice_total = 0;
+
+static sched_class sched_classes[PRIO_CLASSES];
+static unsigned int sched_slots = 1;
+static unsigned int sched_inflight = 0;
+static unsigned long long sched_vtime = 0;
+static DEFINE_SPINLOCK( sched_lock );
+static DECLARE_WAIT_QUEUE_HEAD( sched_wq );
+
 /*_GENSYNDROME_MAIN_FUNCTION__________________________________________________*/
 
 DECLARE_MUTEX( gen_syndrome_mutex );
@@ -155,24 +287,247 @@ DECLARE_MUTEX( gen_syndrome_mutex );
 
 void raid6_cuda_gen_syndrome(int disks, size_t bytes, void **ptrs)
 {
+raid6_cuda_gen_syndrome_prio(disks, bytes, ptrs, PRIO_FOREGROUND);
+}
+
+
+
+/**
+ * Hands one stripe over the single slot of the connection and waits for its 
+ * syndromes. gen_syndrome_mutex must be held, or md must be held back by it.
+ *
+ * @param 		disks		Number of disks
+ * @param		bytes		Number of bytes
+ * @param		ptrs		Datapointers
+ * @param		prio		Priority class
+ *
+ * @returns		void
+ */
+
+static void slot_gen_syndrome(int disks, size_t bytes, void **ptrs, int prio)
+{
 syndrome_container snc;
-	
-down( &gen_syndrome_mutex );
-	
+int packed;
+int ret;
+
 /* Pack the syndrome data to a structure*/	
 snc = pack_smc(disks, bytes, ptrs);
+desc_fill(OP_GEN, prio, disks, bytes);
+
+/* With a shared arena the data disks are copied, not mapped */
+packed = arena_pack(disks, bytes, ptrs);
+if(packed != 0){ sg_describe(disks, bytes, ptrs); }
 
 #ifdef DEBUG_LEVEL_7
 printk ("raid6_cuda_gen_syndrome\n");
 #endif
 	
 /* Marshall it with the function which was choosen in <write_conf()> */
-call_usp(snc);
+ret = call_usp(snc);
+if(ret != 0){
+	barracuda_printk(0, "gen_syndrome of %d disks was not computed, the connection failed with %d\n", disks, ret);
+	}
+
+/* Fetch the checksums from the arena */
+else if(packed == 0){ arena_unpack(disks, bytes, ptrs); }
 
 /* deallocate the syndrome pointer */
 kill_smc(&snc);
+}
+
+
+
+/**
+ * gen_syndrome of one piece of a stripe, it waits for its admission by the 
+ * scheduler first.
+ *
+ * @param 		disks		Number of disks
+ * @param		bytes		Number of bytes
+ * @param		ptrs		Datapointers
+ * @param		prio		Priority class
+ *
+ * @returns		void
+ */
+
+static void gen_syndrome_piece(int disks, size_t bytes, void **ptrs, int prio)
+{
+sched_enter(prio);
+
+/* The ring allows many stripes in flight, it bypasses the single slot. 
+ * ring_alloc() sized every slot for ARENA_MAX_DISKS disks, only a wider 
+ * stripe than any array can have is refused. */
+if(ring_mode){
+	if( ring_gen_syndrome(disks, bytes, ptrs) != 0 ){
+		barracuda_printk(0, "Stripe with %d disks exceeds ARENA_MAX_DISKS, it is not computed\n", disks);
+		}
+	sched_leave(prio);
+	return;
+	}
+
+/* Concurrent callers share one handshake, see <batch_gen_syndrome()> */
+if( (batch_max > 1) && (arena != NULL) ){
+	batch_gen_syndrome(disks, bytes, prio, ptrs);
+	sched_leave(prio);
+	return;
+	}
 	
+down( &gen_syndrome_mutex );
+slot_gen_syndrome(disks, bytes, ptrs, prio);
 up( &gen_syndrome_mutex );
+
+sched_leave(prio);
+}
+
+
+
+/**
+ * gen_syndrome of a stripe of a priority class, resync and rebuild stripes 
+ * should be passed as PRIO_RECOVERY or PRIO_BACKGROUND. The stripe waits for
+ * its admission by the scheduler first. A stripe above the slice= size of 
+ * the daemon is served slice by slice, every slice is admitted on its own so 
+ * that the small stripes of the other classes get in between. The call 
+ * returns after the last slice.
+ *
+ * @param 		disks		Number of disks
+ * @param		bytes		Number of bytes
+ * @param		ptrs		Datapointers
+ * @param		prio		PRIO_FOREGROUND, PRIO_RECOVERY or PRIO_BACKGROUND
+ *
+ * @returns		void
+ */
+
+void raid6_cuda_gen_syndrome_prio(int disks, size_t bytes, void **ptrs, int prio)
+{
+void **slice;
+size_t offset;
+size_t length;
+int i;
+
+if( (prio < 0) || (prio >= PRIO_CLASSES) ){ prio = PRIO_FOREGROUND; }
+
+slice = slice_begin(disks, bytes);
+if(slice == NULL){
+	gen_syndrome_piece(disks, bytes, ptrs, prio);
+	return;
+	}
+
+for(offset=0; offset < bytes; offset += length){
+	length = min(bytes - offset, slice_bytes);
+	for(i=0; i < disks; i++){ slice[i] = (u8 *)ptrs[i] + offset; }
+	gen_syndrome_piece(disks, length, slice, prio);
+	}
+
+vfree(slice);
+}
+
+
+
+/*_CONNECTION_CALIBRATION_____________________________________________________*/
+
+static struct task_struct *ping_task = NULL;
+static DECLARE_COMPLETION( ping_done );
+static void *ping_ptrs[PING_DISKS];
+static int ping_rounds = 0;
+static size_t ping_bytes = 0;
+
+/**
+ * Kernel thread of ping=, it hands the ping stripes over the connection one 
+ * after the other like md would. md itself can't get in between, it waits for
+ * gen_syndrome_mutex until con= is set.
+ *
+ * @param		*data		unused
+ *
+ * @returns		0
+ */
+
+static int ping_thread(void *data)
+{
+unsigned long start = jiffies;
+int i;
+
+for(i=0; i < ping_rounds; i++){
+	slot_gen_syndrome(PING_DISKS, ping_bytes, ping_ptrs, PRIO_FOREGROUND);
+	}
+
+barracuda_printk(0, "ping : %d stripes of %lu bytes in %u us\n", 
+				ping_rounds, (unsigned long)ping_bytes, jiffies_to_usecs(jiffies - start));
+
+for(i=0; i < PING_DISKS; i++){
+	vfree(ping_ptrs[i]);
+	ping_ptrs[i] = NULL;
+	}
+
+complete_and_exit( &ping_done, 0 );
+
+return 0;
+}
+
+
+
+/**
+ * Starts the ping stripes of ping=<connection>:<rounds>:<bytes>, see 
+ * global_def.h. A previous ping is waited for first. conf_mutex must be held.
+ *
+ * @param		*value		<connection>:<rounds>:<bytes>
+ *
+ * @returns		0 on success, -EINVAL or -ENOMEM on error
+ */
+
+static int ping_start(char *value)
+{
+char *connection = strsep( &value, ":");
+char *rounds = strsep( &value, ":");
+int i;
+
+if( (rounds == NULL) || (value == NULL) ){ return -EINVAL; }
+
+ping_wait();
+
+ping_rounds = simple_strtoul(rounds, NULL, 10);
+ping_bytes	= PAGE_ALIGN( simple_strtoul(value, NULL, 10) );
+if( (ping_rounds <= 0) || (ping_bytes == 0) || (ping_bytes > PING_MAX_BYTES) ){ return -EINVAL; }
+
+if( strcmp(connection, "NL") == 0 ){ call_usp = call_usp_nl; }
+else if( strcmp(connection, "PROCFS") == 0 ){ call_usp = call_usp_proc; }
+else if( strcmp(connection, "IOCTL") == 0 ){ call_usp = call_usp_ioctl; }
+else if( (strcmp(connection, "DOORBELL") == 0) && (doorbell != NULL) ){ call_usp = call_usp_doorbell; }
+else{ return -EINVAL; }
+
+for(i=0; i < PING_DISKS; i++){
+	ping_ptrs[i] = vmalloc(ping_bytes);
+	if(ping_ptrs[i] == NULL){ break; }
+	memset(ping_ptrs[i], i, ping_bytes);
+	}
+
+if(i == PING_DISKS){
+	init_completion( &ping_done );
+	ping_task = kthread_run(ping_thread, NULL, "barracuda_ping");
+	if( !IS_ERR(ping_task) ){ return 0; }
+	ping_task = NULL;
+	}
+
+while(i-- > 0){
+	vfree(ping_ptrs[i]);
+	ping_ptrs[i] = NULL;
+	}
+
+return -ENOMEM;
+}
+
+
+
+/**
+ * Waits until the stripes of the last ping= are served.
+ *
+ * @returns		void
+ */
+
+static void ping_wait(void)
+{
+if(ping_task == NULL){ return; }
+
+wait_for_completion( &ping_done );
+ping_task = NULL;
 }
 
 
@@ -186,7 +541,7 @@ up( &gen_syndrome_mutex );
  * @param		count		# of bytes
  * @param		*data		Datapointer
  *
- * @returns		0 success and -EFAULT or -EOVERFLOW on error
+ * @returns		0 success and -EFAULT, -EOVERFLOW, or the error of ping= 
  */
 
 static unsigned int PID	= 0;
@@ -252,12 +607,106 @@ else{
 	barracuda_printk (1, "Inst  : %s\n", instruction);
 	barracuda_printk (1, "Value : %s\n", value);
 	
+	/**
+	 * arena=<bytes> allocates the shared arena, it must be set before the
+	 * connection-type because the daemon maps it right after. A ping packs
+	 * into the arena, it is finished first.
+	 */
+	if( strcmp(instruction, "arena") == 0 ){
+		ping_wait();
+		if( arena_alloc( simple_strtoul(value, NULL, 10) ) != 0 ){
+			barracuda_printk (0, "Arena allocation failed\n");
+			}
+		}
+	
+	/* batch=<stripes> hands up to that many stripes over with one handshake */
+	if( strcmp(instruction, "batch") == 0 ){
+		batch_max = simple_strtoul(value, NULL, 10);
+		if(batch_max > BATCH_MAX_STRIPES){ batch_max = BATCH_MAX_STRIPES; }
+		barracuda_printk (1, "Batches of up to %d stripes\n", batch_max);
+		}
+	
+	/**
+	 * ring=<entries>:<slot bytes>[:<shards>] allocates the submission/completion
+	 * rings, one for every server thread of the daemon
+	 */
+	if( strcmp(instruction, "ring") == 0 ){
+		char *entries = strsep( &value, ":");
+		char *slot_bytes = strsep( &value, ":");
+		
+		if( (slot_bytes == NULL) || 
+			(ring_alloc( simple_strtoul(entries, NULL, 10), simple_strtoul(slot_bytes, NULL, 10),
+						(value == NULL) ? 1 : simple_strtoul(value, NULL, 10) ) != 0) ){
+			barracuda_printk (0, "Ring allocation failed\n");
+			}
+		}
+	
+	/* slice=<bytes> serves larger stripes slice by slice, in whole pages */
+	if( strcmp(instruction, "slice") == 0 ){
+		slice_bytes = PAGE_ALIGN( simple_strtoul(value, NULL, 10) );
+		barracuda_printk (1, "Slices of %lu bytes\n", (unsigned long)slice_bytes);
+		}
+	
+	/* ping=<connection>:<rounds>:<bytes> lets the daemon time a connection */
+	if( strcmp(instruction, "ping") == 0 ){
+		int ret = ping_start(value);
+		
+		if(ret != 0){
+			barracuda_printk (0, "Ping refused\n");
+			up( &conf_mutex );
+			return ret;
+			}
+		}
+	
+	/* sg=1 describes the stripes outside of the arena as page lists, a ping uses the table */
+	if( strcmp(instruction, "sg") == 0 ){
+		ping_wait();
+		if( (simple_strtoul(value, NULL, 10) != 0) && (sg_alloc() != 0) ){
+			barracuda_printk (0, "Scatter-gather table allocation failed\n");
+			}
+		}
+	
+	/* proto=<version> negotiates the request descriptor, see global_def.h */
+	if( strcmp(instruction, "proto") == 0 ){
+		proto_version = simple_strtoul(value, NULL, 10);
+		if(proto_version > BARRACUDA_PROTO_VERSION){ proto_version = BARRACUDA_PROTO_VERSION; }
+		if(desc != NULL){ desc->version = proto_version; }
+		barracuda_printk (1, "Protocol version %u\n", proto_version);
+		}
+	
+	/* sched=<credits>/<weight>/<target us>:... sets the priority classes */
+	if( strcmp(instruction, "sched") == 0 ){
+		if( sched_conf(value) != 0 ){
+			barracuda_printk (0, "Invalid scheduler classes, the defaults stay\n");
+			}
+		}
+	
+	/* shard=CPU|STRIPE chooses how the stripes are spread over the rings */
+	if( strcmp(instruction, "shard") == 0 ){
+		if( strcmp(value, "STRIPE") == 0 ){ ring_shard_by = RING_SHARD_STRIPE; }
+		else{ ring_shard_by = RING_SHARD_CPU; }
+		}
+	
+	/**
+	 * doorbell=<submit eventfd>:<complete eventfd>, the descriptors are only
+	 * valid in the daemon, which is the writer of this file.
+	 */
+	if( strcmp(instruction, "doorbell") == 0 ){
+		char *submit = strsep( &value, ":");
+		
+		if( (value == NULL) || 
+			(doorbell_setup( simple_strtol(submit, NULL, 10), simple_strtol(value, NULL, 10) ) != 0) ){
+			barracuda_printk (0, "Doorbell setup failed\n");
+			}
+		}
+	
 	/**
 	 * For this reason we construct a function pointer to the right implementation.
 	 * This one gets used in the function <raid6_cuda_gen_syndrome()>
 	 */
 	if( strcmp(instruction, "con") == 0 ){
 		barracuda_printk (1, "Choosing connection\n");
+		ping_wait();
 		
 		/*con=NL*/
 		if( strcmp(value, "NL") == 0 ){
@@ -283,10 +732,31 @@ else{
 			up( &gen_syndrome_mutex );
 			}
 		
+		/*con=RING*/
+		if( (strcmp(value, "RING") == 0) && (ring_shards > 0) ){ 
+			ring_mode = 1;
+			configured = 1;
+			barracuda_printk (1, "configured = %d\n", configured);
+			up( &gen_syndrome_mutex );
+			}
+		
+		/*con=DOORBELL*/
+		if( (strcmp(value, "DOORBELL") == 0) && (doorbell != NULL) ){ 
+			call_usp = call_usp_doorbell;
+			configured = 1;
+			barracuda_printk (1, "configured = %d\n", configured);
+			up( &gen_syndrome_mutex );
+			}
+		
 		/**
 		 * After a pid and a connection-type was choosen, the gen_syndrome
-		 * function is ready to use.
+		 * function is ready to use. The scheduler admits as many stripes 
+		 * as the connection holds at once.
 		 */
+		spin_lock( &sched_lock );
+		sched_slots = sched_slot_count();
+		sched_dispatch();
+		spin_unlock( &sched_lock );
 		}
 	}
 
@@ -498,6 +968,9 @@ static int ioctl_callback(	struct inode *inode,
 {
 char buffer[5];
 
+/* The ring has its own doorbell, it doesn't take part in the handshake */
+if(cmd == IOCTL_RING_ENTER){ return ring_enter(arg); }
+
 #ifdef DEBUG_LEVEL_3
 printk(KERN_INFO "IOCTL called.\n");
 #endif
@@ -510,6 +983,13 @@ printk(KERN_INFO "next strcpy and check\n");
 		
 strcpy( (char *)&buffer, (char *)arg);
 	
+/* "done" acknowledges the last ping stripe without waiting for another one */
+if( strcmp(buffer, "done") == 0 ){
+	ioctl_wq_enter_flag = 1;
+	wake_up_interruptible(&ioctl_wq_enter);
+	return 0;
+	}
+
 if( strcmp(buffer, "flag") ){
 	printk(KERN_INFO "No valid IOCTL calling!\n");
 	}
@@ -558,124 +1038,127 @@ DECLARE_MUTEX( call_usp_nl_mutex );
 static struct sock *nl_sk  = NULL;
 static DEFINE_MUTEX(nl_mutex);
 static DECLARE_WAIT_QUEUE_HEAD(nl_receive_queue);
-int nl_receive_flag = 2;
-struct sk_buff *skb_global = NULL;
+static u32 nl_port = 0;
+static unsigned int nl_seq = 0;
+static nl_request nl_completion;
+static int nl_completed = 0;
 
 /**
- * Redirection stub for calling the userspace by the netlink method. Therefore
- * all input arguments for gen_syndrome get packed together to one syndrome-
- * container.
+ * Describes the stripes of the actual handshake. A packed arena holds a chain
+ * of stripe headers, every header gets a descriptor; otherwise the stripe 
+ * goes alone on the mmap path.
+ *
+ * @param 		*req	: the descriptors are stored here
+ *
+ * @returns		void
+ */
+
+static void nl_describe(nl_request *req)
+{
+unsigned long offset = 0;
+arena_header *hdr;
+
+req->count = 0;
+
+if( (arena == NULL) || (arena->mode != ARENA_INLINE) ){
+	req->desc[0].offset = NL_DESC_MAPPED;
+	req->desc[0].status = -EINPROGRESS;
+	req->count = 1;
+	return;
+	}
+
+do{
+	hdr = (arena_header *)((char *)arena + offset);
+	req->desc[req->count].offset = offset;
+	req->desc[req->count].status = -EINPROGRESS;
+	req->count++;
+	offset = hdr->next;
+	}while( (offset != 0) && (req->count < NL_DESC_MAX) );
+}
+
+
+
+/**
+ * Redirection stub for calling the userspace by the netlink method. All
+ * stripes of the handshake are described in one binary request message, the
+ * daemon answers with one completion message. The daemon has registered its 
+ * port once, no message is needed to open the next handshake.
  *
  * @param 		*snc	This are the gen_syndrome arguments which should be 
  *						marshalled to the userspace.
  *
- * @returns		int > 0 as the size of the returned data
+ * @returns		0 on success, -EFAULT on error
  */
 
 static int call_usp_nl(syndrome_container snc)
 {
-unsigned long back_adress;
-unsigned long curr_adress;
-	
 struct sk_buff *skb;
-struct sk_buff *ret_skb;
-struct nlmsghdr *nlh;
 struct nlmsghdr *hdr;
-char *data_ptr;
-char *ret_data_ptr;
-u32 pid;
-int status;
-	
+nl_request req;
+size_t len;
+int ret = 0;
+int i;
+
 down(&call_usp_nl_mutex);
-	/* get first a new package from the userspace */
-	skb          = nl_recv_pkg();
-	nlh = nlmsg_hdr(skb);
-	pid = nlh->nlmsg_pid;
-	
-	if(PID != pid){
-		printk("PIDs are defering.\n");
-		return 1;
-		}
-	
-	/* Set actual pointer and prepare it for passing to the userspace */
-	memcpy(actual_snc, &snc, sizeof(syndrome_container) );
-	
-	back_adress = (unsigned long)&actual_snc;
-	
-	/* Put the pointer in a netlink packet */
-	ret_skb = nlmsg_new(NLMSG_GOODSIZE, GFP_KERNEL);
-	if(ret_skb == NULL){
-		printk("There is no memory for the socket buffer.\n");
-		return 1;
-		}
-	
-	hdr = nlmsg_put(ret_skb, 0, 1, NLMSG_DONE, sizeof(unsigned long), 0);
-	if( IS_ERR(hdr) ){
-		printk("nlmsg_put failed.\n");
-		return 1;
-		}
-	
-	data_ptr = nlmsg_data(hdr);
-	memcpy(data_ptr, &back_adress, sizeof(unsigned long) );
 
-	/* send it to the userspace */
-	#ifdef DEBUG_LEVEL_1
-	printk("next unicast\n");
-	#endif
-	
-	status = netlink_unicast(nl_sk, ret_skb, PID, MSG_DONTWAIT);
-	if (status < 0){
-		printk("Unicast failed\n");
-		}
-	
-	/* wait for a response */
-	skb          = nl_recv_pkg();
-	
-	#ifdef DEBUG_LEVEL_1
-	printk("received\n");
-	#endif
-	
-	/* copy the returned data */
-	#ifdef DEBUG_LEVEL_1	
-	printk("next nlmsg_hdr\n");
-	#endif
-		
-	nlh          = nlmsg_hdr(skb);
-	
-	#ifdef DEBUG_LEVEL_1
-	printk("next nlmsg_data\n");
-	#endif
-		
-	ret_data_ptr = nlmsg_data(nlh);
-	
-	/* get the current returned adress */
-	
-	#ifdef DEBUG_LEVEL_1
-	printk("next memcpy\n");
-	#endif
-		
-	memcpy(&curr_adress, ret_data_ptr, sizeof(unsigned long) );
+/* wait for the registration of the daemon */
+if( wait_event_interruptible(nl_receive_queue, nl_port != 0) ){
+	up(&call_usp_nl_mutex);
+	return -EFAULT;
+	}
 
-	/* Check if there is all going right */
-	
-	#ifdef DEBUG_LEVEL_1
-	printk("next check\n");
-	#endif
+/* Set actual pointer for the mmap path of the daemon */
+memcpy(actual_snc, &snc, sizeof(syndrome_container) );
 
-	if(back_adress != curr_adress){
-		barracuda_printk (0, "Netlink back adress is not the same\n", configured);
-		return -EFAULT;;
-		}
-	#ifdef DEBUG_LEVEL_1
-	else{
-		printk("Check successed\n");
+req.seq = ++nl_seq;
+nl_describe(&req);
+len = NL_REQUEST_BYTES(req.count);
+
+skb = nlmsg_new(len, GFP_KERNEL);
+if(skb == NULL){
+	printk("There is no memory for the socket buffer.\n");
+	up(&call_usp_nl_mutex);
+	return -EFAULT;
+	}
+
+hdr = nlmsg_put(skb, 0, req.seq, NL_MSG_REQUEST, len, 0);
+if(hdr == NULL){
+	printk("nlmsg_put failed.\n");
+	kfree_skb(skb);
+	up(&call_usp_nl_mutex);
+	return -EFAULT;
+	}
+memcpy(nlmsg_data(hdr), &req, len);
+
+nl_completed = 0;
+
+#ifdef DEBUG_LEVEL_1
+printk("next unicast\n");
+#endif
+
+/* send it to the userspace, the skb belongs to the socket afterwards */
+if( netlink_unicast(nl_sk, skb, nl_port, MSG_DONTWAIT) < 0 ){
+	printk("Unicast failed\n");
+	up(&call_usp_nl_mutex);
+	return -EFAULT;
+	}
+
+/* wait for the completion of this request */
+if( wait_event_interruptible(nl_receive_queue, nl_completed && (nl_completion.seq == req.seq)) ){
+	up(&call_usp_nl_mutex);
+	return -EFAULT;
+	}
+
+for(i=0; i < req.count; i++){
+	if( (i >= nl_completion.count) || (nl_completion.desc[i].status != 0) ){
+		barracuda_printk(0, "Netlink request %u failed for stripe %d\n", req.seq, i);
+		ret = -EFAULT;
 		}
-	#endif
+	}
 
-	//kfree_skb(skb);
 up(&call_usp_nl_mutex);
 
-return 0;
+return ret;
 }
 
 
@@ -683,9 +1166,9 @@ return 0;
 /**
  * Netlink callback-server-function which is registered at the function 
  * <barracuda_start()> and deregistered in <barracuda_stop()>. It is associated
- * to a Netlink-socket <static struct sock *nl_sk> and called everytime if a
- * related netlink packet comes in. In combination with the wait queue <nl_receive_queue>
- * it is used to implement the blocking receive function <nl_recv_pkg()>.
+ * to a Netlink-socket <static struct sock *nl_sk> and called for every 
+ * message the daemon sends. A registration stores the port of the daemon, a
+ * completion wakes up <call_usp_nl()>.
  *
  * @param *skb		: netlink socket buffer for the incoming package
  *
@@ -694,62 +1177,54 @@ return 0;
 
 static void nl_data_ready( struct sk_buff *skb )
 {
-wait_event_interruptible(nl_receive_queue, nl_receive_flag==0);
+struct nlmsghdr *nlh = nlmsg_hdr(skb);
+size_t len;
 
-#ifdef DEBUG_LEVEL_1
-printk("data_read function was triggered\n");
-#endif
-	
-if(skb_global != NULL){
-	kfree_skb(skb_global);
-	skb_global = NULL;
+if( (skb->len < NLMSG_HDRLEN) || (nlh->nlmsg_len > skb->len) ){ return; }
+
+if(nlh->nlmsg_pid != PID){
+	printk("PIDs are defering.\n");
+	return;
 	}
-skb_global = skb_copy(skb, 1);
 
-#ifdef DEBUG_LEVEL_1
-printk("skb copied\n");
-#endif
+switch(nlh->nlmsg_type){
+	case NL_MSG_REGISTER :
+		nl_port = nlh->nlmsg_pid;
+		barracuda_printk(0, "Netlink port %u registered\n", nl_port);
+		break;
 	
-nl_receive_flag = 1;
+	case NL_MSG_COMPLETE :
+		len = nlh->nlmsg_len - NLMSG_HDRLEN;
+		if( (len < NL_REQUEST_BYTES(0)) || (len > sizeof(nl_request)) ){ return; }
+		
+		memset(&nl_completion, 0, sizeof(nl_request));
+		memcpy(&nl_completion, nlmsg_data(nlh), len);
+		if(nl_completion.count > NL_DESC_MAX){ nl_completion.count = 0; }
+		nl_completed = 1;
+		break;
+	
+	default :
+		return;
+	}
+
 wake_up_interruptible(&nl_receive_queue);
 }
 
 
 
+/*_copy_to_user_MARSHALLING_IMPLEMENTATION_DEPENDEND__________________________*/
 /**
- * Netlink blocking receive function. This function blocks until it gets triggert
- * by the function <nl_data_ready()>. It can be used to receive a new package from
- * the registered netlink socket.
+ * Function for copying the marshalling structs data into the userspace.
  *
- * @param 			void
+ * @param 			*instance	: The filepointer of the devfs file
+ * @param 			*users		: Adress pointer from the userspace program
+ * @param			to_copy		: data size
+ * @param			*offset		: offset given by pread()
  *
- * @returns			generic socket buffer
+ * @returns			void
  */
 
-static struct sk_buff *nl_recv_pkg( void )
-{
-nl_receive_flag = 0;
-wake_up_interruptible(&nl_receive_queue);
-wait_event_interruptible(nl_receive_queue, nl_receive_flag==1);
-	
-return skb_global;
-}
-
-
-
-/*_copy_to_user_MARSHALLING_IMPLEMENTATION_DEPENDEND__________________________*/
-/**
- * Function for copying the marshalling structs data into the userspace.
- *
- * @param 			*instance	: The filepointer of the devfs file
- * @param 			*users		: Adress pointer from the userspace program
- * @param			to_copy		: data size
- * @param			*offset		: offset given by pread()
- *
- * @returns			void
- */
-
-static ssize_t barracuda_read( struct file *instance, char *user, size_t to_copy, loff_t *offset)
+static ssize_t barracuda_read( struct file *instance, char *user, size_t to_copy, loff_t *offset)
 {
 int not_copied;
 char *tmp;
@@ -817,6 +1292,47 @@ printk("mmapdrv: mmap_mmap() called %lu\n", i);
 	printk("disks : %d, bytes : %lu\n", actual_snc->disks, actual_snc->bytes);
 #endif
 	
+/* At ARENA_PGOFF we map the whole shared arena */
+if (i == ARENA_PGOFF){
+	if(arena == NULL){ return -EIO; }
+	if(vma->vm_end - vma->vm_start > arena_size){ return -EINVAL; }
+	return remap_vmalloc_range(vma, arena, 0);
+	}
+
+/* At RING_PGOFF + shard we map a submission/completion ring with its slots */
+if ( (i >= RING_PGOFF) && (i < RING_PGOFF + RING_MAX_SHARDS) ){
+	ring_shard *rs = &ring_shard_table[i - RING_PGOFF];
+	
+	if(rs->ring == NULL){ return -EIO; }
+	if(vma->vm_end - vma->vm_start > rs->size){ return -EINVAL; }
+	return remap_vmalloc_range(vma, rs->ring, 0);
+	}
+
+/* At DOORBELL_PGOFF we map the sequence words of the doorbell */
+if (i == DOORBELL_PGOFF){
+	if(doorbell == NULL){ return -EIO; }
+	if(vma->vm_end - vma->vm_start > PAGE_SIZE){ return -EINVAL; }
+	return map_vmem(file, vma, doorbell);
+	}
+
+/* At SG_TABLE_PGOFF we map the segment table, at SG_WINDOW_PGOFF the pages it describes */
+if (i == SG_TABLE_PGOFF){
+	if(sg == NULL){ return -EIO; }
+	if(vma->vm_end - vma->vm_start > PAGE_ALIGN(sizeof(sg_table))){ return -EINVAL; }
+	return remap_vmalloc_range(vma, sg, 0);
+	}
+
+if (i == SG_WINDOW_PGOFF){
+	return sg_map_window(vma);
+	}
+
+/* At DESC_PGOFF we map the descriptor of the actual request */
+if (i == DESC_PGOFF){
+	if(desc == NULL){ return -EIO; }
+	if(vma->vm_end - vma->vm_start > PAGE_ALIGN(sizeof(request_desc))){ return -EINVAL; }
+	return map_vmem(file, vma, desc);
+	}
+
 /* At offset 0 we map the marshalling sruct */
 if (i == 0){
 	#ifdef DEBUG_LEVEL_6
@@ -1019,139 +1535,1577 @@ vfree(syndrome_conti->ptrs);
 
 
 
-/*_INITIALISATION_AND_CLEANUP_________________________________________________*/
+/*_SHARED_ARENA_______________________________________________________________*/
 /**
- * This initialisation _MUST_ be called before the barracuda-connector could do
- * anything. It does some initialisation steps, such as creating the needed
- * PROCFS entries an assigning a file in /dev/ to the related functions. The called
- * functions could be found in this file. local_dev_mmap() is the callback for
- * mmap syscall, which marshalls the syndrome-data to the userspace. ioctl_callback()
- * is the function for the IOCTL-based message method. proc_read and proc_write
- * are used for the PROCFS-based connection method which relays to the file 
- * /proc/barracuda/stub. A configuration entry at the PROCFS is also given. It can
- * be found on /proc/barracuda/stub and the related callbacks are conf_read and 
- * conf_write.
+ * Allocates the shared arena. Its header is followed by page aligned disk 
+ * buffers, so the arena is vmalloc'ed and mapped with remap_vmalloc_range().
+ * It is allocated once, the daemon may have it mapped and the stub packs into
+ * it from then on; the mapping holds its pages even after arena_free().
  *
- * @returns		int 	O on success
+ * @param 			size  : size of the arena in bytes
+ *
+ * @returns			0 on success, -EBUSY if there is an arena, -ENOMEM on error
  */
 
-int barracuda_start( void )
+static int arena_alloc(size_t size)
 {
-barracuda_printk(0, "<mod_init> called\n" );
+size = PAGE_ALIGN(size);
+if(size <= PAGE_ALIGN(sizeof(arena_header))){ return -ENOMEM; }
 
-/** 
- * This mutex locks the cuda_gen_syndrome function until the PID and connection
- * type is configured.
+if(arena != NULL){ return -EBUSY; }
+
+/* zeroed and allowed to be mapped to userspace */
+arena = (arena_header *)vmalloc_user(size);
+if(arena == NULL){ return -ENOMEM; }
+
+arena_size = size;
+
+barracuda_printk(0, "Shared arena with %lu bytes\n", (unsigned long)size );
+return 0;
+}
+
+
+
+/**
+ * Frees the shared arena.
+ *
+ * @returns			void
  */
-down( &gen_syndrome_mutex );
-	
-down(&ioctl_init_mutex);
-	
+
+static void arena_free(void)
+{
+if(arena != NULL){ vfree(arena); }
+
+arena = NULL;
+arena_size = 0;
+}
+
+
+
 /**
- *  Populate the PROCFS :
- *  This must be done for the the connection-type PROCFS which creates the file
- *  under /proc/barracuda/stub. The second file, which is created under 
- *  /proc/barracuda/conf is a generic configuration interface.
+ * Offset of a disk of a stripe whose header is at base. The kernel always 
+ * computes it, the offsets in the header are only read by the daemon, which 
+ * can write the arena.
+ *
+ * @param 			base   : arena offset of the header of the stripe
+ * @param 			i      : disk
+ * @param 			bytes  : number of bytes
+ *
+ * @returns			the arena offset of the disk
  */
-	
-proc_directory = proc_mkdir("barracuda", NULL);
-if( !proc_directory ){
-	barracuda_printk(0, "Proc-Directory creation failed\n" );
-	return -EIO;
-	}
-	
-proc_stub = create_proc_entry( "stub", 0, proc_directory);
-if( !proc_stub ){
-	barracuda_printk(0, "Proc-File creation failed (stub)\n" );
-	return -EIO;
-	}
-else{
-	proc_stub->read_proc  = proc_read;
-	proc_stub->write_proc = proc_write;
+
+static unsigned long arena_offset(unsigned long base, int i, size_t bytes)
+{
+return base + PAGE_ALIGN(sizeof(arena_header)) + (unsigned long)i * PAGE_ALIGN(bytes);
+}
+
+
+
+/**
+ * Copies the data disks of a stripe into the arena and fills in the offsets of
+ * all disks. A stripe which doesn't fit is marked ARENA_MAPPED.
+ *
+ * @param 			disks  : number of disks
+ * @param 			bytes  : number of bytes
+ * @param			**ptrs : disks pointers
+ *
+ * @returns			0 if the stripe was packed, -1 if not
+ */
+
+static int arena_pack(int disks, size_t bytes, void **ptrs)
+{
+int i;
+
+if(arena == NULL){ return -1; }
+
+if( (disks > ARENA_MAX_DISKS) || (arena_offset(0, disks, bytes) > arena_size) ){
+	arena->mode = ARENA_MAPPED;
+	return -1;
 	}
 
-proc_conf = create_proc_entry( "conf", 0, proc_directory);
-if( !proc_conf ){
-	barracuda_printk(0, "Proc-File creation failed (conf)\n" );
-	return -EIO;
+for(i=0; i < disks; i++){
+	arena->offsets[i] = arena_offset(0, i, bytes);
+	if(i < disks-2){ memcpy( (char *)arena + arena_offset(0, i, bytes), ptrs[i], bytes ); }
 	}
-else{
-	proc_conf->read_proc  = conf_read;
-	proc_conf->write_proc = conf_write;
+
+arena->disks = disks;
+arena->bytes = bytes;
+arena->mode  = ARENA_INLINE;
+arena->next  = 0;
+
+return 0;
+}
+
+
+
+/**
+ * Copies the checksums of a packed stripe back to the disks. The offsets are
+ * the ones arena_pack() chose, not the ones in the header.
+ *
+ * @param 			disks  : number of disks
+ * @param 			bytes  : number of bytes
+ * @param			**ptrs : disks pointers
+ *
+ * @returns			void
+ */
+
+static void arena_unpack(int disks, size_t bytes, void **ptrs)
+{
+memcpy( ptrs[disks-2], (char *)arena + arena_offset(0, disks-2, bytes), bytes );
+memcpy( ptrs[disks-1], (char *)arena + arena_offset(0, disks-1, bytes), bytes );
+}
+
+
+
+/*_SCATTER_GATHER_____________________________________________________________*/
+/**
+ * Allocates the segment table and the page list of the window on sg=1. The
+ * table is vmalloc'ed and mapped with remap_vmalloc_range() like the arena,
+ * and like the arena it is allocated once.
+ *
+ * @returns			0 on success, -EBUSY if there is a table, -ENOMEM on error
+ */
+
+static int sg_alloc(void)
+{
+if(sg != NULL){ return -EBUSY; }
+
+/* the table is zeroed and allowed to be mapped to userspace */
+sg		 = (sg_table *)vmalloc_user( PAGE_ALIGN(sizeof(sg_table)) );
+sg_pages = (struct page **)vmalloc( SG_MAX_SEGMENTS * sizeof(struct page *) );
+if( (sg == NULL) || (sg_pages == NULL) ){
+	sg_release();
+	return -ENOMEM;
 	}
-	
-barracuda_printk(0, "Procfs successfull populated\n" );
+
+barracuda_printk(0, "Scatter-gather stripes with up to %d pages\n", SG_MAX_SEGMENTS );
+return 0;
+}
+
+
 
 /**
- * Now we initialise a character-device. This is needed for two reasons. First
- * we need a device were we can bind the ioctl callback function for the related
- * systemcall. Second is needed for the mmap system call, which is further used
- * for marshalling the data from the kernel- to the user-space.
+ * Frees the segment table and the page list.
+ *
+ * @returns			void
  */
+
+static void sg_release(void)
+{
+if(sg != NULL){ vfree(sg); }
+if(sg_pages != NULL){ vfree(sg_pages); }
+
+sg		  = NULL;
+sg_pages  = NULL;
+sg_npages = 0;
+}
+
+
+
+/**
+ * Describes a stripe in the segment table. Every page of every disk gets the 
+ * next page of the window, nothing is copied or gathered; a disk which spans
+ * several pages gets a segment for every run of pages. A stripe with more 
+ * pages than the window holds or with a disk which is not SG_ALIGN aligned 
+ * is marked with disks = 0, the daemon maps it disk by disk then.
+ *
+ * @param 			disks  : number of disks
+ * @param 			bytes  : number of bytes
+ * @param			**ptrs : disks pointers
+ *
+ * @returns			void
+ */
+
+static void sg_describe(int disks, size_t bytes, void **ptrs)
+{
+int i;
+char *p;
+size_t done;
+unsigned long len;
+unsigned long offset;
+unsigned int n = 0;
+unsigned int segments = 0;
+sg_segment *last;
+
+if(sg == NULL){ return; }
+
+sg->disks = 0;
+sg_npages = 0;
+
+if( (disks > ARENA_MAX_DISKS) || (bytes % SG_ALIGN) ){ return; }
+
+for(i=0; i < disks; i++){
+	sg->first[i] = segments;
 	
-if ( alloc_chrdev_region(&mmap_dev, 0, 1, "barracuda") < 0 ){
-	barracuda_printk(0, "Could not allocate major number\n");
-	return -EIO;
+	if( (unsigned long)ptrs[i] % SG_ALIGN ){ return; }
+	
+	for(done = 0; done < bytes; done += len){
+		p	= (char *)ptrs[i] + done;
+		len = min( (unsigned long)(bytes - done), PAGE_SIZE - offset_in_page(p) );
+		
+		if(n == SG_MAX_SEGMENTS){ return; }
+		
+		sg_pages[n] = is_vmalloc_addr(p) ? vmalloc_to_page(p) : virt_to_page(p);
+		offset		= (unsigned long)n * PAGE_SIZE + offset_in_page(p);
+		n++;
+		
+		/* the pages of a disk are put one after the other into the window */
+		if(segments > sg->first[i]){
+			last = &sg->segs[segments-1];
+			if(last->offset + last->len == offset){
+				last->len += len;
+				continue;
+				}
+			}
+		
+		sg->segs[segments].offset = offset;
+		sg->segs[segments].len	  = len;
+		segments++;
+		}
 	}
 
-cdev_init(&mmap_cdev, &fops);
-if ( cdev_add(&mmap_cdev, mmap_dev, 1) < 0 ){
-    barracuda_printk(0, "Could not allocate chrdev\n");
-	unregister_chrdev_region(mmap_dev, 1);
-	return -EIO;
-	}
+sg->first[disks]	= segments;
+sg->segments		= segments;
+sg->bytes			= bytes;
+sg->window_bytes	= (unsigned long)n * PAGE_SIZE;
+sg->disks			= disks;
+sg_npages			= n;
+}
+
 
-barracuda_printk(0, "/dev/barracuda character devices created\n" );
 
 /**
- * At least we initialise a Netlink server.
+ * Maps the pages of the actual stripe one after the other into the window, 
+ * in the order the segment table expects them.
+ *
+ * @param 			*vma  : Virtual Area Management struct of the calling 
+ *							userspace process
+ *
+ * @returns			0 on success, a negative errno on error
  */
+
+static int sg_map_window(struct vm_area_struct *vma)
+{
+unsigned int i;
+int ret;
+unsigned long start = vma->vm_start;
+
+if( (sg == NULL) || (sg->disks == 0) ){ return -EIO; }
+if(vma->vm_end - vma->vm_start > (unsigned long)sg_npages * PAGE_SIZE){ return -EINVAL; }
+
+for(i=0; start < vma->vm_end; i++){
+	ret = remap_pfn_range(vma, start, page_to_pfn(sg_pages[i]), PAGE_SIZE, PAGE_SHARED);
+	if (ret < 0){ return ret; }
 	
-nl_sk = netlink_kernel_create(	&init_net, NETLINK_RS_SERVER, 
-								0, nl_data_ready, &nl_mutex, 
-							  	THIS_MODULE );
-if( !nl_sk ){
-	barracuda_printk(0, "Netlink socket creation failed\n");
-	return -EIO;
+	start += PAGE_SIZE;
 	}
-	
-actual_snc = (syndrome_container * )vmalloc(sizeof(syndrome_container));
-	
-barracuda_printk(0, "Netlink socket successfull created\n" );
-	
+
 return 0;
 }
 
 
 
+/*_REQUEST_DESCRIPTORS________________________________________________________*/
+
 /**
- * This is the barracuda power-off function, which _MUST_ be called on unloading
- * the module. It deletes all entries which were created at barracuda_start
+ * Fills the descriptor of the actual request. Disk i is mapped at page i+1 of
+ * the device, like the per-request mmap path of the daemon expects it. The
+ * caller must hold gen_syndrome_mutex.
  *
- * @returns		int 	O on success
+ * @param 			opcode : one of the OP_* codes
+ * @param 			prio   : priority class
+ * @param 			disks  : number of disks
+ * @param 			bytes  : number of bytes
+ *
+ * @returns			void
  */
 
-int barracuda_stop( void )
+static void desc_fill(unsigned int opcode, int prio, int disks, size_t bytes)
 {
-barracuda_printk(0, "<mod_exit> called\n" );
+int i;
 
-/* Remove all PROCFS entries */
-remove_proc_entry("stub", proc_directory);
-remove_proc_entry("conf", proc_directory);
-remove_proc_entry("barracuda", NULL);
+if(desc == NULL){ return; }
+
+desc->opcode  = opcode;
+desc->prio	  = prio;
+desc->id      = ++desc_id;
+desc->disks   = disks;
+desc->bytes   = bytes;
+desc->start   = 0;
+desc->stop    = disks-3;
+desc->nfailed = 0;
+desc->flags   = 0;
+desc->result  = 0;
+desc->array   = 0;
+
+for(i=0; (i < disks) && (i < ARENA_MAX_DISKS); i++){
+	desc->offsets[i] = (i+1) * PAGE_SIZE;
+	}
+}
 
-barracuda_printk(0, "Removed proc entries\n" );
-	
-/* Remove all /dev entries */
-cdev_del(&mmap_cdev);
-unregister_chrdev_region(mmap_dev, 1);
-barracuda_printk(0, "/dev/barracuda unregistered\n");
-	
-/* Unload the netlink server */
-if(nl_sk){ sock_release(nl_sk->sk_socket); }
-barracuda_printk(0, "Netlink socket terminated\n" ) ;
+
+
+/**
+ * Hands one piece of an operation to the daemon, see <barracuda_op()>.
+ *
+ * @param 			array   : array of the operation
+ * @param 			opcode  : one of the OP_* codes
+ * @param 			prio    : priority class
+ * @param 			disks   : number of disks
+ * @param 			bytes   : number of bytes
+ * @param 			start   : first data disk of OP_XOR_UPDATE
+ * @param 			stop    : last data disk of OP_XOR_UPDATE
+ * @param 			nfailed : number of failed disks
+ * @param 			*failed : the failed disks
+ * @param 			flags   : DESC_FLAG_*
+ * @param			**ptrs  : disks pointers
+ *
+ * @returns			the result of the daemon or the error of the connection if the
+ *					daemon was not reached
+ */
+
+static int barracuda_op_piece(unsigned int array, unsigned int opcode, int prio, int disks, size_t bytes, 
+							  int start, int stop, int nfailed, int *failed, unsigned int flags, void **ptrs)
+{
+syndrome_container snc;
+int ret;
+int i;
+
+sched_enter(prio);
+down( &gen_syndrome_mutex );
+
+snc = pack_smc(disks, bytes, ptrs);
+desc_fill(opcode, prio, disks, bytes);
+
+desc->start   = start;
+desc->stop    = stop;
+desc->nfailed = nfailed;
+desc->flags   = flags;
+desc->array   = array;
+for(i=0; i < nfailed; i++){ desc->failed[i] = failed[i]; }
+
+if(arena != NULL){
+	arena->mode = ARENA_MAPPED;
+	arena->next = 0;
+	}
+if(sg != NULL){ sg->disks = 0; }
+
+/* the result is only valid after a round trip through the daemon */
+ret = call_usp(snc);
+if(ret == 0){ ret = desc->result; }
+
+kill_smc(&snc);
+
+up( &gen_syndrome_mutex );
+sched_leave(prio);
+
+return ret;
+}
+
+
+
+/**
+ * Hands one operation to the daemon. The disks are always mapped one by one,
+ * neither the arena nor the segment table is used, and the ring doesn't 
+ * carry descriptors at all. Large operations are sliced like gen_syndrome, 
+ * the CHECK_* bits of the slices are merged.
+ *
+ * @param 			array   : array of the operation, 0 for the md hooks
+ * @param 			opcode  : one of the OP_* codes
+ * @param 			prio    : priority class
+ * @param 			disks   : number of disks
+ * @param 			bytes   : number of bytes
+ * @param 			start   : first data disk of OP_XOR_UPDATE
+ * @param 			stop    : last data disk of OP_XOR_UPDATE
+ * @param 			nfailed : number of failed disks
+ * @param 			*failed : the failed disks
+ * @param 			flags   : DESC_FLAG_*
+ * @param			**ptrs  : disks pointers
+ *
+ * @returns			the result of the daemon or -EOPNOTSUPP if it doesn't 
+ *					speak descriptors or arrays
+ */
+
+static int barracuda_op(unsigned int array, unsigned int opcode, int prio, int disks, size_t bytes, int start, 
+						int stop, int nfailed, int *failed, unsigned int flags, void **ptrs)
+{
+void **slice;
+size_t offset;
+size_t length;
+int result = 0;
+int ret;
+int i;
+
+if( (desc == NULL) || (proto_version < 1) || ring_mode || (configured == 0) ){ return -EOPNOTSUPP; }
+if( (array != 0) && (proto_version < 3) ){ return -EOPNOTSUPP; }
+if( (nfailed < 0) || (nfailed > DESC_MAX_FAILED) || (disks > ARENA_MAX_DISKS) ){ return -EINVAL; }
+
+slice = slice_begin(disks, bytes);
+if(slice == NULL){
+	return barracuda_op_piece(array, opcode, prio, disks, bytes, start, stop, nfailed, failed, flags, ptrs);
+	}
+
+for(offset=0; offset < bytes; offset += length){
+	length = min(bytes - offset, slice_bytes);
+	for(i=0; i < disks; i++){ slice[i] = (u8 *)ptrs[i] + offset; }
+	
+	ret = barracuda_op_piece(array, opcode, prio, disks, length, start, stop, nfailed, failed, flags, slice);
+	if(ret < 0){
+		result = ret;
+		break;
+		}
+	result |= ret;
+	}
+
+vfree(slice);
+
+return result;
+}
+
+
+
+/**
+ * Read-modify-write update of P and Q, like xor_syndrome of the raid6 library.
+ *
+ * @param 			disks  : number of disks
+ * @param 			start  : first changed data disk
+ * @param 			stop   : last changed data disk
+ * @param 			bytes  : number of bytes
+ * @param			**ptrs : disks pointers
+ *
+ * @returns			0 on success, a negative errno on error
+ */
+
+int raid6_cuda_xor_syndrome(int disks, int start, int stop, size_t bytes, void **ptrs)
+{
+return barracuda_op(0, OP_XOR_UPDATE, PRIO_FOREGROUND, disks, bytes, start, stop, 0, NULL, 0, ptrs);
+}
+
+
+
+/**
+ * Rebuilds two failed data disks. The caller falls back to raid6_2data_recov()
+ * on an error.
+ *
+ * @param 			disks  : number of disks
+ * @param 			bytes  : number of bytes
+ * @param 			faila  : first failed data disk
+ * @param 			failb  : second failed data disk
+ * @param			**ptrs : disks pointers
+ *
+ * @returns			0 on success, a negative errno on error
+ */
+
+int raid6_cuda_2data_recov(int disks, size_t bytes, int faila, int failb, void **ptrs)
+{
+int failed[2];
+
+failed[0] = faila;
+failed[1] = failb;
+
+return barracuda_op(0, OP_RECOV_2DATA, PRIO_RECOVERY, disks, bytes, 0, disks-3, 2, failed, 0, ptrs);
+}
+
+
+
+/**
+ * Rebuilds a failed data disk and P. The caller falls back to 
+ * raid6_datap_recov() on an error.
+ *
+ * @param 			disks  : number of disks
+ * @param 			bytes  : number of bytes
+ * @param 			faila  : failed data disk
+ * @param			**ptrs : disks pointers
+ *
+ * @returns			0 on success, a negative errno on error
+ */
+
+int raid6_cuda_datap_recov(int disks, size_t bytes, int faila, void **ptrs)
+{
+return barracuda_op(0, OP_RECOV_DATAP, PRIO_RECOVERY, disks, bytes, 0, disks-3, 1, &faila, 0, ptrs);
+}
+
+
+
+/**
+ * Checks P and Q of a stripe and rewrites the wrong ones on repair. A check
+ * is scrubbing, it runs in the background class.
+ *
+ * @param 			disks  : number of disks
+ * @param 			bytes  : number of bytes
+ * @param 			repair : rewrite wrong checksums if not 0
+ * @param			**ptrs : disks pointers
+ *
+ * @returns			mask of DESC_CHECK_P and DESC_CHECK_Q, a negative errno on error
+ */
+
+int raid6_cuda_check(int disks, size_t bytes, int repair, void **ptrs)
+{
+return barracuda_op(0, OP_CHECK, PRIO_BACKGROUND, disks, bytes, 0, disks-3, 0, NULL, repair ? DESC_FLAG_REPAIR : 0, ptrs);
+}
+
+
+
+/**
+ * Computes the check symbols of the multi failure Reed-Solomon code.
+ *
+ * @param 			disks  : number of disks, the last DESC_MAX_FAILED are checks
+ * @param 			bytes  : number of bytes
+ * @param			**ptrs : disks pointers
+ *
+ * @returns			0 on success, a negative errno on error
+ */
+
+int raid6_cuda_multi_encode(int disks, size_t bytes, void **ptrs)
+{
+return barracuda_op(0, OP_MULTI_ENCODE, PRIO_FOREGROUND, disks, bytes, 0, disks-DESC_MAX_FAILED-1, 0, NULL, 0, ptrs);
+}
+
+
+
+/**
+ * Rebuilds up to DESC_MAX_FAILED failed disks of the multi failure 
+ * Reed-Solomon code.
+ *
+ * @param 			disks   : number of disks
+ * @param 			bytes   : number of bytes
+ * @param 			nfailed : number of failed disks
+ * @param 			*failed : the failed disks
+ * @param			**ptrs  : disks pointers
+ *
+ * @returns			0 on success, -EIO if the failures can't be solved
+ */
+
+int raid6_cuda_multi_decode(int disks, size_t bytes, int nfailed, int *failed, void **ptrs)
+{
+return barracuda_op(0, OP_MULTI_DECODE, PRIO_RECOVERY, disks, bytes, 0, disks-DESC_MAX_FAILED-1, nfailed, failed, 0, ptrs);
+}
+
+
+
+/**
+ * Hands an operation of one of the arrays of the daemon over, it computes it
+ * with the code, the geometry and the backend it registered for the array 
+ * (see --array of the daemon). OP_GEN of a MULTI array encodes its check 
+ * symbols.
+ *
+ * @param 			array   : id of the array
+ * @param 			opcode  : one of the OP_* codes
+ * @param 			prio    : PRIO_FOREGROUND, PRIO_RECOVERY or PRIO_BACKGROUND
+ * @param 			disks   : number of disks
+ * @param 			bytes   : number of bytes
+ * @param 			start   : first data disk of OP_XOR_UPDATE
+ * @param 			stop    : last data disk of OP_XOR_UPDATE
+ * @param 			nfailed : number of failed disks
+ * @param 			*failed : the failed disks
+ * @param 			flags   : DESC_FLAG_*
+ * @param			**ptrs  : disks pointers
+ *
+ * @returns			the result of the daemon, -ENODEV if it doesn't serve the
+ *					array, -EINVAL if the array has another code or geometry
+ */
+
+int raid6_cuda_array_op(unsigned int array, unsigned int opcode, int prio, int disks, size_t bytes, int start, 
+						int stop, int nfailed, int *failed, unsigned int flags, void **ptrs)
+{
+if( (prio < 0) || (prio >= PRIO_CLASSES) || (opcode >= OP_MAX) ){ return -EINVAL; }
+
+return barracuda_op(array, opcode, prio, disks, bytes, start, stop, nfailed, failed, flags, ptrs);
+}
+
+
+
+/*_ADMISSION_SCHEDULER________________________________________________________*/
+
+/**
+ * Sets the priority classes from sched=<credits>/<weight>/<target us>:..., 
+ * the foreground class first. Nothing changes on a malformed value.
+ *
+ * @param 			*value : the classes, gets modified
+ *
+ * @returns			0 on success, -EINVAL on error
+ */
+
+static int sched_conf(char *value)
+{
+unsigned long conf[PRIO_CLASSES][3];
+char *class;
+char *field;
+int i;
+int j;
+
+for(i=0; i < PRIO_CLASSES; i++){
+	class = strsep( &value, ":");
+	if(class == NULL){ return -EINVAL; }
+	
+	for(j=0; j < 3; j++){
+		field = strsep( &class, "/");
+		if( (field == NULL) || ((conf[i][j] = simple_strtoul(field, NULL, 10)) == 0) ){ return -EINVAL; }
+		}
+	}
+
+spin_lock( &sched_lock );
+for(i=0; i < PRIO_CLASSES; i++){
+	sched_classes[i].credits   = conf[i][0];
+	sched_classes[i].weight	   = conf[i][1];
+	sched_classes[i].target_us = conf[i][2];
+	barracuda_printk(1, "Class %d : %lu credits, weight %lu, target %lu us\n", i, conf[i][0], conf[i][1], conf[i][2]);
+	}
+spin_unlock( &sched_lock );
+
+return 0;
+}
+
+
+
+/**
+ * Number of stripes the connection holds at once: all slots of all rings, a
+ * batch or the single slot.
+ *
+ * @returns			number of stripes
+ */
+
+static unsigned int sched_slot_count(void)
+{
+unsigned int slots = 0;
+int s;
+
+if(ring_mode){
+	for(s=0; s < ring_shards; s++){ slots += ring_shard_table[s].entries; }
+	return slots;
+	}
+
+if( (batch_max > 1) && (arena != NULL) ){ return batch_max; }
+
+return 1;
+}
+
+
+
+/**
+ * Chooses the class of the next admission. A class takes part if it has a 
+ * waiting stripe and a credit left. The class whose oldest stripe is most 
+ * overdue relative to its target wins, without an overdue class the one with
+ * the smallest virtual time. sched_lock must be held.
+ *
+ * @param 			now : time in us
+ *
+ * @returns			the class or -1
+ */
+
+static int sched_pick(s64 now)
+{
+sched_class *c;
+sched_waiter *w;
+unsigned long waited;
+unsigned long ratio;
+unsigned long late_ratio = 0;
+int late = -1;
+int best = -1;
+int i;
+
+for(i=0; i < PRIO_CLASSES; i++){
+	c = &sched_classes[i];
+	if( list_empty(&c->waiting) || (c->admitted >= c->credits) ){ continue; }
+	
+	w = list_first_entry(&c->waiting, sched_waiter, list);
+	waited = (unsigned long)(now - w->enqueued);
+	if(waited > c->target_us){
+		ratio = (waited << 8) / c->target_us;
+		if( (late < 0) || (ratio > late_ratio) ){
+			late		= i;
+			late_ratio	= ratio;
+			}
+		}
+	
+	if( (best < 0) || (c->vtime < sched_classes[best].vtime) ){ best = i; }
+	}
+
+return (late >= 0) ? late : best;
+}
+
+
+
+/**
+ * Admits waiting stripes as long as the connection has room for them. 
+ * sched_lock must be held.
+ *
+ * @returns			void
+ */
+
+static void sched_dispatch(void)
+{
+s64 now = ktime_to_us(ktime_get());
+sched_class *c;
+sched_waiter *w;
+unsigned long waited;
+int woken = 0;
+int i;
+
+while(sched_inflight < sched_slots){
+	i = sched_pick(now);
+	if(i < 0){ break; }
+	
+	c = &sched_classes[i];
+	w = list_first_entry(&c->waiting, sched_waiter, list);
+	list_del(&w->list);
+	
+	waited = (unsigned long)(now - w->enqueued);
+	c->served++;
+	c->wait_us += waited;
+	if(waited > c->max_wait_us){ c->max_wait_us = waited; }
+	if(waited > c->target_us){ c->overdue++; }
+	
+	c->admitted++;
+	sched_inflight++;
+	sched_vtime = c->vtime;
+	c->vtime   += SCHED_VTIME_UNIT / c->weight;
+	
+	w->granted = 1;
+	woken = 1;
+	}
+
+if(woken){ wake_up_all( &sched_wq ); }
+}
+
+
+
+/**
+ * Waits until the scheduler admits a stripe of a class. A class which was 
+ * idle starts at the virtual time of the last admission, it can't claim the
+ * service it missed meanwhile.
+ *
+ * @param 			prio : priority class
+ *
+ * @returns			void
+ */
+
+static void sched_enter(int prio)
+{
+sched_class *c = &sched_classes[prio];
+sched_waiter w;
+
+w.enqueued = ktime_to_us(ktime_get());
+w.granted  = 0;
+
+spin_lock( &sched_lock );
+if( list_empty(&c->waiting) && (c->admitted == 0) && (c->vtime < sched_vtime) ){ c->vtime = sched_vtime; }
+list_add_tail( &w.list, &c->waiting );
+sched_dispatch();
+spin_unlock( &sched_lock );
+
+wait_event( sched_wq, w.granted );
+}
+
+
+
+/**
+ * Gives the credit of a completed stripe back.
+ *
+ * @param 			prio : priority class
+ *
+ * @returns			void
+ */
+
+static void sched_leave(int prio)
+{
+spin_lock( &sched_lock );
+sched_classes[prio].admitted--;
+sched_inflight--;
+sched_dispatch();
+spin_unlock( &sched_lock );
+}
+
+
+
+/**
+ * Writes the counters of the classes to the kernel log.
+ *
+ * @returns			void
+ */
+
+static void sched_report(void)
+{
+sched_class *c;
+unsigned long long mean;
+int i;
+
+for(i=0; i < PRIO_CLASSES; i++){
+	c = &sched_classes[i];
+	mean = c->wait_us;
+	if(c->served > 0){ do_div(mean, c->served); }
+	barracuda_printk(0, "Class %d : %lu stripes, mean wait %llu us, max wait %lu us, %lu over target\n", i, 
+					c->served, mean, c->max_wait_us, c->overdue);
+	}
+}
+
+
+
+/*_TIME_SLICING_______________________________________________________________*/
+
+/**
+ * Starts a sliced request. The daemon serves one request at a time, so a 
+ * large one would hold back every small one behind it. Its slices of 
+ * slice_bytes are admitted one by one instead and the scheduler puts the 
+ * stripes of the other classes in between by their latency targets. The 
+ * ring chunks the stripes by its slots and holds many of them at once, it 
+ * is never sliced.
+ *
+ * @param 			disks : number of disks
+ * @param 			bytes : number of bytes
+ *
+ * @returns			the pointer table of the slices, which the caller frees, 
+ *					or NULL if the request is served as a whole
+ */
+
+static void **slice_begin(int disks, size_t bytes)
+{
+void **slice;
+
+if( (slice_bytes == 0) || (bytes <= slice_bytes) || ring_mode ){ return NULL; }
+
+slice = (void **)vmalloc(disks * sizeof(void *));
+if(slice == NULL){ return NULL; }
+
+spin_lock( &sched_lock );
+slice_requests++;
+slice_total += DIV_ROUND_UP(bytes, slice_bytes);
+spin_unlock( &sched_lock );
+
+return slice;
+}
+
+
+
+/*_BATCHED_PICKUP_____________________________________________________________*/
+
+/* A stripe of a caller which waits for the daemon */
+typedef struct batch_stripe{
+	int disks;
+	size_t bytes;
+	int prio;
+	void **ptrs;
+	int finished;
+	struct list_head list;
+	}batch_stripe;
+
+static LIST_HEAD( batch_pending );
+static DEFINE_SPINLOCK( batch_lock );
+
+/**
+ * Size of a stripe with its header in the shared arena.
+ *
+ * @param			*s : stripe
+ *
+ * @returns			bytes
+ */
+
+static unsigned long batch_stripe_size(batch_stripe *s)
+{
+return PAGE_ALIGN(sizeof(arena_header)) + s->disks * PAGE_ALIGN(s->bytes);
+}
+
+
+
+/**
+ * Tells whether a stripe can be put into the arena at all.
+ *
+ * @param			*s : stripe
+ *
+ * @returns			1 if it fits into the empty arena
+ */
+
+static int batch_fits(batch_stripe *s)
+{
+return (s->disks <= ARENA_MAX_DISKS) && (batch_stripe_size(s) <= arena_size);
+}
+
+
+
+/**
+ * Copies the data disks of a stripe into the arena, behind its own header.
+ *
+ * @param 			offset : arena offset of the header
+ * @param			*s     : stripe
+ *
+ * @returns			void
+ */
+
+static void batch_pack(unsigned long offset, batch_stripe *s)
+{
+int i;
+arena_header *hdr = (arena_header *)((char *)arena + offset);
+
+for(i=0; i < s->disks; i++){
+	hdr->offsets[i] = arena_offset(offset, i, s->bytes);
+	if(i < s->disks-2){ memcpy( (char *)arena + arena_offset(offset, i, s->bytes), s->ptrs[i], s->bytes ); }
+	}
+
+hdr->disks = s->disks;
+hdr->bytes = s->bytes;
+hdr->mode  = ARENA_INLINE;
+hdr->next  = 0;
+}
+
+
+
+/**
+ * Hands the oldest waiting stripes to the daemon with one handshake. They are
+ * taken in order as long as they fit into the arena, a stripe which doesn't
+ * fit at all goes alone on the per-request mmap path. The caller must hold
+ * gen_syndrome_mutex.
+ *
+ * @returns			void
+ */
+
+static void batch_run(void)
+{
+LIST_HEAD( taken );
+batch_stripe *s, *tmp;
+arena_header *hdr = NULL;
+syndrome_container snc;
+unsigned long offset = 0;
+int n = 0;
+
+spin_lock( &batch_lock );
+list_for_each_entry_safe(s, tmp, &batch_pending, list){
+	if( (n > 0) && ( !batch_fits(s) || (offset + batch_stripe_size(s) > arena_size) ) ){ break; }
+	
+	offset += batch_stripe_size(s);
+	list_move_tail(&s->list, &taken);
+	
+	if( (++n == batch_max) || !batch_fits(s) ){ break; }
+	}
+spin_unlock( &batch_lock );
+
+if(n == 0){ return; }
+
+/* the first stripe is the one the mmap path of the daemon sees */
+s = list_first_entry(&taken, batch_stripe, list);
+snc = pack_smc(s->disks, s->bytes, s->ptrs);
+desc_fill(OP_GEN, s->prio, s->disks, s->bytes);
+
+if( !batch_fits(s) ){
+	arena->mode = ARENA_MAPPED;
+	arena->next = 0;
+	sg_describe(s->disks, s->bytes, s->ptrs);
+	call_usp(snc);
+	}
+else{
+	offset = 0;
+	list_for_each_entry(s, &taken, list){
+		if(hdr != NULL){ hdr->next = offset; }
+		batch_pack(offset, s);
+		hdr = (arena_header *)((char *)arena + offset);
+		offset += batch_stripe_size(s);
+		}
+	
+	call_usp(snc);
+	
+	/* fetch the checksums of all stripes from where batch_pack() put them */
+	offset = 0;
+	list_for_each_entry(s, &taken, list){
+		memcpy( s->ptrs[s->disks-2], (char *)arena + arena_offset(offset, s->disks-2, s->bytes), s->bytes );
+		memcpy( s->ptrs[s->disks-1], (char *)arena + arena_offset(offset, s->disks-1, s->bytes), s->bytes );
+		offset += batch_stripe_size(s);
+		}
+	}
+
+kill_smc(&snc);
+
+/* the stripes live on the stacks of their callers, don't touch them after this */
+list_for_each_entry_safe(s, tmp, &taken, list){ s->finished = 1; }
+}
+
+
+
+/**
+ * gen_syndrome with batched pickup. Every caller queues its stripe; the one 
+ * which gets gen_syndrome_mutex serves all queued stripes, the callers behind
+ * it mostly find theirs already finished when they get the mutex.
+ *
+ * @param 			disks  : number of disks
+ * @param 			bytes  : number of bytes
+ * @param 			prio   : priority class, the descriptor of a batch carries
+ *							 the one of its first stripe
+ * @param			**ptrs : disks pointers
+ *
+ * @returns			void
+ */
+
+static void batch_gen_syndrome(int disks, size_t bytes, int prio, void **ptrs)
+{
+batch_stripe self;
+
+self.disks	  = disks;
+self.bytes	  = bytes;
+self.prio	  = prio;
+self.ptrs	  = ptrs;
+self.finished = 0;
+
+spin_lock( &batch_lock );
+list_add_tail( &self.list, &batch_pending );
+spin_unlock( &batch_lock );
+
+down( &gen_syndrome_mutex );
+while( !self.finished ){ batch_run(); }
+up( &gen_syndrome_mutex );
+}
+
+
+
+/*_SUBMISSION_COMPLETION_RING________________________________________________*/
+
+/**
+ * Allocates the rings, every header is followed by the page aligned data slots.
+ * They are allocated once and mapped with remap_vmalloc_range() like the arena.
+ *
+ * @param 			entries		: number of slots, a power of two
+ * @param 			slot_bytes	: size of one slot, at least RING_MIN_SLOT
+ * @param 			shards		: number of rings
+ *
+ * @returns			0 on success, -EINVAL, -EBUSY or -ENOMEM on error
+ */
+
+static int ring_alloc(unsigned int entries, unsigned long slot_bytes, int shards)
+{
+unsigned int i;
+int s;
+ring_shard *rs;
+unsigned long data_offset = PAGE_ALIGN(sizeof(ring_header));
+
+if( (entries == 0) || (entries > RING_MAX_ENTRIES) || (entries & (entries-1)) ){ return -EINVAL; }
+if( (shards <= 0) || (shards > RING_MAX_SHARDS) ){ return -EINVAL; }
+
+/* every stripe md can hand over must fit, at least in slices */
+slot_bytes = PAGE_ALIGN(slot_bytes);
+if(slot_bytes < RING_MIN_SLOT){ return -EINVAL; }
+
+if(ring_shards > 0){ return -EBUSY; }
+
+for(s=0; s < shards; s++){
+	rs = &ring_shard_table[s];
+	
+	rs->size		= data_offset + entries*slot_bytes;
+	rs->ring		= (ring_header *)vmalloc_user(rs->size);
+	rs->free_slots	= (unsigned int *)vmalloc(entries * sizeof(unsigned int));
+	rs->done		= (struct completion *)vmalloc(entries * sizeof(struct completion));
+	ring_shards		= s+1;
+	
+	if( (rs->ring == NULL) || (rs->free_slots == NULL) || (rs->done == NULL) ){
+		ring_release();
+		return -ENOMEM;
+		}
+	
+	rs->entries		= entries;
+	rs->slot_bytes	= slot_bytes;
+	rs->data_offset	= data_offset;
+	
+	memset(rs->ring, 0, sizeof(ring_header));
+	rs->ring->entries		= entries;
+	rs->ring->slot_bytes	= slot_bytes;
+	rs->ring->data_offset	= data_offset;
+	
+	for(i=0; i < entries; i++){
+		rs->free_slots[i] = i;
+		init_completion( &rs->done[i] );
+		}
+	rs->free_top = entries;
+	sema_init( &rs->slots, entries );
+	spin_lock_init( &rs->slot_lock );
+	spin_lock_init( &rs->sq_lock );
+	mutex_init( &rs->cq_mutex );
+	init_waitqueue_head( &rs->sq_wq );
+	}
+
+barracuda_printk(0, "%d rings with %u slots of %lu bytes\n", shards, entries, slot_bytes );
+return 0;
+}
+
+
+
+/**
+ * Frees all rings.
+ *
+ * @returns			void
+ */
+
+static void ring_release(void)
+{
+int s;
+ring_shard *rs;
+
+for(s=0; s < ring_shards; s++){
+	rs = &ring_shard_table[s];
+	
+	if(rs->ring != NULL){ vfree(rs->ring); }
+	if(rs->free_slots != NULL){ vfree(rs->free_slots); }
+	if(rs->done != NULL){ vfree(rs->done); }
+	
+	rs->ring = NULL;
+	rs->free_slots = NULL;
+	rs->done = NULL;
+	rs->size = 0;
+	rs->entries = 0;
+	}
+
+ring_shards = 0;
+}
+
+
+
+/**
+ * Chooses the ring of a stripe. By CPU the submitter stays on the server
+ * thread next to it, by STRIPE the first data page decides, so a stripe is
+ * always served by the same thread.
+ *
+ * @param			**ptrs : disks pointers
+ *
+ * @returns			the ring
+ */
+
+static ring_shard *ring_pick(void **ptrs)
+{
+unsigned long key;
+
+if(ring_shards == 1){ return &ring_shard_table[0]; }
+
+if(ring_shard_by == RING_SHARD_STRIPE){ key = hash_long((unsigned long)ptrs[0] >> PAGE_SHIFT, 16); }
+else{ key = raw_smp_processor_id(); }
+
+return &ring_shard_table[key % ring_shards];
+}
+
+
+
+/**
+ * Submits one stripe to its ring and waits for its completion. Many callers
+ * can be in flight at the same time, one per slot. A stripe which is larger 
+ * than a slot is processed in slices, the syndromes are bytewise independent.
+ *
+ * @param 			disks  : number of disks
+ * @param 			bytes  : number of bytes
+ * @param			**ptrs : disks pointers
+ *
+ * @returns			0 on success, -EINVAL for more than ARENA_MAX_DISKS disks
+ */
+
+static int ring_gen_syndrome(int disks, size_t bytes, void **ptrs)
+{
+int i;
+unsigned int slot;
+unsigned int tail;
+char *base;
+size_t done;
+ring_shard *rs = ring_pick(ptrs);
+ring_header *ring = rs->ring;
+size_t slice = (rs->slot_bytes / disks) & ~(RING_ALIGN-1);
+
+if(slice == 0){ return -EINVAL; }
+
+/* claim a free slot */
+down( &rs->slots );
+spin_lock( &rs->slot_lock );
+slot = rs->free_slots[--rs->free_top];
+spin_unlock( &rs->slot_lock );
+
+base = (char *)ring + rs->data_offset + slot*rs->slot_bytes;
+
+for(done = 0; done < bytes; done += slice){
+	if(slice > bytes - done){ slice = bytes - done; }
+	
+	/* copy the data disks into the slot */
+	for(i=0; i < disks-2; i++){
+		memcpy( base + i*RING_STRIDE(slice), (char *)ptrs[i] + done, slice );
+		}
+	
+	/* publish the submission entry */
+	spin_lock( &rs->sq_lock );
+	tail = ring->sq_tail;
+	ring->sq[tail & (rs->entries-1)].slot  = slot;
+	ring->sq[tail & (rs->entries-1)].disks = disks;
+	ring->sq[tail & (rs->entries-1)].bytes = slice;
+	smp_wmb();
+	ring->sq_tail = tail + 1;
+	spin_unlock( &rs->sq_lock );
+	
+	wake_up_interruptible( &rs->sq_wq );
+	wait_for_completion( &rs->done[slot] );
+	
+	/* fetch the checksums */
+	memcpy( (char *)ptrs[disks-2] + done, base + (disks-2)*RING_STRIDE(slice), slice );
+	memcpy( (char *)ptrs[disks-1] + done, base + (disks-1)*RING_STRIDE(slice), slice );
+	}
+
+/* give the slot back */
+spin_lock( &rs->slot_lock );
+rs->free_slots[rs->free_top++] = slot;
+spin_unlock( &rs->slot_lock );
+up( &rs->slots );
+
+return 0;
+}
+
+
+
+/**
+ * Doorbell of a server thread of the daemon. All posted completions of its 
+ * ring are reaped and their submitters are woken up. With wait != 0 the call
+ * blocks until there are submissions which the daemon hasn't taken yet.
+ *
+ * @param 			arg	: wait flag, the shard above RING_ENTER_SHARD_SHIFT
+ *
+ * @returns			number of pending submissions, -EIO or -ERESTARTSYS
+ */
+
+static int ring_enter(unsigned long arg)
+{
+unsigned int head;
+unsigned int slot;
+unsigned int reaped = 0;
+ring_cqe *cqe;
+ring_shard *rs;
+ring_header *ring;
+unsigned long shard = arg >> RING_ENTER_SHARD_SHIFT;
+unsigned long wait = arg & ((1UL << RING_ENTER_SHARD_SHIFT) - 1);
+
+if(shard >= ring_shards){ return -EIO; }
+rs	 = &ring_shard_table[shard];
+ring = rs->ring;
+
+mutex_lock( &rs->cq_mutex );
+head = ring->cq_head;
+while( (head != ring->cq_tail) && (reaped++ < rs->entries) ){
+	smp_rmb();
+	cqe  = &ring->cq[head & (rs->entries-1)];
+	slot = ACCESS_ONCE(cqe->slot);
+	if(slot < rs->entries){
+		if(cqe->result != 0){
+			barracuda_printk(0, "Daemon failed on slot %u of ring %lu\n", slot, shard);
+			}
+		complete( &rs->done[slot] );
+		}
+	head++;
+	}
+ring->cq_head = head;
+mutex_unlock( &rs->cq_mutex );
+
+if(wait){
+	if( wait_event_interruptible(rs->sq_wq, ring->sq_head != ring->sq_tail) ){
+		return -ERESTARTSYS;
+		}
+	}
+
+return ring->sq_tail - ring->sq_head;
+}
+
+
+
+/*_DOORBELL___________________________________________________________________*/
+
+static struct eventfd_ctx *doorbell_submit = NULL;
+static struct eventfd_ctx *doorbell_complete = NULL;
+static struct file *doorbell_complete_file = NULL;
+static wait_queue_head_t *doorbell_complete_wqh = NULL;
+static wait_queue_t doorbell_wait;
+static poll_table doorbell_pt;
+static DECLARE_WAIT_QUEUE_HEAD( doorbell_wq );
+
+/**
+ * Called by the complete eventfd whenever the daemon signals it. The submitter
+ * sleeps on our own wait queue and checks complete_seq itself.
+ *
+ * @param 			*wait	: our entry in the wait queue of the eventfd
+ * @param 			mode	: wake up mode
+ * @param 			sync	: synchronous wake up
+ * @param 			*key	: poll events
+ *
+ * @returns			0
+ */
+
+static int doorbell_wakeup(wait_queue_t *wait, unsigned mode, int sync, void *key)
+{
+wake_up( &doorbell_wq );
+return 0;
+}
+
+
+
+/**
+ * Hooks doorbell_wait into the wait queue of the complete eventfd, called by
+ * its poll function.
+ *
+ * @param 			*file	: the eventfd
+ * @param 			*wqh	: its wait queue
+ * @param 			*pt		: doorbell_pt
+ *
+ * @returns			void
+ */
+
+static void doorbell_ptable_queue(struct file *file, wait_queue_head_t *wqh, poll_table *pt)
+{
+doorbell_complete_wqh = wqh;
+add_wait_queue(wqh, &doorbell_wait);
+}
+
+
+
+/**
+ * Takes the eventfds of the daemon and allocates the doorbell page.
+ *
+ * @param 			submit_fd	: eventfd the stub signals on a submission
+ * @param 			complete_fd	: eventfd the daemon signals on a completion
+ *
+ * @returns			0 on success, < 0 on error
+ */
+
+static int doorbell_setup(int submit_fd, int complete_fd)
+{
+doorbell_release();
+
+doorbell = (doorbell_page *)vmalloc(PAGE_SIZE);
+if(doorbell == NULL){ return -ENOMEM; }
+memset(doorbell, 0, PAGE_SIZE);
+
+doorbell_submit = eventfd_ctx_fdget(submit_fd);
+if( IS_ERR(doorbell_submit) ){
+	doorbell_submit = NULL;
+	doorbell_release();
+	return -EBADF;
+	}
+
+doorbell_complete_file = eventfd_fget(complete_fd);
+if( IS_ERR(doorbell_complete_file) ){
+	doorbell_complete_file = NULL;
+	doorbell_release();
+	return -EBADF;
+	}
+doorbell_complete = eventfd_ctx_fileget(doorbell_complete_file);
+
+init_waitqueue_func_entry(&doorbell_wait, doorbell_wakeup);
+init_poll_funcptr(&doorbell_pt, doorbell_ptable_queue);
+doorbell_complete_file->f_op->poll(doorbell_complete_file, &doorbell_pt);
+
+barracuda_printk(0, "Doorbell on eventfds %d and %d\n", submit_fd, complete_fd );
+
+return 0;
+}
+
+
+
+/**
+ * Drops the eventfds and frees the doorbell page.
+ *
+ * @returns			void
+ */
+
+static void doorbell_release(void)
+{
+if(doorbell_complete_wqh != NULL){ remove_wait_queue(doorbell_complete_wqh, &doorbell_wait); }
+if(doorbell_complete != NULL){ eventfd_ctx_put(doorbell_complete); }
+if(doorbell_complete_file != NULL){ fput(doorbell_complete_file); }
+if(doorbell_submit != NULL){ eventfd_ctx_put(doorbell_submit); }
+if(doorbell != NULL){ vfree(doorbell); }
+
+doorbell_complete_wqh	= NULL;
+doorbell_complete		= NULL;
+doorbell_complete_file	= NULL;
+doorbell_submit			= NULL;
+doorbell				= NULL;
+}
+
+
+
+/**
+ * The doorbell connection. The request is published by bumping submit_seq, 
+ * the only message is the eventfd signal; the daemon answers with complete_seq
+ * and its own eventfd.
+ *
+ * @param 		snc	This are the gen_syndrome arguments which should be 
+ *						marshalled to the userspace.
+ *
+ * @returns		0 on success, -ERESTARTSYS if interrupted
+ */
+
+static int call_usp_doorbell(syndrome_container snc)
+{
+unsigned int seq;
+
+memcpy(actual_snc, &snc, sizeof(syndrome_container) );
+
+seq = doorbell->submit_seq + 1;
+smp_wmb();
+doorbell->submit_seq = seq;
+
+/* a spinning daemon sees the sequence word without the syscall */
+smp_mb();
+if(doorbell->daemon_sleeping){ eventfd_signal(doorbell_submit, 1); }
+
+if( wait_event_interruptible(doorbell_wq, doorbell->complete_seq == seq) ){
+	return -ERESTARTSYS;
+	}
+smp_rmb();
+
+return 0;
+}
+
+
+
+/*_INITIALISATION_AND_CLEANUP_________________________________________________*/
+/**
+ * This initialisation _MUST_ be called before the barracuda-connector could do
+ * anything. It does some initialisation steps, such as creating the needed
+ * PROCFS entries an assigning a file in /dev/ to the related functions. The called
+ * functions could be found in this file. local_dev_mmap() is the callback for
+ * mmap syscall, which marshalls the syndrome-data to the userspace. ioctl_callback()
+ * is the function for the IOCTL-based message method. proc_read and proc_write
+ * are used for the PROCFS-based connection method which relays to the file 
+ * /proc/barracuda/stub. A configuration entry at the PROCFS is also given. It can
+ * be found on /proc/barracuda/stub and the related callbacks are conf_read and 
+ * conf_write.
+ *
+ * @returns		int 	O on success
+ */
+
+int barracuda_start( void )
+{
+char sched_default[] = SCHED_DEFAULT;
+int i;
+
+barracuda_printk(0, "<mod_init> called\n" );
+
+/** 
+ * This mutex locks the cuda_gen_syndrome function until the PID and connection
+ * type is configured.
+ */
+down( &gen_syndrome_mutex );
+	
+down(&ioctl_init_mutex);
+	
+/**
+ *  Populate the PROCFS :
+ *  This must be done for the the connection-type PROCFS which creates the file
+ *  under /proc/barracuda/stub. The second file, which is created under 
+ *  /proc/barracuda/conf is a generic configuration interface.
+ */
+	
+proc_directory = proc_mkdir("barracuda", NULL);
+if( !proc_directory ){
+	barracuda_printk(0, "Proc-Directory creation failed\n" );
+	return -EIO;
+	}
+	
+proc_stub = create_proc_entry( "stub", 0, proc_directory);
+if( !proc_stub ){
+	barracuda_printk(0, "Proc-File creation failed (stub)\n" );
+	return -EIO;
+	}
+else{
+	proc_stub->read_proc  = proc_read;
+	proc_stub->write_proc = proc_write;
+	}
+
+proc_conf = create_proc_entry( "conf", 0, proc_directory);
+if( !proc_conf ){
+	barracuda_printk(0, "Proc-File creation failed (conf)\n" );
+	return -EIO;
+	}
+else{
+	proc_conf->read_proc  = conf_read;
+	proc_conf->write_proc = conf_write;
+	}
+	
+barracuda_printk(0, "Procfs successfull populated\n" );
+
+/**
+ * Now we initialise a character-device. This is needed for two reasons. First
+ * we need a device were we can bind the ioctl callback function for the related
+ * systemcall. Second is needed for the mmap system call, which is further used
+ * for marshalling the data from the kernel- to the user-space.
+ */
+	
+if ( alloc_chrdev_region(&mmap_dev, 0, 1, "barracuda") < 0 ){
+	barracuda_printk(0, "Could not allocate major number\n");
+	return -EIO;
+	}
+
+cdev_init(&mmap_cdev, &fops);
+if ( cdev_add(&mmap_cdev, mmap_dev, 1) < 0 ){
+    barracuda_printk(0, "Could not allocate chrdev\n");
+	unregister_chrdev_region(mmap_dev, 1);
+	return -EIO;
+	}
+
+barracuda_printk(0, "/dev/barracuda character devices created\n" );
+
+/**
+ * At least we initialise a Netlink server.
+ */
+	
+nl_sk = netlink_kernel_create(	&init_net, NETLINK_RS_SERVER, 
+								0, nl_data_ready, &nl_mutex, 
+							  	THIS_MODULE );
+if( !nl_sk ){
+	barracuda_printk(0, "Netlink socket creation failed\n");
+	return -EIO;
+	}
+	
+actual_snc = (syndrome_container * )vmalloc(sizeof(syndrome_container));
+
+/* The classes start with the defaults, the daemon may change them */
+for(i=0; i < PRIO_CLASSES; i++){ INIT_LIST_HEAD( &sched_classes[i].waiting ); }
+sched_conf(sched_default);
+
+/* The descriptor stays at version 0 until the daemon negotiates one */
+desc = (request_desc *)vmalloc( PAGE_ALIGN(sizeof(request_desc)) );
+if(desc != NULL){ memset(desc, 0, PAGE_ALIGN(sizeof(request_desc))); }
+	
+barracuda_printk(0, "Netlink socket successfull created\n" );
+	
+return 0;
+}
+
+
+
+/**
+ * This is the barracuda power-off function, which _MUST_ be called on unloading
+ * the module. It deletes all entries which were created at barracuda_start
+ *
+ * @returns		int 	O on success
+ */
+
+int barracuda_stop( void )
+{
+barracuda_printk(0, "<mod_exit> called\n" );
+
+/* Remove all PROCFS entries */
+remove_proc_entry("stub", proc_directory);
+remove_proc_entry("conf", proc_directory);
+remove_proc_entry("barracuda", NULL);
+
+barracuda_printk(0, "Removed proc entries\n" );
+	
+/* Remove all /dev entries */
+cdev_del(&mmap_cdev);
+unregister_chrdev_region(mmap_dev, 1);
+barracuda_printk(0, "/dev/barracuda unregistered\n");
+	
+/* Unload the netlink server */
+if(nl_sk){ sock_release(nl_sk->sk_socket); }
+barracuda_printk(0, "Netlink socket terminated\n" ) ;
+
+ping_wait();
+sched_report();
+if(slice_requests > 0){
+	barracuda_printk(0, "%lu requests served in %lu slices\n", slice_requests, slice_total);
+	}
 
 vfree(actual_snc);
+if(desc != NULL){ vfree(desc); }
+arena_free();
+ring_release();
+doorbell_release();
+sg_release();
 
 return 0;
 }
@@ -35,6 +35,15 @@
  *****************************************************************/
 
 void raid6_cuda_gen_syndrome(int disks, size_t bytes, void **ptrs);
+void raid6_cuda_gen_syndrome_prio(int disks, size_t bytes, void **ptrs, int prio);
+int raid6_cuda_xor_syndrome(int disks, int start, int stop, size_t bytes, void **ptrs);
+int raid6_cuda_2data_recov(int disks, size_t bytes, int faila, int failb, void **ptrs);
+int raid6_cuda_datap_recov(int disks, size_t bytes, int faila, void **ptrs);
+int raid6_cuda_check(int disks, size_t bytes, int repair, void **ptrs);
+int raid6_cuda_multi_encode(int disks, size_t bytes, void **ptrs);
+int raid6_cuda_multi_decode(int disks, size_t bytes, int nfailed, int *failed, void **ptrs);
+int raid6_cuda_array_op(unsigned int array, unsigned int opcode, int prio, int disks, size_t bytes, int start, 
+						int stop, int nfailed, int *failed, unsigned int flags, void **ptrs);
 int barracuda_start( void );
 int barracuda_stop( void );
 
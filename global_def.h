@@ -78,4 +78,271 @@ typedef struct syndrome_container{
 	void **ptrs;
 	}syndrome_container;
 
+/* __Shared Arena__
+ * If the daemon writes arena=<bytes> to /proc/barracuda/conf (before con=), the
+ * kernel stub copies every stripe into one long-lived buffer which the daemon
+ * maps a single time at page offset ARENA_PGOFF. The header at the start of the
+ * arena tells where every disk of the actual request resides. Stripes which do
+ * not fit are marked ARENA_MAPPED and take the per-request mmap path.
+ */
+#define ARENA_PGOFF		0x10000
+#define ARENA_MAX_DISKS	256
+
+/* __Batched Pickup__
+ * With batch=<stripes> (after arena=) the kernel stub collects the stripes of 
+ * all callers which wait for the daemon and hands up to that many over with 
+ * one handshake of the chosen connection type. Every stripe in the arena gets
+ * its own header, followed by its disks; next is the arena offset of the 
+ * header of the following stripe, 0 ends the batch. The first header resides
+ * at the start of the arena as before.
+ */
+#define BATCH_MAX_STRIPES	32
+
+#define ARENA_MAPPED	0
+#define ARENA_INLINE	1
+
+typedef struct arena_header{
+	int mode;
+	int disks;
+	size_t bytes;
+	unsigned long offsets[ARENA_MAX_DISKS];
+	unsigned long next;
+	}arena_header;
+
+/* __Submission/Completion Ring__
+ * With ring=<entries>:<slot bytes> and con=RING the kernel stub and the daemon
+ * share a ring which is mapped at page offset RING_PGOFF. Every stripe owns one
+ * data slot while it is in flight; its disks reside at data_offset + slot *
+ * slot_bytes + disk * RING_STRIDE(bytes). The kernel produces submission 
+ * entries (sq_tail) and consumes completions (cq_head), the daemon does the 
+ * opposite. Completions may be posted in any order, they name their slot.
+ * IOCTL_RING_ENTER reaps the completions and, if its argument is not zero, 
+ * waits until there are new submissions. A slot holds at least a page of every
+ * disk of the widest stripe, ring= refuses slots below RING_MIN_SLOT; a slot 
+ * smaller than a stripe takes it in slices.
+ */
+#define RING_PGOFF			0x20000
+#define RING_MAX_ENTRIES	256
+#define RING_ALIGN			4096UL
+#define RING_STRIDE(bytes)	(((bytes) + RING_ALIGN-1) & ~(RING_ALIGN-1))
+#define RING_MIN_SLOT		(ARENA_MAX_DISKS * RING_ALIGN)
+
+typedef struct ring_sqe{
+	unsigned int slot;
+	int disks;
+	size_t bytes;
+	}ring_sqe;
+
+typedef struct ring_cqe{
+	unsigned int slot;
+	int result;
+	}ring_cqe;
+
+typedef struct ring_header{
+	unsigned int entries;
+	unsigned long slot_bytes;
+	unsigned long data_offset;
+	volatile unsigned int sq_head;
+	volatile unsigned int sq_tail;
+	volatile unsigned int cq_head;
+	volatile unsigned int cq_tail;
+	ring_sqe sq[RING_MAX_ENTRIES];
+	ring_cqe cq[RING_MAX_ENTRIES];
+	}ring_header;
+
+/* __Ring Shards__
+ * ring=<entries>:<slot bytes>:<shards> allocates one ring for every server 
+ * thread of the daemon, shard s is mapped at RING_PGOFF + s. With shard=CPU 
+ * the kernel stub puts a stripe on the ring of the submitting CPU, with 
+ * shard=STRIPE on the ring chosen by a hash of its first data page. The 
+ * argument of IOCTL_RING_ENTER carries the shard above RING_ENTER_SHARD_SHIFT.
+ */
+#define RING_MAX_SHARDS			16
+#define RING_ENTER_SHARD_SHIFT	8
+
+#define RING_SHARD_CPU		0
+#define RING_SHARD_STRIPE	1
+
+/* __Doorbell__
+ * With doorbell=<submit eventfd>:<complete eventfd> and con=DOORBELL no message
+ * carries a request. The kernel stub publishes the stripe as with the other
+ * connection types (shared arena or mmap per disk), increments submit_seq in
+ * the page mapped at DOORBELL_PGOFF and signals the submit eventfd. The daemon
+ * stores that number in complete_seq when the syndromes are done and signals 
+ * the complete eventfd. The words alone tell whether there is work, the 
+ * eventfds are only needed to sleep. A daemon which busy-polls submit_seq 
+ * clears daemon_sleeping and the kernel skips the signal; the daemon sets it 
+ * before its last look at the word and the kernel reads it after the store
+ * of submit_seq, so one of both always sees the other.
+ */
+#define DOORBELL_PGOFF	0x30000
+
+typedef struct doorbell_page{
+	volatile unsigned int submit_seq;
+	volatile unsigned int complete_seq;
+	volatile unsigned int daemon_sleeping;
+	}doorbell_page;
+
+/* __Netlink Descriptors__
+ * With con=NL the daemon registers its netlink port once with a 
+ * NL_MSG_REGISTER message. A request is a NL_MSG_REQUEST message that carries
+ * an nl_request with count descriptors, one for every stripe of the 
+ * handshake; offset is the arena offset of the stripe header or 
+ * NL_DESC_MAPPED for a stripe on the mmap/copy path, which is always alone.
+ * The daemon answers with a NL_MSG_COMPLETE message that echoes the request 
+ * with the status of every stripe, 0 or a negative errno. Only the first 
+ * NL_REQUEST_BYTES(count) bytes are sent.
+ */
+#define NL_MSG_REGISTER		0x12
+#define NL_MSG_REQUEST		0x13
+#define NL_MSG_COMPLETE		0x14
+
+#define NL_DESC_MAX			BATCH_MAX_STRIPES
+#define NL_DESC_MAPPED		(~0UL)
+
+typedef struct nl_descriptor{
+	unsigned long offset;
+	int status;
+	int reserved;
+	}nl_descriptor;
+
+typedef struct nl_request{
+	unsigned int seq;
+	unsigned int count;
+	nl_descriptor desc[NL_DESC_MAX];
+	}nl_request;
+
+#define NL_REQUEST_BYTES(count)	( sizeof(nl_request) - (NL_DESC_MAX - (count)) * sizeof(nl_descriptor) )
+
+/* __Scatter-Gather Stripes__
+ * With sg=1 the kernel stub describes every stripe outside of the arena as a
+ * list of segments per disk instead of letting the daemon map each disk on its
+ * own. The pages of all disks are mapped in one window at SG_WINDOW_PGOFF in 
+ * the order of the bio_vecs, the table at SG_TABLE_PGOFF tells where they 
+ * landed. The segments of disk d are segs[first[d]] up to segs[first[d+1]-1],
+ * they cover its bytes in order and their offsets count from the start of the
+ * window. Pages which follow each other on the disk and in the window are one 
+ * segment. Offsets and lengths are multiples of SG_ALIGN, so no word of the 
+ * kernels straddles two segments. A stripe the table can't describe has 
+ * disks set to 0 and takes the mmap path.
+ */
+#define SG_TABLE_PGOFF		0x40000
+#define SG_WINDOW_PGOFF		0x50000
+#define SG_MAX_SEGMENTS		8192
+#define SG_ALIGN			64UL
+
+typedef struct sg_segment{
+	unsigned long offset;
+	unsigned long len;
+	}sg_segment;
+
+typedef struct sg_table{
+	int disks;
+	size_t bytes;
+	unsigned long window_bytes;
+	unsigned int segments;
+	unsigned int first[ARENA_MAX_DISKS+1];
+	sg_segment segs[SG_MAX_SEGMENTS];
+	}sg_table;
+
+/* __Request Descriptors__
+ * The daemon writes proto=<version> to /proc/barracuda/conf (before con=), the
+ * kernel stub stores the lower of both versions in the descriptor page at 
+ * DESC_PGOFF, which the daemon maps once before con=. Version 0 means that 
+ * there is no descriptor and every request is a full-stripe GEN described by
+ * the marshalling struct. From version 1 on the descriptor of the actual 
+ * request tells what to compute:
+ *
+ * OP_GEN			: P and Q of all data disks
+ * OP_XOR_UPDATE	: XOR the P and Q share of the data disks start..stop into
+ *					  the existing P and Q, once with the old and once with 
+ *					  the new data of a read-modify-write
+ * OP_RECOV_2DATA	: rebuild the data disks failed[0] and failed[1]
+ * OP_RECOV_DATAP	: rebuild the data disk failed[0] and P
+ * OP_CHECK			: compare P and Q, result is a mask of DESC_CHECK_P and
+ *					  DESC_CHECK_Q for the wrong ones; with DESC_FLAG_REPAIR
+ *					  in flags they are rewritten as well, like md's repair
+ * OP_MULTI_ENCODE	: the DESC_MAX_FAILED check symbols of the multi failure
+ *					  Reed-Solomon code, they are the last disks
+ * OP_MULTI_DECODE	: rebuild the nfailed disks in failed[] of that code
+ *
+ * offsets[i] is the device offset at which disk i is mapped or copied, the 
+ * kernel pointers stay in the kernel. id numbers the requests. The daemon 
+ * stores 0, a mask of OP_CHECK or a negative errno in result before it 
+ * acknowledges the request. Stripes in the shared arena, in the ring and in 
+ * the segment table are always OP_GEN. Version 2 appends the priority class
+ * of the request, see below; a version 1 daemon doesn't look at it. Version 3
+ * appends the array the request belongs to, the daemon computes it with the
+ * code, geometry and backend it registered for that array. Array 0 is the 
+ * array of the md hooks and of everything without a descriptor. Version 4 
+ * leaves the descriptor as it is, such a stub answers ping= as well, see 
+ * below.
+ */
+#define BARRACUDA_PROTO_VERSION	4
+#define DESC_PGOFF				0x60000
+
+#define OP_GEN			0
+#define OP_XOR_UPDATE	1
+#define OP_RECOV_2DATA	2
+#define OP_RECOV_DATAP	3
+#define OP_CHECK		4
+#define OP_MULTI_ENCODE	5
+#define OP_MULTI_DECODE	6
+#define OP_MAX			7
+
+#define DESC_MAX_FAILED	4
+
+#define DESC_CHECK_P	0x1
+#define DESC_CHECK_Q	0x2
+
+#define DESC_FLAG_REPAIR	0x1
+
+typedef struct request_desc{
+	unsigned int version;
+	unsigned int opcode;
+	unsigned long id;
+	int disks;
+	size_t bytes;
+	int start;
+	int stop;
+	int nfailed;
+	int failed[DESC_MAX_FAILED];
+	unsigned int flags;
+	int result;
+	unsigned long offsets[ARENA_MAX_DISKS];
+	unsigned int prio;
+	unsigned int array;
+	}request_desc;
+
+/* __Priority Classes__
+ * Every request of the kernel stub belongs to a class. Before a request may 
+ * enter a slot, a batch or the ring it is admitted by the scheduler of the 
+ * stub: a class has a number of credits, the requests of the class which may
+ * be admitted and not yet completed at once, so a burst waits in the stub 
+ * instead of flooding the queues behind it. Of the waiting requests the 
+ * scheduler admits the one of the class that has received the least service
+ * relative to its weight, unless the oldest request of a class waits longer
+ * than the latency target of the class; the most overdue class comes first
+ * then. The daemon sets the classes with 
+ * sched=<credits>/<weight>/<target us>:... (foreground first) before con=.
+ */
+#define PRIO_FOREGROUND	0
+#define PRIO_RECOVERY	1
+#define PRIO_BACKGROUND	2
+#define PRIO_CLASSES	3
+
+#define SCHED_DEFAULT	"32/8/1000:16/4/5000:8/1/50000"
+
+/* __Connection Calibration__
+ * Before con= a daemon of protocol version 4 may write 
+ * ping=<NL|IOCTL|PROCFS|DOORBELL>:<rounds>:<bytes>. The stub hands rounds
+ * OP_GEN stripes of PING_DISKS disks with bytes each (at most PING_MAX_BYTES)
+ * over that connection, one after the other, as if md had issued them. md 
+ * itself is held back until con=. The daemon serves exactly rounds requests
+ * and times them; the last one of -c IOCTL is acknowledged by the ioctl 
+ * argument "done", which doesn't wait for another request.
+ */
+#define PING_DISKS		6
+#define PING_MAX_BYTES	(256*1024)
+
 #endif